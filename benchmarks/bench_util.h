@@ -0,0 +1,46 @@
+//===-- bench_util.h - Shared timing helpers for benchmarks ----*- C++ -*-===//
+//
+// Minimal wall-clock timing used by the benchmark programs. Each kernel is
+// run a fixed number of times and the best and median times are reported.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace bench {
+
+struct Timing {
+    double best_ms;
+    double median_ms;
+};
+
+template <typename Fn>
+Timing measure(Fn &&fn, int repetitions = 5) {
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    for (int r = 0; r < repetitions; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return {samples.front(), samples[samples.size() / 2]};
+}
+
+inline void report(const char *name, const Timing &t, double baseline_ms = 0.0) {
+    if (baseline_ms > 0.0) {
+        std::printf("%-28s best %9.2f ms  median %9.2f ms  speedup %5.2fx\n",
+                    name, t.best_ms, t.median_ms, baseline_ms / t.best_ms);
+    } else {
+        std::printf("%-28s best %9.2f ms  median %9.2f ms\n",
+                    name, t.best_ms, t.median_ms);
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,127 @@
+// Sample kernels vs the library calls the idiom recognizer emits for them,
+// using the Matrix layout and kernels from sample/src/matrix_operations.cpp.
+//
+// Usage: blas_idiom_bench [N]
+// The vector<vector> Matrix loads a row pointer per row, so the recognizer
+// only matches the contiguous row-major form of each kernel; that form is
+// what the BLAS columns use.
+
+#include "bench_util.h"
+#include <cblas.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+class Matrix {
+private:
+    std::vector<std::vector<double>> data;
+    size_t rows, cols;
+
+public:
+    Matrix(size_t r, size_t c) : data(r, std::vector<double>(c, 0.0)), rows(r), cols(c) {}
+
+    double& operator()(size_t i, size_t j) { return data[i][j]; }
+    const double& operator()(size_t i, size_t j) const { return data[i][j]; }
+
+    size_t getRows() const { return rows; }
+    size_t getCols() const { return cols; }
+};
+
+// Kernels as written in sample/src/matrix_operations.cpp
+void matrixAdd(const Matrix& A, const Matrix& B, Matrix& C) {
+    for (size_t i = 0; i < A.getRows(); i++) {
+        for (size_t j = 0; j < A.getCols(); j++) {
+            C(i, j) = A(i, j) + B(i, j);
+        }
+    }
+}
+
+double matrixFrobeniusNorm(const Matrix& A) {
+    double sum = 0.0;
+    for (size_t i = 0; i < A.getRows(); i++) {
+        for (size_t j = 0; j < A.getCols(); j++) {
+            sum += A(i, j) * A(i, j);
+        }
+    }
+    return sqrt(sum);
+}
+
+void matrixMultiply(const Matrix& A, const Matrix& B, Matrix& C) {
+    for (size_t i = 0; i < A.getRows(); i++) {
+        for (size_t j = 0; j < B.getCols(); j++) {
+            double sum = 0.0;
+            for (size_t k = 0; k < A.getCols(); k++) {
+                sum += A(i, k) * B(k, j);
+            }
+            C(i, j) = sum;
+        }
+    }
+}
+
+// Replacements reported for the row-major forms of the kernels above:
+//   C = A + B  ->  memcpy(C, A, n * sizeof(double)); cblas_daxpy(n, 1.0, B, 1, C, 1);
+//   sum += a*a ->  sum += cblas_ddot(n, A, 1, A, 1);
+//   C = A * B  ->  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+//                              N, N, N, 1.0, A, N, B, N, 0.0, C, N);
+void blasAdd(const double *A, const double *B, double *C, size_t n) {
+    std::memcpy(C, A, n * sizeof(double));
+    cblas_daxpy(n, 1.0, B, 1, C, 1);
+}
+
+double blasFrobeniusNorm(const double *A, size_t n) {
+    return sqrt(cblas_ddot(n, A, 1, A, 1));
+}
+
+void blasMultiply(const double *A, const double *B, double *C, size_t N) {
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, N, N, N, 1.0, A, N, B, N,
+                0.0, C, N);
+}
+
+static double maxDifference(const Matrix& M, const std::vector<double>& flat) {
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < M.getRows(); i++)
+        for (size_t j = 0; j < M.getCols(); j++)
+            maxDiff = std::max(maxDiff, std::fabs(M(i, j) - flat[i * M.getCols() + j]));
+    return maxDiff;
+}
+
+int main(int argc, char **argv) {
+    const size_t N = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+
+    Matrix A(N, N), B(N, N), C1(N, N);
+    std::vector<double> a(N * N), b(N * N), c(N * N);
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = 0; j < N; j++) {
+            A(i, j) = a[i * N + j] = static_cast<double>((i + j) % 17) * 0.5;
+            B(i, j) = b[i * N + j] = static_cast<double>((i * j + 1) % 13) * 0.25;
+        }
+    }
+
+    std::cout << "Sample kernels vs BLAS/libc, " << N << "x" << N << "\n";
+    bool ok = true;
+
+    bench::Timing add = bench::measure([&] { matrixAdd(A, B, C1); });
+    bench::Timing addBlas = bench::measure([&] { blasAdd(a.data(), b.data(), c.data(), N * N); });
+    bench::report("matrixAdd", add);
+    bench::report("memcpy + cblas_daxpy", addBlas, add.best_ms);
+    ok &= maxDifference(C1, c) == 0.0;
+
+    double norm = 0.0, normBlas = 0.0;
+    bench::Timing frob = bench::measure([&] { norm = matrixFrobeniusNorm(A); });
+    bench::Timing frobBlas = bench::measure([&] { normBlas = blasFrobeniusNorm(a.data(), N * N); });
+    bench::report("matrixFrobeniusNorm", frob);
+    bench::report("cblas_ddot", frobBlas, frob.best_ms);
+    ok &= std::fabs(norm - normBlas) <= 1e-12 * norm;
+
+    bench::Timing mul = bench::measure([&] { matrixMultiply(A, B, C1); }, 3);
+    bench::Timing mulBlas = bench::measure([&] { blasMultiply(a.data(), b.data(), c.data(), N); }, 3);
+    bench::report("matrixMultiply", mul);
+    bench::report("cblas_dgemm", mulBlas, mul.best_ms);
+    double maxDiff = maxDifference(C1, c);
+    std::cout << "max |naive - dgemm| = " << maxDiff << "\n";
+    ok &= maxDiff < 1e-9 * N;
+
+    return ok ? 0 : 1;
+}
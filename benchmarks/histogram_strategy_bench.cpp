@@ -0,0 +1,147 @@
+// Crossover points between the three race-free forms of a scatter update
+// h[idx[i]] += w[i] that the scatter-update analysis chooses from:
+//   reduction  #pragma omp parallel for reduction(+:h[0:N])
+//   privatized per-thread copies merged in a pairwise tree
+//   atomic     #pragma omp atomic update on every element
+//
+// Usage: histogram_strategy_bench [updates] [threads]
+// Sweeps the number of bins from 16 to 16M. Small arrays favour the
+// reduction, mid-sized ones the privatized copies, and once threads x bins
+// outgrows the updates (or the caches) atomics win. Array-section
+// reductions above 64K bins are skipped: their copies live on thread stacks.
+
+#include "bench_util.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#else
+inline int omp_get_num_threads() { return 1; }
+inline int omp_get_thread_num() { return 0; }
+inline int omp_get_max_threads() { return 1; }
+inline void omp_set_num_threads(int) {}
+#endif
+
+namespace {
+
+constexpr long MaxReductionBins = 1L << 16;
+
+void histSerial(double *h, const std::uint32_t *idx, const double *w, long n) {
+    for (long i = 0; i < n; ++i) h[idx[i]] += w[i];
+}
+
+void histReduction(double *h, const std::uint32_t *idx, const double *w, long n, long NB) {
+    #pragma omp parallel for reduction(+:h[0:NB])
+    for (long i = 0; i < n; ++i) h[idx[i]] += w[i];
+}
+
+// The privatized patch as the analysis emits it
+void histPrivatized(double *h, const std::uint32_t *idx, const double *w, long n, long NB) {
+    std::vector<double> priv;
+    #pragma omp parallel
+    {
+        const int nt = omp_get_num_threads(), tid = omp_get_thread_num();
+        #pragma omp single
+        priv.assign((size_t)nt * NB, 0);
+        double *mine = priv.data() + (size_t)tid * NB;
+        #pragma omp for schedule(static)
+        for (long i = 0; i < n; ++i)
+            mine[idx[i]] += w[i];
+        for (int stride = 1; stride < nt; stride *= 2) {
+            #pragma omp for schedule(static)
+            for (long k = 0; k < NB; ++k)
+                for (int t = 0; t + stride < nt; t += 2 * stride)
+                    priv[t * NB + k] += priv[(t + stride) * NB + k];
+        }
+        #pragma omp for schedule(static)
+        for (long k = 0; k < NB; ++k)
+            h[k] += priv[k];
+    }
+}
+
+void histAtomic(double *h, const std::uint32_t *idx, const double *w, long n) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; ++i) {
+        #pragma omp atomic update
+        h[idx[i]] += w[i];
+    }
+}
+
+// Sums are reassociated; compare against the serial result with a tolerance
+bool close(const std::vector<double> &a, const std::vector<double> &b) {
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (std::fabs(a[k] - b[k]) > 1e-9 * (1.0 + std::fabs(b[k]))) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const long n = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 1L << 24;
+    if (argc > 2) omp_set_num_threads(std::atoi(argv[2]));
+    const int threads = omp_get_max_threads();
+
+    std::vector<std::uint32_t> random(n);
+    std::vector<double> w(n);
+    std::uint32_t state = 12345;
+    for (long i = 0; i < n; ++i) {
+        state = state * 1664525u + 1013904223u;
+        random[i] = state;
+        w[i] = (state >> 16 & 0xff) * 0.125;
+    }
+
+    std::cout << "Scatter update h[idx[i]] += w[i], " << n << " updates, " << threads
+              << " threads\n";
+    std::printf("%10s %10s %12s %12s %12s %12s  %s\n", "bins", "bytes", "serial ms",
+                "reduction", "privatized", "atomic", "best");
+    bool ok = true;
+    for (long NB = 16; NB <= (1L << 24); NB *= 16) {
+        std::vector<std::uint32_t> idx(n);
+        for (long i = 0; i < n; ++i) idx[i] = random[i] % NB;
+
+        std::vector<double> expected(NB), h(NB);
+        bench::Timing serial = bench::measure([&] {
+            std::fill(expected.begin(), expected.end(), 0.0);
+            histSerial(expected.data(), idx.data(), w.data(), n);
+        }, 3);
+
+        double ms[3] = {0, 0, 0};
+        const char *names[3] = {"reduction", "privatized", "atomic"};
+        if (NB <= MaxReductionBins) {
+            ms[0] = bench::measure([&] {
+                std::fill(h.begin(), h.end(), 0.0);
+                histReduction(h.data(), idx.data(), w.data(), n, NB);
+            }, 3).best_ms;
+            ok &= close(h, expected);
+        }
+        ms[1] = bench::measure([&] {
+            std::fill(h.begin(), h.end(), 0.0);
+            histPrivatized(h.data(), idx.data(), w.data(), n, NB);
+        }, 3).best_ms;
+        ok &= close(h, expected);
+        ms[2] = bench::measure([&] {
+            std::fill(h.begin(), h.end(), 0.0);
+            histAtomic(h.data(), idx.data(), w.data(), n);
+        }, 3).best_ms;
+        ok &= close(h, expected);
+
+        int best = ms[0] > 0 ? 0 : 1;
+        for (int s = 1; s < 3; ++s) {
+            if (ms[s] < ms[best]) best = s;
+        }
+        char bytes[32];
+        std::snprintf(bytes, sizeof(bytes), "%.0f KiB", NB * sizeof(double) / 1024.0);
+        std::printf("%10ld %10s %12.2f", NB, bytes, serial.best_ms);
+        for (double t : ms) {
+            if (t > 0) std::printf(" %11.2fx", serial.best_ms / t);
+            else std::printf(" %12s", "-");
+        }
+        std::printf("  %s\n", names[best]);
+    }
+    std::cout << (ok ? "results match the serial loop\n" : "MISMATCH against the serial loop\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Producer/consumer loop chains as the pipeline analysis rewrites them, on
+// the QRS detector's derivative -> square -> moving window -> threshold
+// stages (sample/src/real-world/healthcare/ecg_analysis.cpp):
+//   sequential  four loops, each streaming its arrays through memory
+//   fused       one loop running every stage for element i (the window
+//               stage reads only elements <= i, so no shift is needed)
+//   pipeline    the emitted patch: blocks of B elements, one task per stage
+//               and block, depend clauses on per-stage block tokens
+//
+// Usage: pipeline_stages_bench [samples] [block] [threads]
+// The moving window carries a running sum and the threshold stage a count,
+// so neither is a parallel for; the pipeline overlaps them with the
+// parallel stages of later blocks.
+
+#include "bench_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#else
+inline int omp_get_max_threads() { return 1; }
+inline void omp_set_num_threads(int) {}
+#endif
+
+namespace {
+
+constexpr long Window = 30;
+constexpr double Threshold = 1e-4;
+
+struct Result {
+    std::vector<double> derivative, squared, integrated;
+    long above = 0;
+    explicit Result(long n) : derivative(n), squared(n), integrated(n) {}
+};
+
+void stagesSequential(const std::vector<double> &x, Result &r) {
+    const long n = x.size();
+    for (long i = 1; i < n - 1; ++i) r.derivative[i] = (x[i + 1] - x[i - 1]) * 0.5;
+    for (long i = 1; i < n - 1; ++i) r.squared[i] = r.derivative[i] * r.derivative[i];
+    double sum = 0;
+    for (long i = 1; i < n - 1; ++i) {
+        sum += r.squared[i];
+        if (i > Window) sum -= r.squared[i - Window];
+        r.integrated[i] = sum / Window;
+    }
+    long above = 0;
+    for (long i = 1; i < n - 1; ++i) above += r.integrated[i] > Threshold;
+    r.above = above;
+}
+
+void stagesFused(const std::vector<double> &x, Result &r) {
+    const long n = x.size();
+    double sum = 0;
+    long above = 0;
+    for (long i = 1; i < n - 1; ++i) {
+        r.derivative[i] = (x[i + 1] - x[i - 1]) * 0.5;
+        r.squared[i] = r.derivative[i] * r.derivative[i];
+        sum += r.squared[i];
+        if (i > Window) sum -= r.squared[i - Window];
+        r.integrated[i] = sum / Window;
+        above += r.integrated[i] > Threshold;
+    }
+    r.above = above;
+}
+
+// The blocked pipeline patch: stages 0 and 1 are parallel, stage 2 carries
+// sum and reads squared at i-30..i, stage 3 carries the count
+void stagesPipeline(const std::vector<double> &x, Result &r, long B, long W) {
+    const long LO = 1, HI = (long)x.size() - 1;
+    const long NB = std::max(0L, (HI - LO + B - 1) / B);
+    std::vector<char> done(4 * (NB + W + 1));
+    [[maybe_unused]] char *d0 = done.data() + 0 * (NB + W + 1) + W;
+    [[maybe_unused]] char *d1 = done.data() + 1 * (NB + W + 1) + W;
+    [[maybe_unused]] char *d2 = done.data() + 2 * (NB + W + 1) + W;
+    [[maybe_unused]] char *d3 = done.data() + 3 * (NB + W + 1) + W;
+    double sum = 0;
+    long above = 0;
+    #pragma omp parallel
+    #pragma omp single
+    for (long b = 0; b < NB; ++b) {
+        const long lo = LO + b * B, hi = std::min(lo + B, HI);
+        #pragma omp task firstprivate(lo, hi) depend(out: d0[b]) depend(in: d1[b - W])
+        for (long i = lo; i < hi; ++i) r.derivative[i] = (x[i + 1] - x[i - 1]) * 0.5;
+        #pragma omp task firstprivate(lo, hi) depend(out: d1[b]) depend(in: d0[b], d2[b - W])
+        for (long i = lo; i < hi; ++i) r.squared[i] = r.derivative[i] * r.derivative[i];
+        #pragma omp task firstprivate(lo, hi) depend(out: d2[b]) depend(in: d1[b - 1], d1[b], d2[b - 1], d3[b - W])
+        {
+            // Carried values live in locals inside the block
+            double s = sum;
+            for (long i = lo; i < hi; ++i) {
+                s += r.squared[i];
+                if (i > Window) s -= r.squared[i - Window];
+                r.integrated[i] = s / Window;
+            }
+            sum = s;
+        }
+        #pragma omp task firstprivate(lo, hi) depend(out: d3[b]) depend(in: d2[b], d3[b - 1])
+        {
+            long count = 0;
+            for (long i = lo; i < hi; ++i) count += r.integrated[i] > Threshold;
+            above += count;
+        }
+    }
+    r.above = above;
+}
+
+bool same(const Result &a, const Result &b) {
+    return a.above == b.above && a.integrated == b.integrated && a.squared == b.squared;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const long n = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 1L << 24;
+    const long B = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 16384;
+    if (argc > 3) omp_set_num_threads(std::atoi(argv[3]));
+    const int threads = omp_get_max_threads();
+    const long W = std::max(2, threads);
+
+    // Synthetic ECG: a 1.2 Hz beat on a 0.3 Hz baseline with a little noise
+    std::vector<double> x(n);
+    unsigned state = 12345;
+    for (long i = 0; i < n; ++i) {
+        state = state * 1664525u + 1013904223u;
+        double t = i / 360.0;
+        double beat = std::exp(-std::pow(std::fmod(t * 1.2, 1.0) - 0.5, 2) * 800);
+        x[i] = beat + 0.1 * std::sin(2 * M_PI * 0.3 * t) + (state >> 16) * 1e-7;
+    }
+
+    std::cout << "ECG stage chain, " << n << " samples, block " << B << ", " << threads
+              << " threads\n";
+    Result expected(n), fused(n), piped(n);
+    bench::Timing sequential = bench::measure([&] { stagesSequential(x, expected); }, 5);
+    bench::report("sequential stages", sequential);
+    bench::report("fused loop", bench::measure([&] { stagesFused(x, fused); }, 5),
+                  sequential.best_ms);
+    bench::report("task pipeline",
+                  bench::measure([&] { stagesPipeline(x, piped, B, W); }, 5),
+                  sequential.best_ms);
+
+    bool ok = same(fused, expected) && same(piped, expected);
+    std::cout << (ok ? "results match" : "MISMATCH") << " (" << expected.above
+              << " samples above threshold)\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Thread scaling of the runtime/ parallel primitives against their serial
+// loops: scan, compaction, histogram, reduce-by-key and argmin/argmax.
+//
+// Usage: primitives_scaling_bench [N] [max_threads]
+// Runs 1, 2, 4, ... up to max_threads (default 64) threads; counts above
+// the core count show the cost of oversubscription. Each row gives the
+// speedup over the serial loop, one column per primitive.
+
+#include "bench_util.h"
+#include "parallel_primitives.h"
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t NumBins = 256;
+
+auto binOf = [](std::uint32_t x) -> std::size_t { return x % NumBins; };
+auto keep = [](std::uint32_t x) { return (x & 3) == 0; };
+
+struct Results {
+    std::vector<std::uint64_t> scan;
+    std::vector<std::uint32_t> compacted;
+    std::vector<std::uint64_t> histogram;
+    std::vector<std::uint32_t> keys;
+    std::vector<std::uint64_t> sums;
+    prt::MinMaxIndex extremes;
+};
+
+// The loops a programmer writes; the baseline and the reference results
+Results runSerial(const std::vector<std::uint32_t> &data, const std::vector<std::uint32_t> &keys,
+                  bench::Timing (&t)[5]) {
+    const std::size_t n = data.size();
+    Results r;
+    r.scan.resize(n);
+    r.compacted.resize(n);
+    r.histogram.assign(NumBins, 0);
+    r.keys.resize(n);
+    r.sums.resize(n);
+
+    t[0] = bench::measure([&] {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            sum += data[i];
+            r.scan[i] = sum;
+        }
+    });
+    std::size_t kept = 0;
+    t[1] = bench::measure([&] {
+        kept = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            if (keep(data[i])) r.compacted[kept++] = data[i];
+        }
+    });
+    r.compacted.resize(kept);
+    t[2] = bench::measure([&] {
+        std::fill(r.histogram.begin(), r.histogram.end(), 0);
+        for (std::size_t i = 0; i < n; i++) r.histogram[binOf(data[i])]++;
+    });
+    std::size_t runs = 0;
+    t[3] = bench::measure([&] {
+        runs = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            if (i == 0 || keys[i] != keys[i - 1]) {
+                r.keys[runs] = keys[i];
+                r.sums[runs++] = 0;
+            }
+            r.sums[runs - 1] += data[i];
+        }
+    });
+    r.keys.resize(runs);
+    r.sums.resize(runs);
+    t[4] = bench::measure([&] {
+        r.extremes = {0, 0};
+        for (std::size_t i = 1; i < n; i++) {
+            if (data[i] < data[r.extremes.min]) r.extremes.min = i;
+            if (data[r.extremes.max] < data[i]) r.extremes.max = i;
+        }
+    });
+    return r;
+}
+
+bool runParallel(prt::WorkStealingPool &pool, const std::vector<std::uint32_t> &data,
+                 const std::vector<std::uint32_t> &keys, const Results &expected,
+                 bench::Timing (&t)[5]) {
+    const std::size_t n = data.size();
+    Results r;
+    r.scan.resize(n);
+    r.compacted.resize(n);
+    r.histogram.assign(NumBins, 0);
+    r.keys.resize(n);
+    r.sums.resize(n);
+
+    t[0] = bench::measure([&] {
+        prt::parallel_scan(pool, data.begin(), data.end(), r.scan.begin(), std::uint64_t{0},
+                           std::plus<>{});
+    });
+    std::size_t kept = 0;
+    t[1] = bench::measure([&] {
+        kept = prt::parallel_compact(pool, data.begin(), data.end(), r.compacted.begin(), keep) -
+               r.compacted.begin();
+    });
+    r.compacted.resize(kept);
+    t[2] = bench::measure([&] {
+        std::fill(r.histogram.begin(), r.histogram.end(), 0);
+        prt::parallel_histogram(pool, data.begin(), data.end(), r.histogram.data(), NumBins, binOf);
+    });
+    std::size_t runs = 0;
+    t[3] = bench::measure([&] {
+        runs = prt::parallel_reduce_by_key(pool, keys.begin(), keys.end(), data.begin(),
+                                           r.keys.begin(), r.sums.begin(),
+                                           [](std::uint64_t a, std::uint64_t b) { return a + b; });
+    });
+    r.keys.resize(runs);
+    r.sums.resize(runs);
+    t[4] = bench::measure([&] {
+        r.extremes = prt::parallel_argminmax(pool, data.begin(), data.end());
+    });
+
+    return r.scan == expected.scan && r.compacted == expected.compacted &&
+           r.histogram == expected.histogram && r.keys == expected.keys &&
+           r.sums == expected.sums && r.extremes.min == expected.extremes.min &&
+           r.extremes.max == expected.extremes.max;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const std::size_t N = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : std::size_t(1) << 24;
+    const unsigned maxThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+
+    // Pseudo-random values; keys in runs of 1-64 equal elements
+    std::vector<std::uint32_t> data(N), keys(N);
+    std::uint32_t state = 12345, key = 0;
+    for (std::size_t i = 0; i < N; i++) {
+        state = state * 1664525u + 1013904223u;
+        data[i] = state >> 8;
+        if ((state & 63) == 0) key++;
+        keys[i] = key;
+    }
+
+    bench::Timing serial[5];
+    Results expected = runSerial(data, keys, serial);
+    std::cout << "Parallel primitives, " << N << " elements, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    const char *names[5] = {"scan", "compact", "histogram", "reduce_by_key", "argminmax"};
+    for (int k = 0; k < 5; ++k) bench::report(names[k], serial[k]);
+
+    std::printf("\nspeedup over serial\n%7s", "threads");
+    for (const char *name : names) std::printf(" %13s", name);
+    std::printf("\n");
+    bool ok = true;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        prt::WorkStealingPool pool(threads);
+        bench::Timing t[5];
+        ok &= runParallel(pool, data, keys, expected, t);
+        std::printf("%7u", threads);
+        for (int k = 0; k < 5; ++k) std::printf(" %12.2fx", serial[k].best_ms / t[k].best_ms);
+        std::printf("\n");
+    }
+    std::cout << (ok ? "results match the serial loops\n" : "MISMATCH against the serial loops\n");
+    return ok ? 0 : 1;
+}
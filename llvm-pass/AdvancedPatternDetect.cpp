@@ -5,6 +5,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "AdvancedPatternDetect.h"
+#include "PipelineAnalysis.h"
+#include "TaskGraph.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Constants.h"
@@ -394,6 +399,33 @@ std::string AdvancedPatternDetector::generateOptimizedPatch(AdvancedPattern patt
   }
 }
 
+bool AdvancedPatternDetector::isTaskParallelPattern(Function &F) {
+  if (F.isDeclaration()) {
+    return false;
+  }
+  // SE belongs to the pass's LoopInfo: trip counts stay at the default
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  TaskGraphBuilder Builder(AA, DT, LI, nullptr);
+  return TaskGraphBuilder::isProfitable(Builder.build(F));
+}
+
+bool AdvancedPatternDetector::isPipelineParallelPattern(Function &F) {
+  if (F.isDeclaration()) {
+    return false;
+  }
+  // Stages are matched on address recurrences of their own loops, so the
+  // loops and scalar evolution must come from the same LoopInfo
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  AssumptionCache AC(F);
+  TargetLibraryInfoImpl TLII(Triple(F.getParent()->getTargetTriple()));
+  TargetLibraryInfo TLI(TLII, &F);
+  ScalarEvolution LocalSE(F, TLI, AC, DT, LI);
+  PipelineAnalyzer Analyzer(LocalSE, AA, DT, LI, CacheModel(), 1);
+  return !Analyzer.analyze(F).empty();
+}
+
 double AdvancedPatternDetector::calculatePatternConfidence(Loop *L, AdvancedPattern pattern) {
   // Calculate confidence based on multiple factors
   double confidence = 0.5; // Base confidence
@@ -0,0 +1,66 @@
+//===-- AliasVersioning.h - Runtime alias-check loop versioning -*- C++ -*-===//
+//
+// Uses LoopAccessInfo to find the minimal set of pointer-range overlap checks
+// under which a loop over may-alias pointers has no cross-iteration
+// dependence, and generates a versioned parallel/serial patch.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ALIASVERSIONING_H
+#define LLVM_ALIASVERSIONING_H
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Dominators.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// One pointer-range overlap test; the loop is safe if the ranges
+/// [LowA, HighA) and [LowB, HighB) are disjoint.
+struct AliasRangeCheck {
+  std::string LowA, HighA, LowB, HighB;   // C expressions, empty if unknown
+  std::string DescriptionA, DescriptionB; // Pointer names for messages
+};
+
+/// Result of alias-versioning analysis for one innermost loop.
+struct AliasVersioningInfo {
+  bool NeedsChecks = false;    // Some pointers may alias
+  bool SafeWithChecks = false; // Checks suffice to make the loop parallel
+  bool Printable = false;      // Every check and loop bound prints as C
+  std::vector<AliasRangeCheck> Checks;
+  std::string LoopVar, LoopLo, LoopHi; // Header of the versioned loops
+  std::string Reason;
+};
+
+/// Runtime alias-check versioning on top of LoopAccessInfo.
+class AliasVersioningAnalyzer {
+public:
+  AliasVersioningAnalyzer(ScalarEvolution &SE, AAResults &AA,
+                          DominatorTree &DT, LoopInfo &LI,
+                          const TargetLibraryInfo &TLI, DependenceInfo &DI)
+    : SE(SE), AA(AA), DT(DT), LI(LI), TLI(TLI), DI(DI) {}
+
+  /// Analyze innermost loop \p L.
+  AliasVersioningInfo analyze(Loop *L);
+
+  /// Render "if (disjoint) { parallel } else { serial }" for \p Info, or
+  /// only the required disjointness as comments if \p Info is not Printable.
+  std::string generateVersionedPatch(const AliasVersioningInfo &Info) const;
+
+private:
+  ScalarEvolution &SE;
+  AAResults &AA;
+  DominatorTree &DT;
+  LoopInfo &LI;
+  const TargetLibraryInfo &TLI;
+  DependenceInfo &DI;
+};
+
+} // namespace llvm
+
+#endif // LLVM_ALIASVERSIONING_H
@@ -0,0 +1,223 @@
+//===-- DependenceProfile.cpp - Shadow-memory dependence profiler -*- C++ -*-===//
+//
+// For each watched loop L with preheader P and exit blocks E:
+//   P:      __parallel_deps_loop_begin(site)
+//   header: __parallel_deps_iteration(site)
+//   E:      __parallel_deps_loop_end(site)
+// and before every load, store, memset and memcpy of the module:
+//   __parallel_deps_access(addr, size, line, is_write)
+// Accesses are reported from every function so callees defined in the module
+// are observed too. Stack slots of functions without a watched loop are
+// private to each call and are left out. Calls to external functions that
+// may write memory cannot be observed; the site records how many each loop
+// makes so the report can say the evidence is partial.
+//
+//===----------------------------------------------------------------------===//
+
+#include "DependenceProfile.h"
+#include "LoopProfile.h"
+#include "PatternDetect.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace {
+
+/// One watched loop: its row in the site table.
+struct DependenceSite {
+  Loop *L;
+  std::string Id, File, Function;
+  unsigned Line;
+  unsigned UnobservedCalls;
+};
+
+/// A memory access to report: address, size in bytes and direction.
+struct Access {
+  Instruction *I;
+  Value *Ptr;
+  Value *Size;
+  bool IsWrite;
+};
+
+} // namespace
+
+bool DependenceProfilePass::parseOptions(StringRef Params,
+                                         std::vector<std::string> &Loops) {
+  SmallVector<StringRef, 4> Entries;
+  Params.split(Entries, ';', -1, false);
+  for (StringRef Entry : Entries) {
+    auto [Key, Value] = Entry.split('=');
+    if (Key != "loop" || Value.empty()) {
+      errs() << "parallel-deps: expected loop=<file:line:function>, got '"
+             << Entry << "'\n";
+      return false;
+    }
+    Loops.push_back(Value.str());
+  }
+  return true;
+}
+
+// Calls whose memory effects the shadow table cannot see
+static unsigned countUnobservedCalls(const Loop &L) {
+  unsigned Count = 0;
+  for (BasicBlock *BB : L.blocks()) {
+    for (Instruction &I : *BB) {
+      auto *CB = dyn_cast<CallBase>(&I);
+      if (!CB || isa<IntrinsicInst>(CB) || CB->onlyReadsMemory())
+        continue;
+      Function *Callee = CB->getCalledFunction();
+      if (!Callee || Callee->isDeclaration())
+        ++Count;
+    }
+  }
+  return Count;
+}
+
+static void collectAccesses(Function &F, bool KeepStack,
+                            std::vector<Access> &Accesses) {
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  Type *I64 = Type::getInt64Ty(F.getContext());
+  auto Add = [&](Instruction *I, Value *Ptr, Value *Size, bool IsWrite) {
+    if (Ptr->getType()->getPointerAddressSpace() != 0)
+      return;
+    const Value *Base = getUnderlyingObject(Ptr);
+    if (isa<AllocaInst>(Base) && !KeepStack)
+      return;
+    if (auto *GV = dyn_cast<GlobalVariable>(Base))
+      if (GV->isConstant())
+        return;
+    Accesses.push_back({I, Ptr, Size, IsWrite});
+  };
+  for (Instruction &I : instructions(F)) {
+    if (auto *LD = dyn_cast<LoadInst>(&I)) {
+      if (!LD->isAtomic())
+        Add(LD, LD->getPointerOperand(),
+            ConstantInt::get(I64, DL.getTypeStoreSize(LD->getType())), false);
+    } else if (auto *ST = dyn_cast<StoreInst>(&I)) {
+      if (!ST->isAtomic())
+        Add(ST, ST->getPointerOperand(),
+            ConstantInt::get(
+                I64, DL.getTypeStoreSize(ST->getValueOperand()->getType())),
+            true);
+    } else if (auto *MT = dyn_cast<MemTransferInst>(&I)) {
+      Add(MT, MT->getRawSource(), MT->getLength(), false);
+      Add(MT, MT->getRawDest(), MT->getLength(), true);
+    } else if (auto *MS = dyn_cast<MemSetInst>(&I)) {
+      Add(MS, MS->getRawDest(), MS->getLength(), true);
+    }
+  }
+}
+
+PreservedAnalyses DependenceProfilePass::run(Module &M,
+                                             ModuleAnalysisManager &MAM) {
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  LLVMContext &Ctx = M.getContext();
+  StringSet<> Wanted;
+  for (const std::string &Id : Loops)
+    Wanted.insert(Id);
+
+  std::vector<DependenceSite> Sites;
+  std::vector<Access> Accesses;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+    size_t First = Sites.size();
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      auto [File, Line] = PatternDetection::getLoopLocation(L);
+      std::string Id =
+          PatternDetection::getCandidateId(File, Line, F.getName().str());
+      if (!Wanted.empty() && !Wanted.count(Id))
+        continue;
+      if (!isProfilableLoop(*L)) {
+        errs() << "parallel-deps: cannot watch " << Id
+               << ": not in loop-simplify form\n";
+        continue;
+      }
+      Sites.push_back({L, Id, File, F.getName().str(),
+                       static_cast<unsigned>(Line), countUnobservedCalls(*L)});
+    }
+    collectAccesses(F, Sites.size() > First, Accesses);
+  }
+  if (Sites.empty()) {
+    errs() << "parallel-deps: no loop to watch\n";
+    return PreservedAnalyses::all();
+  }
+
+  Type *I32 = Type::getInt32Ty(Ctx);
+  Type *I64 = Type::getInt64Ty(Ctx);
+  Type *I8Ptr = Type::getInt8PtrTy(Ctx);
+  Type *Void = Type::getVoidTy(Ctx);
+
+  // { id, file, function, line, unobserved calls } per site; the runtime
+  // keys its statistics by the row's address
+  IRBuilder<> B(Ctx);
+  StructType *SiteTy = StructType::get(Ctx, {I8Ptr, I8Ptr, I8Ptr, I32, I32});
+  std::vector<Constant *> Rows;
+  for (const DependenceSite &Site : Sites) {
+    Rows.push_back(ConstantStruct::get(
+        SiteTy,
+        {B.CreateGlobalStringPtr(Site.Id, "deps.id", 0, &M),
+         B.CreateGlobalStringPtr(Site.File, "deps.file", 0, &M),
+         B.CreateGlobalStringPtr(Site.Function, "deps.function", 0, &M),
+         ConstantInt::get(I32, Site.Line),
+         ConstantInt::get(I32, Site.UnobservedCalls)}));
+  }
+  ArrayType *SitesTy = ArrayType::get(SiteTy, Rows.size());
+  auto *SiteTable = new GlobalVariable(
+      M, SitesTy, true, GlobalValue::InternalLinkage,
+      ConstantArray::get(SitesTy, Rows), "__parallel_deps_sites");
+
+  FunctionCallee AccessFn = M.getOrInsertFunction(
+      "__parallel_deps_access", Void, I8Ptr, I64, I32, I32);
+  FunctionCallee BeginFn =
+      M.getOrInsertFunction("__parallel_deps_loop_begin", Void, I8Ptr);
+  FunctionCallee IterationFn =
+      M.getOrInsertFunction("__parallel_deps_iteration", Void, I8Ptr);
+  FunctionCallee EndFn =
+      M.getOrInsertFunction("__parallel_deps_loop_end", Void, I8Ptr);
+
+  // Accesses first, so the iteration and exit markers go in front of them
+  for (const Access &A : Accesses) {
+    IRBuilder<> At(A.I);
+    const DebugLoc &DL = A.I->getDebugLoc();
+    At.CreateCall(AccessFn,
+                  {At.CreatePointerCast(A.Ptr, I8Ptr),
+                   At.CreateZExtOrTrunc(A.Size, I64),
+                   At.getInt32(DL ? DL.getLine() : 0),
+                   At.getInt32(A.IsWrite)});
+  }
+
+  for (unsigned S = 0; S < Sites.size(); ++S) {
+    Loop *L = Sites[S].L;
+    Constant *Idx[] = {ConstantInt::get(I32, 0), ConstantInt::get(I32, S)};
+    Constant *Site = ConstantExpr::getBitCast(
+        ConstantExpr::getInBoundsGetElementPtr(SitesTy, SiteTable, Idx),
+        I8Ptr);
+
+    IRBuilder<> Pre(L->getLoopPreheader()->getTerminator());
+    Pre.CreateCall(BeginFn, {Site});
+    IRBuilder<> Header(&*L->getHeader()->getFirstInsertionPt());
+    Header.CreateCall(IterationFn, {Site});
+
+    SmallVector<BasicBlock *, 4> Exits;
+    L->getExitBlocks(Exits);
+    for (BasicBlock *Exit : Exits) {
+      IRBuilder<> Out(&*Exit->getFirstInsertionPt());
+      Out.CreateCall(EndFn, {Site});
+    }
+  }
+
+  errs() << "parallel-deps: watching " << Sites.size() << " loops, "
+         << Accesses.size() << " memory accesses instrumented\n";
+  return PreservedAnalyses::none();
+}
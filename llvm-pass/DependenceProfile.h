@@ -0,0 +1,40 @@
+//===-- DependenceProfile.h - Shadow-memory dependence profiler -*- C++ -*-===//
+//
+// Instrumentation mode for loops the static detector cannot decide (indirect
+// subscripts, pointer chasing, opaque aliasing). Selected loops mark their
+// executions and iterations, and every load and store of the module reports
+// its address, so runtime/dependence_profile.cpp can record the last writer
+// and readers of each address in a shadow hash table and observe
+// cross-iteration RAW, WAR and WAW conflicts, with their source lines.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DEPENDENCEPROFILE_H
+#define LLVM_DEPENDENCEPROFILE_H
+
+#include "llvm/IR/PassManager.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// Module pass behind -passes=parallel-deps. With no parameters every loop
+/// in loop-simplify form is watched; "loop=<candidate id>" (repeatable)
+/// restricts it to those candidates.
+class DependenceProfilePass : public PassInfoMixin<DependenceProfilePass> {
+public:
+  explicit DependenceProfilePass(std::vector<std::string> Loops = {})
+    : Loops(std::move(Loops)) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+
+  /// Parse "loop=file:line:function;loop=...".
+  static bool parseOptions(StringRef Params, std::vector<std::string> &Loops);
+
+private:
+  std::vector<std::string> Loops;
+};
+
+} // namespace llvm
+
+#endif // LLVM_DEPENDENCEPROFILE_H
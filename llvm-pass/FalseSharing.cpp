@@ -0,0 +1,294 @@
+//===-- FalseSharing.cpp - Cache-line sharing between threads ---*- C++ -*-===//
+//
+// For the parallel loop P and each store with address {start,+,s}<P>:
+//   |s| < line  iterations i and i+1 may write the same line
+//   chunk C = line / gcd(|s|, line) iterations spans whole lines, so chunks
+//   of C (from a line-aligned start) never share one
+// With N iterations over T threads a static block is N/T iterations; below
+// C every thread shares its lines with its neighbours.
+//
+//===----------------------------------------------------------------------===//
+
+#include "FalseSharing.h"
+#include "PatternDetect.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <sstream>
+
+using namespace llvm;
+
+static std::string getCTypeName(Type *Ty) {
+  if (Ty->isFloatTy())
+    return "float";
+  if (Ty->isDoubleTy())
+    return "double";
+  if (Ty->isIntegerTy(8))
+    return "char";
+  if (Ty->isIntegerTy(16))
+    return "short";
+  if (Ty->isIntegerTy(32))
+    return "int";
+  if (Ty->isIntegerTy(64))
+    return "long";
+  if (Ty->isPointerTy())
+    return "pointer";
+  return "";
+}
+
+/// Name of the struct whose field \p Ptr addresses, "" for plain elements.
+static std::string getRecordName(Value *Ptr) {
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  if (!GEP || GEP->getNumIndices() < 2)
+    return "";
+  auto *ST = dyn_cast<StructType>(GEP->getSourceElementType());
+  if (!ST)
+    return "";
+  if (!ST->hasName())
+    return "struct";
+  StringRef Name = ST->getName();
+  Name.consume_front("struct.");
+  Name.consume_front("class.");
+  return Name.str();
+}
+
+FalseSharingInfo FalseSharingAnalyzer::analyze(Loop &L,
+                                               ArrayRef<Loop *> Collapsed) {
+  FalseSharingInfo Info;
+  Info.LineSize = Cache.LineSize;
+  Loop *Par = Collapsed.empty() ? &L : Collapsed.back();
+  const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+
+  Loop *Root = &L;
+  uint64_t Trips = 1;
+  for (Loop *Level : Collapsed.empty() ? ArrayRef<Loop *>(Root) : Collapsed) {
+    unsigned TC = SE.getSmallConstantTripCount(Level);
+    Trips = TC ? Trips * TC : 0;
+  }
+  if (Trips)
+    Info.TripCount = Trips;
+
+  std::set<std::tuple<std::string, unsigned, int64_t>> Seen;
+  const int64_t Line = static_cast<int64_t>(Info.LineSize);
+  for (BasicBlock *BB : Par->blocks()) {
+    for (Instruction &I : *BB) {
+      auto *SI = dyn_cast<StoreInst>(&I);
+      if (!SI)
+        continue;
+      Value *Ptr = SI->getPointerOperand();
+      // Addresses that move in inner loops: their position at the inner
+      // loops' first iteration is what moves with P
+      const SCEV *S = SE.getSCEV(Ptr);
+      while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+        if (AR->getLoop() == Par || !Par->contains(AR->getLoop()))
+          break;
+        S = AR->getStart();
+      }
+      auto *AR = dyn_cast<SCEVAddRecExpr>(S);
+      if (!AR || AR->getLoop() != Par || !AR->isAffine())
+        continue;
+      auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+      if (!Step)
+        continue;
+      // Stride 0 is one location for every iteration: a dependence, not
+      // false sharing
+      int64_t Stride = Step->getAPInt().getSExtValue();
+      if (Stride == 0 || std::abs(Stride) >= Line)
+        continue;
+
+      SharedLineStore Store;
+      Store.Array =
+          PatternDetection::getVariableName(getUnderlyingObject(Ptr));
+      Store.ElemType = getCTypeName(SI->getValueOperand()->getType());
+      Store.Record = getRecordName(Ptr);
+      Store.StoreSize =
+          DL.getTypeStoreSize(SI->getValueOperand()->getType()).getFixedSize();
+      Store.Stride = Stride;
+      Store.Repeated = any_of(Par->getSubLoops(),
+                              [&](Loop *Inner) { return Inner->contains(BB); });
+      Store.Line = SI->getDebugLoc() ? SI->getDebugLoc().getLine() : 0;
+
+      const SCEV *Base = SE.getPointerBase(AR->getStart());
+      auto *Offset =
+          dyn_cast<SCEVConstant>(SE.getMinusSCEV(AR->getStart(), Base));
+      if (auto *U = dyn_cast<SCEVUnknown>(Base)) {
+        uint64_t BaseAlign = U->getValue()->getPointerAlignment(DL).value();
+        Store.Aligned = Offset && BaseAlign >= Info.LineSize &&
+                        Offset->getAPInt().getSExtValue() % Line == 0;
+      }
+
+      if (!Seen.insert({Store.Array, Store.Line, Stride}).second)
+        continue;
+      Info.MinChunk = std::max<unsigned>(
+          Info.MinChunk, Line / std::gcd(std::abs(Stride), Line));
+      Info.Stores.push_back(std::move(Store));
+    }
+  }
+  if (Info.Stores.empty())
+    return Info;
+
+  bool Repeated = any_of(Info.Stores,
+                         [](const SharedLineStore &S) { return S.Repeated; });
+  bool Records = any_of(Info.Stores,
+                        [](const SharedLineStore &S) { return !S.Record.empty(); });
+  uint64_t Block = Trips ? (Trips + Threads - 1) / Threads : 0;
+
+  std::ostringstream Reason;
+  const SharedLineStore &First = Info.Stores.front();
+  Reason << (First.Array.empty() ? "a store" : First.Array) << " advances "
+         << std::abs(First.Stride) << " bytes per iteration, "
+         << Info.LineSize / std::abs(First.Stride)
+         << " iterations per cache line";
+  if (Trips && Block < Info.MinChunk) {
+    Info.Risk = "high";
+    Info.UseChunk = Trips >= 2 * uint64_t(Info.MinChunk);
+    Info.Padding = !Info.UseChunk;
+    Reason << "; " << Trips << " iterations over " << Threads
+           << " threads leave each thread less than a line";
+  } else if (Repeated) {
+    Info.Risk = "moderate";
+    Info.Padding = Records;
+    Reason << "; written in an inner loop, so lines at chunk edges are "
+              "contended for the whole inner loop";
+  } else {
+    Info.Risk = "low";
+    Reason << "; static blocks share lines only at their edges";
+  }
+  Info.Reason = Reason.str();
+  return Info;
+}
+
+/// "schedule(kind[, chunk])" of a directive line, split into its parts.
+static bool parseSchedule(StringRef Directive, size_t &Begin, size_t &End,
+                          StringRef &Kind, StringRef &Chunk) {
+  Begin = Directive.find("schedule(");
+  if (Begin == StringRef::npos)
+    return false;
+  End = Directive.find(')', Begin);
+  if (End == StringRef::npos)
+    return false;
+  StringRef Args = Directive.slice(Begin + strlen("schedule("), End);
+  std::tie(Kind, Chunk) = Args.split(',');
+  Kind = Kind.trim();
+  Chunk = Chunk.trim();
+  ++End;
+  return true;
+}
+
+unsigned FalseSharingAnalyzer::fitChunk(const FalseSharingInfo &Info,
+                                        StringRef Kind, unsigned Chunk) {
+  if (Info.Risk == "none" || Info.MinChunk == 0)
+    return Chunk;
+  // dynamic and guided default to chunks of one iteration; plain static
+  // blocks only need a chunk when a thread's block is under a line
+  unsigned Current = Chunk || Kind == "static" ? Chunk : 1;
+  if (Current == 0)
+    return Info.UseChunk ? Info.MinChunk : Chunk;
+  if (Current % Info.MinChunk == 0)
+    return Chunk;
+  return (Current + Info.MinChunk - 1) / Info.MinChunk * Info.MinChunk;
+}
+
+void FalseSharingAnalyzer::applyToPatch(const FalseSharingInfo &Info,
+                                        std::string &Patch) {
+  if (Info.Risk == "none" || Info.MinChunk == 0)
+    return;
+
+  std::vector<std::string> Lines;
+  std::istringstream In(Patch);
+  for (std::string Text; std::getline(In, Text);)
+    Lines.push_back(Text);
+  auto Directive = find_if(Lines, [](const std::string &Text) {
+    StringRef T = StringRef(Text).trim();
+    return T.startswith("#pragma omp") && T.contains(" for");
+  });
+  if (Directive == Lines.end())
+    return;
+
+  const std::string C = std::to_string(Info.MinChunk);
+  std::string Arrays;
+  bool Misaligned = false;
+  for (const SharedLineStore &Store : Info.Stores) {
+    Misaligned |= !Store.Aligned;
+    if (!Store.Array.empty() && Arrays.find(Store.Array) == std::string::npos)
+      Arrays += (Arrays.empty() ? "" : ", ") + Store.Array;
+  }
+  if (Arrays.empty())
+    Arrays = "the stored array";
+
+  const std::string BlockNote =
+      "// Note: false sharing - each thread's block is under a " +
+      std::to_string(Info.LineSize) + "-byte line of " + Arrays +
+      "; chunks of " + C + " iterations keep threads on separate lines";
+
+  std::vector<std::string> Notes;
+  size_t Begin, End;
+  StringRef Kind, Chunk;
+  bool Chunked = false;
+  if (parseSchedule(*Directive, Begin, End, Kind, Chunk)) {
+    unsigned Current = 0;
+    bool Numeric = Chunk.empty() || !Chunk.getAsInteger(10, Current);
+    unsigned Rounded = Numeric ? fitChunk(Info, Kind, Current) : Current;
+    if (Rounded != Current) {
+      Directive->replace(Begin, End - Begin,
+                         "schedule(" + Kind.str() + ", " +
+                             std::to_string(Rounded) + ")");
+      if (Current == 0 && Kind == "static")
+        Notes.push_back(BlockNote);
+      else
+        Notes.push_back("// Note: chunk rounded up to " +
+                        std::to_string(Rounded) + " iterations so chunks of " +
+                        Arrays + " do not share " +
+                        std::to_string(Info.LineSize) + "-byte lines");
+      Chunked = true;
+    } else if (!Numeric) {
+      Notes.push_back("// Note: keep the chunk a multiple of " + C +
+                      " iterations so chunks of " + Arrays +
+                      " do not share cache lines");
+    }
+  } else if (Info.UseChunk) {
+    *Directive += " schedule(static, " + C + ")";
+    Notes.push_back(BlockNote);
+    Chunked = true;
+  }
+
+  if (Info.Risk == "moderate") {
+    Notes.push_back("// Note: false sharing - " + Arrays +
+                    " is stored inside an inner loop at every chunk edge; "
+                    "accumulate in a local and store once, or use chunks that "
+                    "are multiples of " + C + " iterations");
+    Chunked = true;
+  }
+  if (Info.Padding) {
+    std::string Record;
+    for (const SharedLineStore &Store : Info.Stores)
+      if (!Store.Record.empty())
+        Record = Store.Record;
+    Notes.push_back(
+        "// Note: false sharing - pad each element of " + Arrays + " to " +
+        std::to_string(Info.LineSize) + " bytes (" +
+        (Record.empty() ? std::string("struct alignas(") +
+                              std::to_string(Info.LineSize) + ") { value; }"
+                        : "alignas(" + std::to_string(Info.LineSize) + ") on " +
+                              Record) +
+        ") so threads never write the same line");
+  }
+  if (Chunked && Misaligned) {
+    Notes.push_back("// Note: allocate " + Arrays + " " +
+                    std::to_string(Info.LineSize) +
+                    "-byte aligned (aligned_alloc or alignas) so chunk edges "
+                    "fall on line edges");
+  }
+
+  Lines.insert(std::next(Directive), Notes.begin(), Notes.end());
+  std::string Out;
+  for (const std::string &Text : Lines)
+    Out += Text + "\n";
+  if (!Out.empty() && (Patch.empty() || Patch.back() != '\n'))
+    Out.pop_back();
+  Patch = std::move(Out);
+}
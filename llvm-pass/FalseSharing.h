@@ -0,0 +1,83 @@
+//===-- FalseSharing.h - Cache-line sharing between threads -----*- C++ -*-===//
+//
+// A loop without dependences can still slow down in parallel when
+// iterations that run on different threads write the same cache line:
+// per-element struct fields, small floats under fine-grained schedules, or
+// per-thread slots of a small array. The analyzer compares each store's
+// stride with respect to the parallelized loop against the cache line,
+// derives the chunk of iterations that covers whole lines, and rates how
+// often chunk boundaries are written: only at the edges of large static
+// blocks (low), over a whole inner loop at every edge (moderate), or by
+// every thread all the time because a thread's block is smaller than a
+// line (high).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_FALSESHARING_H
+#define LLVM_FALSESHARING_H
+
+#include "TilingAdvisor.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// A store whose consecutive iterations are less than a line apart.
+struct SharedLineStore {
+  std::string Array;       // Stored-to array, "" if unnamed
+  std::string ElemType;    // C type of the stored value
+  std::string Record;      // Struct the stored field belongs to, if any
+  uint64_t StoreSize = 0;
+  int64_t Stride = 0;      // Bytes between consecutive iterations
+  bool Repeated = false;   // Stored in an inner loop, many times per iteration
+  bool Aligned = false;    // The first iteration's address starts a line
+  unsigned Line = 0;
+};
+
+struct FalseSharingInfo {
+  std::vector<SharedLineStore> Stores;
+  std::string Risk = "none"; // none, low, moderate, high
+  uint64_t LineSize = 64;
+  unsigned MinChunk = 0;     // Iterations per chunk that fill whole lines
+  Optional<uint64_t> TripCount;
+  bool UseChunk = false;     // schedule(static, MinChunk) belongs in the pragma
+  bool Padding = false;      // Pad elements to a line instead
+  std::string Reason;
+};
+
+class FalseSharingAnalyzer {
+public:
+  FalseSharingAnalyzer(ScalarEvolution &SE, const CacheModel &Cache,
+                       unsigned Threads)
+    : SE(SE), Cache(Cache), Threads(Threads) {}
+
+  /// Stores of \p L (and of the loops inside it) whose addresses advance by
+  /// less than a line per iteration of \p L, and the risk they carry when
+  /// \p L is the parallel loop. \p Collapsed are the loops collapsed with
+  /// it, outermost first; the innermost of them sets the strides.
+  FalseSharingInfo analyze(Loop &L, ArrayRef<Loop *> Collapsed = {});
+
+  /// Round the chunk of a fine-grained schedule clause up to whole lines,
+  /// or add (or complete) schedule(static, MinChunk) when the risk calls
+  /// for it, and note the padding and alignment advice under the directive.
+  static void applyToPatch(const FalseSharingInfo &Info, std::string &Patch);
+
+  /// Chunk of a schedule(\p Kind, \p Chunk) clause once applyToPatch has
+  /// rounded it up to whole lines; dynamic and guided default to 1, and a
+  /// chunkless static clause gets MinChunk when UseChunk is set.
+  static unsigned fitChunk(const FalseSharingInfo &Info, StringRef Kind,
+                           unsigned Chunk);
+
+private:
+  ScalarEvolution &SE;
+  CacheModel Cache;
+  unsigned Threads;
+};
+
+} // namespace llvm
+
+#endif // LLVM_FALSESHARING_H
@@ -0,0 +1,622 @@
+//===-- IdiomRecognizer.cpp - BLAS and libc idioms in loops ----*- C++ -*-===//
+//
+// Exact gemm/gemv/dot/axpy/memset/memcpy replacements for loops
+//
+//===----------------------------------------------------------------------===//
+
+#include "IdiomRecognizer.h"
+#include "AdvancedPatternDetect.h"
+#include "PatternDetect.h"
+#include "SCEVSourcePrinter.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "idiom-recognizer"
+
+static bool isOne(const SCEV *S) { return S && S->isOne(); }
+
+static bool isBlasType(Type *Ty) { return Ty->isFloatTy() || Ty->isDoubleTy(); }
+
+/// cblas_s* for float, cblas_d* for double.
+static std::string getBlasRoutine(Type *Ty, StringRef Name) {
+  return (Twine("cblas_") + (Ty->isFloatTy() ? "s" : "d") + Name).str();
+}
+
+static std::string getLiteral(Type *Ty, StringRef Value) {
+  return Ty->isFloatTy() ? (Value + "f").str() : Value.str();
+}
+
+static std::string getCTypeName(Type *Ty) {
+  if (Ty->isFloatTy())
+    return "float";
+  if (Ty->isDoubleTy())
+    return "double";
+  if (Ty->isPointerTy())
+    return "void *";
+  if (Ty->isIntegerTy(8))
+    return "char";
+  if (Ty->isIntegerTy(16))
+    return "short";
+  if (Ty->isIntegerTy(32))
+    return "int";
+  if (Ty->isIntegerTy(64))
+    return "long";
+  return "";
+}
+
+/// Source spelling of a loop-invariant scalar: a constant or a named value.
+static std::string printScalar(Value *V) {
+  if (auto *CF = dyn_cast<ConstantFP>(V)) {
+    SmallString<16> Text;
+    CF->getValueAPF().toString(Text);
+    return getLiteral(V->getType(), Text);
+  }
+  if (auto *CI = dyn_cast<ConstantInt>(V))
+    return std::to_string(CI->getSExtValue());
+  return PatternDetection::getVariableName(V);
+}
+
+/// False when some argument has no source spelling (no debug name, ...).
+static bool hasAllArguments(const LibraryIdiom &Idiom) {
+  return all_of(Idiom.Arguments,
+                [](const auto &Arg) { return !Arg.second.empty(); });
+}
+
+/// Loads and stores of \p L; false if anything else touches memory.
+static bool collectAccesses(Loop &L, SmallVectorImpl<LoadInst *> &Loads,
+                            SmallVectorImpl<StoreInst *> &Stores) {
+  for (BasicBlock *BB : L.blocks()) {
+    for (Instruction &I : *BB) {
+      if (isa<DbgInfoIntrinsic>(&I) || I.isLifetimeStartOrEnd())
+        continue;
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        if (!Load->isSimple())
+          return false;
+        Loads.push_back(Load);
+      } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        if (!Store->isSimple())
+          return false;
+        Stores.push_back(Store);
+      } else if (I.mayReadOrWriteMemory()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// The product operand of an fadd, as its two loads inside \p L.
+static bool matchProduct(Value *V, Loop &L, LoadInst *&Lhs, LoadInst *&Rhs) {
+  auto *Mul = dyn_cast<BinaryOperator>(V);
+  if (!Mul || Mul->getOpcode() != Instruction::FMul)
+    return false;
+  Lhs = dyn_cast<LoadInst>(Mul->getOperand(0));
+  Rhs = dyn_cast<LoadInst>(Mul->getOperand(1));
+  return Lhs && Rhs && L.contains(Lhs) && L.contains(Rhs);
+}
+
+const SCEV *IdiomRecognizer::toElements(const SCEV *Bytes,
+                                        uint64_t ElementSize) {
+  if (auto *C = dyn_cast<SCEVConstant>(Bytes)) {
+    int64_t Value = C->getAPInt().getSExtValue();
+    if (Value % static_cast<int64_t>(ElementSize))
+      return nullptr;
+    return SE.getConstant(Bytes->getType(),
+                          Value / static_cast<int64_t>(ElementSize), true);
+  }
+  // c * n bytes with c a multiple of the element size, as SCEV folds
+  // row strides; getUDivExactExpr only divides products known not to wrap
+  if (auto *Mul = dyn_cast<SCEVMulExpr>(Bytes)) {
+    SmallVector<const SCEV *, 4> Operands(Mul->operands());
+    if (isa<SCEVConstant>(Operands.front())) {
+      if (const SCEV *Factor = toElements(Operands.front(), ElementSize)) {
+        Operands.front() = Factor;
+        return SE.getMulExpr(Operands);
+      }
+    }
+  }
+  const SCEV *Size = SE.getConstant(Bytes->getType(), ElementSize);
+  const SCEV *Elements = SE.getUDivExactExpr(Bytes, Size);
+  // Only an exact division gives a usable leading dimension
+  if (SE.getMulExpr(Elements, Size) != Bytes)
+    return nullptr;
+  return Elements;
+}
+
+bool IdiomRecognizer::decompose(Value *Ptr, Type *ElementTy,
+                                ArrayRef<Loop *> Nest, AffineAccess &Access) {
+  const DataLayout &DL = SE.getDataLayout();
+  uint64_t ElementSize = DL.getTypeAllocSize(ElementTy).getFixedSize();
+  Access.Strides.assign(Nest.size(), nullptr);
+
+  const SCEV *S = SE.getSCEV(Ptr);
+  while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    auto Level = find(Nest, AR->getLoop());
+    if (!AR->isAffine() || Level == Nest.end())
+      return false;
+    const SCEV *Step = AR->getStepRecurrence(SE);
+    if (!SE.isLoopInvariant(Step, Nest.front()))
+      return false;
+    const SCEV *Stride = toElements(Step, ElementSize);
+    if (!Stride)
+      return false;
+    Access.Strides[Level - Nest.begin()] = Stride;
+    S = AR->getStart();
+  }
+  if (!SE.isLoopInvariant(S, Nest.front()))
+    return false;
+  Access.Start = S;
+  return true;
+}
+
+const SCEV *IdiomRecognizer::getTripCount(Loop *L, Loop *Root) {
+  const SCEV *BTC = SE.getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BTC) || !SE.isLoopInvariant(BTC, Root))
+    return nullptr;
+  return SE.getAddExpr(BTC, SE.getOne(BTC->getType()));
+}
+
+std::string IdiomRecognizer::printPointer(const SCEV *Start, Type *ElementTy) {
+  auto *Base = dyn_cast<SCEVUnknown>(SE.getPointerBase(Start));
+  if (!Base)
+    return "";
+  std::string Name = PatternDetection::getVariableName(Base->getValue());
+  if (Name.empty())
+    return "";
+  const SCEV *Offset = SE.getMinusSCEV(Start, Base);
+  if (Offset->isZero())
+    return Name;
+
+  const SCEV *Elements =
+      toElements(Offset, SE.getDataLayout().getTypeAllocSize(ElementTy).getFixedSize());
+  std::string Text = Elements ? scevToSource(Elements) : "";
+  return Text.empty() ? "" : Name + " + " + Text;
+}
+
+std::string IdiomRecognizer::printCount(const SCEV *Count) {
+  std::string Text = Count ? scevToSource(Count) : "";
+  if (Text.find_first_of("+-") != std::string::npos)
+    return "(" + Text + ")";
+  return Text;
+}
+
+bool IdiomRecognizer::runsEveryIteration(BasicBlock *BB,
+                                         ArrayRef<Loop *> Nest) const {
+  // Innermost first: BB dominates the latch of its loop, and each loop's
+  // header the latch of the loop around it
+  for (Loop *L : reverse(Nest)) {
+    if (!L->contains(BB))
+      continue;
+    if (!DT.dominates(BB, L->getLoopLatch()))
+      return false;
+    BB = L->getHeader();
+  }
+  return true;
+}
+
+bool IdiomRecognizer::findContraction(ArrayRef<Loop *> Nest, Contraction &C) {
+  Loop &Root = *Nest.front();
+  Loop &Inner = *Nest.back();
+  if (!Inner.getLoopPreheader() || !Inner.getLoopLatch())
+    return false;
+
+  SmallVector<LoadInst *, 8> Loads;
+  SmallVector<StoreInst *, 2> Stores;
+  if (!collectAccesses(Root, Loads, Stores) || Stores.size() != 1)
+    return false;
+  StoreInst *Store = Stores.front();
+  if (!runsEveryIteration(Store->getParent(), Nest) ||
+      !runsEveryIteration(Inner.getHeader(), Nest))
+    return false;
+
+  // The stored value, looking through the LCSSA phi of the inner loop
+  Value *Stored = Store->getValueOperand();
+  if (auto *Phi = dyn_cast<PHINode>(Stored))
+    if (Phi->getNumIncomingValues() == 1)
+      Stored = Phi->getIncomingValue(0);
+  auto *Add = dyn_cast<BinaryOperator>(Stored);
+  if (!Add || Add->getOpcode() != Instruction::FAdd || !Inner.contains(Add) ||
+      !isBlasType(Add->getType()))
+    return false;
+
+  const SCEV *Target = SE.getSCEV(Store->getPointerOperand());
+  for (unsigned Op = 0; Op < 2; ++Op) {
+    if (!matchProduct(Add->getOperand(Op), Inner, C.Lhs, C.Rhs))
+      continue;
+    Value *Acc = Add->getOperand(1 - Op);
+    C.Store = Store;
+
+    // sum = init; for (k) sum += a * b; C = sum;
+    auto *Phi = dyn_cast<PHINode>(Acc);
+    if (Phi && Phi->getParent() == Inner.getHeader() && !Inner.contains(Store) &&
+        Phi->getIncomingValueForBlock(Inner.getLoopLatch()) == Add) {
+      Value *Init = Phi->getIncomingValueForBlock(Inner.getLoopPreheader());
+      if (auto *Zero = dyn_cast<ConstantFP>(Init))
+        return Zero->isZero();
+      auto *InitLoad = dyn_cast<LoadInst>(Init);
+      C.Accumulates = InitLoad && SE.getSCEV(InitLoad->getPointerOperand()) == Target;
+      return C.Accumulates;
+    }
+
+    // for (k) C += a * b;
+    auto *Load = dyn_cast<LoadInst>(Acc);
+    if (Load && Inner.contains(Store) &&
+        SE.getSCEV(Load->getPointerOperand()) == Target) {
+      C.Accumulates = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IdiomRecognizer::overlapsOperands(const Contraction &C) {
+  return DI.depends(C.Lhs, C.Store, true) || DI.depends(C.Rhs, C.Store, true);
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchGemm(Loop &Root) {
+  Loop *Middle = Root.getSubLoops().front();
+  if (Middle->getSubLoops().size() != 1)
+    return None;
+  Loop *Inner = Middle->getSubLoops().front();
+  if (!PatternDetection::isMatrixMultiplication(&Root, Middle, Inner) ||
+      !Advanced.isMatrixMultiplicationPattern(&Root, Middle, Inner))
+    return None;
+
+  SmallVector<Loop *, 3> Nest{&Root, Middle, Inner};
+  Contraction C;
+  if (!findContraction(Nest, C) || overlapsOperands(C))
+    return None;
+  Type *Ty = C.Store->getValueOperand()->getType();
+  AffineAccess AccC, AccL, AccR;
+  if (!decompose(C.Store->getPointerOperand(), Ty, Nest, AccC) ||
+      !decompose(C.Lhs->getPointerOperand(), Ty, Nest, AccL) ||
+      !decompose(C.Rhs->getPointerOperand(), Ty, Nest, AccR))
+    return None;
+
+  // Roles from C: k is the loop C does not move in, j its unit-stride loop
+  int I = -1, J = -1, K = -1;
+  for (int D = 0; D < 3; ++D) {
+    int &Role = !AccC.Strides[D] ? K : isOne(AccC.Strides[D]) ? J : I;
+    if (Role >= 0)
+      return None;
+    Role = D;
+  }
+  if (I < 0 || J < 0 || K < 0)
+    return None;
+
+  // A moves with i and k, B with k and j
+  AffineAccess *A = &AccL, *B = &AccR;
+  if (A->Strides[J])
+    std::swap(A, B);
+  if (A->Strides[J] || B->Strides[I] || !A->Strides[I] || !A->Strides[K] ||
+      !B->Strides[K] || !B->Strides[J])
+    return None;
+
+  bool TransA = !isOne(A->Strides[K]);
+  bool TransB = !isOne(B->Strides[J]);
+  if ((TransA && !isOne(A->Strides[I])) || (TransB && !isOne(B->Strides[K])))
+    return None;
+
+  LibraryIdiom Idiom;
+  Idiom.Kind = "gemm";
+  Idiom.Routine = getBlasRoutine(Ty, "gemm");
+  Idiom.Arguments = {
+      {"M", printCount(getTripCount(Nest[I], &Root))},
+      {"N", printCount(getTripCount(Nest[J], &Root))},
+      {"K", printCount(getTripCount(Nest[K], &Root))},
+      {"A", printPointer(A->Start, Ty)},
+      {"lda", scevToSource(TransA ? A->Strides[K] : A->Strides[I])},
+      {"B", printPointer(B->Start, Ty)},
+      {"ldb", scevToSource(TransB ? B->Strides[J] : B->Strides[K])},
+      {"C", printPointer(AccC.Start, Ty)},
+      {"ldc", scevToSource(AccC.Strides[I])}};
+  if (!hasAllArguments(Idiom))
+    return None;
+
+  const auto &Args = Idiom.Arguments;
+  Idiom.Call = Idiom.Routine + "(CblasRowMajor, " +
+               (TransA ? "CblasTrans" : "CblasNoTrans") + ", " +
+               (TransB ? "CblasTrans" : "CblasNoTrans") + ", " + Args[0].second +
+               ", " + Args[1].second + ", " + Args[2].second + ", " +
+               getLiteral(Ty, "1.0") + ", " + Args[3].second + ", " +
+               Args[4].second + ", " + Args[5].second + ", " + Args[6].second +
+               ", " + getLiteral(Ty, C.Accumulates ? "1.0" : "0.0") + ", " +
+               Args[7].second + ", " + Args[8].second + ");";
+  Idiom.Reason = "Matrix multiply C(MxN) " + std::string(C.Accumulates ? "+" : "") +
+                 "= A(MxK) * B(KxN) over row-major arrays";
+  Idiom.Notes.push_back("BLAS sums the k products in a different order - "
+                        "results may differ in the last bits");
+  return Idiom;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchGemv(Loop &Root) {
+  Loop *Inner = Root.getSubLoops().front();
+  if (!Inner->getSubLoops().empty())
+    return None;
+
+  SmallVector<Loop *, 2> Nest{&Root, Inner};
+  Contraction C;
+  if (!findContraction(Nest, C) || overlapsOperands(C))
+    return None;
+  Type *Ty = C.Store->getValueOperand()->getType();
+  AffineAccess AccY, AccL, AccR;
+  if (!decompose(C.Store->getPointerOperand(), Ty, Nest, AccY) ||
+      !decompose(C.Lhs->getPointerOperand(), Ty, Nest, AccL) ||
+      !decompose(C.Rhs->getPointerOperand(), Ty, Nest, AccR))
+    return None;
+
+  // i is the loop y moves in, j the loop summed over
+  if (!AccY.Strides[0] == !AccY.Strides[1])
+    return None;
+  int I = AccY.Strides[0] ? 0 : 1;
+  int J = 1 - I;
+  AffineAccess *A = &AccL, *X = &AccR;
+  if (!A->Strides[I])
+    std::swap(A, X);
+  if (!A->Strides[I] || !A->Strides[J] || X->Strides[I] || !X->Strides[J])
+    return None;
+  bool Trans = !isOne(A->Strides[J]);
+  if (Trans && !isOne(A->Strides[I]))
+    return None;
+
+  // Row-major A is rows x cols; transposed, y = A^T x has cols elements
+  Loop *Rows = Trans ? Nest[J] : Nest[I];
+  Loop *Cols = Trans ? Nest[I] : Nest[J];
+  LibraryIdiom Idiom;
+  Idiom.Kind = "gemv";
+  Idiom.Routine = getBlasRoutine(Ty, "gemv");
+  Idiom.Arguments = {{"M", printCount(getTripCount(Rows, &Root))},
+                     {"N", printCount(getTripCount(Cols, &Root))},
+                     {"A", printPointer(A->Start, Ty)},
+                     {"lda", scevToSource(Trans ? A->Strides[J] : A->Strides[I])},
+                     {"X", printPointer(X->Start, Ty)},
+                     {"incx", scevToSource(X->Strides[J])},
+                     {"Y", printPointer(AccY.Start, Ty)},
+                     {"incy", scevToSource(AccY.Strides[I])}};
+  if (!hasAllArguments(Idiom))
+    return None;
+
+  const auto &Args = Idiom.Arguments;
+  Idiom.Call = Idiom.Routine + "(CblasRowMajor, " +
+               (Trans ? "CblasTrans" : "CblasNoTrans") + ", " + Args[0].second +
+               ", " + Args[1].second + ", " + getLiteral(Ty, "1.0") + ", " +
+               Args[2].second + ", " + Args[3].second + ", " + Args[4].second +
+               ", " + Args[5].second + ", " +
+               getLiteral(Ty, C.Accumulates ? "1.0" : "0.0") + ", " +
+               Args[6].second + ", " + Args[7].second + ");";
+  Idiom.Reason = std::string("Matrix-vector product y ") +
+                 (C.Accumulates ? "+" : "") + "= " + (Trans ? "A^T" : "A") + " * x";
+  Idiom.Notes.push_back("BLAS sums the products in a different order - "
+                        "results may differ in the last bits");
+  return Idiom;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchDot(Loop &L) {
+  SmallVector<LoadInst *, 4> Loads;
+  SmallVector<StoreInst *, 1> Stores;
+  if (!L.isLoopSimplifyForm() || !collectAccesses(L, Loads, Stores) ||
+      !Stores.empty())
+    return None;
+
+  for (PHINode &Phi : L.getHeader()->phis()) {
+    auto *Add = dyn_cast<BinaryOperator>(Phi.getIncomingValueForBlock(L.getLoopLatch()));
+    if (!Add || Add->getOpcode() != Instruction::FAdd || !isBlasType(Phi.getType()))
+      continue;
+    LoadInst *Lhs, *Rhs;
+    unsigned Op = Add->getOperand(0) == &Phi ? 1 : 0;
+    if (Add->getOperand(1 - Op) != &Phi || !matchProduct(Add->getOperand(Op), L, Lhs, Rhs))
+      continue;
+
+    Type *Ty = Phi.getType();
+    AffineAccess X, Y;
+    if (!decompose(Lhs->getPointerOperand(), Ty, &L, X) ||
+        !decompose(Rhs->getPointerOperand(), Ty, &L, Y) || !X.Strides[0] ||
+        !Y.Strides[0] || !SE.isKnownPositive(X.Strides[0]) ||
+        !SE.isKnownPositive(Y.Strides[0]))
+      return None;
+
+    std::string Sum;
+    for (const auto &R : PatternDetection::findReductions(&L))
+      if (R.phi == &Phi)
+        Sum = R.variable;
+
+    LibraryIdiom Idiom;
+    Idiom.Kind = "dot";
+    Idiom.Routine = getBlasRoutine(Ty, "dot");
+    Idiom.Arguments = {{"N", printCount(getTripCount(&L, &L))},
+                       {"X", printPointer(X.Start, Ty)},
+                       {"incx", scevToSource(X.Strides[0])},
+                       {"Y", printPointer(Y.Start, Ty)},
+                       {"incy", scevToSource(Y.Strides[0])}};
+    if (Sum.empty() || !hasAllArguments(Idiom))
+      return None;
+    const auto &Args = Idiom.Arguments;
+    Idiom.Call = Sum + " += " + Idiom.Routine + "(" + Args[0].second + ", " +
+                 Args[1].second + ", " + Args[2].second + ", " + Args[3].second +
+                 ", " + Args[4].second + ");";
+    Idiom.Reason = "Dot product accumulated into " + Sum;
+    Idiom.Notes.push_back("BLAS sums in a different order - results may differ "
+                          "in the last bits");
+    return Idiom;
+  }
+  return None;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchAxpy(Loop &L) {
+  SmallVector<LoadInst *, 4> Loads;
+  SmallVector<StoreInst *, 1> Stores;
+  if (!collectAccesses(L, Loads, Stores) || Stores.size() != 1 ||
+      !runsEveryIteration(Stores.front()->getParent(), &L))
+    return None;
+  StoreInst *Store = Stores.front();
+  auto *Add = dyn_cast<BinaryOperator>(Store->getValueOperand());
+  if (!Add || Add->getOpcode() != Instruction::FAdd || !isBlasType(Add->getType()))
+    return None;
+
+  // y[i] = y[i] + a * x[i], in any operand order
+  const SCEV *Target = SE.getSCEV(Store->getPointerOperand());
+  for (unsigned Op = 0; Op < 2; ++Op) {
+    auto *LoadY = dyn_cast<LoadInst>(Add->getOperand(Op));
+    auto *Mul = dyn_cast<BinaryOperator>(Add->getOperand(1 - Op));
+    if (!LoadY || !Mul || Mul->getOpcode() != Instruction::FMul ||
+        SE.getSCEV(LoadY->getPointerOperand()) != Target)
+      continue;
+    unsigned XOp = isa<LoadInst>(Mul->getOperand(0)) ? 0 : 1;
+    auto *LoadX = dyn_cast<LoadInst>(Mul->getOperand(XOp));
+    Value *Alpha = Mul->getOperand(1 - XOp);
+    if (!LoadX || !L.contains(LoadX) || !L.isLoopInvariant(Alpha))
+      return None;
+
+    // BLAS assumes x and y do not overlap
+    if (DI.depends(LoadX, Store, true))
+      return None;
+
+    Type *Ty = Add->getType();
+    AffineAccess X, Y;
+    if (!decompose(LoadX->getPointerOperand(), Ty, &L, X) ||
+        !decompose(Store->getPointerOperand(), Ty, &L, Y) || !X.Strides[0] ||
+        !Y.Strides[0] || !SE.isKnownPositive(X.Strides[0]) ||
+        !SE.isKnownPositive(Y.Strides[0]))
+      return None;
+
+    LibraryIdiom Idiom;
+    Idiom.Kind = "axpy";
+    Idiom.Routine = getBlasRoutine(Ty, "axpy");
+    Idiom.Arguments = {{"N", printCount(getTripCount(&L, &L))},
+                       {"alpha", printScalar(Alpha)},
+                       {"X", printPointer(X.Start, Ty)},
+                       {"incx", scevToSource(X.Strides[0])},
+                       {"Y", printPointer(Y.Start, Ty)},
+                       {"incy", scevToSource(Y.Strides[0])}};
+    if (!hasAllArguments(Idiom))
+      return None;
+    const auto &Args = Idiom.Arguments;
+    Idiom.Call = Idiom.Routine + "(" + Args[0].second + ", " + Args[1].second +
+                 ", " + Args[2].second + ", " + Args[3].second + ", " +
+                 Args[4].second + ", " + Args[5].second + ");";
+    Idiom.Reason = "y += alpha * x over " + Args[4].second;
+    return Idiom;
+  }
+  return None;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchMemset(Loop &L) {
+  SmallVector<LoadInst *, 1> Loads;
+  SmallVector<StoreInst *, 1> Stores;
+  if (!collectAccesses(L, Loads, Stores) || !Loads.empty() || Stores.size() != 1 ||
+      !runsEveryIteration(Stores.front()->getParent(), &L))
+    return None;
+  StoreInst *Store = Stores.front();
+  Value *Stored = Store->getValueOperand();
+  if (!L.isLoopInvariant(Stored))
+    return None;
+
+  // memset writes one byte value; 0.0 and -1 qualify, 1.0f does not
+  const DataLayout &DL = SE.getDataLayout();
+  Value *Byte = isBytewiseValue(Stored, DL);
+  std::string ByteText;
+  if (auto *C = dyn_cast_or_null<ConstantInt>(Byte))
+    ByteText = std::to_string(C->getZExtValue());
+  else if (Byte == Stored)
+    ByteText = printScalar(Stored);
+
+  Type *Ty = Stored->getType();
+  AffineAccess Dst;
+  std::string TypeName = getCTypeName(Ty);
+  if (ByteText.empty() || TypeName.empty() ||
+      !decompose(Store->getPointerOperand(), Ty, &L, Dst) || !isOne(Dst.Strides[0]))
+    return None;
+
+  LibraryIdiom Idiom;
+  Idiom.Kind = "memset";
+  Idiom.Routine = "memset";
+  Idiom.Arguments = {{"dest", printPointer(Dst.Start, Ty)},
+                     {"ch", ByteText},
+                     {"count", printCount(getTripCount(&L, &L))}};
+  if (!hasAllArguments(Idiom))
+    return None;
+  const auto &Args = Idiom.Arguments;
+  Idiom.Call = "memset(" + Args[0].second + ", " + Args[1].second + ", " +
+               Args[2].second + " * sizeof(" + TypeName + "));";
+  Idiom.Reason = "Fills " + Args[0].second + " with one byte value";
+  return Idiom;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchMemcpy(Loop &L) {
+  SmallVector<LoadInst *, 1> Loads;
+  SmallVector<StoreInst *, 1> Stores;
+  if (!collectAccesses(L, Loads, Stores) || Loads.size() != 1 || Stores.size() != 1 ||
+      !runsEveryIteration(Stores.front()->getParent(), &L))
+    return None;
+  LoadInst *Load = Loads.front();
+  StoreInst *Store = Stores.front();
+  if (Store->getValueOperand() != Load)
+    return None;
+
+  // memcpy requires disjoint ranges; an overlapping copy loop is not memmove
+  if (DI.depends(Load, Store, true))
+    return None;
+
+  Type *Ty = Load->getType();
+  AffineAccess Src, Dst;
+  std::string TypeName = getCTypeName(Ty);
+  if (TypeName.empty() || !decompose(Load->getPointerOperand(), Ty, &L, Src) ||
+      !decompose(Store->getPointerOperand(), Ty, &L, Dst) ||
+      !isOne(Src.Strides[0]) || !isOne(Dst.Strides[0]))
+    return None;
+
+  LibraryIdiom Idiom;
+  Idiom.Kind = "memcpy";
+  Idiom.Routine = "memcpy";
+  Idiom.Arguments = {{"dest", printPointer(Dst.Start, Ty)},
+                     {"src", printPointer(Src.Start, Ty)},
+                     {"count", printCount(getTripCount(&L, &L))}};
+  if (!hasAllArguments(Idiom))
+    return None;
+  const auto &Args = Idiom.Arguments;
+  Idiom.Call = "memcpy(" + Args[0].second + ", " + Args[1].second + ", " +
+               Args[2].second + " * sizeof(" + TypeName + "));";
+  Idiom.Reason = "Copies " + Args[1].second + " to " + Args[0].second;
+  return Idiom;
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchNest(Loop &Root) {
+  if (Root.getSubLoops().size() != 1 ||
+      !all_of(Root.getLoopsInPreorder(),
+              [](Loop *L) { return L->isLoopSimplifyForm(); }))
+    return None;
+  if (Optional<LibraryIdiom> Idiom = matchGemm(Root))
+    return Idiom;
+  return matchGemv(Root);
+}
+
+Optional<LibraryIdiom> IdiomRecognizer::matchLoop(Loop &L) {
+  // The matchers read the preheader's and the latch's incoming values
+  if (!L.getSubLoops().empty() || !L.isLoopSimplifyForm())
+    return None;
+  if (Optional<LibraryIdiom> Idiom = matchDot(L))
+    return Idiom;
+  if (Optional<LibraryIdiom> Idiom = matchAxpy(L))
+    return Idiom;
+  if (Optional<LibraryIdiom> Idiom = matchMemset(L))
+    return Idiom;
+  return matchMemcpy(L);
+}
+
+std::string IdiomRecognizer::generatePatch(const LibraryIdiom &Idiom) {
+  bool IsBlas = StringRef(Idiom.Routine).startswith("cblas_");
+  std::string Patch = "// ✅ Replace the loop with one " +
+                      std::string(IsBlas ? "BLAS" : "libc") + " call (" +
+                      Idiom.Kind + ")\n" + Idiom.Call + "\n";
+  for (const std::string &Note : Idiom.Notes)
+    Patch += "// Note: " + Note + "\n";
+  Patch += IsBlas ? "// #include <cblas.h>, link with -lopenblas (or any CBLAS)"
+                  : "// #include <cstring>";
+  return Patch;
+}
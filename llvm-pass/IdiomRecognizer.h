@@ -0,0 +1,102 @@
+//===-- IdiomRecognizer.h - BLAS and libc idioms in loops ------*- C++ -*-===//
+//
+// Recognizes loops and loop nests that compute exactly what one library
+// routine computes (cblas ?gemm, ?gemv, ?dot, ?axpy, memset, memcpy) and
+// renders the replacement call, with dimensions, leading dimensions and
+// increments taken from SCEV.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IDIOMRECOGNIZER_H
+#define LLVM_IDIOMRECOGNIZER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class AdvancedPatternDetector;
+
+/// A loop or loop nest that one library call can replace.
+struct LibraryIdiom {
+  std::string Kind;    // gemm, gemv, dot, axpy, memset or memcpy
+  std::string Routine; // cblas_dgemm, memset, ...
+  std::string Call;    // Complete replacement statement
+  std::string Reason;
+
+  /// Call arguments by their BLAS/libc names (M, lda, incx, ...), as
+  /// source expressions.
+  std::vector<std::pair<std::string, std::string>> Arguments;
+  std::vector<std::string> Notes;
+};
+
+class IdiomRecognizer {
+public:
+  IdiomRecognizer(ScalarEvolution &SE, DependenceInfo &DI, DominatorTree &DT,
+                  AdvancedPatternDetector &Advanced)
+      : SE(SE), DI(DI), DT(DT), Advanced(Advanced) {}
+
+  /// gemm for a three-deep nest rooted at \p Root, gemv for a two-deep one.
+  Optional<LibraryIdiom> matchNest(Loop &Root);
+
+  /// dot, axpy, memset or memcpy for an innermost loop.
+  Optional<LibraryIdiom> matchLoop(Loop &L);
+
+  /// Patch text: the call, its notes and what to include and link.
+  static std::string generatePatch(const LibraryIdiom &Idiom);
+
+private:
+  ScalarEvolution &SE;
+  DependenceInfo &DI;
+  DominatorTree &DT;
+  AdvancedPatternDetector &Advanced;
+
+  /// An address as Start + sum(Strides[d] * iv_d) over the loops of a nest,
+  /// with strides in elements (null when invariant in that loop).
+  struct AffineAccess {
+    const SCEV *Start = nullptr;
+    SmallVector<const SCEV *, 3> Strides;
+  };
+
+  /// acc += lhs * rhs in the innermost loop of a nest, where acc is either
+  /// a register reduction stored after the loop or an element updated in
+  /// place by the single store of the nest.
+  struct Contraction {
+    LoadInst *Lhs = nullptr;
+    LoadInst *Rhs = nullptr;
+    StoreInst *Store = nullptr;
+    bool Accumulates = false; // Adds to the stored element (beta = 1)
+  };
+
+  Optional<LibraryIdiom> matchGemm(Loop &Root);
+  Optional<LibraryIdiom> matchGemv(Loop &Root);
+  Optional<LibraryIdiom> matchDot(Loop &L);
+  Optional<LibraryIdiom> matchAxpy(Loop &L);
+  Optional<LibraryIdiom> matchMemset(Loop &L);
+  Optional<LibraryIdiom> matchMemcpy(Loop &L);
+
+  bool findContraction(ArrayRef<Loop *> Nest, Contraction &C);
+  /// The stored output may overlap an operand, which BLAS does not allow.
+  bool overlapsOperands(const Contraction &C);
+  /// \p BB runs on every iteration of the loops of \p Nest (outermost
+  /// first): a store under an if is not a library call over the whole range.
+  bool runsEveryIteration(BasicBlock *BB, ArrayRef<Loop *> Nest) const;
+  bool decompose(Value *Ptr, Type *ElementTy, ArrayRef<Loop *> Nest,
+                 AffineAccess &Access);
+  const SCEV *toElements(const SCEV *Bytes, uint64_t ElementSize);
+  const SCEV *getTripCount(Loop *L, Loop *Root);
+  std::string printPointer(const SCEV *Start, Type *ElementTy);
+  std::string printCount(const SCEV *Count);
+};
+
+} // namespace llvm
+
+#endif // LLVM_IDIOMRECOGNIZER_H
@@ -0,0 +1,153 @@
+//===-- LoopAnnotate.cpp - Loop metadata from dependence proofs -*- C++ -*-===//
+//
+// Access groups and vectorizer hints for loops proven free of carried
+// dependences
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopAnnotate.h"
+#include "PerfectNestAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/VectorUtils.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-annotate"
+
+// LoopVectorize rarely profits from more than four interleaved copies
+static constexpr unsigned MaxInterleave = 4;
+
+static MDNode *makeHint(LLVMContext &Ctx, StringRef Name, Metadata *Value) {
+  return MDNode::get(Ctx, {MDString::get(Ctx, Name), Value});
+}
+
+static MDNode *makeHint(LLVMContext &Ctx, StringRef Name, unsigned Value) {
+  return makeHint(Ctx, Name,
+                  ConstantAsMetadata::get(
+                      ConstantInt::get(Type::getInt32Ty(Ctx), Value)));
+}
+
+bool LoopAnnotatePass::annotate(Loop &L, ScalarEvolution &SE,
+                                DependenceInfo &DI,
+                                const TargetTransformInfo &TTI,
+                                OptimizationRemarkEmitter &ORE) {
+  // Explicit pragmas and earlier annotations win
+  if (!L.isLoopSimplifyForm() || L.isAnnotatedParallel() ||
+      getOptionalBoolLoopAttribute(&L, "llvm.loop.vectorize.enable"))
+    return false;
+
+  // Forcing the vectorizer also allows it to reassociate reductions, which
+  // would change the result of a strict floating-point reduction
+  for (PHINode &Phi : L.getHeader()->phis()) {
+    RecurrenceDescriptor RD;
+    if (RecurrenceDescriptor::isReductionPHI(&Phi, &L, RD) &&
+        RD.getExactFPMathInst()) {
+      LLVM_DEBUG(dbgs() << "parallel-annotate: strict FP reduction "
+                        << Phi.getName() << "\n");
+      return false;
+    }
+  }
+
+  SmallVector<Instruction *, 16> Accesses;
+  if (!hasNoCarriedDependence(L, DI, &Accesses) || Accesses.empty())
+    return false;
+
+  // One vector register of the widest element accessed, interleaved up to
+  // what the target allows and the trip count fills
+  const DataLayout &DL = L.getHeader()->getModule()->getDataLayout();
+  unsigned WidestBits = 0;
+  for (Instruction *I : Accesses) {
+    Type *Ty = getLoadStoreType(I);
+    if (!Ty->isIntOrPtrTy() && !Ty->isFloatingPointTy()) {
+      WidestBits = 0;
+      break;
+    }
+    WidestBits = std::max<unsigned>(WidestBits,
+                                    DL.getTypeSizeInBits(Ty).getFixedSize());
+  }
+  unsigned RegisterBits =
+      TTI.getRegisterBitWidth(TargetTransformInfo::RGK_FixedWidthVector)
+          .getFixedSize();
+  unsigned Width = WidestBits ? RegisterBits / WidestBits : 0;
+  unsigned Interleave =
+      Width > 1 ? std::min(TTI.getMaxInterleaveFactor(Width), MaxInterleave)
+                : 1;
+  if (unsigned TripCount = SE.getSmallConstantTripCount(&L)) {
+    if (Width > TripCount)
+      Width = 0;
+    while (Interleave > 1 && Width * Interleave > TripCount)
+      Interleave /= 2;
+  }
+
+  LLVMContext &Ctx = L.getHeader()->getContext();
+  MDNode *AccessGroup = MDNode::getDistinct(Ctx, {});
+  for (Instruction *I : Accesses)
+    I->setMetadata(LLVMContext::MD_access_group,
+                   uniteAccessGroups(
+                       I->getMetadata(LLVMContext::MD_access_group),
+                       AccessGroup));
+
+  SmallVector<MDNode *, 4> Hints;
+  Hints.push_back(makeHint(Ctx, "llvm.loop.parallel_accesses", AccessGroup));
+  Hints.push_back(makeHint(Ctx, "llvm.loop.vectorize.enable",
+                           ConstantAsMetadata::get(ConstantInt::getTrue(Ctx))));
+  // Hints the loop already carries are kept; 0 marks a hint not attached
+  unsigned AttachedWidth = 0, AttachedInterleave = 0;
+  if (Width > 1 && !findOptionMDForLoop(&L, "llvm.loop.vectorize.width")) {
+    Hints.push_back(makeHint(Ctx, "llvm.loop.vectorize.width", Width));
+    AttachedWidth = Width;
+  }
+  if (Width > 1 && !findOptionMDForLoop(&L, "llvm.loop.interleave.count")) {
+    Hints.push_back(makeHint(Ctx, "llvm.loop.interleave.count", Interleave));
+    AttachedInterleave = Interleave;
+  }
+  L.setLoopID(makePostTransformationMetadata(Ctx, L.getLoopID(), {}, Hints));
+
+  ORE.emit([&]() {
+    OptimizationRemark R(DEBUG_TYPE, "Annotated", L.getStartLoc(),
+                         L.getHeader());
+    R << "loop proven free of carried dependences";
+    if (AttachedWidth || AttachedInterleave) {
+      R << " (";
+      if (AttachedWidth)
+        R << "vectorize.width=" << ore::NV("Width", AttachedWidth);
+      if (AttachedWidth && AttachedInterleave)
+        R << ", ";
+      if (AttachedInterleave)
+        R << "interleave.count=" << ore::NV("Interleave", AttachedInterleave);
+      R << ")";
+    }
+    return R;
+  });
+  return true;
+}
+
+PreservedAnalyses LoopAnnotatePass::run(Function &F,
+                                        FunctionAnalysisManager &FAM) {
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  DependenceInfo &DI = FAM.getResult<DependenceAnalysis>(F);
+  const TargetTransformInfo &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  OptimizationRemarkEmitter &ORE =
+      FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+
+  // LoopVectorize only handles innermost loops
+  bool Changed = false;
+  for (Loop *L : LI.getLoopsInPreorder())
+    if (L->isInnermost())
+      Changed |= annotate(*L, SE, DI, TTI, ORE);
+
+  if (!Changed)
+    return PreservedAnalyses::all();
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  PA.preserve<ScalarEvolutionAnalysis>();
+  return PA;
+}
@@ -0,0 +1,38 @@
+//===-- LoopAnnotate.h - Loop metadata from dependence proofs --*- C++ -*-===//
+//
+// Annotation mode of the analyzer: innermost loops whose accesses
+// DependenceAnalysis proves free of carried dependences get
+// llvm.loop.parallel_accesses and vectorizer hints, so LoopVectorize can
+// use the proof instead of its own (more conservative) dependence checks.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LOOPANNOTATE_H
+#define LLVM_LOOPANNOTATE_H
+
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+class OptimizationRemarkEmitter;
+class TargetTransformInfo;
+
+/// Function pass behind -passes=parallel-annotate. The plugin also runs it
+/// at the vectorizer start point of the default pipelines, which is where
+/// it lands when loaded with clang -fpass-plugin.
+class LoopAnnotatePass : public PassInfoMixin<LoopAnnotatePass> {
+public:
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+private:
+  /// Attach the access group and loop hints to \p L if it is proven safe.
+  bool annotate(Loop &L, ScalarEvolution &SE, DependenceInfo &DI,
+                const TargetTransformInfo &TTI, OptimizationRemarkEmitter &ORE);
+};
+
+} // namespace llvm
+
+#endif // LLVM_LOOPANNOTATE_H
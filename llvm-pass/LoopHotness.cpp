@@ -0,0 +1,69 @@
+//===-- LoopHotness.cpp - Execution weight of candidate loops ---*- C++ -*-===//
+//
+// weight(B) = size(B) * freq(B) / freq(entry)   instructions per call
+// share(L)  = sum of weight(B) over L / sum over F
+// With a profiled entry count N, N * weight is the instruction count of
+// the run and the header's profile count its executed iterations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopHotness.h"
+#include "llvm/IR/Function.h"
+
+using namespace llvm;
+
+LoopHotness &LoopHotness::operator+=(const LoopHotness &Other) {
+  IterationsPerCall += Other.IterationsPerCall;
+  CallWeight += Other.CallWeight;
+  FunctionShare += Other.FunctionShare;
+  Profiled = Profiled && Other.Profiled;
+  HeaderCount += Other.HeaderCount;
+  Weight += Other.Weight;
+  return *this;
+}
+
+LoopHotnessAnalyzer::LoopHotnessAnalyzer(Function &F, BlockFrequencyInfo &BFI)
+    : BFI(BFI), EntryFreq(static_cast<double>(BFI.getEntryFreq())) {
+  if (F.hasProfileData())
+    if (auto Count = F.getEntryCount())
+      EntryCount = Count->getCount();
+  for (const BasicBlock &BB : F)
+    CallWeight += blockWeight(BB);
+}
+
+double LoopHotnessAnalyzer::blockWeight(const BasicBlock &BB) const {
+  if (EntryFreq == 0)
+    return 0;
+  double Freq = static_cast<double>(BFI.getBlockFreq(&BB).getFrequency());
+  return static_cast<double>(BB.sizeWithoutDebug()) * Freq / EntryFreq;
+}
+
+LoopHotness LoopHotnessAnalyzer::analyze(const Loop &L) const {
+  LoopHotness H;
+  for (const BasicBlock *BB : L.blocks())
+    H.CallWeight += blockWeight(*BB);
+  if (EntryFreq != 0)
+    H.IterationsPerCall =
+        static_cast<double>(BFI.getBlockFreq(L.getHeader()).getFrequency()) /
+        EntryFreq;
+  H.FunctionShare = CallWeight > 0 ? H.CallWeight / CallWeight : 0;
+  if (EntryCount) {
+    H.Profiled = true;
+    H.HeaderCount = BFI.getBlockProfileCount(L.getHeader()).getValueOr(0);
+    H.Weight = H.CallWeight * static_cast<double>(*EntryCount);
+  }
+  return H;
+}
+
+LoopHotness LoopHotnessAnalyzer::function() const {
+  LoopHotness H;
+  H.IterationsPerCall = 1;
+  H.CallWeight = CallWeight;
+  H.FunctionShare = 1;
+  if (EntryCount) {
+    H.Profiled = true;
+    H.HeaderCount = *EntryCount;
+    H.Weight = CallWeight * static_cast<double>(*EntryCount);
+  }
+  return H;
+}
@@ -0,0 +1,57 @@
+//===-- LoopHotness.h - Execution weight of candidate loops -----*- C++ -*-===//
+//
+// Estimates how much of a function's (and, with PGO data, the program's)
+// execution a loop accounts for, so candidates can be ranked by where the
+// time goes instead of by pattern. Blocks are weighted by their instruction
+// count times their BlockFrequencyInfo frequency relative to the entry.
+// With instrumentation or sample profiles (-fprofile-use, !prof metadata)
+// the function's entry count turns these per-call weights into counts over
+// the profiled run, comparable across functions.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LOOPHOTNESS_H
+#define LLVM_LOOPHOTNESS_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include <cstdint>
+
+namespace llvm {
+
+/// Execution weight of one loop (or of several, summed).
+struct LoopHotness {
+  double IterationsPerCall = 0; // Header executions per call of the function
+  double CallWeight = 0;        // Instructions run in the loop per call
+  double FunctionShare = 0;     // Of the instructions run per call
+  bool Profiled = false;
+  uint64_t HeaderCount = 0;     // Profiled header executions
+  double Weight = 0;            // Profiled instructions over the whole run
+
+  LoopHotness &operator+=(const LoopHotness &Other);
+};
+
+class LoopHotnessAnalyzer {
+public:
+  LoopHotnessAnalyzer(Function &F, BlockFrequencyInfo &BFI);
+
+  LoopHotness analyze(const Loop &L) const;
+
+  /// The whole function, as a loop that runs once per call.
+  LoopHotness function() const;
+
+  bool isProfiled() const { return EntryCount.hasValue(); }
+
+private:
+  double blockWeight(const BasicBlock &BB) const;
+
+  BlockFrequencyInfo &BFI;
+  double EntryFreq;
+  double CallWeight = 0;
+  Optional<uint64_t> EntryCount;
+};
+
+} // namespace llvm
+
+#endif // LLVM_LOOPHOTNESS_H
@@ -0,0 +1,317 @@
+//===-- LoopProfile.cpp - Per-loop counters for measured hotness -*- C++ -*-===//
+//
+// For each loop L with preheader P and exit blocks E:
+//   P:  entries += 1 (atomic); t0 = now(); n = 0
+//   header: n += 1 (a stack slot, so iterations cost no atomics)
+//   E:  ticks += now() - t0; iterations += n (atomic)
+// With counters, P also snapshots the hardware counters into a stack slot
+// and E adds the difference to the loop's row of a second table:
+//   P:  __parallel_profile_hw_read(snap)
+//   E:  __parallel_profile_hw_add(&hw[site], snap)
+// With variance, loops with inner loops or calls time each iteration:
+//   P:  __parallel_profile_iter_begin(timer, t0)
+//   latch: __parallel_profile_iter_next(timer, now())
+//   E:  __parallel_profile_iter_end(&cost[site], timer, now())
+// Times are inclusive of inner loops and callees; the site table records
+// each loop's parent so the runtime output can be turned into self time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "LoopProfile.h"
+#include "PatternDetect.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "parallel-profile"
+
+// Clock kinds passed to __parallel_profile_register (runtime/loop_profile.h)
+static constexpr uint32_t ClockKindGettime = 0;
+static constexpr uint32_t ClockKindTSC = 1;
+// Words of a ParallelProfileHardware row and snapshot
+static constexpr unsigned HardwareWords = 6;
+
+namespace {
+
+/// One instrumented loop: its row in the counter and site tables.
+struct ProfileSite {
+  Loop *L;
+  std::string Id, File, Function;
+  unsigned Line;
+  int Parent; // Site index of the enclosing loop, -1 at the top level
+};
+
+} // namespace
+
+bool LoopProfilePass::parseOptions(StringRef Params, ProfileClock &Clock,
+                                   bool &Counters, bool &Variance) {
+  SmallVector<StringRef, 2> Entries;
+  Params.split(Entries, ';', -1, false);
+  for (StringRef Entry : Entries) {
+    auto [Key, Value] = Entry.split('=');
+    if (Key == "counters" && Value.empty()) {
+      Counters = true;
+      continue;
+    }
+    if (Key == "variance" && Value.empty()) {
+      Variance = true;
+      continue;
+    }
+    if (Key != "clock") {
+      errs() << "parallel-profile: unknown parameter '" << Key << "'\n";
+      return false;
+    }
+    if (Value == "tsc") {
+      Clock = ProfileClock::TSC;
+    } else if (Value == "clock_gettime") {
+      Clock = ProfileClock::ClockGettime;
+    } else {
+      errs() << "parallel-profile: invalid clock '" << Value << "'\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool llvm::isProfilableLoop(const Loop &L) {
+  if (!L.getLoopPreheader() || !L.hasDedicatedExits())
+    return false;
+  SmallVector<BasicBlock *, 4> Exits;
+  L.getExitBlocks(Exits);
+  // catchswitch blocks have nowhere to put the exit code
+  return all_of(Exits, [](BasicBlock *Exit) {
+    return Exit->getFirstInsertionPt() != Exit->end();
+  });
+}
+
+PreservedAnalyses LoopProfilePass::run(Module &M, ModuleAnalysisManager &MAM) {
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  LLVMContext &Ctx = M.getContext();
+  Triple TT(M.getTargetTriple());
+  bool UseTSC = Clock == ProfileClock::TSC ||
+                (Clock == ProfileClock::Default && TT.isX86());
+
+  std::vector<ProfileSite> Sites;
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+    DenseMap<const Loop *, int> Index;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      if (!isProfilableLoop(*L)) {
+        LLVM_DEBUG(dbgs() << "parallel-profile: skipping a loop in "
+                          << F.getName() << ": not in loop-simplify form\n");
+        continue;
+      }
+      auto [File, Line] = PatternDetection::getLoopLocation(L);
+      int Parent = -1;
+      for (Loop *Outer = L->getParentLoop(); Outer && Parent < 0;
+           Outer = Outer->getParentLoop())
+        Parent = Index.lookup(Outer) - 1;
+      Index[L] = Sites.size() + 1;
+      Sites.push_back({L,
+                       PatternDetection::getCandidateId(File, Line,
+                                                        F.getName().str()),
+                       File, F.getName().str(), static_cast<unsigned>(Line),
+                       Parent});
+    }
+  }
+  if (Sites.empty())
+    return PreservedAnalyses::all();
+
+  // { entries, iterations, ticks } per site
+  Type *I32 = Type::getInt32Ty(Ctx);
+  Type *I64 = Type::getInt64Ty(Ctx);
+  Type *I8Ptr = Type::getInt8PtrTy(Ctx);
+  StructType *CounterTy = StructType::get(Ctx, {I64, I64, I64});
+  ArrayType *CountersTy = ArrayType::get(CounterTy, Sites.size());
+  auto *CounterTable = new GlobalVariable(
+      M, CountersTy, false, GlobalValue::InternalLinkage,
+      ConstantAggregateZero::get(CountersTy), "__parallel_profile_counters");
+
+  // Hardware counter rows, same order as the sites
+  ArrayType *HardwareRowTy = ArrayType::get(I64, HardwareWords);
+  ArrayType *HardwareTy = ArrayType::get(HardwareRowTy, Sites.size());
+  GlobalVariable *Hardware = nullptr;
+  FunctionCallee HardwareRead, HardwareAdd;
+  if (Counters) {
+    Hardware = new GlobalVariable(M, HardwareTy, false,
+                                  GlobalValue::InternalLinkage,
+                                  ConstantAggregateZero::get(HardwareTy),
+                                  "__parallel_profile_hw");
+    Type *I64Ptr = Type::getInt64PtrTy(Ctx);
+    HardwareRead = M.getOrInsertFunction("__parallel_profile_hw_read",
+                                         Type::getVoidTy(Ctx), I64Ptr);
+    HardwareAdd = M.getOrInsertFunction("__parallel_profile_hw_add",
+                                        Type::getVoidTy(Ctx), I64Ptr, I64Ptr);
+  }
+
+  // Iteration cost rows { sum of squared iteration ticks, longest iteration }
+  // and the per-entry timer { last tick, sum of squares, longest }
+  Type *Double = Type::getDoubleTy(Ctx);
+  StructType *IterCostTy = StructType::get(Ctx, {Double, I64});
+  StructType *IterTimerTy = StructType::get(Ctx, {I64, Double, I64});
+  ArrayType *IterCostsTy = ArrayType::get(IterCostTy, Sites.size());
+  GlobalVariable *IterCosts = nullptr;
+  FunctionCallee IterBegin, IterNext, IterEnd;
+  if (Variance) {
+    IterCosts = new GlobalVariable(M, IterCostsTy, false,
+                                   GlobalValue::InternalLinkage,
+                                   ConstantAggregateZero::get(IterCostsTy),
+                                   "__parallel_profile_iter");
+    Type *CostPtr = PointerType::getUnqual(IterCostTy);
+    Type *TimerPtr = PointerType::getUnqual(IterTimerTy);
+    Type *Void = Type::getVoidTy(Ctx);
+    IterBegin = M.getOrInsertFunction("__parallel_profile_iter_begin", Void,
+                                      TimerPtr, I64);
+    IterNext = M.getOrInsertFunction("__parallel_profile_iter_next", Void,
+                                     TimerPtr, I64);
+    IterEnd = M.getOrInsertFunction("__parallel_profile_iter_end", Void,
+                                    CostPtr, TimerPtr, I64);
+  }
+  // Iterations of innermost loops without calls are too short to time
+  auto HasVaryingWork = [](const Loop &L) {
+    if (!L.getSubLoops().empty())
+      return true;
+    return any_of(L.blocks(), [](BasicBlock *BB) {
+      return any_of(*BB, [](Instruction &I) {
+        return isa<CallBase>(I) && !isa<IntrinsicInst>(I);
+      });
+    });
+  };
+
+  FunctionCallee Now;
+  if (!UseTSC)
+    Now = M.getOrInsertFunction("__parallel_profile_clock", I64);
+  auto ReadClock = [&](IRBuilder<> &B) -> Value * {
+    if (UseTSC)
+      return B.CreateIntrinsic(Intrinsic::readcyclecounter, {}, {});
+    return B.CreateCall(Now);
+  };
+
+  for (unsigned S = 0; S < Sites.size(); ++S) {
+    Loop *L = Sites[S].L;
+    Function &F = *L->getHeader()->getParent();
+    auto Counter = [&](IRBuilder<> &B, unsigned K) {
+      Value *Idx[] = {B.getInt32(0), B.getInt32(S), B.getInt32(K)};
+      return B.CreateInBoundsGEP(CountersTy, CounterTable, Idx);
+    };
+
+    IRBuilder<> Entry(&*F.getEntryBlock().getFirstInsertionPt());
+    AllocaInst *Trips = Entry.CreateAlloca(I64, nullptr, "profile.trips");
+    Value *Snapshot = nullptr;
+    if (Counters)
+      Snapshot = Entry.CreateConstInBoundsGEP2_32(
+          HardwareRowTy,
+          Entry.CreateAlloca(HardwareRowTy, nullptr, "profile.hw"), 0, 0);
+    Value *Timer = nullptr;
+    if (Variance && HasVaryingWork(*L))
+      Timer = Entry.CreateAlloca(IterTimerTy, nullptr, "profile.iter");
+
+    IRBuilder<> Pre(L->getLoopPreheader()->getTerminator());
+    Pre.CreateAtomicRMW(AtomicRMWInst::Add, Counter(Pre, 0), Pre.getInt64(1),
+                        MaybeAlign(8), AtomicOrdering::Monotonic);
+    if (Counters)
+      Pre.CreateCall(HardwareRead, {Snapshot});
+    Value *Start = ReadClock(Pre);
+    Pre.CreateStore(Pre.getInt64(0), Trips);
+    if (Timer) {
+      Pre.CreateCall(IterBegin, {Timer, Start});
+      SmallVector<BasicBlock *, 2> Latches;
+      L->getLoopLatches(Latches);
+      for (BasicBlock *Latch : Latches) {
+        IRBuilder<> Back(Latch->getTerminator());
+        Back.CreateCall(IterNext, {Timer, ReadClock(Back)});
+      }
+    }
+
+    IRBuilder<> Header(&*L->getHeader()->getFirstInsertionPt());
+    Header.CreateStore(
+        Header.CreateAdd(Header.CreateLoad(I64, Trips), Header.getInt64(1)),
+        Trips);
+
+    SmallVector<BasicBlock *, 4> Exits;
+    L->getExitBlocks(Exits);
+    for (BasicBlock *Exit : Exits) {
+      IRBuilder<> Out(&*Exit->getFirstInsertionPt());
+      Value *End = ReadClock(Out);
+      Value *Elapsed = Out.CreateSub(End, Start);
+      if (Timer) {
+        Value *Idx[] = {Out.getInt32(0), Out.getInt32(S)};
+        Out.CreateCall(IterEnd,
+                       {Out.CreateInBoundsGEP(IterCostsTy, IterCosts, Idx),
+                        Timer, End});
+      }
+      if (Counters) {
+        Value *Idx[] = {Out.getInt32(0), Out.getInt32(S), Out.getInt32(0)};
+        Out.CreateCall(HardwareAdd,
+                       {Out.CreateInBoundsGEP(HardwareTy, Hardware, Idx),
+                        Snapshot});
+      }
+      Out.CreateAtomicRMW(AtomicRMWInst::Add, Counter(Out, 1),
+                          Out.CreateLoad(I64, Trips), MaybeAlign(8),
+                          AtomicOrdering::Monotonic);
+      Out.CreateAtomicRMW(AtomicRMWInst::Add, Counter(Out, 2), Elapsed,
+                          MaybeAlign(8), AtomicOrdering::Monotonic);
+    }
+  }
+
+  // Site table and the constructor that hands both tables to the runtime
+  FunctionType *CtorTy = FunctionType::get(Type::getVoidTy(Ctx), false);
+  Function *Ctor = Function::Create(CtorTy, GlobalValue::InternalLinkage,
+                                    "__parallel_profile_init", M);
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", Ctor));
+  StructType *SiteTy = StructType::get(Ctx, {I8Ptr, I8Ptr, I8Ptr, I32, I32});
+  std::vector<Constant *> Rows;
+  for (const ProfileSite &Site : Sites) {
+    Rows.push_back(ConstantStruct::get(
+        SiteTy, {B.CreateGlobalStringPtr(Site.Id, "profile.id", 0, &M),
+                 B.CreateGlobalStringPtr(Site.File, "profile.file", 0, &M),
+                 B.CreateGlobalStringPtr(Site.Function, "profile.function",
+                                         0, &M),
+                 B.getInt32(Site.Line),
+                 ConstantInt::getSigned(I32, Site.Parent)}));
+  }
+  ArrayType *SitesTy = ArrayType::get(SiteTy, Rows.size());
+  auto *SiteTable = new GlobalVariable(
+      M, SitesTy, true, GlobalValue::InternalLinkage,
+      ConstantArray::get(SitesTy, Rows), "__parallel_profile_sites");
+  FunctionCallee Register =
+      M.getOrInsertFunction("__parallel_profile_register",
+                            Type::getVoidTy(Ctx), I8Ptr, I8Ptr, I32, I32);
+  B.CreateCall(Register, {B.CreateBitCast(CounterTable, I8Ptr),
+                          B.CreateBitCast(SiteTable, I8Ptr),
+                          B.getInt32(Sites.size()),
+                          B.getInt32(UseTSC ? ClockKindTSC
+                                            : ClockKindGettime)});
+  if (Counters) {
+    FunctionCallee RegisterHardware = M.getOrInsertFunction(
+        "__parallel_profile_register_hw", Type::getVoidTy(Ctx), I8Ptr, I8Ptr);
+    B.CreateCall(RegisterHardware, {B.CreateBitCast(CounterTable, I8Ptr),
+                                    B.CreateBitCast(Hardware, I8Ptr)});
+  }
+  if (Variance) {
+    FunctionCallee RegisterIter = M.getOrInsertFunction(
+        "__parallel_profile_register_iter", Type::getVoidTy(Ctx), I8Ptr, I8Ptr);
+    B.CreateCall(RegisterIter, {B.CreateBitCast(CounterTable, I8Ptr),
+                                B.CreateBitCast(IterCosts, I8Ptr)});
+  }
+  B.CreateRetVoid();
+  appendToGlobalCtors(M, Ctor, 65535);
+
+  errs() << "parallel-profile: instrumented " << Sites.size() << " loops ("
+         << (UseTSC ? "tsc" : "clock_gettime")
+         << (Counters ? ", hardware counters" : "")
+         << (Variance ? ", iteration variance" : "") << ")\n";
+  return PreservedAnalyses::none();
+}
@@ -0,0 +1,59 @@
+//===-- LoopProfile.h - Per-loop counters for measured hotness --*- C++ -*-===//
+//
+// Instrumentation mode of the analyzer: every loop in loop-simplify form
+// counts its entries and iterations and accumulates the time spent in it,
+// keyed by the same "file:line:function" id as the candidates the analysis
+// reports. runtime/loop_profile.cpp registers the counters of each module
+// and writes them as JSON when the program exits, so candidates can be
+// ranked by measured time instead of source heuristics. With the counters
+// option each loop also reads the thread's hardware counters (cycles,
+// instructions, LLC and branch misses) on entry and exit, which tells
+// memory-bound loops from compute-bound ones. With the variance option,
+// loops that contain loops or calls also time every iteration, and the
+// spread of those times tells which OpenMP schedule balances them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LOOPPROFILE_H
+#define LLVM_LOOPPROFILE_H
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+/// Timer read at loop entry and exit.
+enum class ProfileClock {
+  Default,      // TSC on x86, clock_gettime elsewhere
+  TSC,          // llvm.readcyclecounter; the runtime calibrates it
+  ClockGettime, // __parallel_profile_clock(), CLOCK_MONOTONIC nanoseconds
+};
+
+/// True if L has a preheader and dedicated exits with room for the exit
+/// code, the shape the instrumentation passes rely on.
+bool isProfilableLoop(const Loop &L);
+
+/// Module pass behind -passes=parallel-profile. Loops must be in
+/// loop-simplify form (a preheader and dedicated exits); others are skipped.
+class LoopProfilePass : public PassInfoMixin<LoopProfilePass> {
+public:
+  explicit LoopProfilePass(ProfileClock Clock = ProfileClock::Default,
+                           bool Counters = false, bool Variance = false)
+    : Clock(Clock), Counters(Counters), Variance(Variance) {}
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+
+  /// Parse "clock=tsc", "clock=clock_gettime", "counters" and "variance",
+  /// separated by ';'.
+  static bool parseOptions(StringRef Params, ProfileClock &Clock,
+                           bool &Counters, bool &Variance);
+
+private:
+  ProfileClock Clock;
+  bool Counters; // Hardware counters around each loop (perf_event_open)
+  bool Variance; // Time each iteration of loops with inner loops or calls
+};
+
+} // namespace llvm
+
+#endif // LLVM_LOOPPROFILE_H
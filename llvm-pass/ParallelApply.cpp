@@ -0,0 +1,326 @@
+//===-- ParallelApply.cpp - Outline parallel loops into OpenMP calls -*- C++ -*-===//
+//
+// Loop rewriting, outlining and OpenMP runtime calls for parallel-apply
+//
+//===----------------------------------------------------------------------===//
+
+#include "ParallelApply.h"
+#include "PatternDetect.h"
+#include "PerfectNestAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Frontend/OpenMP/OMPIRBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+using namespace llvm;
+using namespace llvm::omp;
+
+#define DEBUG_TYPE "parallel-apply"
+
+// kmp_sch_static: one contiguous block of iterations per thread
+static constexpr int32_t KmpSchStatic = 34;
+
+static std::string describeLoop(const Loop &L) {
+  std::string Text = L.getHeader()->getParent()->getName().str();
+  if (DebugLoc Loc = L.getStartLoc())
+    Text += " line " + std::to_string(Loc.getLine());
+  return Text;
+}
+
+bool ParallelApplyPass::isLegal(Loop &L, ScalarEvolution &SE,
+                                DependenceInfo &DI, std::string &Reason) {
+  BasicBlock *Latch = L.getLoopLatch();
+  BasicBlock *Exit = L.getExitBlock();
+  if (!L.isLoopSimplifyForm() || !Exit || L.getExitingBlock() != Latch ||
+      !isa<BranchInst>(Latch->getTerminator())) {
+    Reason = "not a rotated single-exit loop in loop-simplify form";
+    return false;
+  }
+  if (!Exit->phis().empty()) {
+    Reason = "values are live after the loop";
+    return false;
+  }
+
+  const SCEV *BTC = SE.getBackedgeTakenCount(&L);
+  if (isa<SCEVCouldNotCompute>(BTC) || !isSafeToExpand(BTC, SE)) {
+    Reason = "trip count is not computable before the loop";
+    return false;
+  }
+
+  if (!PatternDetection::isEmbarrassinglyParallel(&L, SE)) {
+    Reason = "loop is not embarrassingly parallel";
+    return false;
+  }
+
+  // Each induction is rebuilt from the iteration number, so it must be an
+  // affine integer or pointer recurrence of this loop
+  for (PHINode &Phi : L.getHeader()->phis()) {
+    InductionDescriptor ID;
+    auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&Phi));
+    if (!InductionDescriptor::isInductionPHI(&Phi, &L, &SE, ID) || !AR ||
+        AR->getLoop() != &L || !AR->isAffine() ||
+        !isSafeToExpand(AR->getStart(), SE) ||
+        !isSafeToExpand(AR->getStepRecurrence(SE), SE)) {
+      Reason = "header PHI is not an integer or pointer induction";
+      return false;
+    }
+  }
+
+  for (BasicBlock *BB : L.blocks()) {
+    for (Instruction &I : *BB) {
+      for (User *U : I.users()) {
+        if (!L.contains(cast<Instruction>(U))) {
+          Reason = "values are live after the loop";
+          return false;
+        }
+      }
+      if (isa<AllocaInst>(&I) || I.isEHPad() || isa<InvokeInst>(&I)) {
+        Reason = "loop contains allocas or exception handling";
+        return false;
+      }
+    }
+  }
+
+  // The proof: no dependence between any two accesses is carried by L
+  if (!hasNoCarriedDependence(L, DI)) {
+    Reason = "dependence analysis cannot rule out a carried dependence";
+    return false;
+  }
+  return true;
+}
+
+bool ParallelApplyPass::parallelize(Loop &L, Function &F, ScalarEvolution &SE,
+                                    OpenMPIRBuilder &OMPBuilder) {
+  Module &M = *F.getParent();
+  LLVMContext &Ctx = M.getContext();
+  const DataLayout &DL = M.getDataLayout();
+  BasicBlock *Preheader = L.getLoopPreheader();
+  BasicBlock *Header = L.getHeader();
+  BasicBlock *Latch = L.getLoopLatch();
+  BasicBlock *Exit = L.getExitBlock();
+  DebugLoc Loc = L.getStartLoc();
+  Type *Int32 = Type::getInt32Ty(Ctx);
+  Type *Int64 = Type::getInt64Ty(Ctx);
+
+  // CodeExtractor must accept the loop before anything is rewritten
+  if (!CodeExtractor(L.getBlocks()).isEligible()) {
+    LLVM_DEBUG(dbgs() << "parallel-apply: cannot outline " << describeLoop(L)
+                      << "\n");
+    return false;
+  }
+
+  // Iterations are numbered 0..BTC; inductions become start + iv * step
+  SCEVExpander Expander(SE, DL, "omp");
+  Instruction *PreheaderTerm = Preheader->getTerminator();
+  Value *LastIter = Expander.expandCodeFor(
+      SE.getTruncateOrZeroExtend(SE.getBackedgeTakenCount(&L), Int64), Int64,
+      PreheaderTerm);
+
+  struct InductionPlan {
+    PHINode *Phi;
+    Value *Start;
+    Value *Step;
+  };
+  SmallVector<InductionPlan, 4> Plans;
+  for (PHINode &Phi : Header->phis()) {
+    auto *AR = cast<SCEVAddRecExpr>(SE.getSCEV(&Phi));
+    const SCEV *Step = AR->getStepRecurrence(SE);
+    Plans.push_back(
+        {&Phi, Expander.expandCodeFor(AR->getStart(), Phi.getType(), PreheaderTerm),
+         Expander.expandCodeFor(Step, Step->getType(), PreheaderTerm)});
+  }
+
+  // preheader -> omp.dispatch -> loop -> omp.fini -> exit
+  BasicBlock *Dispatch = BasicBlock::Create(Ctx, "omp.dispatch", &F, Header);
+  BasicBlock *Fini = BasicBlock::Create(Ctx, "omp.fini", &F, Exit);
+  PreheaderTerm->replaceUsesOfWith(Header, Dispatch);
+  Latch->getTerminator()->replaceUsesOfWith(Exit, Fini);
+  for (PHINode &Phi : Header->phis())
+    Phi.replaceIncomingBlockWith(Preheader, Dispatch);
+
+  uint32_t SrcLocSize = 0;
+  Constant *SrcLoc = Loc ? OMPBuilder.getOrCreateSrcLocStr(Loc, SrcLocSize, &F)
+                         : OMPBuilder.getOrCreateDefaultSrcLocStr(SrcLocSize);
+  Constant *Ident = OMPBuilder.getOrCreateIdent(SrcLoc, SrcLocSize,
+                                                IdentFlag::OMP_IDENT_FLAG_KMPC);
+
+  IRBuilder<> &Builder = OMPBuilder.Builder;
+  Builder.SetInsertPoint(Dispatch);
+  Builder.SetCurrentDebugLocation(Loc);
+  Value *IsLast = Builder.CreateAlloca(Int32, nullptr, "omp.is_last");
+  Value *PLower = Builder.CreateAlloca(Int64, nullptr, "omp.lb.addr");
+  Value *PUpper = Builder.CreateAlloca(Int64, nullptr, "omp.ub.addr");
+  Value *PStride = Builder.CreateAlloca(Int64, nullptr, "omp.stride.addr");
+  Builder.CreateStore(Builder.getInt32(0), IsLast);
+  Builder.CreateStore(Builder.getInt64(0), PLower);
+  Builder.CreateStore(LastIter, PUpper);
+  Builder.CreateStore(Builder.getInt64(1), PStride);
+  Value *ThreadID = OMPBuilder.getOrCreateThreadID(Ident);
+  Builder.CreateCall(
+      OMPBuilder.getOrCreateRuntimeFunctionPtr(OMPRTL___kmpc_for_static_init_8u),
+      {Ident, ThreadID, Builder.getInt32(KmpSchStatic), IsLast, PLower, PUpper,
+       PStride, Builder.getInt64(1), Builder.getInt64(1)});
+  Value *Lower = Builder.CreateLoad(Int64, PLower, "omp.lb");
+  Value *Upper = Builder.CreateLoad(Int64, PUpper);
+  Upper = Builder.CreateSelect(Builder.CreateICmpUGT(Upper, LastIter), LastIter,
+                               Upper, "omp.ub");
+  Builder.CreateCondBr(Builder.CreateICmpULE(Lower, Upper), Header, Fini);
+
+  Builder.SetInsertPoint(Fini);
+  Builder.CreateCall(
+      OMPBuilder.getOrCreateRuntimeFunctionPtr(OMPRTL___kmpc_for_static_fini),
+      {Ident, ThreadID});
+  Builder.CreateBr(Exit);
+
+  // Drive the loop by the iteration number of this thread's block
+  Builder.SetInsertPoint(Header, Header->getFirstInsertionPt());
+  PHINode *IV = PHINode::Create(Int64, 2, "omp.iv", &Header->front());
+  IV->addIncoming(Lower, Dispatch);
+  for (InductionPlan &Plan : Plans) {
+    Type *Ty = Plan.Phi->getType();
+    Value *Offset = Builder.CreateMul(
+        Builder.CreateZExtOrTrunc(IV, Plan.Step->getType()), Plan.Step);
+    Value *Rebuilt;
+    if (Ty->isPointerTy()) {
+      Type *BytePtr = Builder.getInt8PtrTy(Ty->getPointerAddressSpace());
+      Rebuilt = Builder.CreateGEP(Builder.getInt8Ty(),
+                                  Builder.CreateBitCast(Plan.Start, BytePtr),
+                                  Offset);
+      Rebuilt = Builder.CreateBitCast(Rebuilt, Ty);
+    } else {
+      Rebuilt = Builder.CreateAdd(Plan.Start, Offset);
+    }
+    Rebuilt->takeName(Plan.Phi);
+    Plan.Phi->replaceAllUsesWith(Rebuilt);
+    Plan.Phi->eraseFromParent();
+  }
+
+  auto *LatchBr = cast<BranchInst>(Latch->getTerminator());
+  Builder.SetInsertPoint(LatchBr);
+  Value *Next = Builder.CreateAdd(IV, Builder.getInt64(1), "omp.iv.next",
+                                  /*HasNUW=*/true, /*HasNSW=*/true);
+  IV->addIncoming(Next, Latch);
+  Builder.CreateCondBr(Builder.CreateICmpULT(IV, Upper), Header, Fini);
+  Value *OldCond = LatchBr->isConditional() ? LatchBr->getCondition() : nullptr;
+  LatchBr->eraseFromParent();
+  if (OldCond)
+    RecursivelyDeleteTriviallyDeadInstructions(OldCond);
+
+  // Outline dispatch, loop and fini into the worksharing body
+  SmallVector<BasicBlock *, 16> Blocks{Dispatch};
+  Blocks.append(L.block_begin(), L.block_end());
+  Blocks.push_back(Fini);
+  CodeExtractorAnalysisCache CEAC(F);
+  CodeExtractor Extractor(Blocks, nullptr, false, nullptr, nullptr, nullptr,
+                          false, /*AllowAlloca=*/true, "omp_par");
+  Function *Body = Extractor.extractCodeRegion(CEAC);
+  if (!Body) {
+    // The rewritten loop still runs correctly on a team of one thread
+    LLVM_DEBUG(dbgs() << "parallel-apply: extraction failed for "
+                      << F.getName() << "\n");
+    return false;
+  }
+  BasicBlock &BodyEntry = Body->getEntryBlock();
+  for (Instruction &I : make_early_inc_range(*Dispatch))
+    if (isa<AllocaInst>(&I))
+      I.moveBefore(&*BodyEntry.getFirstInsertionPt());
+
+  // Microtask void(i32 *gtid, i32 *btid, captures...). Captures travel as
+  // pointers; scalars are passed by reference like clang does.
+  auto *Call = cast<CallInst>(Body->user_back());
+  SmallVector<Type *, 8> Params{Int32->getPointerTo(), Int32->getPointerTo()};
+  for (Value *Arg : Call->args())
+    Params.push_back(Arg->getType()->isPointerTy() ? Arg->getType()
+                                                   : Arg->getType()->getPointerTo());
+  Function *Microtask = Function::Create(
+      FunctionType::get(Type::getVoidTy(Ctx), Params, false),
+      GlobalValue::InternalLinkage, F.getName() + ".omp_outlined", M);
+  Microtask->addFnAttr(Attribute::NoUnwind);
+  IRBuilder<> TaskBuilder(BasicBlock::Create(Ctx, "entry", Microtask));
+  SmallVector<Value *, 8> Forwarded;
+  for (unsigned K = 0; K < Call->arg_size(); ++K) {
+    Type *Ty = Call->getArgOperand(K)->getType();
+    Value *Param = Microtask->getArg(K + 2);
+    Forwarded.push_back(Ty->isPointerTy() ? Param : TaskBuilder.CreateLoad(Ty, Param));
+  }
+  TaskBuilder.CreateCall(Body, Forwarded);
+  TaskBuilder.CreateRetVoid();
+
+  Function *ForkCall =
+      OMPBuilder.getOrCreateRuntimeFunctionPtr(OMPRTL___kmpc_fork_call);
+  IRBuilder<> EntryBuilder(&*F.getEntryBlock().getFirstInsertionPt());
+  IRBuilder<> CallBuilder(Call);
+  SmallVector<Value *, 8> ForkArgs{
+      Ident, CallBuilder.getInt32(Call->arg_size()),
+      CallBuilder.CreateBitCast(Microtask,
+                                ForkCall->getFunctionType()->getParamType(2))};
+  for (Value *Arg : Call->args()) {
+    if (Arg->getType()->isPointerTy()) {
+      ForkArgs.push_back(Arg);
+      continue;
+    }
+    Value *Slot = EntryBuilder.CreateAlloca(Arg->getType(), nullptr,
+                                            Arg->getName() + ".capture");
+    CallBuilder.CreateStore(Arg, Slot);
+    ForkArgs.push_back(Slot);
+  }
+  CallBuilder.CreateCall(ForkCall, ForkArgs);
+  Call->eraseFromParent();
+  return true;
+}
+
+PreservedAnalyses ParallelApplyPass::run(Module &M, ModuleAnalysisManager &MAM) {
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  OpenMPIRBuilder OMPBuilder(M);
+  OMPBuilder.initialize();
+
+  // Outlining adds functions; only visit the ones that were there before
+  SmallVector<Function *, 16> Functions;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+
+  bool Changed = false;
+  for (Function *F : Functions) {
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+    ScalarEvolution &SE = FAM.getResult<ScalarEvolutionAnalysis>(*F);
+    DependenceInfo &DI = FAM.getResult<DependenceAnalysis>(*F);
+
+    // Parallelize the outermost legal loop of every nest
+    SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+    SmallVector<Loop *, 8> Legal;
+    while (!Worklist.empty()) {
+      Loop *L = Worklist.pop_back_val();
+      std::string Reason;
+      if (isLegal(*L, SE, DI, Reason)) {
+        Legal.push_back(L);
+        continue;
+      }
+      LLVM_DEBUG(dbgs() << "parallel-apply: skipping " << describeLoop(*L)
+                        << ": " << Reason << "\n");
+      Worklist.append(L->begin(), L->end());
+    }
+
+    bool FunctionChanged = false;
+    for (Loop *L : Legal) {
+      std::string Where = describeLoop(*L);
+      if (parallelize(*L, *F, SE, OMPBuilder)) {
+        errs() << "parallel-apply: parallelized loop in " << Where << "\n";
+        FunctionChanged = true;
+      }
+    }
+    if (FunctionChanged) {
+      FAM.invalidate(*F, PreservedAnalyses::none());
+      Changed = true;
+    }
+  }
+  return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
@@ -0,0 +1,44 @@
+//===-- ParallelApply.h - Outline parallel loops into OpenMP calls -*- C++ -*-===//
+//
+// Transformation mode of the analyzer: loops that are embarrassingly
+// parallel and whose independence DependenceAnalysis proves are outlined
+// into an OpenMP microtask and replaced by __kmpc_fork_call, with the
+// iteration space split by __kmpc_for_static_init.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PARALLELAPPLY_H
+#define LLVM_PARALLELAPPLY_H
+
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/PassManager.h"
+#include <string>
+
+namespace llvm {
+
+class OpenMPIRBuilder;
+
+/// Module pass behind -passes=parallel-apply. Loops must be in loop-simplify
+/// form; run it after the usual -O1/-O2 function pipeline.
+class ParallelApplyPass : public PassInfoMixin<ParallelApplyPass> {
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+
+  /// Check that \p L can be run as an OpenMP static worksharing loop: a
+  /// rotated loop with a computable trip count, integer or pointer
+  /// inductions only, no values live after the loop and no dependence
+  /// carried by \p L. On failure \p Reason says why.
+  static bool isLegal(Loop &L, ScalarEvolution &SE, DependenceInfo &DI,
+                      std::string &Reason);
+
+private:
+  /// Outline \p L into a microtask and fork it. \p L must be legal.
+  bool parallelize(Loop &L, Function &F, ScalarEvolution &SE,
+                   OpenMPIRBuilder &OMPBuilder);
+};
+
+} // namespace llvm
+
+#endif // LLVM_PARALLELAPPLY_H
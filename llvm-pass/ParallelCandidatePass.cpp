@@ -6,6 +6,10 @@
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/IRBuilder.h"
@@ -14,7 +18,27 @@
 #include "llvm/IR/DebugLoc.h"
 #include "PatternDetect.h"
 #include "AIEnhancedAnalysis.h"
+#include "PerfectNestAnalysis.h"
+#include "TilingAdvisor.h"
+#include "AliasVersioning.h"
+#include "SCEVSourcePrinter.h"
+#include "ParallelApply.h"
+#include "LoopAnnotate.h"
+#include "AdvancedPatternDetect.h"
+#include "IdiomRecognizer.h"
+#include "StencilAnalysis.h"
+#include "ScatterUpdate.h"
+#include "TaskGraph.h"
+#include "PipelineAnalysis.h"
+#include "LoopProfile.h"
+#include "DependenceProfile.h"
+#include "LoopHotness.h"
+#include "FalseSharing.h"
+#include "ScheduleAdvisor.h"
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <cstdlib>
@@ -29,6 +53,14 @@ std::string getJsonOutputPath() {
 
 namespace {
 
+// Options parsed from parallel-candidate<...> pass parameters
+struct ParallelCandidateOptions {
+    CacheModel cache = CacheModel::detect();
+    // A reference multicore target rather than the analyzing machine, whose
+    // core count (one, on a build server) would hide every imbalance
+    unsigned threads = 8;
+};
+
 struct CandidateResult {
     std::string file;
     std::string function;
@@ -36,34 +68,405 @@ struct CandidateResult {
     std::string candidate_type;
     std::string reason;
     std::string suggested_patch;
+    json::Object details;  // Pattern-specific analysis facts
+    Optional<LoopHotness> hotness;  // Execution weight of the loops it covers
+
+    // Details and hotness are filled in by the annotate* passes over the
+    // candidates of a function
+    CandidateResult(std::string file, std::string function, int line, std::string candidate_type,
+                    std::string reason, std::string suggested_patch)
+        : file(std::move(file)), function(std::move(function)), line(line),
+          candidate_type(std::move(candidate_type)), reason(std::move(reason)),
+          suggested_patch(std::move(suggested_patch)) {}
 };
 
 class ParallelCandidatePass : public PassInfoMixin<ParallelCandidatePass> {
 private:
     std::vector<CandidateResult> candidates;
     AIEnhancedAnalysis aiAnalysis;  // Add AI analysis component
+    ParallelCandidateOptions options;
+    double profiledWeight = 0;  // Profiled instructions of every analyzed function
 
-    void analyzeLoop(Loop *L, Function &F, ScalarEvolution &SE) {
-        // Skip non-innermost loops for now
-        if (!L->getSubLoops().empty()) {
+    // Directive lines of a patch that go directly above the loop, or ""
+    // when the patch has code before the loop or placeholders to fill in
+    static std::string extractLoopDirectives(const std::string &patch) {
+        std::string directives;
+        std::istringstream lines(patch);
+        std::string line;
+        while (std::getline(lines, line)) {
+            StringRef text = StringRef(line).trim();
+            if (text.empty() || text.startswith("//")) continue;
+            if (text.startswith("for")) break;
+            if (!text.startswith("#pragma") || text.contains("/*")) return "";
+            directives += text.str() + "\n";
+        }
+        if (!directives.empty()) directives.pop_back();
+        return directives;
+    }
+
+    // Reduction candidate with the recognized operators and variables
+    static CandidateResult makeReductionCandidate(Loop *L, const std::string &filename,
+                                                  const std::string &functionName, int line,
+                                                  const std::string &patternType) {
+        std::string reason = "Reduction recognized:";
+        json::Array reductions;
+        for (const auto &R : PatternDetection::findReductions(L)) {
+            std::string var = R.variable.empty() ? "<unnamed>" : R.variable;
+            reason += " " + R.ompOperator + " over " + var + ",";
+            json::Object obj;
+            obj["variable"] = R.variable;
+            obj["kind"] = R.kind;
+            obj["operator"] = R.ompOperator;
+            obj["exact_fp_math"] = R.exactFPMath;
+            reductions.push_back(std::move(obj));
+        }
+        reason.pop_back();
+
+        CandidateResult candidate{
+            filename, functionName, line,
+            patternType,
+            reason,
+            PatternDetection::generateOptimalPatch(patternType, L)
+        };
+        candidate.details["reductions"] = std::move(reductions);
+        return candidate;
+    }
+
+    // Loop or nest that one BLAS or libc call replaces outright
+    static CandidateResult makeIdiomCandidate(const std::string &filename,
+                                              const std::string &functionName, int line,
+                                              const LibraryIdiom &Idiom) {
+        CandidateResult candidate{
+            filename, functionName, line,
+            "library_call",
+            Idiom.Reason + " - replace with " + Idiom.Routine,
+            IdiomRecognizer::generatePatch(Idiom)
+        };
+        json::Object arguments;
+        for (const auto &Arg : Idiom.Arguments) {
+            arguments[Arg.first] = Arg.second;
+        }
+        candidate.details["idiom"] = Idiom.Kind;
+        candidate.details["routine"] = Idiom.Routine;
+        candidate.details["call"] = Idiom.Call;
+        candidate.details["arguments"] = std::move(arguments);
+        return candidate;
+    }
+
+    // gemm and gemv nests; returns false when the nest is no library idiom
+    bool analyzeLibraryNest(Loop *Root, Function &F, IdiomRecognizer &Idioms) {
+        Optional<LibraryIdiom> Idiom = Idioms.matchNest(*Root);
+        if (!Idiom) return false;
+        auto [filename, line] = PatternDetection::getLoopLocation(Root);
+        candidates.push_back(makeIdiomCandidate(filename, F.getName().str(), line, *Idiom));
+        annotateLocation(Root, candidates.size() - 1);
+        return true;
+    }
+
+    // The analyzers read preheaders, latches and dedicated exits, which
+    // only loops in loop-simplify form have: run loop-simplify first
+    static bool isSimplifiedNest(Loop *Root) {
+        return all_of(Root->getLoopsInPreorder(),
+                      [](Loop *L) { return L->isLoopSimplifyForm(); });
+    }
+
+    void analyzeNest(Loop *Root, Function &F, PerfectNestAnalyzer &NestAnalyzer,
+                     TilingAdvisor &Tiling, ScheduleAdvisor &Schedules,
+                     FalseSharingAnalyzer &FalseSharing) {
+        PerfectNestInfo Info = NestAnalyzer.analyze(*Root);
+
+        // Single-level bands are handled loop by loop in analyzeLoop, unless
+        // the outer loop's iterations differ in cost
+        if (Info.Band.size() < 2) {
+            if (Info.CollapseDepth == 1) {
+                analyzeUnbalancedLoop(Root, F, Schedules, FalseSharing);
+            }
             return;
         }
+        TilingAdvice Advice = Tiling.advise(Info);
+        bool worthTiling = Advice.Legal && Advice.Profitable;
+        if (Info.CollapseDepth == 0 && !Info.OrderChanged && !worthTiling) return;
 
-        Instruction *firstInst = nullptr;
-        for (BasicBlock *BB : L->blocks()) {
-            if (!BB->empty()) {
-                firstInst = &BB->front();
-                break;
+        std::string patternType = "perfect_nest";
+        if (Info.NestDepth == 3 && Root->getSubLoops().size() == 1) {
+            Loop *Middle = Root->getSubLoops().front();
+            Loop *Inner = Middle->getSubLoops().size() == 1 ? Middle->getSubLoops().front() : nullptr;
+            if (PatternDetection::isMatrixMultiplication(Root, Middle, Inner)) {
+                patternType = "matrix_multiply";
             }
         }
 
-        if (!firstInst) return;
+        auto [filename, line] = PatternDetection::getLoopLocation(Root);
+        CandidateResult candidate{
+            filename, F.getName().str(), line,
+            patternType,
+            Info.Reason,
+            NestAnalyzer.generateNestPatch(Info)
+        };
+        if (worthTiling) {
+            candidate.suggested_patch += Tiling.generateTiledSkeleton(Info, Advice);
+            json::Array l1Tiles, l2Tiles;
+            for (unsigned tile : Advice.L1Tiles) l1Tiles.push_back(static_cast<int64_t>(tile));
+            for (unsigned tile : Advice.L2Tiles) l2Tiles.push_back(static_cast<int64_t>(tile));
+            candidate.details["l1_tile_sizes"] = std::move(l1Tiles);
+            candidate.details["l2_tile_sizes"] = std::move(l2Tiles);
+            candidate.details["l1_working_set_bytes"] = static_cast<int64_t>(Advice.L1Footprint);
+            candidate.details["l2_working_set_bytes"] = static_cast<int64_t>(Advice.L2Footprint);
+        } else if (patternType == "matrix_multiply") {
+            candidate.suggested_patch += "// Tiling not applied: " + Advice.Reason;
+        }
+        candidate.details["nest_depth"] = static_cast<int64_t>(Info.NestDepth);
+        candidate.details["perfect_depth"] = static_cast<int64_t>(Info.PerfectDepth);
+        candidate.details["rectangular_depth"] = static_cast<int64_t>(Info.RectangularDepth);
+        candidate.details["collapse_depth"] = static_cast<int64_t>(Info.CollapseDepth);
+        candidate.details["interchange_legal"] = Info.InterchangeLegal;
+        json::Array order;
+        for (unsigned level : Info.RecommendedOrder) {
+            order.push_back(static_cast<int64_t>(level));
+        }
+        candidate.details["recommended_order"] = std::move(order);
+        // The collapsed triangle is balanced; without non-rectangular
+        // collapse the outer loop alone needs a schedule
+        bool nonRectangular = Info.NonRectangular && Info.CollapseDepth > Info.RectangularDepth;
+        candidate.details["non_rectangular_collapse"] = nonRectangular;
+        if (nonRectangular) {
+            // Fitted to whole lines the way annotateFalseSharing fits the pragma
+            std::string fallback = "#pragma omp parallel for";
+            ScheduleInfo outer = Schedules.analyze(*Root);
+            FalseSharingInfo outerSharing = FalseSharing.analyze(*Root);
+            outer.Chunk = FalseSharingAnalyzer::fitChunk(outerSharing, outer.Kind, outer.Chunk);
+            std::string clause = outer.clause();
+            if (clause.empty() && outerSharing.UseChunk) {
+                clause = "schedule(static, " + std::to_string(outerSharing.MinChunk) + ")";
+            }
+            if (!clause.empty()) fallback += " " + clause;
+            candidate.details["fallback_pragma"] = fallback;
+            candidate.suggested_patch += "// Compilers without OpenMP 5.x non-rectangular loops: " +
+                                         fallback + " on the outer loop\n";
+        }
+        candidates.push_back(std::move(candidate));
+        if (Info.CollapseDepth > 0) {
+            ArrayRef<Loop *> collapsed(Info.Band.data(), Info.CollapseDepth);
+            annotateSchedule(Schedules.analyze(*Root, collapsed), candidates.size() - 1);
+            annotateFalseSharing(FalseSharing.analyze(*Root, collapsed), candidates.size() - 1);
+        }
+        annotateLocation(Root, candidates.size() - 1);
+    }
+
+    // Outer loop without carried dependences whose inner loops do a
+    // different amount of work per iteration (triangles, sparse rows, early
+    // exits): the loop to run in parallel, with a balancing schedule
+    void analyzeUnbalancedLoop(Loop *Root, Function &F, ScheduleAdvisor &Schedules,
+                               FalseSharingAnalyzer &FalseSharing) {
+        ScheduleInfo schedule = Schedules.analyze(*Root);
+        if (schedule.Imbalance == "none") return;
+        auto [filename, line] = PatternDetection::getLoopLocation(Root);
+        candidates.push_back({
+            filename, F.getName().str(), line,
+            "parallel_loop",
+            "Outer loop carries no dependence, but its iterations differ in cost",
+            "#pragma omp parallel for"
+        });
+        annotateSchedule(schedule, candidates.size() - 1);
+        annotateFalseSharing(FalseSharing.analyze(*Root), candidates.size() - 1);
+        annotateLocation(Root, candidates.size() - 1);
+    }
+
+    // Stencil shape facts shared by every candidate of the stencil's loop
+    static json::Object makeStencilDetails(const StencilInfo &Info, const StencilTiling &Tiling) {
+        json::Object obj;
+        json::Array radius;
+        for (unsigned r : Info.Radius) radius.push_back(static_cast<int64_t>(r));
+        obj["dimensions"] = static_cast<int64_t>(Info.Spatial.size());
+        obj["radius"] = std::move(radius);
+        obj["points"] = static_cast<int64_t>(Info.Points);
+        obj["shape"] = Info.Star ? "star" : "box";
+        obj["in_place"] = Info.InPlace;
+        obj["time_loop"] = Info.TimeKind;
+        if (Info.TimeLoop) {
+            obj["time_loop_line"] = PatternDetection::getLoopLocation(Info.TimeLoop).second;
+        }
+        obj["blocking"] = Tiling.Scheme;
+        if (Tiling.Scheme == "trapezoid") {
+            obj["time_block"] = static_cast<int64_t>(Tiling.TimeBlock);
+            obj["tile_width"] = static_cast<int64_t>(Tiling.TileWidth);
+        } else if (Tiling.Scheme == "wavefront") {
+            obj["block"] = json::Array{static_cast<int64_t>(Tiling.BlockI),
+                                       static_cast<int64_t>(Tiling.BlockJ)};
+            obj["skew"] = static_cast<int64_t>(Tiling.Skew);
+        }
+        if (Tiling.Footprint) obj["tile_bytes"] = static_cast<int64_t>(Tiling.Footprint);
+        obj["blocking_reason"] = Tiling.Reason;
+        return obj;
+    }
+
+    // Target size and chosen strategy of a scatter update
+    static json::Object makeScatterDetails(const ScatterUpdateInfo &Info) {
+        json::Object obj;
+        obj["target"] = Info.Target;
+        obj["index"] = Info.Index;
+        obj["operator"] = Info.Operator;
+        if (!Info.Guard.empty()) obj["condition"] = Info.Guard;
+        obj["element_type"] = Info.ElemType;
+        obj["elements"] = Info.SizeExpr;
+        obj["size_source"] = Info.SizeSource;
+        if (Info.Size) obj["bytes"] = static_cast<int64_t>(*Info.Size * Info.ElemSize);
+        if (Info.TripCount) obj["updates"] = static_cast<int64_t>(*Info.TripCount);
+        obj["disjoint"] = Info.Disjoint;
+        if (!Info.Input.empty()) {
+            obj["input"] = Info.Input;
+            obj["bin"] = Info.BinOf;
+        }
+        obj["strategy"] = Info.Strategy;
+        return obj;
+    }
+
+    // Call sites and loop nests that the loop-level analysis sees one at a
+    // time, run as a DAG of OpenMP tasks when independent work overlaps
+    void analyzeTasks(Function &F, TaskGraphBuilder &TaskGraphs) {
+        TaskGraph graph = TaskGraphs.build(F);
+        if (!TaskGraphBuilder::isProfitable(graph)) {
+            return;
+        }
+        const TaskNode &first = graph.Nodes.front();
+        CandidateResult candidate{
+            first.File.empty() ? "unknown" : first.File, F.getName().str(),
+            static_cast<int>(first.FirstLine),
+            "task_graph",
+            graph.Reason,
+            TaskGraphBuilder::generatePatch(graph)
+        };
+        json::Array tasks;
+        for (const TaskNode &node : graph.Nodes) {
+            json::Object task;
+            task["kind"] = node.Kind;
+            task["label"] = node.Label;
+            task["first_line"] = static_cast<int64_t>(node.FirstLine);
+            task["last_line"] = static_cast<int64_t>(node.LastLine);
+            task["cost"] = static_cast<int64_t>(node.Cost);
+            task["depends_on"] = json::Array(node.Preds);
+            task["reads"] = json::Array(node.Reads);
+            task["writes"] = json::Array(node.Writes);
+            tasks.push_back(std::move(task));
+        }
+        json::Object details;
+        details["tasks"] = std::move(tasks);
+        details["work"] = static_cast<int64_t>(graph.Work);
+        details["critical_path"] = json::Array(graph.CriticalPath);
+        details["critical_path_cost"] = static_cast<int64_t>(graph.Span);
+        details["parallelism"] = graph.Parallelism;
+        details["width"] = static_cast<int64_t>(graph.Width);
+        candidate.details["task_graph"] = std::move(details);
+        candidates.push_back(std::move(candidate));
+    }
+
+    void analyzeLoop(Loop *L, Function &F, ScalarEvolution &SE,
+                     AliasVersioningAnalyzer &AliasVersioning, IdiomRecognizer &Idioms,
+                     StencilAnalyzer &Stencils, ScatterUpdateAnalyzer &Scatters,
+                     ScheduleAdvisor &Schedules, FalseSharingAnalyzer &FalseSharing) {
+        // Outer loops are covered by analyzeNest
+        if (!L->getSubLoops().empty()) {
+            return;
+        }
 
-        auto [filename, line] = PatternDetection::getSourceLocation(firstInst);
+        auto [filename, line] = PatternDetection::getLoopLocation(L);
         std::string functionName = F.getName().str();
+        size_t firstCandidate = candidates.size();
 
+        // Time-stepped and in-place stencils are rewritten around the
+        // innermost loop: trapezoids over the time loop or a wavefront
+        StencilInfo stencil = Stencils.analyze(*L);
+        StencilTiling stencilTiling = Stencils.plan(stencil);
+        if (!stencilTiling.Scheme.empty()) {
+            Loop *target = stencilTiling.Scheme == "trapezoid" ? stencil.TimeLoop
+                                                               : stencil.Spatial.front();
+            auto [targetFile, targetLine] = PatternDetection::getLoopLocation(target);
+            CandidateResult candidate{
+                targetFile, functionName, targetLine,
+                "stencil",
+                stencil.Reason + " - " + stencilTiling.Scheme + " schedule",
+                Stencils.generatePatch(stencil, stencilTiling)
+            };
+            candidate.details["stencil"] = makeStencilDetails(stencil, stencilTiling);
+            candidates.push_back(std::move(candidate));
+            annotateLocation(target, firstCandidate);
+            return;
+        }
+
+        // Loops over may-alias pointers are only parallel behind a runtime check
+        AliasVersioningInfo aliasInfo = AliasVersioning.analyze(L);
+        PatternDetection::ScanInfo scanInfo;
+        PatternDetection::FilterInfo filterInfo;
+        // A tuned library routine beats any pragma on the same loop
+        if (Optional<LibraryIdiom> idiom = Idioms.matchLoop(*L)) {
+            candidates.push_back(makeIdiomCandidate(filename, functionName, line, *idiom));
+        }
+        // Indirect updates h[idx[i]] op= v race unless privatized or atomic
+        else if (ScatterUpdateInfo scatter = Scatters.analyze(*L); scatter.Found) {
+            CandidateResult candidate{
+                filename, functionName, line,
+                "histogram",
+                scatter.Reason,
+                Scatters.generatePatch(scatter)
+            };
+            candidate.details["scatter_update"] = makeScatterDetails(scatter);
+            candidates.push_back(std::move(candidate));
+        }
+        // out[k++] = x[i] under a condition: the cursor is a scan of the
+        // condition, so count, scan and scatter keep the output order
+        else if (PatternDetection::findFilter(L, SE, filterInfo)) {
+            CandidateResult candidate{
+                filename, functionName, line,
+                "filter",
+                std::string("Conditional append ") +
+                    (filterInfo.pushBack ? "through push_back" : "at cursor " + filterInfo.cursor) +
+                    " - order-preserving parallel stream compaction",
+                PatternDetection::generateFilterPatch(filterInfo)
+            };
+            json::Object filter;
+            filter["cursor"] = filterInfo.cursor;
+            json::Array outputs;
+            for (const std::string &output : filterInfo.outputs) outputs.push_back(output);
+            filter["outputs"] = std::move(outputs);
+            filter["condition"] = filterInfo.condition;
+            filter["push_back"] = filterInfo.pushBack;
+            candidate.details["filter"] = std::move(filter);
+            candidates.push_back(std::move(candidate));
+        }
+        else if (aliasInfo.NeedsChecks && aliasInfo.SafeWithChecks) {
+            CandidateResult candidate{
+                filename, functionName, line,
+                "alias_versioned",
+                aliasInfo.Reason,
+                AliasVersioning.generateVersionedPatch(aliasInfo)
+            };
+            candidate.details["runtime_checks"] = static_cast<int64_t>(aliasInfo.Checks.size());
+            if (!aliasInfo.Printable)
+                candidate.details["versioning"] = "Not emitted - the range or loop bounds are not "
+                                                  "expressible in source";
+            candidates.push_back(std::move(candidate));
+        }
+        // Prefix scans look sequential but map onto OpenMP inscan reductions
+        else if (PatternDetection::findScan(L, SE, scanInfo)) {
+            std::string kind = scanInfo.inclusive ? "inclusive" : "exclusive";
+            CandidateResult candidate{
+                filename, functionName, line,
+                "prefix_sum",
+                "Associative " + kind + " scan (" + scanInfo.ompOperator + ") - parallel with an "
+                "OpenMP inscan reduction",
+                PatternDetection::generateOptimalPatch("prefix_sum", L, &scanInfo)
+            };
+            candidate.details["scan_operator"] = scanInfo.ompOperator;
+            candidate.details["scan_kind"] = kind;
+            candidate.details["scan_variable"] = scanInfo.variable;
+            candidate.details["scan_array"] = scanInfo.array;
+            if (!PatternDetection::isScanPrintable(scanInfo))
+                candidate.details["scan_patch"] = "Advisory only - the scan input or loop bounds "
+                                                  "are not expressible in source";
+            candidates.push_back(std::move(candidate));
+        }
         // Check for embarrassingly parallel patterns first (easiest to parallelize)
-        if (PatternDetection::isEmbarrassinglyParallel(L)) {
+        else if (PatternDetection::isEmbarrassinglyParallel(L, SE)) {
             candidates.push_back({
                 filename, functionName, line,
                 "embarrassingly_parallel",
@@ -72,7 +475,7 @@ private:
             });
         }
         // Check for vectorizable loops
-        else if (PatternDetection::isVectorizableLoop(L)) {
+        else if (PatternDetection::isVectorizableLoop(L, SE)) {
             candidates.push_back({
                 filename, functionName, line,
                 "vectorizable",
@@ -81,13 +484,9 @@ private:
             });
         }
         // Check for advanced reduction patterns
-        else if (PatternDetection::hasAdvancedReductionPattern(L)) {
-            candidates.push_back({
-                filename, functionName, line,
-                "advanced_reduction", 
-                "Min/max or logical reduction pattern detected",
-                PatternDetection::generateOptimalPatch("advanced_reduction", L)
-            });
+        else if (PatternDetection::hasAdvancedReductionPattern(L, SE)) {
+            candidates.push_back(makeReductionCandidate(L, filename, functionName, line,
+                                                        "advanced_reduction"));
         }
         // Check for original simple parallel patterns
         else if (PatternDetection::isSimpleParallelLoop(L, SE)) {
@@ -99,13 +498,9 @@ private:
             });
         }
         // Check for reduction patterns
-        else if (PatternDetection::hasReductionPattern(L)) {
-            candidates.push_back({
-                filename, functionName, line,
-                "reduction",
-                "Potential reduction pattern detected",
-                PatternDetection::generateReductionPatch(L)
-            });
+        else if (PatternDetection::hasReductionPattern(L, SE)) {
+            candidates.push_back(makeReductionCandidate(L, filename, functionName, line,
+                                                        "reduction"));
         }
         // Check for stencil patterns
         else if (PatternDetection::isStencilPattern(L)) {
@@ -117,7 +512,7 @@ private:
             });
         }
         // Check for map operations
-        else if (PatternDetection::isMapOperation(L)) {
+        else if (PatternDetection::isMapOperation(L, SE)) {
             candidates.push_back({
                 filename, functionName, line,
                 "map_operation",
@@ -146,21 +541,253 @@ private:
                     "// Requires careful analysis for parallelization"
                 });
             }
-            
-            // Check for problematic patterns
-            if (PatternDetection::isPrefixSumPattern(L)) {
-                candidates.push_back({
-                    filename, functionName, line,
-                    "prefix_sum",
-                    "Sequential dependency detected - requires parallel scan algorithms",
-                    "// WARNING: Sequential dependency - use parallel scan"
-                });
+        }
+
+        if (stencil.Recognized) {
+            for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+                candidates[i].details["stencil"] = makeStencilDetails(stencil, stencilTiling);
+            }
+        }
+        annotateInductions(L, SE, firstCandidate);
+        if (firstCandidate < candidates.size()) {
+            annotateSchedule(Schedules.analyze(*L), firstCandidate);
+            annotateFalseSharing(FalseSharing.analyze(*L), firstCandidate);
+        }
+        annotateLocation(L, firstCandidate);
+    }
+
+    // Record the source range of L and the directive to insert above it,
+    // which is what pragma-rewriter needs to apply the patch. Scans and
+    // versioned loops change the loop itself; stencils still need review.
+    void annotateLocation(Loop *L, size_t firstCandidate) {
+        json::Object range;
+        Loop::LocRange locRange = L->getLocRange();
+        if (locRange.getStart() && locRange.getEnd()) {
+            DILocation *start = locRange.getStart().get();
+            DILocation *end = locRange.getEnd().get();
+            range["directory"] = start->getDirectory().str();
+            range["start_line"] = static_cast<int64_t>(start->getLine());
+            range["start_column"] = static_cast<int64_t>(start->getColumn());
+            range["end_line"] = static_cast<int64_t>(end->getLine());
+            range["end_column"] = static_cast<int64_t>(end->getColumn());
+        }
+
+        for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+            CandidateResult &candidate = candidates[i];
+            if (!range.empty()) {
+                candidate.details["loop_range"] = json::Object(range);
+            }
+            const std::string &type = candidate.candidate_type;
+            if (type == "prefix_sum" || type == "alias_versioned" ||
+                type == "stencil" || type == "filter" || type == "risky") {
+                continue;
+            }
+            // Privatized and atomic histograms rewrite the loop body
+            if (type == "histogram" &&
+                candidate.details.getObject("scatter_update")->getString("strategy") !=
+                    StringRef("array_reduction")) {
+                continue;
+            }
+            std::string pragma = extractLoopDirectives(candidate.suggested_patch);
+            if (!pragma.empty()) {
+                candidate.details["pragma"] = pragma;
             }
         }
     }
 
+    // Record the inductions of L on the candidates emitted for it. A
+    // floating-point induction keeps iterations dependent unless it is
+    // recomputed from the loop index.
+    void annotateInductions(Loop *L, ScalarEvolution &SE, size_t firstCandidate) {
+        if (firstCandidate == candidates.size()) return;
+
+        json::Array inductions;
+        std::string notes;
+        for (const auto &IV : PatternDetection::findInductions(L, SE)) {
+            const SCEV *start = SE.isSCEVable(IV.start->getType())
+                ? SE.getSCEV(IV.start) : SE.getUnknown(IV.start);
+            json::Object obj;
+            obj["variable"] = IV.variable;
+            obj["kind"] = IV.kind;
+            obj["start"] = scevToSource(start);
+            obj["step"] = scevToSource(IV.step);
+            inductions.push_back(std::move(obj));
+
+            if (IV.kind == "fp") {
+                std::string var = IV.variable.empty() ? "the floating-point induction" : IV.variable;
+                notes += "\n// Note: compute " + var + " = " + scevToSource(start) + " + iteration * " +
+                         scevToSource(IV.step) + " instead of accumulating it";
+            }
+        }
+
+        for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+            candidates[i].details["inductions"] = json::Array(inductions);
+            candidates[i].suggested_patch += notes;
+        }
+    }
+
+    // Candidate types whose patch is a parallel for over the analyzed loop
+    static bool isParallelFor(const CandidateResult &candidate) {
+        static const char *const parallelFor[] = {
+            "embarrassingly_parallel", "vectorizable", "parallel_loop", "map_operation",
+            "reduction", "advanced_reduction", "perfect_nest", "matrix_multiply",
+            "alias_versioned"};
+        return is_contained(parallelFor, candidate.candidate_type);
+    }
+
+    // Balance iterations of different cost with a schedule clause
+    void annotateSchedule(const ScheduleInfo &Info, size_t firstCandidate) {
+        if (Info.Imbalance == "none") return;
+        for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+            CandidateResult &candidate = candidates[i];
+            if (!isParallelFor(candidate)) continue;
+            ScheduleAdvisor::applyToPatch(Info, candidate.suggested_patch);
+            json::Object details;
+            details["imbalance"] = Info.Imbalance;
+            details["kind"] = Info.Kind;
+            details["chunk"] = static_cast<int64_t>(Info.Chunk);
+            details["clause"] = Info.clause();
+            json::Array lines;
+            for (unsigned line : Info.VaryingLines) lines.push_back(static_cast<int64_t>(line));
+            details["varying_lines"] = std::move(lines);
+            if (Info.TripCount) details["trip_count"] = static_cast<int64_t>(*Info.TripCount);
+            if (Info.StaticImbalance) details["static_imbalance"] = *Info.StaticImbalance;
+            if (Info.ChunkedImbalance) details["chunked_imbalance"] = *Info.ChunkedImbalance;
+            details["reason"] = Info.Reason;
+            candidate.details["schedule"] = std::move(details);
+        }
+    }
+
+    // applyToPatch rounds the pragma's chunk up to whole lines; the schedule
+    // details must quote the clause the pragma ends up with
+    static void fitScheduleDetails(json::Object &schedule, const FalseSharingInfo &Info) {
+        Optional<StringRef> kind = schedule.getString("kind");
+        Optional<int64_t> chunk = schedule.getInteger("chunk");
+        Optional<StringRef> clause = schedule.getString("clause");
+        if (!kind || !chunk || !clause) return;
+        unsigned fitted = FalseSharingAnalyzer::fitChunk(Info, *kind, static_cast<unsigned>(*chunk));
+        if (fitted == *chunk) return;
+
+        std::string before = clause->str();
+        std::string after = "schedule(" + kind->str() + ", " + std::to_string(fitted) + ")";
+        std::string reason = schedule.getString("reason").getValueOr("").str();
+        for (size_t pos = reason.find(before); pos != std::string::npos;
+             pos = reason.find(before, pos + after.size())) {
+            reason.replace(pos, before.size(), after);
+        }
+        reason += "; chunk rounded up to " + std::to_string(fitted) +
+                  " iterations so chunks do not share cache lines";
+        schedule["chunk"] = static_cast<int64_t>(fitted);
+        schedule["clause"] = after;
+        schedule["reason"] = reason;
+    }
+
+    // Record cache-line sharing between the threads of a parallel for and
+    // fit its schedule to whole lines
+    void annotateFalseSharing(const FalseSharingInfo &Info, size_t firstCandidate) {
+        if (Info.Risk == "none") return;
+        for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+            CandidateResult &candidate = candidates[i];
+            if (!isParallelFor(candidate)) continue;
+            FalseSharingAnalyzer::applyToPatch(Info, candidate.suggested_patch);
+            if (json::Object *schedule = candidate.details.getObject("schedule")) {
+                fitScheduleDetails(*schedule, Info);
+            }
+            json::Array stores;
+            for (const SharedLineStore &store : Info.Stores) {
+                json::Object obj;
+                obj["array"] = store.Array;
+                obj["element_type"] = store.ElemType;
+                if (!store.Record.empty()) obj["record"] = store.Record;
+                obj["store_bytes"] = static_cast<int64_t>(store.StoreSize);
+                obj["stride_bytes"] = store.Stride;
+                obj["repeated"] = store.Repeated;
+                obj["line_aligned"] = store.Aligned;
+                obj["line"] = static_cast<int64_t>(store.Line);
+                stores.push_back(std::move(obj));
+            }
+            json::Object details;
+            details["risk"] = Info.Risk;
+            details["line_size"] = static_cast<int64_t>(Info.LineSize);
+            details["min_chunk"] = static_cast<int64_t>(Info.MinChunk);
+            if (Info.TripCount) details["trip_count"] = static_cast<int64_t>(*Info.TripCount);
+            details["chunked_schedule"] = Info.UseChunk;
+            details["padding"] = Info.Padding;
+            details["stores"] = std::move(stores);
+            details["reason"] = Info.Reason;
+            candidate.details["false_sharing"] = std::move(details);
+        }
+    }
+
+    // Weight each candidate of F by the loops it covers: its own, the
+    // stages of a pipeline or, for a task graph, the whole function
+    void annotateHotness(LoopInfo &LI, const LoopHotnessAnalyzer &Hotness, size_t firstCandidate) {
+        std::map<int, LoopHotness> byLine;
+        for (Loop *L : LI.getLoopsInPreorder()) {
+            byLine.emplace(PatternDetection::getLoopLocation(L).second, Hotness.analyze(*L));
+        }
+        auto lookup = [&](int64_t line) -> Optional<LoopHotness> {
+            auto it = byLine.find(static_cast<int>(line));
+            if (it == byLine.end()) return None;
+            return it->second;
+        };
+
+        for (size_t i = firstCandidate; i < candidates.size(); ++i) {
+            CandidateResult &candidate = candidates[i];
+            if (candidate.candidate_type == "task_graph") {
+                candidate.hotness = Hotness.function();
+            } else if (const json::Object *pipeline = candidate.details.getObject("pipeline")) {
+                for (const json::Value &stage : *pipeline->getArray("stages")) {
+                    Optional<LoopHotness> stageHotness =
+                        lookup(stage.getAsObject()->getInteger("line").getValueOr(0));
+                    if (!stageHotness) continue;
+                    if (candidate.hotness) *candidate.hotness += *stageHotness;
+                    else candidate.hotness = stageHotness;
+                }
+            } else {
+                candidate.hotness = lookup(candidate.line);
+            }
+        }
+        if (Hotness.isProfiled()) {
+            profiledWeight += Hotness.function().Weight;
+        }
+    }
+
+    // Record each candidate's hotness score and put the hottest first:
+    // profiled loops by their share of the run, the others by their share
+    // of their function's execution
+    void rankByHotness() {
+        for (CandidateResult &candidate : candidates) {
+            if (!candidate.hotness) continue;
+            const LoopHotness &H = *candidate.hotness;
+            json::Object hotness;
+            double score = H.FunctionShare;
+            hotness["source"] = H.Profiled ? "profile" : "static";
+            hotness["iterations_per_call"] = H.IterationsPerCall;
+            hotness["function_share"] = H.FunctionShare;
+            if (H.Profiled) {
+                score = profiledWeight > 0 ? H.Weight / profiledWeight : 0;
+                hotness["header_count"] = static_cast<int64_t>(H.HeaderCount);
+                hotness["program_share"] = score;
+            }
+            hotness["score"] = score;
+            candidate.details["hotness"] = std::move(hotness);
+        }
+        auto key = [](const CandidateResult &candidate) -> std::pair<int, double> {
+            if (!candidate.hotness) return {-1, 0};
+            const json::Object *hotness = candidate.details.getObject("hotness");
+            return {candidate.hotness->Profiled ? 1 : 0,
+                    hotness->getNumber("score").getValueOr(0)};
+        };
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [&](const CandidateResult &a, const CandidateResult &b) {
+                             return key(a) > key(b);
+                         });
+    }
+
     void exportToJSON() {
         json::Array jsonCandidates;
+        rankByHotness();
 
         // Convert candidates to AI format for enhancement
         std::vector<AIEnhancedCandidate> aiCandidates;
@@ -184,14 +811,20 @@ private:
             errs() << "AI Enhancement: Disabled (using basic analysis)\n";
         }
 
-        for (const auto &candidate : enhancedCandidates) {
+        for (size_t i = 0; i < enhancedCandidates.size(); ++i) {
+            const auto &candidate = enhancedCandidates[i];
             json::Object obj;
+            obj["id"] = PatternDetection::getCandidateId(candidate.fileName, candidate.lineNumber,
+                                                         candidate.functionName);
             obj["file"] = candidate.fileName;
             obj["function"] = candidate.functionName;
             obj["line"] = static_cast<int64_t>(candidate.lineNumber);
             obj["candidate_type"] = candidate.candidateType;
             obj["reason"] = candidate.reason;
             obj["suggested_patch"] = candidate.suggestedPatch;
+            if (!candidates[i].details.empty()) {
+                obj["analysis"] = json::Object(candidates[i].details);
+            }
             
             // Add AI analysis if available
             if (aiAnalysis.isAIEnabled()) {
@@ -230,94 +863,144 @@ private:
         outs() << "Exported " << candidates.size() << " candidates to " << outputPath << "\n";
     }
 
+    // Consecutive loops that consume each other's arrays element by element,
+    // fused or overlapped as a blocked pipeline of tasks
+    void analyzePipelines(Function &F, PipelineAnalyzer &Pipelines) {
+        for (const PipelineInfo &info : Pipelines.analyze(F)) {
+            CandidateResult candidate{
+                info.File, F.getName().str(),
+                static_cast<int>(info.Stages.front().Line),
+                "pipeline",
+                info.Reason,
+                PipelineAnalyzer::generatePatch(info)
+            };
+            json::Array stages;
+            for (const PipelineStage &stage : info.Stages) {
+                json::Object obj;
+                obj["line"] = static_cast<int64_t>(stage.Line);
+                obj["index"] = stage.Index;
+                obj["cost"] = static_cast<int64_t>(stage.Cost);
+                obj["sequential"] = stage.Sequential;
+                if (stage.Sequential) obj["carries"] = stage.Carried;
+                json::Array inputs;
+                for (const PipelineEdge &edge : stage.Inputs) {
+                    inputs.push_back(json::Object{
+                        {"stage", static_cast<int64_t>(edge.Producer)},
+                        {"array", edge.Array},
+                        {"min_offset", edge.MinOffset},
+                        {"max_offset", edge.MaxOffset}});
+                }
+                obj["reads"] = std::move(inputs);
+                obj["writes"] = json::Array(stage.Writes);
+                stages.push_back(std::move(obj));
+            }
+            json::Object details;
+            details["strategy"] = info.Strategy;
+            details["stages"] = std::move(stages);
+            details["bottleneck"] = static_cast<int64_t>(info.Bottleneck);
+            details["speedup_bound"] = info.SpeedupBound;
+            if (info.Strategy == "pipeline") {
+                details["block"] = static_cast<int64_t>(info.BlockSize);
+                details["window"] = static_cast<int64_t>(info.Window);
+            }
+            candidate.details["pipeline"] = std::move(details);
+            candidates.push_back(std::move(candidate));
+        }
+    }
+
+
 public:
+    ParallelCandidatePass() = default;
+    explicit ParallelCandidatePass(ParallelCandidateOptions opts) : options(std::move(opts)) {}
+
     PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
         // Skip declarations
         if (F.isDeclaration()) {
             return PreservedAnalyses::all();
         }
 
-        // Simple analysis without complex loop analysis to avoid crashes
-        // Look for basic patterns in the function
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                // Look for loops (back edges)
-                if (auto *Br = dyn_cast<BranchInst>(&I)) {
-                    if (Br->isConditional()) {
-                        // Try to determine what kind of loop this might be
-                        CandidateResult candidate;
-                        candidate.file = F.getParent()->getName().str();
-                        candidate.function = F.getName().str();
-                        
-                        // Try to get debug info
-                        auto location = PatternDetection::getSourceLocation(&I);
-                        candidate.file = location.first;
-                        candidate.line = location.second;
-                        
-                        // Use enhanced pattern classification based on surrounding instructions
-                        std::string patternType = classifyLoopPattern(&BB);
-                        candidate.candidate_type = patternType;
-                        candidate.reason = getPatternReason(patternType);
-                        candidate.suggested_patch = PatternDetection::generateOptimalPatch(patternType, nullptr);
-                        
-                        candidates.push_back(candidate);
+        LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+        ScalarEvolution &SE = AM.getResult<ScalarEvolutionAnalysis>(F);
+        DependenceInfo &DI = AM.getResult<DependenceAnalysis>(F);
+        AAResults &AA = AM.getResult<AAManager>(F);
+        DominatorTree &DT = AM.getResult<DominatorTreeAnalysis>(F);
+        TargetLibraryInfo &TLI = AM.getResult<TargetLibraryAnalysis>(F);
+        BlockFrequencyInfo &BFI = AM.getResult<BlockFrequencyAnalysis>(F);
+        AliasVersioningAnalyzer AliasVersioning(SE, AA, DT, LI, TLI, DI);
+        PerfectNestAnalyzer NestAnalyzer(SE, DI);
+        TilingAdvisor Tiling(SE, options.cache);
+        AdvancedPatternDetector Advanced(AA, SE);
+        IdiomRecognizer Idioms(SE, DI, DT, Advanced);
+        StencilAnalyzer Stencils(SE, options.cache);
+        ScatterUpdateAnalyzer Scatters(SE, AA, DT, options.cache, options.threads);
+        ScheduleAdvisor Schedules(SE, DT, options.threads);
+        FalseSharingAnalyzer FalseSharing(SE, options.cache, options.threads);
+        TaskGraphBuilder TaskGraphs(AA, DT, LI, &SE);
+        PipelineAnalyzer Pipelines(SE, AA, DT, LI, options.cache, options.threads);
+        LoopHotnessAnalyzer Hotness(F, BFI);
+        size_t firstCandidate = candidates.size();
+
+        for (Loop *TopLevel : LI) {
+            // Nests start at the top-level loop and below every imperfect
+            // parent, e.g. the space loops of a time-step loop
+            SmallVector<Loop *, 4> libraryNests;
+            for (Loop *L : TopLevel->getLoopsInPreorder()) {
+                if (!isSimplifiedNest(L)) continue;
+                if (any_of(libraryNests, [&](Loop *Nest) { return Nest->contains(L); })) continue;
+                if (NestAnalyzer.startsNest(*L)) {
+                    if (analyzeLibraryNest(L, F, Idioms)) {
+                        libraryNests.push_back(L);
+                        continue;
                     }
+                    analyzeNest(L, F, NestAnalyzer, Tiling, Schedules, FalseSharing);
                 }
+                analyzeLoop(L, F, SE, AliasVersioning, Idioms, Stencils, Scatters, Schedules,
+                            FalseSharing);
             }
         }
 
+        analyzeTasks(F, TaskGraphs);
+        analyzePipelines(F, Pipelines);
+        annotateHotness(LI, Hotness, firstCandidate);
+
         // Export results after processing this function
         exportToJSON();
 
         return PreservedAnalyses::all();
     }
 
-private:
-    // Classify loop pattern based on surrounding instructions
-    std::string classifyLoopPattern(BasicBlock *BB) {
-        bool hasArrayAccess = false;
-        bool hasArithmetic = false;
-        bool hasFunctionCall = false;
-        bool hasComplexOps = false;
-        
-        // Look at this and nearby basic blocks for patterns
-        for (Instruction &I : *BB) {
-            if (isa<GetElementPtrInst>(&I)) {
-                hasArrayAccess = true;
-            } else if (isa<BinaryOperator>(&I)) {
-                hasArithmetic = true;
-            } else if (isa<CallInst>(&I)) {
-                hasFunctionCall = true;
-            } else if (I.mayHaveSideEffects() && !isa<StoreInst>(&I)) {
-                hasComplexOps = true;
-            }
-        }
-        
-        if (hasFunctionCall || hasComplexOps) {
-            return "risky";
-        } else if (hasArrayAccess && hasArithmetic) {
-            return "vectorizable";
-        } else if (hasArrayAccess) {
-            return "embarrassingly_parallel";
-        } else {
-            return "simple_loop";
+};
+
+} // end anonymous namespace
+
+// Parse "l1-cache=32K;l2-cache=1M;l3-cache=8M;cache-line=64;threads=16"
+static bool parsePassOptions(StringRef params, ParallelCandidateOptions &opts) {
+    SmallVector<StringRef, 4> entries;
+    params.split(entries, ';', -1, false);
+    for (StringRef entry : entries) {
+        auto [key, value] = entry.split('=');
+        uint64_t size = CacheModel::parseSize(value);
+        if (size == 0) {
+            errs() << "parallel-candidate: invalid value for '" << key << "': " << value << "\n";
+            return false;
         }
-    }
-    
-    std::string getPatternReason(const std::string& patternType) {
-        if (patternType == "embarrassingly_parallel") {
-            return "Array access with simple indexing detected";
-        } else if (patternType == "vectorizable") {
-            return "Array access with arithmetic operations - good for SIMD";
-        } else if (patternType == "risky") {
-            return "Function calls or complex operations detected";
+        if (key == "l1-cache") {
+            opts.cache.L1Size = size;
+        } else if (key == "l2-cache") {
+            opts.cache.L2Size = size;
+        } else if (key == "l3-cache") {
+            opts.cache.L3Size = size;
+        } else if (key == "cache-line") {
+            opts.cache.LineSize = size;
+        } else if (key == "threads") {
+            opts.threads = static_cast<unsigned>(size);
         } else {
-            return "Found conditional branch that may be a loop";
+            errs() << "parallel-candidate: unknown parameter '" << key << "'\n";
+            return false;
         }
     }
-};
-
-} // end anonymous namespace
+    return true;
+}
 
 // Plugin registration for the new pass manager
 extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
@@ -331,7 +1014,64 @@ extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
                         FPM.addPass(ParallelCandidatePass());
                         return true;
                     }
+                    if (Name.consume_front("parallel-candidate<") && Name.consume_back(">")) {
+                        ParallelCandidateOptions opts;
+                        if (!parsePassOptions(Name, opts)) {
+                            return false;
+                        }
+                        FPM.addPass(ParallelCandidatePass(std::move(opts)));
+                        return true;
+                    }
+                    return false;
+                });
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, ModulePassManager &MPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                    if (Name == "parallel-apply") {
+                        MPM.addPass(ParallelApplyPass());
+                        return true;
+                    }
+                    if (Name == "parallel-profile") {
+                        MPM.addPass(LoopProfilePass());
+                        return true;
+                    }
+                    if (Name.consume_front("parallel-profile<") && Name.consume_back(">")) {
+                        ProfileClock clock = ProfileClock::Default;
+                        bool counters = false;
+                        bool variance = false;
+                        if (!LoopProfilePass::parseOptions(Name, clock, counters, variance)) {
+                            return false;
+                        }
+                        MPM.addPass(LoopProfilePass(clock, counters, variance));
+                        return true;
+                    }
+                    if (Name == "parallel-deps") {
+                        MPM.addPass(DependenceProfilePass());
+                        return true;
+                    }
+                    if (Name.consume_front("parallel-deps<") && Name.consume_back(">")) {
+                        std::vector<std::string> loops;
+                        if (!DependenceProfilePass::parseOptions(Name, loops)) {
+                            return false;
+                        }
+                        MPM.addPass(DependenceProfilePass(std::move(loops)));
+                        return true;
+                    }
+                    return false;
+                });
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                    if (Name == "parallel-annotate") {
+                        FPM.addPass(LoopAnnotatePass());
+                        return true;
+                    }
                     return false;
                 });
+            // clang -fpass-plugin: hand the proofs to LoopVectorize
+            PB.registerVectorizerStartEPCallback(
+                [](FunctionPassManager &FPM, OptimizationLevel) {
+                    FPM.addPass(LoopAnnotatePass());
+                });
         }};
 }
\ No newline at end of file
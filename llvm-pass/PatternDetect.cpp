@@ -1,15 +1,303 @@
 #include "PatternDetect.h"
+#include "PerfectNestAnalysis.h"
+#include "SCEVSourcePrinter.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/PatternMatch.h"
+#include <cctype>
 #include <set>
 
 namespace PatternDetection {
 
+    // Source name from the dbg.value/dbg.declare describing V, empty if none
+    static std::string getDebugVariableName(Value *V) {
+        if (auto *LAM = LocalAsMetadata::getIfExists(V)) {
+            if (auto *MDV = MetadataAsValue::getIfExists(V->getContext(), LAM)) {
+                for (User *U : MDV->users()) {
+                    if (auto *DVI = dyn_cast<DbgVariableIntrinsic>(U)) {
+                        return DVI->getVariable()->getName().str();
+                    }
+                }
+            }
+        }
+        return "";
+    }
+
+    // The induction and recurrence descriptors read the PHI's values from
+    // the preheader and the latch; loops outside loop-simplify form (a
+    // guarded loop entered straight from the guard) have neither
+    static bool hasPreheaderAndLatch(Loop *L) {
+        return L->getLoopPreheader() && L->getLoopLatch();
+    }
+
+    // Header PHI with a loop-invariant step: integer (i += c), pointer
+    // (p += c) or floating-point (x += h)
+    static bool getInduction(PHINode *Phi, Loop *L, ScalarEvolution &SE,
+                             InductionDescriptor &ID) {
+        if (!hasPreheaderAndLatch(L)) return false;
+        if (Phi->getType()->isFloatingPointTy()) {
+            return InductionDescriptor::isFPInductionPHI(Phi, L, &SE, ID);
+        }
+        return InductionDescriptor::isInductionPHI(Phi, L, &SE, ID);
+    }
+
+    static bool isInduction(PHINode *Phi, Loop *L, ScalarEvolution &SE) {
+        InductionDescriptor ID;
+        return getInduction(Phi, L, SE, ID);
+    }
+
+    // An induction a parallel for can leave to its threads: integers and
+    // pointers. A floating-point induction (x += h) stays shared, so every
+    // thread would race on x until it is rewritten as x0 + i * h.
+    static bool isIndexInduction(PHINode *Phi, Loop *L, ScalarEvolution &SE) {
+        return !Phi->getType()->isFloatingPointTy() && isInduction(Phi, L, SE);
+    }
+
+    // Source name of a loop-carried PHI; IR names keep the source name
+    // before the first '.', e.g. "i.07"
+    static std::string getPHIVariableName(PHINode *Phi) {
+        std::string name = getDebugVariableName(Phi);
+        if (name.empty() && Phi->hasName()) {
+            name = Phi->getName().split('.').first.str();
+        }
+        return name;
+    }
+
+    // Reduction kind name and OpenMP operator for a recurrence kind
+    static std::pair<std::string, std::string> getReductionOperator(RecurKind Kind) {
+        switch (Kind) {
+        case RecurKind::Add:
+        case RecurKind::FAdd:
+        case RecurKind::FMulAdd:
+            return {"add", "+"};
+        case RecurKind::Mul:
+        case RecurKind::FMul:
+            return {"mul", "*"};
+        case RecurKind::And:
+            return {"and", "&"};
+        case RecurKind::Or:
+            return {"or", "|"};
+        case RecurKind::Xor:
+            return {"xor", "^"};
+        case RecurKind::SMin:
+        case RecurKind::UMin:
+            return {"min", "min"};
+        case RecurKind::SMax:
+        case RecurKind::UMax:
+            return {"max", "max"};
+        case RecurKind::FMin:
+            return {"fmin", "min"};
+        case RecurKind::FMax:
+            return {"fmax", "max"};
+        case RecurKind::SelectICmp:
+        case RecurKind::SelectFCmp:
+            return {"any_of", "||"};
+        default:
+            return {"", ""};
+        }
+    }
+
+    // Source name of a reduction: the PHI itself, the value leaving the loop
+    // or its LCSSA copy may carry the dbg.value
+    static std::string getReductionVariableName(PHINode *Phi, const RecurrenceDescriptor &RD) {
+        std::string name = getDebugVariableName(Phi);
+        if (!name.empty()) return name;
+
+        if (Instruction *Exit = RD.getLoopExitInstr()) {
+            name = getDebugVariableName(Exit);
+            if (!name.empty()) return name;
+            for (User *U : Exit->users()) {
+                if (auto *ExitPhi = dyn_cast<PHINode>(U)) {
+                    name = getDebugVariableName(ExitPhi);
+                    if (!name.empty()) return name;
+                }
+            }
+        }
+
+        return getPHIVariableName(Phi);
+    }
+
+    // Per-iteration address step of Ptr in L: zero when invariant, null when
+    // the address is not affine in L. Steps may be symbolic, e.g. a[j*n+i].
+    static const SCEV *getAddressStep(ScalarEvolution &SE, Value *Ptr, const Loop *L) {
+        const SCEV *S = SE.getSCEV(Ptr);
+        while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+            if (AR->getLoop() == L) {
+                return AR->isAffine() ? AR->getStepRecurrence(SE) : nullptr;
+            }
+            S = AR->getStart();
+        }
+        return SE.isLoopInvariant(S, L) ? SE.getZero(SE.getDataLayout().getIndexType(Ptr->getType())) : nullptr;
+    }
+
+    // Every store writes its own element each iteration (a[i], p[2*i+1],
+    // a[j*n+i]), and other accesses to a stored array stay inside the element
+    // range of their own iteration
+    static bool storesStayInIteration(Loop *L, ScalarEvolution &SE,
+                                      const std::vector<Instruction *> &accesses) {
+        const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+        for (Instruction *Store : accesses) {
+            if (!isa<StoreInst>(Store)) continue;
+
+            Value *StorePtr = getLoadStorePointerOperand(Store);
+            const SCEV *step = getAddressStep(SE, StorePtr, L);
+            uint64_t size = DL.getTypeStoreSize(getLoadStoreType(Store)).getFixedSize();
+            if (!step || step->isZero()) return false;
+            auto *constStep = dyn_cast<SCEVConstant>(step);
+            if (constStep && constStep->getAPInt().abs().ult(size)) return false;
+
+            const SCEV *StoreSCEV = SE.getSCEV(StorePtr);
+            for (Instruction *Other : accesses) {
+                if (Other == Store) continue;
+                Value *OtherPtr = getLoadStorePointerOperand(Other);
+                const SCEV *OtherSCEV = SE.getSCEV(OtherPtr);
+                if (SE.getPointerBase(OtherSCEV) != SE.getPointerBase(StoreSCEV)) continue;
+                if (getAddressStep(SE, OtherPtr, L) != step) return false;
+
+                // Same element, or a field of the same constant-stride stripe
+                auto *diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(OtherSCEV, StoreSCEV));
+                if (!diff) return false;
+                int64_t offset = diff->getAPInt().getSExtValue();
+                if (offset == 0) continue;
+                uint64_t otherSize = DL.getTypeStoreSize(getLoadStoreType(Other)).getFixedSize();
+                if (!constStep ||
+                    (uint64_t)std::abs(offset) + std::max(size, otherSize) >
+                        constStep->getAPInt().abs().getZExtValue()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static bool storesStayInIteration(Loop *L, ScalarEvolution &SE) {
+        std::vector<Instruction *> accesses;
+        for (BasicBlock *BB : L->blocks()) {
+            for (Instruction &I : *BB) {
+                if (isa<LoadInst>(&I) || isa<StoreInst>(&I)) {
+                    accesses.push_back(&I);
+                }
+            }
+        }
+        return storesStayInIteration(L, SE, accesses);
+    }
+
+    // Every loop-carried scalar is an induction or a recognized reduction,
+    // and at least one reduction exists
+    static bool isReductionLoop(Loop *L, ScalarEvolution &SE,
+                                std::vector<ReductionInfo> &reductions) {
+        reductions = findReductions(L);
+        if (reductions.empty()) return false;
+
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            bool isReduction = any_of(reductions, [&](const ReductionInfo &R) {
+                return R.phi == &Phi;
+            });
+            if (!isReduction && !isIndexInduction(&Phi, L, SE)) return false;
+        }
+        return true;
+    }
+
+    std::vector<ReductionInfo> findReductions(Loop *L) {
+        std::vector<ReductionInfo> reductions;
+        if (!hasPreheaderAndLatch(L)) return reductions;
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            RecurrenceDescriptor RD;
+            if (!RecurrenceDescriptor::isReductionPHI(&Phi, L, RD)) continue;
+
+            auto [kind, ompOperator] = getReductionOperator(RD.getRecurrenceKind());
+            if (ompOperator.empty()) continue;
+            reductions.push_back({&Phi, kind, ompOperator,
+                                  getReductionVariableName(&Phi, RD),
+                                  RD.hasExactFPMath()});
+        }
+        return reductions;
+    }
+
+    std::vector<InductionInfo> findInductions(Loop *L, ScalarEvolution &SE) {
+        std::vector<InductionInfo> inductions;
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            InductionDescriptor ID;
+            if (!getInduction(&Phi, L, SE, ID)) continue;
+
+            InductionInfo info{&Phi, "integer", getPHIVariableName(&Phi),
+                               ID.getStartValue(), ID.getStep(), 0};
+            if (ID.getKind() == InductionDescriptor::IK_PtrInduction) {
+                info.kind = "pointer";
+            } else if (ID.getKind() == InductionDescriptor::IK_FpInduction) {
+                info.kind = "fp";
+            }
+            if (ConstantInt *step = ID.getConstIntStepValue()) {
+                info.constantStep = step->getSExtValue();
+            }
+            // Pointer steps are counted in elements; report bytes like SCEV
+            if (info.kind == "pointer" && info.constantStep) {
+                const SCEV *AR = SE.getSCEV(&Phi);
+                if (auto *AddRec = dyn_cast<SCEVAddRecExpr>(AR)) {
+                    info.step = AddRec->getStepRecurrence(SE);
+                    if (auto *C = dyn_cast<SCEVConstant>(info.step)) {
+                        info.constantStep = C->getAPInt().getSExtValue();
+                    }
+                }
+            }
+            inductions.push_back(info);
+        }
+        return inductions;
+    }
+
+    // The loop has an integer or pointer induction with a constant non-zero
+    // step, i.e. an index an OpenMP canonical loop can be written over.
+    // Start value and step are free: -O2 loops start anywhere and count
+    // by any stride.
+    bool getLoopBounds(Loop *L, ScalarEvolution &SE, std::string &index,
+                       std::string &lower, std::string &upper) {
+        for (const InductionInfo &IV : findInductions(L, SE)) {
+            if (IV.kind != "integer" || IV.constantStep != 1) continue;
+            if (!IV.variable.empty()) index = IV.variable;
+            auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(IV.phi));
+            const SCEV *BTC = SE.getBackedgeTakenCount(L);
+            if (!AR || isa<SCEVCouldNotCompute>(BTC)) return false;
+            // Exit value = start + backedge-taken count + 1
+            const SCEV *Start = AR->getStart();
+            std::string begin = scevToSource(Start);
+            std::string end = scevToSource(SE.getAddExpr(
+                Start, SE.getTruncateOrZeroExtend(SE.getAddExpr(BTC, SE.getOne(BTC->getType())),
+                                                  Start->getType())));
+            if (begin.empty() || end.empty()) return false;
+            lower = begin;
+            upper = end;
+            return true;
+        }
+        return false;
+    }
+
+    bool hasLoopIndex(Loop *L, ScalarEvolution &SE) {
+        return any_of(findInductions(L, SE), [](const InductionInfo &IV) {
+            return IV.kind != "fp" && IV.constantStep != 0;
+        });
+    }
+
+    bool hasOnlyInductionPHIs(Loop *L, ScalarEvolution &SE) {
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            if (!isIndexInduction(&Phi, L, SE)) return false;
+        }
+        return true;
+    }
+
     // Original methods from ParallelCandidatePass
     bool isSimpleParallelLoop(Loop *L, ScalarEvolution &SE) {
-        // Check for simple increment induction variable
-        PHINode *IndVar = L->getCanonicalInductionVariable();
-        if (!IndVar) return false;
+        // Check for an induction with a constant step
+        if (!hasLoopIndex(L, SE)) return false;
+
+        // Loop-carried scalars (reductions, recurrences) need more than a plain parallel for
+        if (!hasOnlyInductionPHIs(L, SE)) return false;
+        if (!storesStayInIteration(L, SE)) return false;
 
         // Check for array access patterns
         bool hasSimpleArrayAccess = false;
@@ -18,14 +306,13 @@ namespace PatternDetection {
 
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
-                if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
-                    // Check if GEP uses induction variable
-                    for (Use &U : GEP->operands()) {
-                        if (U.get() == IndVar) {
-                            hasSimpleArrayAccess = true;
-                            break;
-                        }
+                if (Value *Ptr = getLoadStorePointerOperand(&I)) {
+                    // Check if the address advances with the induction variables
+                    Optional<int64_t> stride = getAccessStride(SE, Ptr, L);
+                    if (stride && *stride != 0) {
+                        hasSimpleArrayAccess = true;
                     }
+                    continue;
                 } else if (auto *Call = dyn_cast<CallInst>(&I)) {
                     // Check for function calls that might have side effects
                     Function *F = Call->getCalledFunction();
@@ -35,10 +322,7 @@ namespace PatternDetection {
                     } else if (!F->doesNotAccessMemory()) {
                         hasCallsWithSideEffects = true;
                     }
-                } else if (isa<LoadInst>(&I) || isa<StoreInst>(&I)) {
-                    // Simple memory operations are generally OK
-                    continue;
-                } else if (I.mayHaveSideEffects() && !isa<StoreInst>(&I)) {
+                } else if (I.mayHaveSideEffects()) {
                     hasComplexOperations = true;
                 }
             }
@@ -47,29 +331,11 @@ namespace PatternDetection {
         return hasSimpleArrayAccess && !hasComplexOperations && !hasCallsWithSideEffects;
     }
 
-    bool hasReductionPattern(Loop *L) {
-        for (BasicBlock *BB : L->blocks()) {
-            for (Instruction &I : *BB) {
-                if (auto *BinOp = dyn_cast<BinaryOperator>(&I)) {
-                    // Look for accumulation patterns (+=, *=, etc.)
-                    if (BinOp->getOpcode() == Instruction::FAdd ||
-                        BinOp->getOpcode() == Instruction::Add ||
-                        BinOp->getOpcode() == Instruction::FMul ||
-                        BinOp->getOpcode() == Instruction::Mul) {
-                        
-                        // Check if one operand is a loop-carried dependency
-                        for (Use &U : BinOp->operands()) {
-                            if (auto *PHI = dyn_cast<PHINode>(U.get())) {
-                                if (L->contains(PHI->getParent())) {
-                                    return true;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        return false;
+    bool hasReductionPattern(Loop *L, ScalarEvolution &SE) {
+        // Accumulation (+=, *=, min/max, ...) recognized by RecurrenceDescriptor;
+        // induction increments are not reductions
+        std::vector<ReductionInfo> reductions;
+        return hasLoopIndex(L, SE) && isReductionLoop(L, SE, reductions);
     }
 
     std::pair<std::string, int> getSourceLocation(Instruction *I) {
@@ -84,84 +350,199 @@ namespace PatternDetection {
         return {filename, line};
     }
 
-    std::string generateParallelPatch(Loop *L) {
+    std::pair<std::string, int> getLoopLocation(Loop *L) {
+        Loop::LocRange range = L->getLocRange();
+        if (range.getStart() && range.getEnd()) {
+            DILocation *start = range.getStart().get();
+            return {start->getFilename().str(), static_cast<int>(start->getLine())};
+        }
+        for (BasicBlock *BB : L->blocks()) {
+            for (Instruction &I : *BB) {
+                if (I.getDebugLoc()) {
+                    return getSourceLocation(&I);
+                }
+            }
+        }
+        return {"unknown", 0};
+    }
+
+    std::string getCandidateId(const std::string &file, int line,
+                               const std::string &function) {
+        return file + ":" + std::to_string(line) + ":" + function;
+    }
+
+    // Source-level name of a value, from the dbg.value/dbg.declare describing
+    // it, falling back to the IR name; empty if neither exists
+    std::string getVariableName(Value *V) {
+        std::string name = getDebugVariableName(V);
+        if (!name.empty()) {
+            return name;
+        }
+        if (V->hasName()) {
+            return V->getName().str();
+        }
+        return "";
+    }
+
+    static const char *getOperatorSymbol(Instruction *I) {
+        if (auto *Cmp = dyn_cast<CmpInst>(I)) {
+            switch (Cmp->getPredicate()) {
+            case CmpInst::ICMP_EQ: case CmpInst::FCMP_OEQ: case CmpInst::FCMP_UEQ: return "==";
+            case CmpInst::ICMP_NE: case CmpInst::FCMP_ONE: case CmpInst::FCMP_UNE: return "!=";
+            case CmpInst::ICMP_SGT: case CmpInst::ICMP_UGT:
+            case CmpInst::FCMP_OGT: case CmpInst::FCMP_UGT: return ">";
+            case CmpInst::ICMP_SGE: case CmpInst::ICMP_UGE:
+            case CmpInst::FCMP_OGE: case CmpInst::FCMP_UGE: return ">=";
+            case CmpInst::ICMP_SLT: case CmpInst::ICMP_ULT:
+            case CmpInst::FCMP_OLT: case CmpInst::FCMP_ULT: return "<";
+            case CmpInst::ICMP_SLE: case CmpInst::ICMP_ULE:
+            case CmpInst::FCMP_OLE: case CmpInst::FCMP_ULE: return "<=";
+            default: return nullptr;
+            }
+        }
+        bool boolean = I->getType()->isIntegerTy(1);
+        switch (I->getOpcode()) {
+        case Instruction::Add: case Instruction::FAdd: return "+";
+        case Instruction::Sub: case Instruction::FSub: return "-";
+        case Instruction::Mul: case Instruction::FMul: return "*";
+        case Instruction::SDiv: case Instruction::UDiv: case Instruction::FDiv: return "/";
+        case Instruction::SRem: case Instruction::URem: return "%";
+        case Instruction::Shl: return "<<";
+        case Instruction::LShr: case Instruction::AShr: return ">>";
+        case Instruction::And: return boolean ? "&&" : "&";
+        case Instruction::Or: return boolean ? "||" : "|";
+        case Instruction::Xor: return boolean ? "!=" : "^";
+        default: return nullptr;
+        }
+    }
+
+    static std::string stripParentheses(const std::string &text) {
+        if (text.size() > 1 && text.front() == '(' && text.back() == ')') {
+            return text.substr(1, text.size() - 2);
+        }
+        return text;
+    }
+
+    static std::string getSourceExpression(Value *V, Loop *L, unsigned depth) {
+        if (depth > 8) return "";
+        if (auto *CI = dyn_cast<ConstantInt>(V)) {
+            return CI->getType()->isIntegerTy(1) ? (CI->isZero() ? "false" : "true")
+                                                 : std::to_string(CI->getSExtValue());
+        }
+        if (auto *CF = dyn_cast<ConstantFP>(V)) {
+            SmallString<16> text;
+            CF->getValueAPF().toString(text);
+            // 0 and 1E+10 need a point or exponent to stay floating-point
+            if (text.find_first_of(".eEn") == StringRef::npos) text += ".0";
+            return std::string(text.str()) + (V->getType()->isFloatTy() ? "f" : "");
+        }
+        if (isa<SExtInst>(V) || isa<ZExtInst>(V) || isa<TruncInst>(V) ||
+            isa<FPExtInst>(V) || isa<FPTruncInst>(V)) {
+            return getSourceExpression(cast<Instruction>(V)->getOperand(0), L, depth + 1);
+        }
+        if (auto *Phi = dyn_cast<PHINode>(V)) {
+            return Phi->getParent() == L->getHeader() ? getPHIVariableName(Phi) : "";
+        }
+        if (L->isLoopInvariant(V)) return getVariableName(V);
+        if (auto *Load = dyn_cast<LoadInst>(V)) {
+            auto *GEP = dyn_cast<GetElementPtrInst>(Load->getPointerOperand());
+            if (!GEP || GEP->getNumIndices() != 1 || !L->isLoopInvariant(GEP->getPointerOperand())) {
+                return "";
+            }
+            std::string array = getVariableName(GEP->getPointerOperand());
+            std::string index = getSourceExpression(*GEP->idx_begin(), L, depth + 1);
+            if (array.empty() || index.empty()) return "";
+            return array + "[" + stripParentheses(index) + "]";
+        }
+        auto *I = dyn_cast<Instruction>(V);
+        if (I && (isa<BinaryOperator>(I) || isa<CmpInst>(I))) {
+            const char *symbol = getOperatorSymbol(I);
+            std::string lhs = getSourceExpression(I->getOperand(0), L, depth + 1);
+            std::string rhs = getSourceExpression(I->getOperand(1), L, depth + 1);
+            if (!symbol || lhs.empty() || rhs.empty()) return "";
+            return "(" + lhs + " " + symbol + " " + rhs + ")";
+        }
+        if (auto *Sel = dyn_cast<SelectInst>(V)) {
+            std::string c = getSourceExpression(Sel->getCondition(), L, depth + 1);
+            std::string t = getSourceExpression(Sel->getTrueValue(), L, depth + 1);
+            std::string f = getSourceExpression(Sel->getFalseValue(), L, depth + 1);
+            if (c.empty() || t.empty() || f.empty()) return "";
+            return "(" + c + " ? " + t + " : " + f + ")";
+        }
+        return "";
+    }
+
+    std::string getSourceExpression(Value *V, Loop *L) {
+        return stripParentheses(getSourceExpression(V, L, 0));
+    }
+
+    std::string generateParallelPatch(Loop *) {
         return "// ✅ OpenMP 5.2 basic parallel for\n"
                "#pragma omp parallel for\n"
                "for(/* existing loop header */)";
     }
 
     std::string generateReductionPatch(Loop *L) {
-        return "// ✅ OpenMP 5.2 reduction - adjust variable and operator\n"
-               "#pragma omp parallel for reduction(+:sum)\n"
-               "for(/* existing loop header */)\n"
-               "// Common operators: +, -, *, min:var, max:var";
-    }
+        std::vector<ReductionInfo> reductions = findReductions(L);
+        if (reductions.empty()) {
+            return "// ⚠️ No reduction variable recognized - keep the loop sequential";
+        }
 
-    // Enhanced pattern detection methods
-    bool hasAdvancedReductionPattern(Loop *L) {
-        for (BasicBlock *BB : L->blocks()) {
-            for (Instruction &I : *BB) {
-                if (auto *BinOp = dyn_cast<BinaryOperator>(&I)) {
-                    // Extended list of reduction operations
-                    Instruction::BinaryOps op = BinOp->getOpcode();
-                    
-                    bool isReductionOp = (
-                        op == Instruction::FAdd || op == Instruction::Add ||      // sum
-                        op == Instruction::FMul || op == Instruction::Mul ||      // product  
-                        op == Instruction::And || op == Instruction::Or ||        // logical reductions
-                        op == Instruction::Xor ||                                 // XOR reduction
-                        op == Instruction::FSub || op == Instruction::Sub         // difference (less common)
-                    );
-                    
-                    if (isReductionOp) {
-                        // Check for loop-carried dependency
-                        for (Use &U : BinOp->operands()) {
-                            if (auto *PHI = dyn_cast<PHINode>(U.get())) {
-                                if (L->contains(PHI->getParent())) {
-                                    return true;
-                                }
-                            }
-                        }
-                    }
-                }
-                // Also check for min/max patterns using select instructions
-                else if (auto *Select = dyn_cast<SelectInst>(&I)) {
-                    // Pattern: max_val = (array[i] > max_val) ? array[i] : max_val;
-                    // This compiles to select instruction
-                    if (auto *Cmp = dyn_cast<CmpInst>(Select->getCondition())) {
-                        CmpInst::Predicate pred = Cmp->getPredicate();
-                        if (pred == CmpInst::ICMP_SGT || pred == CmpInst::ICMP_SLT ||
-                            pred == CmpInst::FCMP_OGT || pred == CmpInst::FCMP_OLT) {
-                            return true; // Min/Max reduction
-                        }
-                    }
-                }
+        std::string clauses;
+        std::string notes;
+        for (const ReductionInfo &R : reductions) {
+            std::string var = R.variable.empty() ? "/* " + R.kind + " variable */" : R.variable;
+            clauses += " reduction(" + R.ompOperator + ":" + var + ")";
+            if (R.variable.empty()) {
+                notes += "// Note: no debug info for the " + R.kind + " reduction - fill in its variable\n";
+            }
+            if (R.exactFPMath) {
+                notes += "// Note: " + var + " is a floating-point " + R.kind +
+                         " - parallel order changes rounding\n";
+            }
+            if (R.kind == "any_of") {
+                notes += "// Note: " + var + " is set once a condition holds - valid as || on a 0/1 flag, "
+                         "otherwise reduce a flag and assign after the loop\n";
             }
         }
-        return false;
+        return "// ✅ OpenMP 5.2 reduction - operator and variable from the recurrence\n"
+               "#pragma omp parallel for" + clauses + "\n" + notes +
+               "for(/* existing loop header */)";
+    }
+
+    // Enhanced pattern detection methods
+    bool hasAdvancedReductionPattern(Loop *L, ScalarEvolution &SE) {
+        // Min/max, bitwise and any-of reductions, e.g.
+        // max_val = (array[i] > max_val) ? array[i] : max_val;
+        std::vector<ReductionInfo> reductions;
+        if (!hasLoopIndex(L, SE) || !isReductionLoop(L, SE, reductions)) return false;
+        return any_of(reductions, [](const ReductionInfo &R) {
+            return R.kind != "add" && R.kind != "mul";
+        });
     }
 
-    bool isVectorizableLoop(Loop *L) {
-        PHINode *IndVar = L->getCanonicalInductionVariable();
-        if (!IndVar) return false;
+    bool isVectorizableLoop(Loop *L, ScalarEvolution &SE) {
+        if (!hasLoopIndex(L, SE)) return false;
+        if (!hasOnlyInductionPHIs(L, SE)) return false;
+        if (!storesStayInIteration(L, SE)) return false;
         
         bool hasUnitStrideAccess = false;
         bool hasVectorizableOps = false;
         bool hasNoSideEffects = true;
+        const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
         
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
-                if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
-                    // Check for unit stride access: array[i], array[i+c]
-                    if (GEP->getNumIndices() == 1) {
-                        Value *idx = GEP->getOperand(1);
-                        if (idx == IndVar) {
-                            hasUnitStrideAccess = true;
-                        }
+                if (Value *Ptr = getLoadStorePointerOperand(&I)) {
+                    // Check for unit stride access: array[i], array[i+c], *p++
+                    Optional<int64_t> stride = getAccessStride(SE, Ptr, L);
+                    int64_t size = DL.getTypeStoreSize(getLoadStoreType(&I)).getFixedSize();
+                    if (stride && (*stride == size || *stride == -size)) {
+                        hasUnitStrideAccess = true;
                     }
+                    hasVectorizableOps = true;
                 }
-                else if (isa<BinaryOperator>(&I) || isa<CastInst>(&I) || 
-                         isa<LoadInst>(&I) || isa<StoreInst>(&I)) {
+                else if (isa<BinaryOperator>(&I) || isa<CastInst>(&I)) {
                     hasVectorizableOps = true;
                 }
                 else if (I.mayHaveSideEffects() && !isa<StoreInst>(&I)) {
@@ -173,46 +554,26 @@ namespace PatternDetection {
         return hasUnitStrideAccess && hasVectorizableOps && hasNoSideEffects;
     }
 
-    bool isEmbarrassinglyParallel(Loop *L) {
-        PHINode *IndVar = L->getCanonicalInductionVariable();
-        if (!IndVar) return false;
-        
-        // Check that all array accesses use only the current iteration's index
+    bool isEmbarrassinglyParallel(Loop *L, ScalarEvolution &SE) {
+        if (!hasLoopIndex(L, SE)) return false;
+
+        // A scalar carried between iterations is a dependence too
+        if (!hasOnlyInductionPHIs(L, SE)) return false;
+
+        std::vector<Instruction *> accesses;
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
-                if (auto *Load = dyn_cast<LoadInst>(&I)) {
-                    if (auto *GEP = dyn_cast<GetElementPtrInst>(Load->getPointerOperand())) {
-                        // Verify index is just the induction variable
-                        for (Use &U : GEP->indices()) {
-                            if (U.get() != IndVar) {
-                                // Complex indexing - might not be embarrassingly parallel
-                                if (!isa<ConstantInt>(U.get())) {
-                                    return false;
-                                }
-                            }
-                        }
-                    }
-                }
-                else if (auto *Store = dyn_cast<StoreInst>(&I)) {
-                    if (auto *GEP = dyn_cast<GetElementPtrInst>(Store->getPointerOperand())) {
-                        // Same check for store operations
-                        for (Use &U : GEP->indices()) {
-                            if (U.get() != IndVar) {
-                                if (!isa<ConstantInt>(U.get())) {
-                                    return false;
-                                }
-                            }
-                        }
-                    }
+                if (isa<LoadInst>(&I) || isa<StoreInst>(&I)) {
+                    accesses.push_back(&I);
                 }
                 // No function calls allowed
-                else if (isa<CallInst>(&I)) {
+                else if (isa<CallInst>(&I) && !isa<DbgInfoIntrinsic>(&I)) {
                     return false;
                 }
             }
         }
-        
-        return true;
+
+        return storesStayInIteration(L, SE, accesses);
     }
 
     bool isMatrixMultiplication(Loop *OuterLoop, Loop *MiddleLoop, Loop *InnerLoop) {
@@ -271,23 +632,23 @@ namespace PatternDetection {
         return false;
     }
 
-    bool isMapOperation(Loop *L) {
+    bool isMapOperation(Loop *L, ScalarEvolution &SE) {
         // Detect element-wise operations that can be easily vectorized
         // f(array[i]) -> result[i]
         
-        bool hasIndependentComputation = true;
+        bool hasIndependentComputation = hasOnlyInductionPHIs(L, SE);
         bool hasArrayAccess = false;
         
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
                 if (auto *Load = dyn_cast<LoadInst>(&I)) {
                     // Check if loading from array indexed by induction variable
-                    if (auto *GEP = dyn_cast<GetElementPtrInst>(Load->getPointerOperand())) {
+                    if (isa<GetElementPtrInst>(Load->getPointerOperand())) {
                         hasArrayAccess = true;
                     }
                 } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
                     // Check if storing to array indexed by induction variable
-                    if (auto *GEP = dyn_cast<GetElementPtrInst>(Store->getPointerOperand())) {
+                    if (isa<GetElementPtrInst>(Store->getPointerOperand())) {
                         // Verify it's a simple indexed store
                         continue;
                     }
@@ -300,48 +661,491 @@ namespace PatternDetection {
         return hasArrayAccess && hasIndependentComputation;
     }
 
-    bool isFilterPattern(Loop *L) {
-        // Detect loops that conditionally process elements
-        // Often requires special handling for parallel execution
-        
-        bool hasConditionalStore = false;
-        
+    bool isFilterPattern(Loop *L, ScalarEvolution &SE) {
+        // Appending to an output under a condition: out[k++] = x[i] or
+        // out.push_back(x[i]) - parallel as count, scan and scatter
+        FilterInfo info;
+        return findFilter(L, SE, info);
+    }
+
+    // OpenMP operator of an associative combine of Running with one other
+    // value, which is returned in Input; empty if Op is not such a combine
+    static std::string getScanOperator(Value *Op, Value *Running, Value *&Input, bool &exactFPMath) {
+        using namespace llvm::PatternMatch;
+        exactFPMath = false;
+
+        Value *A = nullptr, *B = nullptr;
+        std::string ompOperator;
+        if (auto *BinOp = dyn_cast<BinaryOperator>(Op)) {
+            A = BinOp->getOperand(0);
+            B = BinOp->getOperand(1);
+            switch (BinOp->getOpcode()) {
+            case Instruction::Add: ompOperator = "+"; break;
+            case Instruction::Mul: ompOperator = "*"; break;
+            case Instruction::And: ompOperator = "&"; break;
+            case Instruction::Or: ompOperator = "|"; break;
+            case Instruction::Xor: ompOperator = "^"; break;
+            case Instruction::FAdd: ompOperator = "+"; break;
+            case Instruction::FMul: ompOperator = "*"; break;
+            default: return "";
+            }
+            if (isa<FPMathOperator>(BinOp)) {
+                exactFPMath = !BinOp->hasAllowReassoc();
+            }
+        } else if (match(Op, m_SMax(m_Value(A), m_Value(B))) ||
+                   match(Op, m_UMax(m_Value(A), m_Value(B))) ||
+                   match(Op, m_OrdFMax(m_Value(A), m_Value(B))) ||
+                   match(Op, m_UnordFMax(m_Value(A), m_Value(B))) ||
+                   match(Op, m_FMax(m_Value(A), m_Value(B)))) {
+            ompOperator = "max";
+        } else if (match(Op, m_SMin(m_Value(A), m_Value(B))) ||
+                   match(Op, m_UMin(m_Value(A), m_Value(B))) ||
+                   match(Op, m_OrdFMin(m_Value(A), m_Value(B))) ||
+                   match(Op, m_UnordFMin(m_Value(A), m_Value(B))) ||
+                   match(Op, m_FMin(m_Value(A), m_Value(B)))) {
+            ompOperator = "min";
+        } else {
+            return "";
+        }
+
+        if (A == Running && B != Running) {
+            Input = B;
+        } else if (B == Running && A != Running) {
+            Input = A;
+        } else {
+            return "";
+        }
+        return ompOperator;
+    }
+
+    // True if V is computed from Running inside L
+    static bool dependsOn(Value *V, Value *Running, Loop *L, unsigned depth = 0) {
+        if (V == Running) return true;
+        auto *I = dyn_cast<Instruction>(V);
+        if (!I || !L->contains(I) || isa<PHINode>(I) || depth > 8) return false;
+        return any_of(I->operands(), [&](Use &U) {
+            return dependsOn(U.get(), Running, L, depth + 1);
+        });
+    }
+
+    // Stores in L of exactly V whose address advances one element per iteration
+    static std::vector<StoreInst *> getElementStores(Value *V, Loop *L, ScalarEvolution &SE) {
+        std::vector<StoreInst *> stores;
+        const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+        for (User *U : V->users()) {
+            auto *Store = dyn_cast<StoreInst>(U);
+            if (!Store || !L->contains(Store) || Store->getValueOperand() != V) continue;
+            Optional<int64_t> stride = getAccessStride(SE, Store->getPointerOperand(), L);
+            int64_t size = DL.getTypeStoreSize(V->getType()).getFixedSize();
+            if (stride && (*stride == size || *stride == -size)) {
+                stores.push_back(Store);
+            }
+        }
+        return stores;
+    }
+
+    static std::string getCTypeName(Type *Ty) {
+        if (Ty->isDoubleTy()) return "double";
+        if (Ty->isFloatTy()) return "float";
+        if (Ty->isIntegerTy(8)) return "char";
+        if (Ty->isIntegerTy(16)) return "short";
+        if (Ty->isIntegerTy(32)) return "int";
+        if (Ty->isIntegerTy(64)) return "long";
+        return "auto";
+    }
+
+    // Name of the array a pointer indexes, from its SCEV base
+    static std::string getArrayName(Value *Ptr, ScalarEvolution &SE) {
+        if (auto *Base = dyn_cast<SCEVUnknown>(SE.getPointerBase(SE.getSCEV(Ptr)))) {
+            return getVariableName(Base->getValue());
+        }
+        return "";
+    }
+
+    static bool isOnlyUsedBy(Value *V, Loop *L, const std::vector<Value *> &allowed) {
+        for (User *U : V->users()) {
+            auto *I = dyn_cast<Instruction>(U);
+            if (!I || !L->contains(I) || isa<DbgInfoIntrinsic>(I)) continue;
+            if (std::find(allowed.begin(), allowed.end(), I) == allowed.end()) return false;
+        }
+        return true;
+    }
+
+    // Running scalar stored every iteration:
+    //   s = s op x[i]; out[i] = s;   (inclusive)
+    //   out[i] = s; s = s op x[i];   (exclusive)
+    static bool findScalarScan(Loop *L, ScalarEvolution &SE, ScanInfo &Info) {
+        BasicBlock *Latch = L->getLoopLatch();
+        if (!Latch) return false;
+
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            if (isInduction(&Phi, L, SE) || Phi.getBasicBlockIndex(Latch) < 0) continue;
+
+            Value *Next = Phi.getIncomingValueForBlock(Latch);
+            Value *Input = nullptr;
+            bool exactFPMath = false;
+            std::string ompOperator = getScanOperator(Next, &Phi, Input, exactFPMath);
+            if (ompOperator.empty() || dependsOn(Input, &Phi, L)) continue;
+
+            std::vector<StoreInst *> inclusiveStores = getElementStores(Next, L, SE);
+            std::vector<StoreInst *> exclusiveStores = getElementStores(&Phi, L, SE);
+            if (inclusiveStores.size() + exclusiveStores.size() != 1) continue;
+
+            // The running value must feed nothing but its combine and the store;
+            // select-based min/max also compare it
+            std::vector<Value *> phiUsers{Next};
+            if (auto *Sel = dyn_cast<SelectInst>(Next)) phiUsers.push_back(Sel->getCondition());
+            if (!exclusiveStores.empty()) phiUsers.push_back(exclusiveStores.front());
+            std::vector<Value *> nextUsers{&Phi};
+            if (!inclusiveStores.empty()) nextUsers.push_back(inclusiveStores.front());
+            if (!isOnlyUsedBy(&Phi, L, phiUsers) || !isOnlyUsedBy(Next, L, nextUsers)) continue;
+
+            // The other loop-carried scalars are plain inductions
+            bool onlyInductions = true;
+            for (PHINode &Other : L->getHeader()->phis()) {
+                if (&Other != &Phi && !isIndexInduction(&Other, L, SE)) onlyInductions = false;
+            }
+            if (!onlyInductions || !storesStayInIteration(L, SE)) continue;
+
+            StoreInst *Store = inclusiveStores.empty() ? exclusiveStores.front() : inclusiveStores.front();
+            Info.ompOperator = ompOperator;
+            Info.input = getSourceExpression(Input, L);
+            Info.array = getArrayName(Store->getPointerOperand(), SE);
+            Info.elementType = getCTypeName(Phi.getType());
+            Info.inclusive = !inclusiveStores.empty();
+            Info.exactFPMath = exactFPMath;
+
+            // Load PRE turns a[i] = a[i-1] op x[i] into a running PHI seeded
+            // with a load of the same array and no source variable
+            Value *Start = nullptr;
+            for (unsigned Idx = 0; Idx < Phi.getNumIncomingValues(); ++Idx) {
+                if (Phi.getIncomingBlock(Idx) != Latch) Start = Phi.getIncomingValue(Idx);
+            }
+            auto *Seed = dyn_cast_or_null<LoadInst>(Start);
+            Info.arrayRecurrence = Seed && getDebugVariableName(&Phi).empty() &&
+                SE.getPointerBase(SE.getSCEV(Seed->getPointerOperand())) ==
+                    SE.getPointerBase(SE.getSCEV(Store->getPointerOperand()));
+            Info.variable = Info.arrayRecurrence
+                ? (Info.array.empty() ? "prefix" : Info.array) + "_scan"
+                : getPHIVariableName(&Phi);
+            return true;
+        }
+        return false;
+    }
+
+    // Array recurrence: a[i] = a[i-1] op x[i]
+    static bool findArrayScan(Loop *L, ScalarEvolution &SE, ScanInfo &Info) {
+        if (!hasOnlyInductionPHIs(L, SE)) return false;
+
+        std::vector<Instruction *> accesses;
+        std::vector<StoreInst *> stores;
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
-                if (auto *Br = dyn_cast<BranchInst>(&I)) {
-                    if (Br->isConditional()) {
-                        // Look for conditional branches followed by stores
-                        // This suggests filtering/selection logic
-                        hasConditionalStore = true;
-                    }
-                }
+                if (isa<LoadInst>(&I) || isa<StoreInst>(&I)) accesses.push_back(&I);
+                if (auto *Store = dyn_cast<StoreInst>(&I)) stores.push_back(Store);
+                else if (I.mayWriteToMemory()) return false;
             }
         }
-        
-        return hasConditionalStore;
+        if (stores.size() != 1) return false;
+
+        StoreInst *Store = stores.front();
+        Value *Input = nullptr;
+        bool exactFPMath = false;
+        auto *Combine = dyn_cast<Instruction>(Store->getValueOperand());
+        if (!Combine) return false;
+
+        // One operand is the element the previous iteration stored
+        for (Use &U : Combine->operands()) {
+            auto *Prev = dyn_cast<LoadInst>(U.get());
+            if (!Prev || !L->contains(Prev)) continue;
+
+            Optional<int64_t> stride = getAccessStride(SE, Store->getPointerOperand(), L);
+            if (!stride) return false;
+            auto *Dist = dyn_cast<SCEVConstant>(SE.getMinusSCEV(
+                SE.getSCEV(Store->getPointerOperand()), SE.getSCEV(Prev->getPointerOperand())));
+            if (!Dist || Dist->getAPInt().getSExtValue() != *stride) continue;
+
+            std::string ompOperator = getScanOperator(Combine, Prev, Input, exactFPMath);
+            if (ompOperator.empty() || dependsOn(Input, Prev, L)) continue;
+            if (!isOnlyUsedBy(Prev, L, {Combine})) continue;
+
+            // Apart from a[i-1], every access stays in its own iteration
+            std::vector<Instruction *> others;
+            for (Instruction *I : accesses) {
+                if (I != Prev) others.push_back(I);
+            }
+            if (!storesStayInIteration(L, SE, others)) return false;
+
+            Info.ompOperator = ompOperator;
+            Info.input = getSourceExpression(Input, L);
+            Info.array = getArrayName(Store->getPointerOperand(), SE);
+            Info.variable = (Info.array.empty() ? "prefix" : Info.array) + "_scan";
+            Info.elementType = getCTypeName(Combine->getType());
+            Info.inclusive = true;
+            Info.arrayRecurrence = true;
+            Info.exactFPMath = exactFPMath;
+            return true;
+        }
+        return false;
     }
 
-    bool isPrefixSumPattern(Loop *L) {
-        // Detect patterns like: array[i] = array[i-1] + input[i]
-        // These require special parallel algorithms
-        
+    bool findScan(Loop *L, ScalarEvolution &SE, ScanInfo &Info) {
+        if (!hasLoopIndex(L, SE)) return false;
+        if (!findScalarScan(L, SE, Info) && !findArrayScan(L, SE, Info)) return false;
+
+        Info.index = "i";
+        for (const InductionInfo &IV : findInductions(L, SE)) {
+            if (IV.kind == "integer" && !IV.variable.empty()) {
+                Info.index = IV.variable;
+                break;
+            }
+        }
+        Info.lower.clear();
+        Info.upper.clear();
+        if (!getLoopBounds(L, SE, Info.index, Info.lower, Info.upper)) {
+            Info.lower.clear();
+            Info.upper.clear();
+        }
+        Info.inputArray.clear();
+        const std::string suffix = "[" + Info.index + "]";
+        if (StringRef(Info.input).endswith(suffix)) {
+            std::string array = Info.input.substr(0, Info.input.size() - suffix.size());
+            if (array.find_first_of("[( ") == std::string::npos) Info.inputArray = array;
+        }
+        return true;
+    }
+
+    bool isScanPrintable(const ScanInfo &Info) {
+        return !Info.input.empty() && !Info.array.empty() && !Info.lower.empty() && !Info.upper.empty();
+    }
+
+    bool isPrefixSumPattern(Loop *L, ScalarEvolution &SE) {
+        // Detect patterns like: array[i] = array[i-1] + input[i], or a running
+        // sum stored every iteration - parallel with an OpenMP scan
+        ScanInfo info;
+        return findScan(L, SE, info);
+    }
+
+    // std::vector<T>::push_back / emplace_back that was not inlined
+    static bool isVectorAppend(CallBase *Call) {
+        Function *Callee = Call->getCalledFunction();
+        if (!Callee || Call->arg_size() != 2) return false;
+        StringRef name = Callee->getName();
+        return name.startswith("_ZNSt6vector") &&
+               (name.contains("9push_back") || name.contains("12emplace_back"));
+    }
+
+    // Predicate under which an iteration of L reaches BB, from the
+    // conditional branches on its chain of single predecessors up to the
+    // header. Empty if some part has no spelling; guarded is false when BB
+    // runs on every iteration.
+    static std::string getBlockCondition(BasicBlock *BB, Loop *L, bool &guarded) {
+        guarded = false;
+        std::vector<std::string> terms;
+        bool complete = true;
+        for (BasicBlock *Cur = BB; Cur != L->getHeader();) {
+            BasicBlock *Pred = Cur->getSinglePredecessor();
+            if (!Pred || !L->contains(Pred)) {
+                complete = false;
+                break;
+            }
+            auto *Br = dyn_cast<BranchInst>(Pred->getTerminator());
+            if (Br && Br->isConditional() && Br->getSuccessor(0) != Br->getSuccessor(1)) {
+                guarded = true;
+                std::string cond = getSourceExpression(Br->getCondition(), L);
+                if (cond.empty()) complete = false;
+                else if (Br->getSuccessor(0) == Cur) terms.push_back(cond);
+                else terms.push_back("!(" + cond + ")");
+            }
+            Cur = Pred;
+        }
+        if (!complete || terms.empty()) return "";
+        if (terms.size() == 1) return terms.front();
+        std::string condition;
+        for (auto it = terms.rbegin(); it != terms.rend(); ++it) {
+            bool compound = it->find(' ') != std::string::npos && it->compare(0, 2, "!(") != 0;
+            condition += (condition.empty() ? "" : " && ") + (compound ? "(" + *it + ")" : *it);
+        }
+        return condition;
+    }
+
+    static Value *stripIntegerCasts(Value *V) {
+        while (isa<SExtInst>(V) || isa<ZExtInst>(V) || isa<TruncInst>(V)) {
+            V = cast<Instruction>(V)->getOperand(0);
+        }
+        return V;
+    }
+
+    // out[k] for the cursor PHI k: the GEP and its index casts
+    static bool isCursorAddress(Value *Ptr, PHINode *Cursor, Loop *L, std::vector<Value *> &uses) {
+        auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+        if (!GEP || GEP->getNumIndices() != 1 || !L->isLoopInvariant(GEP->getPointerOperand())) {
+            return false;
+        }
+        Value *index = *GEP->idx_begin();
+        if (stripIntegerCasts(index) != Cursor) return false;
+        uses.push_back(GEP);
+        for (Value *V = index; V != Cursor; V = cast<Instruction>(V)->getOperand(0)) {
+            uses.push_back(V);
+        }
+        return true;
+    }
+
+    // k advanced by one where an element is appended, kept elsewhere
+    // An unguarded out[k] = v; k += cond is the branch-free spelling: the
+    // element past the end is overwritten by the next append
+    static bool findCursorAppends(Loop *L, const std::vector<StoreInst *> &stores,
+                                  bool guarded, ScalarEvolution &SE, FilterInfo &Info) {
+        using namespace llvm::PatternMatch;
+        BasicBlock *Latch = L->getLoopLatch();
+        PHINode *Cursor = nullptr;
+        for (PHINode &Phi : L->getHeader()->phis()) {
+            if (isInduction(&Phi, L, SE)) continue;
+            if (Cursor) return false;
+            Cursor = &Phi;
+        }
+        if (!Cursor || !Cursor->getType()->isIntegerTy() || Cursor->getBasicBlockIndex(Latch) < 0) {
+            return false;
+        }
+
+        Value *Next = Cursor->getIncomingValueForBlock(Latch);
+        Value *Increment = nullptr;
+        std::vector<Value *> merged;
+        if (auto *Merge = dyn_cast<PHINode>(Next)) {
+            merged.assign(Merge->incoming_values().begin(), Merge->incoming_values().end());
+        } else if (auto *Sel = dyn_cast<SelectInst>(Next)) {
+            merged = {Sel->getTrueValue(), Sel->getFalseValue()};
+            if (!guarded) {
+                std::string cond = getSourceExpression(Sel->getCondition(), L);
+                if (!cond.empty() && Sel->getFalseValue() == Cursor) Info.condition = cond;
+                else if (!cond.empty()) Info.condition = "!(" + cond + ")";
+            }
+        } else {
+            return false;
+        }
+        if (!guarded && !isa<SelectInst>(Next)) return false;
+        for (Value *V : merged) {
+            if (V == Cursor) continue;
+            if (!match(V, m_Add(m_Specific(Cursor), m_One())) || (Increment && V != Increment)) {
+                return false;
+            }
+            Increment = V;
+        }
+        if (!Increment) return false;
+
+        std::vector<Value *> cursorUsers{Increment, Next};
+        for (StoreInst *Store : stores) {
+            if (!isCursorAddress(Store->getPointerOperand(), Cursor, L, cursorUsers)) return false;
+        }
+        // The cursor feeds nothing else: a condition on k would need the
+        // count of the earlier iterations
+        if (!isOnlyUsedBy(Cursor, L, cursorUsers) || !isOnlyUsedBy(Increment, L, {Next}) ||
+            !isOnlyUsedBy(Next, L, {Cursor})) {
+            return false;
+        }
+
+        Info.cursor = getPHIVariableName(Cursor);
+        if (Info.cursor.empty()) Info.cursor = "k";
+        Value *Start = nullptr;
+        for (unsigned Idx = 0; Idx < Cursor->getNumIncomingValues(); ++Idx) {
+            if (Cursor->getIncomingBlock(Idx) != Latch) Start = Cursor->getIncomingValue(Idx);
+        }
+        Info.cursorStart = Start ? getSourceExpression(Start, L) : "";
+        if (Info.cursorStart.empty()) Info.cursorStart = "/* " + Info.cursor + " before the loop */";
+        for (StoreInst *Store : stores) {
+            auto *GEP = cast<GetElementPtrInst>(Store->getPointerOperand());
+            Info.outputs.push_back(getVariableName(GEP->getPointerOperand()));
+            Info.values.push_back(getSourceExpression(Store->getValueOperand(), L));
+        }
+        Info.elementType = getCTypeName(stores.front()->getValueOperand()->getType());
+        return true;
+    }
+
+    static bool findVectorAppends(Loop *L, const std::vector<CallBase *> &appends,
+                                  ScalarEvolution &SE, FilterInfo &Info) {
+        if (!hasOnlyInductionPHIs(L, SE)) return false;
+        std::set<Value *> vectors;
+        for (CallBase *Call : appends) {
+            Value *Vector = Call->getArgOperand(0);
+            if (!L->isLoopInvariant(Vector) || !vectors.insert(Vector).second) return false;
+            Info.outputs.push_back(getVariableName(Vector));
+            // push_back(const T &): x[i] when the argument addresses an element
+            std::string value;
+            auto *GEP = dyn_cast<GetElementPtrInst>(Call->getArgOperand(1));
+            if (GEP && GEP->getNumIndices() == 1 && L->isLoopInvariant(GEP->getPointerOperand())) {
+                std::string array = getVariableName(GEP->getPointerOperand());
+                std::string index = getSourceExpression(*GEP->idx_begin(), L);
+                if (!array.empty() && !index.empty()) value = array + "[" + index + "]";
+                if (Info.elementType.empty()) Info.elementType = getCTypeName(GEP->getResultElementType());
+            }
+            Info.values.push_back(value);
+        }
+        return true;
+    }
+
+    bool findFilter(Loop *L, ScalarEvolution &SE, FilterInfo &Info) {
+        if (!L->isInnermost() || !L->getLoopLatch() || !hasLoopIndex(L, SE)) return false;
+
+        std::vector<StoreInst *> stores;
+        std::vector<CallBase *> appends;
+        std::vector<LoadInst *> loads;
         for (BasicBlock *BB : L->blocks()) {
             for (Instruction &I : *BB) {
-                if (auto *BinOp = dyn_cast<BinaryOperator>(&I)) {
-                    // Look for operations that use previous array element
-                    for (Use &U : BinOp->operands()) {
-                        if (auto *Load = dyn_cast<LoadInst>(U.get())) {
-                            if (auto *GEP = dyn_cast<GetElementPtrInst>(Load->getPointerOperand())) {
-                                // Check if accessing array[i-1] pattern
-                                // This indicates scan/prefix sum
-                                return true;
-                            }
-                        }
-                    }
+                if (isa<DbgInfoIntrinsic>(&I) || I.isLifetimeStartOrEnd()) continue;
+                if (auto *Load = dyn_cast<LoadInst>(&I)) {
+                    if (!Load->isSimple()) return false;
+                    loads.push_back(Load);
+                } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+                    if (!Store->isSimple()) return false;
+                    stores.push_back(Store);
+                } else if (auto *Call = dyn_cast<CallBase>(&I); Call && isVectorAppend(Call)) {
+                    appends.push_back(Call);
+                } else if (I.mayReadOrWriteMemory() || I.mayHaveSideEffects()) {
+                    return false;
                 }
             }
         }
-        return false;
+        // Arrays or vectors, appended to from one guarded block
+        if (stores.empty() == appends.empty()) return false;
+        BasicBlock *AppendBB = stores.empty() ? appends.front()->getParent() : stores.front()->getParent();
+        for (StoreInst *Store : stores) {
+            if (Store->getParent() != AppendBB) return false;
+        }
+        for (CallBase *Call : appends) {
+            if (Call->getParent() != AppendBB) return false;
+        }
+        bool guarded = false;
+        Info.condition = getBlockCondition(AppendBB, L, guarded);
+        if (!guarded && !appends.empty()) return false;
+
+        Info.pushBack = !appends.empty();
+        Info.outputs.clear();
+        Info.values.clear();
+        Info.elementType.clear();
+        if (Info.pushBack ? !findVectorAppends(L, appends, SE, Info)
+                          : !findCursorAppends(L, stores, guarded, SE, Info)) {
+            return false;
+        }
+
+        // In-place compaction reads elements that other threads overwrite
+        for (LoadInst *Load : loads) {
+            Value *Object = getUnderlyingObject(Load->getPointerOperand());
+            for (StoreInst *Store : stores) {
+                if (getUnderlyingObject(Store->getPointerOperand()) == Object) return false;
+            }
+        }
+
+        Info.index = "i";
+        Info.lower = "/* lower bound */";
+        Info.upper = "/* upper bound */";
+        getLoopBounds(L, SE, Info.index, Info.lower, Info.upper);
+        Info.input.clear();
+        const std::string suffix = "[" + Info.index + "]";
+        if (Info.values.size() == 1 && StringRef(Info.values.front()).endswith(suffix)) {
+            std::string array = Info.values.front().substr(0, Info.values.front().size() - suffix.size());
+            if (array.find_first_of("[( ") == std::string::npos) Info.input = array;
+        }
+        return true;
     }
 
     MemoryAccessPattern analyzeMemoryAccess(Loop *L) {
@@ -359,7 +1163,7 @@ namespace PatternDetection {
                                 return CONSTANT_STRIDE;
                             }
                         }
-                        if (auto *Load = dyn_cast<LoadInst>(U.get())) {
+                        if (isa<LoadInst>(U.get())) {
                             // Indirect access through another array
                             return INDIRECT_ACCESS;
                         }
@@ -415,7 +1219,196 @@ namespace PatternDetection {
         return result;
     }
 
-    std::string generateOptimalPatch(const std::string& patternType, Loop *L) {
+    // Binary functor for prt::parallel_scan equivalent to an OpenMP operator
+    static std::string getRuntimeOperator(const std::string &op, const std::string &type) {
+        if (op == "+") return "std::plus<>{}";
+        if (op == "*") return "std::multiplies<>{}";
+        if (op == "&") return "std::bit_and<>{}";
+        if (op == "|") return "std::bit_or<>{}";
+        if (op == "^") return "std::bit_xor<>{}";
+        std::string param = type.empty() ? "auto" : type;
+        return "[](" + param + " a, " + param + " b) { return std::" + op + "(a, b); }";
+    }
+
+    // "b - 1", folded when b is a literal
+    static std::string getPredecessorIndex(const std::string &b) {
+        if (!b.empty() && b.find_first_not_of("0123456789") == std::string::npos) {
+            return std::to_string(std::stol(b) - 1);
+        }
+        return b + " - 1";
+    }
+
+    std::string generateScanPatch(const ScanInfo &Info) {
+        std::string var = Info.variable.empty() ? "running" : Info.variable;
+        std::string kind = Info.inclusive ? "inclusive" : "exclusive";
+        std::string op = Info.ompOperator;
+        const std::string &i = Info.index;
+
+        // Without the input or the bounds there is no loop to write down
+        if (!isScanPrintable(Info)) {
+            std::string patch = "// ⚠️ " + kind + " scan (" + op + ") of " + var;
+            if (!Info.array.empty()) patch += " into " + Info.array;
+            return patch + " - its input or loop bounds are not expressible in source\n"
+                   "// Rewrite the loop by hand as an OpenMP 5.0 scan with reduction(inscan, " + op + ":" + var +
+                   ") or with\n// prt::parallel_scan(first, last, out, " + var + ", " +
+                   getRuntimeOperator(op, Info.elementType) + ", prt::ScanKind::" +
+                   (Info.inclusive ? "Inclusive" : "Exclusive") + ") (runtime/parallel_primitives.h)";
+        }
+
+        std::string patch = "// ✅ OpenMP 5.0 " + kind + " scan (" + op + ")";
+        if (Info.arrayRecurrence) {
+            patch += " - " + Info.array + "[" + i + "] = " + Info.array + "[" + i + " - 1] " + op + " " +
+                     Info.input + ", carried in a scalar\n" +
+                     Info.elementType + " " + var + " = " + Info.array + "[" +
+                     getPredecessorIndex(Info.lower) + "];\n";
+        } else {
+            patch += " - running value " + var + " stored every iteration\n";
+        }
+        if (Info.exactFPMath) {
+            patch += "// Note: floating-point " + op + " is reassociated across threads - rounding may differ\n";
+        }
+
+        std::string combine = (op == "min" || op == "max")
+            ? var + " = std::" + op + "(" + var + ", " + Info.input + ");"
+            : var + " " + op + "= " + Info.input + ";";
+        // The input phase precedes an inclusive scan directive and follows an
+        // exclusive one
+        std::string store = Info.array + "[" + i + "] = " + var + ";";
+        patch += "#pragma omp parallel for reduction(inscan, " + op + ":" + var + ")\n"
+                 "for (long " + i + " = " + Info.lower + "; " + i + " < " + Info.upper + "; ++" + i + ") {\n"
+                 "    " + (Info.inclusive ? combine : store) + "\n"
+                 "    #pragma omp scan " + kind + "(" + var + ")\n"
+                 "    " + (Info.inclusive ? store : combine) + "\n"
+                 "}";
+
+        // Same scan through the work-stealing runtime, for compilers
+        // without OpenMP 5.0 scan support; it takes the input as a range
+        if (!Info.inputArray.empty()) {
+            auto offset = [&](const std::string &base, const std::string &by) {
+                return by == "0" ? base : base + " + " + by;
+            };
+            patch += "\n// Without OpenMP 5.0 scan support: #include \"parallel_primitives.h\" (runtime/)\n"
+                     "// " + var + " = prt::parallel_scan(" + offset(Info.inputArray, Info.lower) + ", " +
+                     offset(Info.inputArray, Info.upper) + ", " + offset(Info.array, Info.lower) + ", " +
+                     var + ", " + getRuntimeOperator(op, Info.elementType) + ", prt::ScanKind::" +
+                     (Info.inclusive ? "Inclusive" : "Exclusive") + ");";
+        }
+        return patch;
+    }
+
+    // Replace the whole-token occurrences of from in text
+    static std::string replaceToken(std::string text, const std::string &from, const std::string &to) {
+        auto isWord = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+        for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos)) {
+            bool startsWord = pos == 0 || !isWord(text[pos - 1]);
+            bool endsWord = pos + from.size() >= text.size() || !isWord(text[pos + from.size()]) ||
+                            !isWord(from.back());
+            if (startsWord && endsWord) {
+                text.replace(pos, from.size(), to);
+                pos += to.size();
+            } else {
+                pos += from.size();
+            }
+        }
+        return text;
+    }
+
+    std::string generateFilterPatch(const FilterInfo &Info) {
+        const std::string &i = Info.index;
+        std::string condition = Info.condition.empty() ? "/* condition on " + i + " */" : Info.condition;
+        auto value = [&](size_t n) {
+            return Info.values[n].empty() ? "/* value of " + i + " */" : Info.values[n];
+        };
+        auto output = [&](size_t n) {
+            return Info.outputs[n].empty() ? "/* output " + std::to_string(n) + " */" : Info.outputs[n];
+        };
+
+        std::string patch = Info.pushBack
+            ? "// ✅ Order-preserving stream compaction into std::vector: count, exclusive scan, scatter\n"
+            : "// ✅ Order-preserving stream compaction: count, exclusive scan, scatter\n";
+        patch += "// Note: the condition is evaluated twice per element and must not write shared state\n"
+                 "// Both loops are schedule(static) over the same range, so each thread\n"
+                 "// scatters exactly the elements it counted, in order\n";
+        if (Info.pushBack) {
+            patch += "// Note: the vectors are resized first - elements must be default-constructible\n";
+        }
+        patch += "#include <omp.h>\n"
+                 "#include <vector>\n"
+                 "auto keep = [&](long " + i + ") -> bool { return " + condition + "; };\n";
+        if (Info.pushBack) {
+            for (size_t n = 0; n < Info.outputs.size(); ++n) {
+                patch += "const size_t base" + std::to_string(n) + " = " + output(n) + ".size();\n";
+            }
+        } else {
+            patch += "const long first = " + Info.cursorStart + ";\n";
+        }
+        patch += "std::vector<long> offset;\n"
+                 "#pragma omp parallel\n"
+                 "{\n"
+                 "    const int nt = omp_get_num_threads(), tid = omp_get_thread_num();\n"
+                 "    #pragma omp single\n"
+                 "    offset.assign(nt + 1, 0);\n"
+                 "    long count = 0;\n"
+                 "    #pragma omp for schedule(static) nowait\n"
+                 "    for (long " + i + " = " + Info.lower + "; " + i + " < " + Info.upper + "; ++" + i + ")\n"
+                 "        count += keep(" + i + ");\n"
+                 "    offset[tid + 1] = count;\n"
+                 "    #pragma omp barrier\n"
+                 "    #pragma omp single\n";
+        if (Info.pushBack) {
+            patch += "    {\n"
+                     "        for (int t = 0; t < nt; ++t) offset[t + 1] += offset[t];\n";
+            for (size_t n = 0; n < Info.outputs.size(); ++n) {
+                patch += "        " + output(n) + ".resize(base" + std::to_string(n) + " + offset[nt]);\n";
+            }
+            patch += "    }\n"
+                     "    long pos = offset[tid];\n";
+        } else {
+            patch += "    for (int t = 0; t < nt; ++t) offset[t + 1] += offset[t];\n"
+                     "    long pos = first + offset[tid];\n";
+        }
+        patch += "    #pragma omp for schedule(static)\n"
+                 "    for (long " + i + " = " + Info.lower + "; " + i + " < " + Info.upper + "; ++" + i + ")\n"
+                 "        if (keep(" + i + ")) {\n";
+        for (size_t n = 0; n < Info.outputs.size(); ++n) {
+            std::string slot = Info.pushBack ? "base" + std::to_string(n) + " + pos" : "pos";
+            patch += "            " + output(n) + "[" + slot + "] = " + value(n) + ";\n";
+        }
+        patch += "            ++pos;\n"
+                 "        }\n"
+                 "}\n";
+        if (!Info.pushBack) {
+            patch += Info.cursor + " = first + offset.back();\n";
+        }
+
+        // x[i] kept when the condition reads only x[i]: a library compaction
+        if (!Info.input.empty() && !Info.condition.empty() && Info.outputs.size() == 1) {
+            std::string element = replaceToken(Info.condition, Info.input + "[" + i + "]", "v");
+            if (replaceToken(element, i, "") == element) {
+                std::string range = (Info.lower == "0" ? Info.input : Info.input + " + " + Info.lower) +
+                                    ", " + Info.input + " + " + Info.upper;
+                std::string out = output(0);
+                patch += "// Or, with C++17 parallel algorithms (<algorithm>, <execution>):\n"
+                         "// auto pred = [&](const auto &v) { return " + element + "; };\n";
+                if (Info.pushBack) {
+                    patch += "// const size_t base = " + out + ".size();\n"
+                             "// " + out + ".resize(base + (" + Info.upper + ")" +
+                             (Info.lower == "0" ? "" : " - (" + Info.lower + ")") + ");\n"
+                             "// " + out + ".erase(std::copy_if(std::execution::par_unseq, " + range + ", " +
+                             out + ".begin() + base, pred), " + out + ".end());\n";
+                } else {
+                    patch += "// " + Info.cursor + " = std::copy_if(std::execution::par_unseq, " + range + ", " +
+                             out + " + first, pred) - " + out + ";\n"
+                             "// Or runtime/parallel_primitives.h: " + Info.cursor + " = prt::parallel_compact(" +
+                             range + ", " + out + " + first, pred) - " + out + ";\n";
+                }
+            }
+        }
+        if (!patch.empty() && patch.back() == '\n') patch.pop_back();
+        return patch;
+    }
+
+    std::string generateOptimalPatch(const std::string& patternType, Loop *L, const ScanInfo *scan) {
         // Generate OpenMP pragmas following specification best practices
         if (patternType == "embarrassingly_parallel") {
             return "// ✅ OpenMP 5.2 specification compliant\n"
@@ -429,27 +1422,27 @@ namespace PatternDetection {
                    "// #pragma omp parallel for\n"
                    "// #pragma omp simd";
         }
-        else if (patternType == "advanced_reduction") {
-            return "// ✅ OpenMP 5.2 reduction clause - adjust operator as needed\n"
-                   "#pragma omp parallel for reduction(+:sum)\n"
-                   "// Other operators: -, *, &, |, ^, &&, ||\n"
-                   "// min:var, max:var for min/max reductions";
+        else if (patternType == "advanced_reduction" || patternType == "reduction") {
+            // Operator and variable come from the recognized recurrences
+            return generateReductionPatch(L);
         }
         else if (patternType == "matrix_multiply") {
-            return "// ✅ OpenMP 5.2 collapse for nested loops\n"
-                   "#pragma omp parallel for collapse(2)\n"
+            // Collapse depth is computed per nest by PerfectNestAnalyzer
+            return "// ✅ OpenMP 5.2 parallel for on the outermost loop\n"
+                   "#pragma omp parallel for\n"
                    "// Consider loop tiling for cache efficiency";
         }
+        else if (patternType == "prefix_sum") {
+            // Operator and kind come from the recognized scan
+            if (scan) return generateScanPatch(*scan);
+            return "// ⚠️ Prefix scan whose operator was not recognized - parallel only as a scan\n"
+                   "// (OpenMP 5.0 inscan reduction or prt::parallel_scan in runtime/parallel_primitives.h)";
+        }
         else if (patternType == "stencil") {
             return "// ⚠️ OpenMP parallel - verify boundary conditions\n"
                    "#pragma omp parallel for\n"
                    "// Note: Check data dependencies at boundaries";
         }
-        else if (patternType == "reduction") {
-            return "// ✅ OpenMP 5.2 standard reduction pattern\n"
-                   "#pragma omp parallel for reduction(+:sum)\n"
-                   "// Specify correct reduction variable and operator";
-        }
         else {
             return "// 📝 Basic OpenMP parallel - requires manual verification\n" +
                    generateParallelPatch(L);
@@ -7,6 +7,7 @@
 #include "llvm/IR/Function.h"
 #include <string>
 #include <utility>
+#include <vector>
 
 using namespace llvm;
 
@@ -27,22 +28,98 @@ namespace PatternDetection {
         std::string reason;
     };
 
+    // Reduction recognized by RecurrenceDescriptor::isReductionPHI
+    struct ReductionInfo {
+        PHINode *phi;
+        std::string kind;         // add, mul, and, or, xor, min, max, fmin, fmax, any_of
+        std::string ompOperator;  // Operator of the OpenMP reduction clause
+        std::string variable;     // Source variable name, empty if unknown
+        bool exactFPMath;         // FP chain without reassociation flags
+    };
+
+    // Induction recognized by InductionDescriptor::isInductionPHI
+    struct InductionInfo {
+        PHINode *phi;
+        std::string kind;      // integer, pointer, fp
+        std::string variable;  // Source variable name, empty if unknown
+        Value *start;
+        const SCEV *step;      // Bytes for pointer inductions
+        int64_t constantStep;  // 0 if the step is not a constant
+    };
+
+    // Prefix scan: a running value combined with one input per iteration
+    // and stored every iteration
+    struct ScanInfo {
+        std::string ompOperator;  // +, *, &, |, ^, min, max
+        std::string variable;     // Running scalar; empty for array recurrences
+        std::string array;        // Array receiving the prefix values
+        std::string index;        // Loop index name
+        std::string input;        // Value combined each iteration; empty if unknown
+        std::string inputArray;   // x when the input is x[index]
+        std::string lower, upper; // Loop bounds; empty if unknown
+        std::string elementType;  // C type of the scanned values
+        bool inclusive;           // Stored value includes this iteration's input
+        bool arrayRecurrence;     // a[i] = a[i-1] op x[i]
+        bool exactFPMath;         // FP combine without reassociation flags
+    };
+
+    // Order-preserving filter: out[k++] = value or out.push_back(value)
+    // under a condition, where the cursor k only moves when an element is
+    // appended
+    struct FilterInfo {
+        std::string cursor;               // Output cursor; empty for push_back
+        std::string cursorStart;          // Cursor value before the loop
+        std::vector<std::string> outputs; // Arrays or vectors appended to
+        std::vector<std::string> values;  // Value appended to each output
+        std::string elementType;          // C type of the first output's elements
+        std::string condition;            // Predicate of iteration index; empty if unknown
+        std::string index;                // Loop index name
+        std::string lower, upper;         // Loop bounds, placeholders if unknown
+        std::string input;                // x when the single value is x[index]
+        bool pushBack;                    // Appends through std::vector::push_back
+    };
+
     // Pattern detection functions from ParallelCandidatePass
     bool isSimpleParallelLoop(Loop *L, ScalarEvolution &SE);
-    bool hasReductionPattern(Loop *L);
+    bool hasReductionPattern(Loop *L, ScalarEvolution &SE);
     std::pair<std::string, int> getSourceLocation(Instruction *I);
+    // Source location of the loop statement: the start of the llvm.loop
+    // location range when the frontend emitted one, else the first
+    // instruction in the loop that carries a location
+    std::pair<std::string, int> getLoopLocation(Loop *L);
+    // "file:line:function", the key shared by candidates and loop profiles
+    std::string getCandidateId(const std::string &file, int line,
+                               const std::string &function);
+    std::string getVariableName(Value *V);
+    // C spelling of a value computed in L from constants, invariant names,
+    // header PHIs, a[expr] loads, casts, arithmetic and comparisons; empty
+    // if some part has no source spelling
+    std::string getSourceExpression(Value *V, Loop *L);
     std::string generateParallelPatch(Loop *L);
     std::string generateReductionPatch(Loop *L);
 
+    // Induction and reduction analysis
+    std::vector<InductionInfo> findInductions(Loop *L, ScalarEvolution &SE);
+    bool hasLoopIndex(Loop *L, ScalarEvolution &SE);
+    // Name and bounds of L's unit-step integer induction as C expressions;
+    // index is updated when the induction has a name, lower and upper only
+    // when both bounds have a spelling (the return value)
+    bool getLoopBounds(Loop *L, ScalarEvolution &SE, std::string &index,
+                       std::string &lower, std::string &upper);
+    bool hasOnlyInductionPHIs(Loop *L, ScalarEvolution &SE);
+    std::vector<ReductionInfo> findReductions(Loop *L);
+
     // Enhanced pattern detection functions
-    bool hasAdvancedReductionPattern(Loop *L);
-    bool isVectorizableLoop(Loop *L);
-    bool isEmbarrassinglyParallel(Loop *L);
+    bool hasAdvancedReductionPattern(Loop *L, ScalarEvolution &SE);
+    bool isVectorizableLoop(Loop *L, ScalarEvolution &SE);
+    bool isEmbarrassinglyParallel(Loop *L, ScalarEvolution &SE);
     bool isMatrixMultiplication(Loop *OuterLoop, Loop *MiddleLoop, Loop *InnerLoop);
     bool isStencilPattern(Loop *L);
-    bool isMapOperation(Loop *L);
-    bool isFilterPattern(Loop *L);
-    bool isPrefixSumPattern(Loop *L);
+    bool isMapOperation(Loop *L, ScalarEvolution &SE);
+    bool isFilterPattern(Loop *L, ScalarEvolution &SE);
+    bool findFilter(Loop *L, ScalarEvolution &SE, FilterInfo &Info);
+    bool isPrefixSumPattern(Loop *L, ScalarEvolution &SE);
+    bool findScan(Loop *L, ScalarEvolution &SE, ScanInfo &Info);
 
     // Memory access and dependency analysis
     MemoryAccessPattern analyzeMemoryAccess(Loop *L);
@@ -50,6 +127,13 @@ namespace PatternDetection {
     VectorizationOpportunity analyzeVectorization(Loop *L);
 
     // Enhanced patch generation
-    std::string generateOptimalPatch(const std::string& patternType, Loop *L);
+    // prefix_sum needs the recognized scan for its operator and kind
+    std::string generateOptimalPatch(const std::string& patternType, Loop *L,
+                                     const ScanInfo *scan = nullptr);
+    // Input, output and bounds all have a source spelling, so the scan
+    // patch can be a complete loop rather than an advisory note
+    bool isScanPrintable(const ScanInfo &Info);
+    std::string generateScanPatch(const ScanInfo &Info);
+    std::string generateFilterPatch(const FilterInfo &Info);
 
 } // namespace PatternDetection
\ No newline at end of file
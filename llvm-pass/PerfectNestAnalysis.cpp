@@ -0,0 +1,489 @@
+//===-- PerfectNestAnalysis.cpp - Perfect loop nest analysis ---*- C++ -*-===//
+//
+// Collapse depth and interchange legality for perfectly nested loop bands
+//
+//===----------------------------------------------------------------------===//
+
+#include "PerfectNestAnalysis.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "perfect-nest-analysis"
+
+static constexpr unsigned DirLT = Dependence::DVEntry::LT;
+static constexpr unsigned DirEQ = Dependence::DVEntry::EQ;
+static constexpr unsigned DirGT = Dependence::DVEntry::GT;
+static constexpr unsigned DirALL = Dependence::DVEntry::ALL;
+
+/// Loads and stores of \p L; returns false if the loop touches memory in a
+/// way the dependence test cannot see (calls, atomics, volatile accesses).
+static bool collectMemoryAccesses(Loop *L,
+                                  SmallVectorImpl<Instruction *> &Accesses) {
+  for (BasicBlock *BB : L->blocks()) {
+    for (Instruction &I : *BB) {
+      if (isa<DbgInfoIntrinsic>(&I) || I.isLifetimeStartOrEnd())
+        continue;
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        if (!Load->isSimple())
+          return false;
+        Accesses.push_back(Load);
+      } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        if (!Store->isSimple())
+          return false;
+        Accesses.push_back(Store);
+      } else if (I.mayReadOrWriteMemory()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Describe a loop by the source line of its header for the patch text.
+static std::string describeLoop(const Loop *L) {
+  if (DebugLoc Loc = L->getStartLoc())
+    return "line " + std::to_string(Loc.getLine());
+  return "depth " + std::to_string(L->getLoopDepth());
+}
+
+bool PerfectNestAnalyzer::isPerfectModuloSinking(const Loop &Outer,
+                                                 const Loop &Inner) const {
+  if (LoopNest::arePerfectlyNested(Outer, Inner, SE))
+    return true;
+
+  // LICM hoists address arithmetic such as i*n into the outer loop, which
+  // LoopNest reports as intervening code. Pure, speculatable computations
+  // could be sunk back into the inner loop, so the source nest is perfect.
+  LoopNest::InstrVectorTy Intervening =
+      LoopNest::getInterveningInstructions(Outer, Inner, SE);
+  if (Intervening.empty())
+    return false; // Invalid loop structure, e.g. an unexpected guard
+  return all_of(Intervening, [](const Instruction *I) {
+    return !isa<PHINode>(I) && !I->mayReadOrWriteMemory() &&
+           isSafeToSpeculativelyExecute(I);
+  });
+}
+
+bool PerfectNestAnalyzer::startsNest(const Loop &L) const {
+  if (L.getSubLoops().empty())
+    return false;
+  const Loop *Parent = L.getParentLoop();
+  return !Parent || Parent->getSubLoops().size() != 1 ||
+         !isPerfectModuloSinking(*Parent, L);
+}
+
+PerfectNestInfo PerfectNestAnalyzer::analyze(Loop &Root) {
+  PerfectNestInfo Info;
+  LoopNest LN(Root, SE);
+  Info.NestDepth = LN.getNestDepth();
+
+  std::vector<Loop *> Perfect{&Root};
+  for (Loop *Cur = &Root; Cur->getSubLoops().size() == 1;) {
+    Loop *Sub = Cur->getSubLoops().front();
+    if (!isPerfectModuloSinking(*Cur, *Sub))
+      break;
+    Perfect.push_back(Sub);
+    Cur = Sub;
+  }
+  Info.PerfectDepth = Perfect.size();
+
+  Info.RectangularDepth = computeRectangularDepth(Perfect);
+  Info.AffineDepth = computeAffineDepth(Perfect);
+  // Rectangular bands keep their tiling and interchange advice; triangles
+  // are only parallel as a whole through a non-rectangular collapse
+  unsigned Depth = Info.RectangularDepth;
+  if (Depth < 2 && Info.AffineDepth > Depth) {
+    Depth = Info.AffineDepth;
+    Info.NonRectangular = true;
+  }
+  Info.Band.assign(Perfect.begin(), Perfect.begin() + Depth);
+  if (Info.Band.empty()) {
+    Info.Reason = "Outermost loop has no computable trip count";
+    return Info;
+  }
+
+  if (!collectDirections(Info)) {
+    Info.Reason = "Nest contains calls or accesses that dependence analysis "
+                  "cannot model";
+    return Info;
+  }
+
+  Info.CollapseDepth = computeCollapseDepth(Info);
+  recommendOrder(Info);
+
+  std::ostringstream Reason;
+  Reason << "Perfect nest depth " << Info.PerfectDepth << " of "
+         << Info.NestDepth << ", rectangular band " << Info.RectangularDepth;
+  if (Info.NonRectangular)
+    Reason << ", non-rectangular band " << Info.Band.size();
+  Reason << ", " << Info.CollapseDepth << " dependence-free outer level(s)";
+  if (Info.OrderChanged)
+    Reason << "; interchange gives unit-stride innermost access";
+  else if (!Info.InterchangeLegal && !Info.NonRectangular)
+    Reason << "; unit-stride interchange blocked by dependences";
+  Info.Reason = Reason.str();
+
+  LLVM_DEBUG(dbgs() << "Perfect nest in "
+                    << Root.getHeader()->getParent()->getName() << ": "
+                    << Info.Reason << "\n");
+  return Info;
+}
+
+unsigned PerfectNestAnalyzer::computeRectangularDepth(
+    const std::vector<Loop *> &Band) const {
+  unsigned Depth = 0;
+  for (unsigned K = 0; K < Band.size(); ++K) {
+    Loop *L = Band[K];
+    const SCEV *BTC = SE.getBackedgeTakenCount(L);
+    if (isa<SCEVCouldNotCompute>(BTC))
+      break;
+
+    // Every induction of this level must start at a value fixed before the
+    // band is entered, otherwise the iteration space is not a box.
+    bool HasIV = false;
+    bool Invariant = true;
+    for (PHINode &PN : L->getHeader()->phis()) {
+      auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&PN));
+      if (!AR || AR->getLoop() != L)
+        continue;
+      HasIV = true;
+      for (unsigned J = 0; J < K; ++J)
+        Invariant &= SE.isLoopInvariant(AR->getStart(), Band[J]);
+    }
+    for (unsigned J = 0; J < K; ++J)
+      Invariant &= SE.isLoopInvariant(BTC, Band[J]);
+
+    if (!HasIV || !Invariant)
+      break;
+    ++Depth;
+  }
+  return Depth;
+}
+
+/// True if \p S is invariant in \p Outer or a * iv + b for the induction
+/// of one of them, a constant: the bound form OpenMP accepts in a
+/// non-rectangular loop nest.
+static bool isAffineInOuter(ScalarEvolution &SE, const SCEV *S,
+                            ArrayRef<Loop *> Outer) {
+  if (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (!is_contained(Outer, AR->getLoop()) || !AR->isAffine() ||
+        !isa<SCEVConstant>(AR->getStepRecurrence(SE)))
+      return false;
+    S = AR->getStart();
+  }
+  return all_of(Outer, [&](Loop *L) { return SE.isLoopInvariant(S, L); });
+}
+
+bool llvm::hasAffineBounds(ScalarEvolution &SE, Loop &L,
+                           ArrayRef<Loop *> Outer) {
+  // OpenMP constrains the bounds of the source loop, not the trip count
+  // SCEV derives from them (smax(i + 1, n) - i - 1 for j = i .. n - 1)
+  if (Optional<Loop::LoopBounds> Bounds = L.getBounds(SE)) {
+    Value *Step = Bounds->getStepValue();
+    return Step && isa<ConstantInt>(Step) &&
+           isAffineInOuter(SE, SE.getSCEV(&Bounds->getInitialIVValue()),
+                           Outer) &&
+           isAffineInOuter(SE, SE.getSCEV(&Bounds->getFinalIVValue()), Outer);
+  }
+  const SCEV *BTC = SE.getBackedgeTakenCount(&L);
+  return !isa<SCEVCouldNotCompute>(BTC) && isAffineInOuter(SE, BTC, Outer);
+}
+
+unsigned PerfectNestAnalyzer::computeAffineDepth(
+    const std::vector<Loop *> &Band) const {
+  unsigned Depth = 0;
+  for (unsigned K = 0; K < Band.size(); ++K) {
+    Loop *L = Band[K];
+    const SCEV *BTC = SE.getBackedgeTakenCount(L);
+    if (isa<SCEVCouldNotCompute>(BTC))
+      break;
+    ArrayRef<Loop *> Outer(Band.data(), K);
+    bool HasIV = false;
+    bool Affine = hasAffineBounds(SE, *L, Outer);
+    for (PHINode &PN : L->getHeader()->phis()) {
+      auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&PN));
+      if (!AR || AR->getLoop() != L)
+        continue;
+      HasIV = true;
+      const SCEV *Step = AR->getStepRecurrence(SE);
+      Affine &= isAffineInOuter(SE, AR->getStart(), Outer) &&
+                all_of(Outer, [&](Loop *O) { return SE.isLoopInvariant(Step, O); });
+    }
+    if (!HasIV || !Affine)
+      break;
+    ++Depth;
+  }
+  return Depth;
+}
+
+bool PerfectNestAnalyzer::collectDirections(PerfectNestInfo &Info) {
+  const unsigned BandSize = Info.Band.size();
+  Loop *Root = Info.Band.front();
+
+  const unsigned Outer = Root->getLoopDepth() - 1;
+
+  SmallVector<Instruction *, 16> Accesses;
+  if (!collectMemoryAccesses(Root, Accesses))
+    return false;
+
+  for (unsigned I = 0; I < Accesses.size(); ++I) {
+    for (unsigned J = I; J < Accesses.size(); ++J) {
+      Instruction *Src = Accesses[I];
+      Instruction *Dst = Accesses[J];
+      if (!Src->mayWriteToMemory() && !Dst->mayWriteToMemory())
+        continue;
+
+      std::unique_ptr<Dependence> D = DI.depends(Src, Dst, true);
+      if (!D)
+        continue;
+      if (D->isConfused())
+        return false;
+
+      // DependenceInfo numbers levels from the outermost loop, which encloses
+      // the band when the nest sits inside a time-step loop
+      std::vector<unsigned> Vec(BandSize, DirALL);
+      for (unsigned K = 0; K < BandSize && Outer + K < D->getLevels(); ++K)
+        Vec[K] = D->getDirection(Outer + K + 1);
+
+      // Iterations that differ in a single level are ordered by that level
+      // alone, so a '*' there is just the pair seen from both ends.
+      unsigned NonEqual = 0;
+      for (unsigned Dir : Vec)
+        NonEqual += Dir != DirEQ;
+      if (NonEqual == 1) {
+        for (unsigned &Dir : Vec)
+          if (Dir != DirEQ)
+            Dir = (Dir & DirEQ) | DirLT;
+        Info.Directions.push_back(std::move(Vec));
+        continue;
+      }
+
+      // A leading '>' means the dependence actually runs from Dst to Src;
+      // flip it so every vector is stated in execution order.
+      for (unsigned K = 0; K < BandSize; ++K) {
+        if (Vec[K] == DirEQ)
+          continue;
+        if (Vec[K] == DirGT) {
+          for (unsigned &Dir : Vec) {
+            unsigned Flipped = Dir & DirEQ;
+            if (Dir & DirLT)
+              Flipped |= DirGT;
+            if (Dir & DirGT)
+              Flipped |= DirLT;
+            Dir = Flipped;
+          }
+        }
+        break;
+      }
+      Info.Directions.push_back(std::move(Vec));
+    }
+  }
+
+  // Scalars carried around a band level (reductions, recurrences) are not
+  // memory dependences but still serialize that level.
+  for (unsigned K = 0; K < BandSize; ++K) {
+    Loop *L = Info.Band[K];
+    for (PHINode &PN : L->getHeader()->phis()) {
+      auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(&PN));
+      if (AR && AR->getLoop() == L)
+        continue;
+      std::vector<unsigned> Vec(BandSize, DirALL);
+      for (unsigned J = 0; J < K; ++J)
+        Vec[J] = DirEQ;
+      Vec[K] = DirLT;
+      Info.Directions.push_back(std::move(Vec));
+    }
+  }
+  return true;
+}
+
+unsigned PerfectNestAnalyzer::computeCollapseDepth(
+    const PerfectNestInfo &Info) const {
+  unsigned Depth = 0;
+  for (; Depth < Info.Band.size(); ++Depth) {
+    bool Carried = false;
+    for (const auto &Vec : Info.Directions)
+      Carried |= Vec[Depth] != DirEQ;
+    if (Carried)
+      break;
+  }
+  return Depth;
+}
+
+bool PerfectNestAnalyzer::isLegalOrder(const PerfectNestInfo &Info,
+                                       const std::vector<unsigned> &Order) const {
+  for (const auto &Vec : Info.Directions) {
+    for (unsigned Level : Order) {
+      unsigned Dir = Vec[Level];
+      if (Dir == DirEQ)
+        continue;
+      if (Dir & DirGT)
+        return false;
+      if (Dir == DirLT)
+        break;
+    }
+  }
+  return true;
+}
+
+Optional<int64_t> llvm::getAccessStride(ScalarEvolution &SE, Value *Ptr,
+                                        const Loop *L) {
+  const SCEV *S = SE.getSCEV(Ptr);
+  while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (AR->getLoop() == L) {
+      if (auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE)))
+        return Step->getAPInt().getSExtValue();
+      return None;
+    }
+    S = AR->getStart();
+  }
+  if (SE.isLoopInvariant(S, L))
+    return 0;
+  return None;
+}
+
+bool llvm::hasNoCarriedDependence(Loop &L, DependenceInfo &DI,
+                                  SmallVectorImpl<Instruction *> *Accesses) {
+  SmallVector<Instruction *, 16> Local;
+  if (!collectMemoryAccesses(&L, Local))
+    return false;
+
+  const unsigned Level = L.getLoopDepth();
+  for (unsigned I = 0; I < Local.size(); ++I) {
+    for (unsigned J = I; J < Local.size(); ++J) {
+      if (!Local[I]->mayWriteToMemory() && !Local[J]->mayWriteToMemory())
+        continue;
+      std::unique_ptr<Dependence> D = DI.depends(Local[I], Local[J], true);
+      if (!D)
+        continue;
+      if (D->isConfused())
+        return false;
+      if (Level <= D->getLevels() && D->getDirection(Level) != DirEQ)
+        return false;
+    }
+  }
+  if (Accesses)
+    Accesses->append(Local.begin(), Local.end());
+  return true;
+}
+
+void PerfectNestAnalyzer::recommendOrder(PerfectNestInfo &Info) {
+  const unsigned BandSize = Info.Band.size();
+  Info.RecommendedOrder.resize(BandSize);
+  for (unsigned K = 0; K < BandSize; ++K)
+    Info.RecommendedOrder[K] = K;
+  Info.InterchangeLegal = true;
+  Info.UnitStrideAccesses.assign(BandSize, 0);
+  if (BandSize < 2)
+    return;
+  // Interchanging a triangle needs new bounds for both loops
+  if (Info.NonRectangular) {
+    Info.InterchangeLegal = false;
+    return;
+  }
+
+  const DataLayout &DL =
+      Info.Band.front()->getHeader()->getModule()->getDataLayout();
+  std::vector<int> Score(BandSize, 0);
+  for (BasicBlock *BB : Info.Band.back()->blocks()) {
+    for (Instruction &I : *BB) {
+      Value *Ptr = getLoadStorePointerOperand(&I);
+      if (!Ptr)
+        continue;
+      int64_t ElemSize =
+          DL.getTypeStoreSize(getLoadStoreType(&I)).getFixedSize();
+      for (unsigned K = 0; K < BandSize; ++K) {
+        Optional<int64_t> Stride = getAccessStride(SE, Ptr, Info.Band[K]);
+        if (!Stride) {
+          --Score[K];
+        } else if (*Stride == ElemSize || *Stride == -ElemSize) {
+          ++Info.UnitStrideAccesses[K];
+          ++Score[K];
+        } else if (*Stride != 0) {
+          --Score[K];
+        }
+      }
+    }
+  }
+
+  unsigned Best = BandSize - 1;
+  for (unsigned K = 0; K + 1 < BandSize; ++K)
+    if (Score[K] > Score[Best])
+      Best = K;
+  if (Best == BandSize - 1)
+    return;
+
+  std::vector<unsigned> Order;
+  for (unsigned K = 0; K < BandSize; ++K)
+    if (K != Best)
+      Order.push_back(K);
+  Order.push_back(Best);
+
+  if (!isLegalOrder(Info, Order)) {
+    Info.InterchangeLegal = false;
+    return;
+  }
+  Info.InterchangedCollapseDepth = 0;
+  for (unsigned Level : Order) {
+    bool Carried = false;
+    for (const auto &Vec : Info.Directions)
+      Carried |= Vec[Level] != DirEQ;
+    if (Carried)
+      break;
+    ++Info.InterchangedCollapseDepth;
+  }
+  Info.RecommendedOrder = std::move(Order);
+  Info.OrderChanged = true;
+}
+
+std::string
+PerfectNestAnalyzer::generateNestPatch(const PerfectNestInfo &Info) const {
+  std::ostringstream Patch;
+  if (Info.CollapseDepth == 0) {
+    Patch << "// ⚠️ Outermost loop of the nest carries a dependence - "
+             "no parallel loop\n";
+  } else if (Info.CollapseDepth == 1) {
+    Patch << "// ✅ OpenMP 5.2 parallel for on the outermost loop "
+             "(inner levels carry dependences)\n"
+          << "#pragma omp parallel for\n";
+  } else if (Info.NonRectangular &&
+             Info.CollapseDepth > Info.RectangularDepth) {
+    Patch << "// ✅ OpenMP 5.2 non-rectangular collapse over the "
+          << Info.CollapseDepth << " dependence-free levels (inner bounds are "
+          << "affine in the outer index), so threads get equal shares of "
+             "the triangle\n"
+          << "#pragma omp parallel for collapse(" << Info.CollapseDepth
+          << ")\n";
+  } else {
+    Patch << "// ✅ OpenMP 5.2 collapse over the " << Info.CollapseDepth
+          << " dependence-free levels of the perfect nest\n"
+          << "#pragma omp parallel for collapse(" << Info.CollapseDepth
+          << ")\n";
+  }
+
+  if (Info.OrderChanged) {
+    Patch << "// Interchange for unit-stride innermost access, order:";
+    for (unsigned K : Info.RecommendedOrder)
+      Patch << " [" << describeLoop(Info.Band[K]) << "]";
+    Patch << "\n// After interchange: ";
+    if (Info.InterchangedCollapseDepth > 1)
+      Patch << "#pragma omp parallel for collapse("
+            << Info.InterchangedCollapseDepth << ")\n";
+    else if (Info.InterchangedCollapseDepth == 1)
+      Patch << "#pragma omp parallel for\n";
+    else
+      Patch << "outermost loop is sequential\n";
+  } else if (!Info.InterchangeLegal && !Info.NonRectangular) {
+    Patch << "// Unit-stride loop order is illegal: dependences forbid "
+             "interchange\n";
+  }
+  return Patch.str();
+}
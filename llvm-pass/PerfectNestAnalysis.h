@@ -0,0 +1,124 @@
+//===-- PerfectNestAnalysis.h - Perfect loop nest analysis -----*- C++ -*-===//
+//
+// Finds the maximal perfectly nested, rectangular, dependence-free band of a
+// loop nest, computes the exact OpenMP collapse depth and checks whether the
+// band can be interchanged to make the innermost access unit stride. Nests
+// without two rectangular levels (triangles) fall back to the band whose
+// bounds are affine in the enclosing indices, which OpenMP 5.x collapses as
+// a non-rectangular loop nest.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PERFECTNESTANALYSIS_H
+#define LLVM_PERFECTNESTANALYSIS_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopNestAnalysis.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// Result of analyzing one loop nest.
+struct PerfectNestInfo {
+  unsigned NestDepth = 0;       // Depth of the deepest loop in the nest
+  unsigned PerfectDepth = 0;    // Perfectly nested levels from the root
+  unsigned RectangularDepth = 0; // Perfect levels whose bounds are invariant
+  unsigned AffineDepth = 0;     // ... or affine in one enclosing index
+  unsigned CollapseDepth = 0;   // Outermost levels carrying no dependence
+
+  /// Loops of the perfect, rectangular band, outermost first. With fewer
+  /// than two rectangular levels, the affine band (NonRectangular).
+  std::vector<Loop *> Band;
+  bool NonRectangular = false;
+
+  /// Direction vectors (restricted to the band) of every dependence found
+  /// between memory accesses of the band. Each entry is a bitmask of
+  /// Dependence::DVEntry::LT/EQ/GT.
+  std::vector<std::vector<unsigned>> Directions;
+
+  /// Recommended loop order as indices into Band (outermost first), and
+  /// whether it differs from the source order.
+  std::vector<unsigned> RecommendedOrder;
+  bool InterchangeLegal = false;
+  bool OrderChanged = false;
+  unsigned InterchangedCollapseDepth = 0; // Collapse depth in that order
+
+  /// Accesses with a unit stride with respect to each band level.
+  std::vector<unsigned> UnitStrideAccesses;
+
+  std::string Reason;
+};
+
+/// Perfect-nest analysis on top of LLVM's LoopNest and DependenceInfo.
+class PerfectNestAnalyzer {
+public:
+  PerfectNestAnalyzer(ScalarEvolution &SE, DependenceInfo &DI)
+    : SE(SE), DI(DI) {}
+
+  /// Analyze the nest rooted at \p Root.
+  PerfectNestInfo analyze(Loop &Root);
+
+  /// True if \p L has sub-loops and is not perfectly nested in its parent,
+  /// so that no enclosing nest's band reaches it (e.g. the space loops of a
+  /// time-step loop).
+  bool startsNest(const Loop &L) const;
+
+  /// Check whether permuting the band by \p Order keeps every dependence
+  /// lexicographically positive.
+  bool isLegalOrder(const PerfectNestInfo &Info,
+                    const std::vector<unsigned> &Order) const;
+
+  /// Generate the collapse pragma and interchange advice for \p Info.
+  std::string generateNestPatch(const PerfectNestInfo &Info) const;
+
+private:
+  ScalarEvolution &SE;
+  DependenceInfo &DI;
+
+  /// True if \p Inner is perfectly nested in \p Outer, allowing hoisted
+  /// pure computations (address arithmetic) between the two loops.
+  bool isPerfectModuloSinking(const Loop &Outer, const Loop &Inner) const;
+
+  /// Trim the perfect band to the levels whose bounds do not depend on any
+  /// enclosing band induction variable.
+  unsigned computeRectangularDepth(const std::vector<Loop *> &Band) const;
+
+  /// Trim the perfect band to the levels whose bounds are invariant or of
+  /// the OpenMP non-rectangular form a * outer-index + b.
+  unsigned computeAffineDepth(const std::vector<Loop *> &Band) const;
+
+  /// Collect dependence direction vectors between band memory accesses.
+  /// Returns false if some access cannot be analyzed at all.
+  bool collectDirections(PerfectNestInfo &Info);
+
+  /// Number of outermost band levels that carry no dependence.
+  unsigned computeCollapseDepth(const PerfectNestInfo &Info) const;
+
+  /// Choose the band order whose innermost loop gives the most unit-stride
+  /// accesses, falling back to the source order when that is illegal.
+  void recommendOrder(PerfectNestInfo &Info);
+};
+
+/// Stride in bytes of \p Ptr with respect to \p L (0 when invariant), or
+/// None when the address is not affine in \p L.
+Optional<int64_t> getAccessStride(ScalarEvolution &SE, Value *Ptr,
+                                  const Loop *L);
+
+/// True if the bounds of \p L are invariant in \p Outer or of the OpenMP
+/// non-rectangular form a * index + b for one of them, with a constant step.
+bool hasAffineBounds(ScalarEvolution &SE, Loop &L, ArrayRef<Loop *> Outer);
+
+/// True if DependenceInfo proves that no dependence between the loads and
+/// stores of \p L is carried by \p L. False when some pair cannot be
+/// analyzed or \p L touches memory through calls, atomics or volatiles.
+/// The accesses examined are appended to \p Accesses when given.
+bool hasNoCarriedDependence(Loop &L, DependenceInfo &DI,
+                            SmallVectorImpl<Instruction *> *Accesses = nullptr);
+
+} // namespace llvm
+
+#endif // LLVM_PERFECTNESTANALYSIS_H
@@ -0,0 +1,595 @@
+//===-- PipelineAnalysis.cpp - Producer/consumer loop pipelines -*- C++ -*-===//
+//
+// Stages are matched on the address recurrences of their outermost loop:
+// a producer store {P + c * S, +, S} and a consumer load {P + d * S, +, S}
+// (inner loops widening either by their constant extent) put element i of
+// the consumer at offsets d - c of the producer's index.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PipelineAnalysis.h"
+#include "PatternDetect.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "pipeline-analysis"
+
+// Blocks smaller than this spend more time in the task runtime than in the
+// stages
+static constexpr unsigned MinBlock = 1024;
+static constexpr unsigned MaxBlock = 1u << 16;
+
+static unsigned floorPowerOf2(uint64_t X) {
+  unsigned P = 1;
+  while (P * 2 <= X && P * 2 <= MaxBlock)
+    P *= 2;
+  return P;
+}
+
+static int64_t floorDiv(int64_t A, int64_t B) {
+  return A / B - (A % B != 0 && (A < 0) != (B < 0));
+}
+
+/// One load or store of a stage, relative to the stage's index.
+struct PipelineAnalyzer::Access {
+  Instruction *I = nullptr;
+  bool Write = false;
+  Value *Base = nullptr;     // Pointer the address is derived from
+  const SCEV *Key = nullptr; // Base, or where Base was loaded from
+  bool Loaded = false;
+  bool Affine = false;       // Lo/Hi are exact
+  bool Invariant = false;    // Same address for every element
+  int64_t Stride = 0;        // Bytes per element of the index
+  int64_t Lo = 0, Hi = 0;    // Elements i + Lo .. i + Hi
+  std::string Name;
+
+  bool sameObject(const Access &Other) const {
+    return Key && Key == Other.Key && Loaded == Other.Loaded;
+  }
+};
+
+struct PipelineAnalyzer::StageAccesses {
+  std::vector<Access> List;
+};
+
+uint64_t PipelineAnalyzer::estimateCost(Loop *L) {
+  uint64_t Cost = 0;
+  for (BasicBlock *BB : L->blocks()) {
+    uint64_t Trips = 1;
+    for (Loop *Inner = LI.getLoopFor(BB); Inner && Inner != L;
+         Inner = Inner->getParentLoop()) {
+      unsigned TC = SE.getSmallConstantTripCount(Inner);
+      Trips *= TC ? TC : DefaultInnerTrip;
+    }
+    uint64_t Insts = 0;
+    for (Instruction &I : *BB) {
+      if (isa<DbgInfoIntrinsic>(I) || isa<PHINode>(I))
+        continue;
+      auto *Call = dyn_cast<CallBase>(&I);
+      Insts += Call && !isa<IntrinsicInst>(Call) ? 20 : 1;
+    }
+    Cost += Insts * Trips;
+  }
+  return Cost;
+}
+
+bool PipelineAnalyzer::analyzeStage(Loop *L, PipelineStage &Stage,
+                                    StageAccesses &Accesses) {
+  Stage.L = L;
+  Stage.Line = PatternDetection::getLoopLocation(L).second;
+
+  // The stage is indexed by a unit-step induction with source bounds
+  PHINode *IV = nullptr;
+  SmallPtrSet<PHINode *, 4> Inductions;
+  for (const auto &Ind : PatternDetection::findInductions(L, SE)) {
+    Inductions.insert(Ind.phi);
+    if (!IV && Ind.kind == "integer" && Ind.constantStep == 1)
+      IV = Ind.phi;
+  }
+  if (!IV || !PatternDetection::getLoopBounds(L, SE, Stage.Index, Stage.Lower,
+                                              Stage.Upper))
+    return false;
+  if (Stage.Index.empty())
+    Stage.Index = "i";
+  const SCEV *IVStart = cast<SCEVAddRecExpr>(SE.getSCEV(IV))->getStart();
+
+  for (PHINode &Phi : L->getHeader()->phis()) {
+    if (Inductions.count(&Phi))
+      continue;
+    Stage.Sequential = true;
+    if (Stage.Carried.empty()) {
+      std::string Name = PatternDetection::getVariableName(&Phi);
+      Stage.Carried = Name.empty() ? "a running value" : Name;
+    }
+  }
+
+  const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+  for (BasicBlock *BB : L->blocks()) {
+    for (Instruction &I : *BB) {
+      if (auto *Call = dyn_cast<CallBase>(&I)) {
+        if (isa<DbgInfoIntrinsic>(Call) || Call->doesNotAccessMemory())
+          continue;
+        if (auto *II = dyn_cast<IntrinsicInst>(Call))
+          if (II->isLifetimeStartOrEnd() ||
+              II->getIntrinsicID() == Intrinsic::assume)
+            continue;
+        // Calls that may touch memory hide the ranges a stage reads or writes
+        return false;
+      }
+      if (!isa<LoadInst>(I) && !isa<StoreInst>(I)) {
+        if (I.mayReadOrWriteMemory())
+          return false;
+        continue;
+      }
+      if (auto *Load = dyn_cast<LoadInst>(&I); Load && !Load->isSimple())
+        return false;
+      if (auto *Store = dyn_cast<StoreInst>(&I); Store && !Store->isSimple())
+        return false;
+      Value *Ptr = getLoadStorePointerOperand(&I);
+      Type *Ty = getLoadStoreType(&I);
+      // Storing pointers may redirect the arrays other stages reach
+      if (isa<StoreInst>(I) && Ty->isPointerTy())
+        return false;
+
+      Access A;
+      A.I = &I;
+      A.Write = isa<StoreInst>(I);
+      int64_t ElemSize = DL.getTypeStoreSize(Ty);
+      Stage.Bytes += ElemSize;
+      const SCEV *Address = SE.getSCEV(Ptr);
+      if (auto *Base = dyn_cast<SCEVUnknown>(SE.getPointerBase(Address))) {
+        A.Base = Base->getValue();
+        if (auto *Load = dyn_cast<LoadInst>(A.Base)) {
+          A.Key = SE.getSCEV(Load->getPointerOperand());
+          A.Loaded = true;
+        } else {
+          A.Key = Base;
+        }
+        A.Name = PatternDetection::getVariableName(A.Base);
+        if (A.Name.empty() && A.Loaded)
+          A.Name = PatternDetection::getVariableName(
+              cast<LoadInst>(A.Base)->getPointerOperand());
+      }
+      if (A.Name.empty())
+        A.Name = "array";
+
+      // Widen by the extent of inner loops, then peel the stage's recurrence
+      int64_t InnerLo = 0, InnerHi = 0;
+      bool Known = A.Key != nullptr;
+      while (Known) {
+        auto *AR = dyn_cast<SCEVAddRecExpr>(Address);
+        if (!AR || AR->getLoop() == L)
+          break;
+        auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        unsigned TC = SE.getSmallConstantTripCount(AR->getLoop());
+        if (!AR->isAffine() || !L->contains(AR->getLoop()) || !Step || !TC) {
+          Known = false;
+          break;
+        }
+        int64_t Span = Step->getAPInt().getSExtValue() * int64_t(TC - 1);
+        (Span < 0 ? InnerLo : InnerHi) += Span;
+        Address = AR->getStart();
+      }
+      auto *AR = dyn_cast<SCEVAddRecExpr>(Address);
+      if (Known && AR && AR->getLoop() == L && AR->isAffine()) {
+        auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        const SCEV *Start = AR->getStart();
+        if (Step && Step->getAPInt().isStrictlyPositive() &&
+            SE.isLoopInvariant(Start, L)) {
+          A.Stride = Step->getAPInt().getSExtValue();
+          // Bytes from the base at the first index, minus that index
+          const SCEV *Offset = SE.getMinusSCEV(
+              SE.getMinusSCEV(Start, SE.getPointerBase(Start)),
+              SE.getMulExpr(SE.getNoopOrSignExtend(IVStart, Step->getType()),
+                            Step));
+          if (auto *C = dyn_cast<SCEVConstant>(Offset)) {
+            int64_t Bytes = C->getAPInt().getSExtValue();
+            A.Lo = floorDiv(Bytes + InnerLo, A.Stride);
+            A.Hi = floorDiv(Bytes + InnerHi + ElemSize - 1, A.Stride);
+            A.Affine = true;
+          }
+        }
+      } else if (Known && SE.isLoopInvariant(Address, L)) {
+        A.Invariant = true;
+      }
+      Accesses.List.push_back(A);
+    }
+  }
+
+  // State carried through memory: scattered or fixed-address updates, or
+  // reading elements of an array the stage writes other than its own
+  for (const Access &W : Accesses.List) {
+    if (!W.Write)
+      continue;
+    bool Carries = !W.Affine;
+    for (const Access &R : Accesses.List) {
+      if (R.Write || !R.sameObject(W))
+        continue;
+      if (!R.Affine || !W.Affine || R.Stride != W.Stride || R.Lo != W.Lo ||
+          R.Hi != W.Hi || W.Lo != W.Hi)
+        Carries = true;
+    }
+    if (Carries) {
+      Stage.Sequential = true;
+      if (Stage.Carried.empty())
+        Stage.Carried = W.Name;
+    }
+    if (find(Stage.Writes, W.Name) == Stage.Writes.end())
+      Stage.Writes.push_back(W.Name);
+  }
+  Stage.Cost = estimateCost(L);
+  return true;
+}
+
+bool PipelineAnalyzer::onlyBookkeepingBetween(Loop *Prev, Loop *Next) {
+  if (!DT.dominates(Prev->getHeader(), Next->getHeader()))
+    return false;
+  // Blocks on a path from Prev's exits to Next's header
+  SmallPtrSet<BasicBlock *, 16> Forward, Between;
+  SmallVector<BasicBlock *, 16> Work;
+  SmallVector<BasicBlock *, 4> Exits;
+  Prev->getExitBlocks(Exits);
+  for (BasicBlock *Exit : Exits)
+    if (Forward.insert(Exit).second)
+      Work.push_back(Exit);
+  while (!Work.empty()) {
+    BasicBlock *BB = Work.pop_back_val();
+    if (BB == Next->getHeader())
+      continue;
+    for (BasicBlock *Succ : successors(BB))
+      if (Forward.insert(Succ).second)
+        Work.push_back(Succ);
+  }
+  Work.push_back(Next->getHeader());
+  while (!Work.empty()) {
+    BasicBlock *BB = Work.pop_back_val();
+    for (BasicBlock *Pred : predecessors(BB))
+      if (Forward.count(Pred) && !Next->contains(Pred) &&
+          Between.insert(Pred).second)
+        Work.push_back(Pred);
+  }
+  for (BasicBlock *BB : Between) {
+    if (LI.getLoopFor(BB))
+      return false;
+    for (Instruction &I : *BB)
+      if (I.mayWriteToMemory() && !isa<DbgInfoIntrinsic>(I))
+        return false;
+  }
+  return true;
+}
+
+bool PipelineAnalyzer::connect(std::vector<PipelineStage> &Chain,
+                               std::vector<StageAccesses> &ChainAccesses,
+                               PipelineStage &Stage,
+                               const StageAccesses &Accesses) {
+  Stage.Inputs.clear();
+  for (unsigned P = 0; P < Chain.size(); ++P) {
+    for (const Access &A : Accesses.List) {
+      for (const Access &B : ChainAccesses[P].List) {
+        if (!A.Write && !B.Write)
+          continue;
+        if (!A.sameObject(B)) {
+          // Arrays loaded from different places are separate containers
+          if (A.Key && B.Key && A.Loaded && B.Loaded)
+            continue;
+          if (A.Base && B.Base &&
+              AA.isNoAlias(MemoryLocation::getBeforeOrAfter(A.Base),
+                           MemoryLocation::getBeforeOrAfter(B.Base)))
+            continue;
+          return false;
+        }
+        // Only element-wise flow from an earlier stage: overwriting what an
+        // earlier stage reads or writes needs the whole stage to finish
+        if (A.Write || !B.Affine || !A.Affine || B.Invariant ||
+            A.Stride != B.Stride)
+          return false;
+        int64_t Min = A.Lo - B.Hi, Max = A.Hi - B.Lo;
+        if (Min < -MaxHalo || Max > MaxHalo)
+          return false;
+        auto Edge = find_if(Stage.Inputs, [&](const PipelineEdge &E) {
+          return E.Producer == P && E.Array == B.Name;
+        });
+        if (Edge == Stage.Inputs.end()) {
+          Stage.Inputs.push_back({P, Min, Max, B.Name});
+        } else {
+          Edge->MinOffset = std::min(Edge->MinOffset, Min);
+          Edge->MaxOffset = std::max(Edge->MaxOffset, Max);
+        }
+      }
+    }
+  }
+  return !Stage.Inputs.empty();
+}
+
+void PipelineAnalyzer::plan(PipelineInfo &Info) {
+  bool AllParallel = true, Aligned = true, Ahead = false;
+  uint64_t Work = 0, SequentialCost = 0, Bytes = 0;
+  int64_t Halo = 0;
+  for (unsigned S = 0; S < Info.Stages.size(); ++S) {
+    PipelineStage &Stage = Info.Stages[S];
+    for (const PipelineEdge &E : Stage.Inputs) {
+      Stage.Lag = std::max(Stage.Lag, Info.Stages[E.Producer].Lag +
+                                          (E.MaxOffset > 0 ? 1 : 0));
+      Aligned &= E.MinOffset == 0 && E.MaxOffset == 0;
+      Ahead |= E.MaxOffset > 0;
+      Halo = std::max({Halo, -E.MinOffset, E.MaxOffset});
+    }
+    AllParallel &= !Stage.Sequential;
+    Work += Stage.Cost;
+    Bytes += Stage.Bytes;
+    if (Stage.Sequential)
+      SequentialCost = std::max(SequentialCost, Stage.Cost);
+  }
+  // Parallel stages share the threads; a sequential one runs on one
+  auto Time = [&](const PipelineStage &Stage) {
+    return Stage.Sequential ? double(Stage.Cost) : double(Stage.Cost) / Threads;
+  };
+  for (unsigned S = 1; S < Info.Stages.size(); ++S)
+    if (Time(Info.Stages[S]) >= Time(Info.Stages[Info.Bottleneck]))
+      Info.Bottleneck = S;
+  double Slowest = std::max(double(SequentialCost), double(Work) / Threads);
+  Info.SpeedupBound = Slowest > 0 ? Work / Slowest : 1;
+
+  std::ostringstream Reason;
+  Reason << Info.Stages.size() << " consecutive loops form a producer/consumer "
+         << "chain";
+  if (AllParallel && Aligned) {
+    Info.Strategy = "fusion";
+    Info.Parallel = true;
+    Reason << " where each stage reads only element "
+           << Info.Stages.front().Index
+           << " of the arrays earlier stages write: fused into one parallel "
+           << "loop, the intermediates stay in registers or L1 instead of "
+           << "streaming through memory once per stage";
+    Info.Reason = Reason.str();
+    return;
+  }
+  if (!Ahead && Info.SpeedupBound < MinPipelineSpeedup) {
+    // Every element a stage reads is computed by the time the fused loop
+    // reaches it; sequential stages keep their order
+    Info.Strategy = "fusion";
+    Reason << " that reads no element ahead, and overlapping the stages "
+           << "gains at most " << std::fixed << std::setprecision(1)
+           << Info.SpeedupBound << "x: fused into one loop, the "
+           << "intermediates stay in cache instead of streaming through "
+           << "memory once per stage";
+    Info.Reason = Reason.str();
+    return;
+  }
+
+  // Blocks of every stage's arrays fit in half of L2 together, and span
+  // the halo so a block depends only on its neighbours
+  Info.Strategy = "pipeline";
+  Info.BlockSize = floorPowerOf2(Cache.L2Size / 2 / std::max<uint64_t>(Bytes, 1));
+  Info.BlockSize = std::max<unsigned>({Info.BlockSize, MinBlock,
+                                       unsigned(2 * Halo)});
+  // Stage S waits for stage S + 1's block b - W, created before its own
+  unsigned MaxLag = 0;
+  for (const PipelineStage &Stage : Info.Stages)
+    MaxLag = std::max(MaxLag, Stage.Lag);
+  Info.Window = std::max({2u, Threads, MaxLag + 1});
+  for (const PipelineStage &Stage : Info.Stages) {
+    if (Stage.Sequential) {
+      Reason << "; the loop at line " << Stage.Line << " carries "
+             << Stage.Carried;
+      break;
+    }
+  }
+  if (AllParallel)
+    Reason << "; stages read neighbouring elements (halo " << Halo << ")";
+  Reason << ": run as a pipeline of " << Info.BlockSize
+         << "-element blocks, one task per stage and block, with at most "
+         << Info.Window << " blocks in flight per stage (speedup bound "
+         << std::fixed << std::setprecision(1) << Info.SpeedupBound << ")";
+  Info.Reason = Reason.str();
+}
+
+std::vector<PipelineInfo> PipelineAnalyzer::analyze(Function &F) {
+  std::vector<PipelineInfo> Pipelines;
+  if (F.isDeclaration())
+    return Pipelines;
+
+  // Top-level loops in execution order
+  DenseMap<const BasicBlock *, unsigned> Order;
+  for (BasicBlock *BB : ReversePostOrderTraversal<Function *>(&F))
+    Order[BB] = Order.size();
+  std::vector<Loop *> Loops(LI.begin(), LI.end());
+  sort(Loops, [&](Loop *X, Loop *Y) {
+    return Order.lookup(X->getHeader()) < Order.lookup(Y->getHeader());
+  });
+
+  std::vector<PipelineStage> Chain;
+  std::vector<StageAccesses> ChainAccesses;
+  auto Flush = [&]() {
+    if (Chain.size() >= 2) {
+      PipelineInfo Info;
+      Info.Stages = Chain;
+      Info.File = PatternDetection::getLoopLocation(Chain.front().L).first;
+      plan(Info);
+      LLVM_DEBUG(dbgs() << "Pipeline in " << F.getName() << ": "
+                        << Info.Reason << "\n");
+      Pipelines.push_back(std::move(Info));
+    }
+    Chain.clear();
+    ChainAccesses.clear();
+  };
+
+  for (Loop *L : Loops) {
+    PipelineStage Stage;
+    StageAccesses Accesses;
+    bool Valid = analyzeStage(L, Stage, Accesses);
+    bool Joins = Valid && !Chain.empty() &&
+                 onlyBookkeepingBetween(Chain.back().L, L) &&
+                 connect(Chain, ChainAccesses, Stage, Accesses);
+    if (!Joins) {
+      Flush();
+      Stage.Inputs.clear();
+    }
+    if (Valid) {
+      Chain.push_back(std::move(Stage));
+      ChainAccesses.push_back(std::move(Accesses));
+    }
+  }
+  Flush();
+  return Pipelines;
+}
+
+static std::string describeStage(const PipelineInfo &Info, unsigned S) {
+  const PipelineStage &Stage = Info.Stages[S];
+  std::ostringstream Text;
+  Text << "Stage " << S << " (line " << Stage.Line << "): ";
+  if (Stage.Sequential)
+    Text << "sequential, carries " << Stage.Carried;
+  else
+    Text << "parallel";
+  Text << ", ~" << Stage.Cost << " instructions per element";
+  for (const PipelineEdge &E : Stage.Inputs) {
+    Text << "; reads " << E.Array << " of stage " << E.Producer << " at "
+         << Stage.Index;
+    auto Offset = [&](int64_t K) {
+      return K == 0 ? std::string() : (K > 0 ? "+" : "") + std::to_string(K);
+    };
+    Text << Offset(E.MinOffset);
+    if (E.MaxOffset != E.MinOffset)
+      Text << ".." << Stage.Index << Offset(E.MaxOffset);
+  }
+  return Text.str();
+}
+
+std::string PipelineAnalyzer::generatePatch(const PipelineInfo &Info) {
+  std::ostringstream Code;
+  const unsigned N = Info.Stages.size();
+  const std::string &I = Info.Stages.front().Index;
+  auto Body = [](const PipelineStage &Stage) {
+    return "/* body of the loop at line " + std::to_string(Stage.Line) + " */";
+  };
+
+  if (Info.Strategy == "fusion") {
+    Code << "// ✅ Loop fusion: " << Info.Reason << "\n";
+    for (unsigned S = 0; S < N; ++S)
+      Code << "// " << describeStage(Info, S) << "\n";
+    if (!Info.Parallel)
+      Code << "// Run the stages in this order for each " << I
+           << "; keep what a sequential stage carries outside the loop.\n";
+    Code << "#include <algorithm>\n";
+    for (unsigned S = 0; S < N; ++S)
+      Code << "const long lo" << S << " = " << Info.Stages[S].Lower << ", hi"
+           << S << " = " << Info.Stages[S].Upper << ";\n";
+    Code << "const long LO = std::min({";
+    for (unsigned S = 0; S < N; ++S)
+      Code << (S ? ", " : "") << "lo" << S;
+    Code << "}), HI = std::max({";
+    for (unsigned S = 0; S < N; ++S)
+      Code << (S ? ", " : "") << "hi" << S;
+    Code << "});\n";
+    if (Info.Parallel)
+      Code << "#pragma omp parallel for schedule(static)\n";
+    Code << "for (long " << I << " = LO; " << I << " < HI; ++" << I
+         << ") {\n";
+    for (unsigned S = 0; S < N; ++S) {
+      const PipelineStage &Stage = Info.Stages[S];
+      Code << "    if (" << I << " >= lo" << S << " && " << I << " < hi" << S
+           << ") {";
+      if (Stage.Index != I)
+        Code << " const long " << Stage.Index << " = " << I << ";";
+      Code << " " << Body(Stage) << " }\n";
+    }
+    Code << "}\n";
+    return Code.str();
+  }
+
+  unsigned MaxLag = 0;
+  for (const PipelineStage &Stage : Info.Stages)
+    MaxLag = std::max(MaxLag, Stage.Lag);
+  Code << "// ✅ Blocked pipeline: " << Info.Reason << "\n";
+  for (unsigned S = 0; S < N; ++S)
+    Code << "// " << describeStage(Info, S) << "\n";
+  Code << "// Bottleneck: stage " << Info.Bottleneck
+       << "; a stage runs block b once the blocks it reads are done, a "
+          "sequential\n"
+       << "// stage also after its own block b - 1, and every stage waits "
+          "for the next one to\n"
+       << "// finish block b - W, so the arrays between stages could "
+          "shrink to rings of W * B elements.\n";
+  if (any_of(Info.Stages, [](const PipelineStage &S) { return S.Sequential; }))
+    Code << "// Declare what a sequential stage carries before the parallel "
+            "region; inside a block,\n"
+         << "// copy it to a local and store it back at the end.\n";
+  Code << "#include <algorithm>\n#include <vector>\n";
+  for (unsigned S = 0; S < N; ++S)
+    Code << "const long lo" << S << " = " << Info.Stages[S].Lower << ", hi"
+         << S << " = " << Info.Stages[S].Upper << ";\n";
+  Code << "const long LO = std::min({";
+  for (unsigned S = 0; S < N; ++S)
+    Code << (S ? ", " : "") << "lo" << S;
+  Code << "}), HI = std::max({";
+  for (unsigned S = 0; S < N; ++S)
+    Code << (S ? ", " : "") << "hi" << S;
+  Code << "});\n"
+       << "const long B = " << Info.BlockSize << ", W = " << Info.Window
+       << ", NB = std::max(0L, (HI - LO + B - 1) / B);\n"
+       << "// One token per stage and block, padded so b - W and b + 1 stay "
+          "in range\n"
+       << "std::vector<char> done(" << N << " * (NB + W + 1));\n";
+  for (unsigned S = 0; S < N; ++S)
+    Code << "char *d" << S << " = done.data() + " << S
+         << " * (NB + W + 1) + W;\n";
+  Code << "#pragma omp parallel\n"
+       << "#pragma omp single\n"
+       << "for (long t = 0; t < NB";
+  if (MaxLag)
+    Code << " + " << MaxLag;
+  Code << "; ++t) {\n";
+  for (unsigned S = 0; S < N; ++S) {
+    const PipelineStage &Stage = Info.Stages[S];
+    std::vector<std::string> In;
+    auto Add = [&In](std::string Token) {
+      if (find(In, Token) == In.end())
+        In.push_back(std::move(Token));
+    };
+    for (const PipelineEdge &E : Stage.Inputs) {
+      std::string D = "d" + std::to_string(E.Producer);
+      if (E.MinOffset < 0)
+        Add(D + "[b - 1]");
+      Add(D + "[b]");
+      if (E.MaxOffset > 0)
+        Add(D + "[b + 1]");
+    }
+    if (Stage.Sequential)
+      Add("d" + std::to_string(S) + "[b - 1]");
+    if (S + 1 < N)
+      Add("d" + std::to_string(S + 1) + "[b - W]");
+
+    Code << "    if (const long b = t";
+    if (Stage.Lag)
+      Code << " - " << Stage.Lag;
+    Code << "; b >= 0 && b < NB) {\n"
+         << "        const long lo = LO + b * B, hi = std::min(lo + B, HI);\n"
+         << "        #pragma omp task firstprivate(lo, hi) depend(out: d" << S
+         << "[b])";
+    if (!In.empty()) {
+      Code << " depend(in: ";
+      for (unsigned K = 0; K < In.size(); ++K)
+        Code << (K ? ", " : "") << In[K];
+      Code << ")";
+    }
+    Code << "\n"
+         << "        for (long " << Stage.Index << " = std::max(lo, lo" << S
+         << "); " << Stage.Index << " < std::min(hi, hi" << S << "); ++"
+         << Stage.Index << ") {\n"
+         << "            " << Body(Stage) << "\n"
+         << "        }\n"
+         << "    }\n";
+  }
+  Code << "}\n";
+  return Code.str();
+}
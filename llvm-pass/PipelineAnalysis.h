@@ -0,0 +1,107 @@
+//===-- PipelineAnalysis.h - Producer/consumer loop pipelines ---*- C++ -*-===//
+//
+// Finds runs of consecutive top-level loops where each loop consumes, element
+// by element, arrays that an earlier loop of the run produced (derivative ->
+// square -> moving window -> threshold). The constant offsets between the
+// producer's writes and the consumer's reads give the halo each stage needs;
+// stages without loop-carried state are fused into one parallel loop when
+// every halo is empty, the others run as a blocked pipeline of OpenMP tasks
+// ordered by depend clauses, unless too little of the chain can overlap to
+// pay for them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PIPELINEANALYSIS_H
+#define LLVM_PIPELINEANALYSIS_H
+
+#include "TilingAdvisor.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// A stage reads, at index i, elements [i + MinOffset, i + MaxOffset] of an
+/// array that stage Producer wrote.
+struct PipelineEdge {
+  unsigned Producer = 0;
+  int64_t MinOffset = 0, MaxOffset = 0;
+  std::string Array;
+};
+
+/// One top-level loop of a pipeline.
+struct PipelineStage {
+  Loop *L = nullptr;
+  unsigned Line = 0;
+  std::string Index, Lower, Upper; // Source spellings of the loop bounds
+  uint64_t Cost = 0;               // Estimated instructions per element
+  uint64_t Bytes = 0;              // Bytes read and written per element
+  bool Sequential = false;         // Carries state from one element to the next
+  std::string Carried;             // What it carries
+  std::vector<PipelineEdge> Inputs;
+  std::vector<std::string> Writes;
+  unsigned Lag = 0;                // Blocks behind the first stage
+};
+
+struct PipelineInfo {
+  std::vector<PipelineStage> Stages; // In program order
+  std::string File;
+  /// "fusion": one parallel loop running every stage for element i;
+  /// "pipeline": blocks of BlockSize elements, one task per stage and block.
+  std::string Strategy;
+  bool Parallel = false;   // Fusion: every element is independent
+  unsigned BlockSize = 0;
+  unsigned Window = 0;     // Blocks in flight per stage
+  unsigned Bottleneck = 0; // Stage that bounds the throughput
+  double SpeedupBound = 1; // Work over the costliest sequential stage
+  std::string Reason;
+};
+
+class PipelineAnalyzer {
+public:
+  PipelineAnalyzer(ScalarEvolution &SE, AAResults &AA, DominatorTree &DT,
+                   LoopInfo &LI, const CacheModel &Cache, unsigned Threads)
+    : SE(SE), AA(AA), DT(DT), LI(LI), Cache(Cache),
+      Threads(Threads ? Threads : 1) {}
+
+  /// Pipelines of two or more stages among the top-level loops of \p F.
+  std::vector<PipelineInfo> analyze(Function &F);
+
+  /// Fused parallel loop, or task pipeline over per-stage block tokens.
+  static std::string generatePatch(const PipelineInfo &Info);
+
+  /// Offsets further than this are not treated as a halo.
+  static constexpr int64_t MaxHalo = 256;
+  /// Inner loops without a constant trip count are assumed to run this many
+  /// iterations per element.
+  static constexpr uint64_t DefaultInnerTrip = 16;
+  /// Below this bound on the speedup a chain that reads no element ahead
+  /// is fused serially rather than pipelined.
+  static constexpr double MinPipelineSpeedup = 1.5;
+
+private:
+  ScalarEvolution &SE;
+  AAResults &AA;
+  DominatorTree &DT;
+  LoopInfo &LI;
+  CacheModel Cache;
+  unsigned Threads;
+
+  struct Access;
+  struct StageAccesses;
+  bool analyzeStage(Loop *L, PipelineStage &Stage, StageAccesses &Accesses);
+  bool connect(std::vector<PipelineStage> &Chain,
+               std::vector<StageAccesses> &ChainAccesses,
+               PipelineStage &Stage, const StageAccesses &Accesses);
+  bool onlyBookkeepingBetween(Loop *Prev, Loop *Next);
+  uint64_t estimateCost(Loop *L);
+  void plan(PipelineInfo &Info);
+};
+
+} // namespace llvm
+
+#endif // LLVM_PIPELINEANALYSIS_H
@@ -0,0 +1,146 @@
+//===-- SCEVSourcePrinter.cpp - Render SCEVs as C expressions --*- C++ -*-===//
+//
+// SCEV to C expression printer used by the patch generators
+//
+//===----------------------------------------------------------------------===//
+
+#include "SCEVSourcePrinter.h"
+#include "PatternDetect.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static bool printSCEV(const SCEV *S, raw_ostream &OS);
+
+/// C type of a min/max operand, so std::max<T> does not deduce conflicting
+/// types from a literal and a long; "" for widths C has no name for.
+static std::string getMinMaxTypeName(Type *Ty, bool Signed) {
+  if (Ty->isPointerTy())
+    return "const char *";
+  if (!Ty->isIntegerTy())
+    return "";
+  std::string Unsigned = Signed ? "" : "unsigned ";
+  switch (Ty->getIntegerBitWidth()) {
+  case 8:
+    return Signed ? "signed char" : "unsigned char";
+  case 16:
+    return Unsigned + "short";
+  case 32:
+    return Signed ? "int" : "unsigned";
+  case 64:
+    return Unsigned + "long";
+  default:
+    return "";
+  }
+}
+
+static bool printOperands(const SCEVNAryExpr *N, StringRef Sep,
+                          raw_ostream &OS) {
+  bool First = true;
+  for (const SCEV *Op : N->operands()) {
+    if (!First)
+      OS << Sep;
+    First = false;
+    bool Nested = isa<SCEVNAryExpr>(Op) && !isa<SCEVMinMaxExpr>(Op);
+    if (Nested)
+      OS << "(";
+    if (!printSCEV(Op, OS))
+      return false;
+    if (Nested)
+      OS << ")";
+  }
+  return true;
+}
+
+static bool printSCEV(const SCEV *S, raw_ostream &OS) {
+  switch (S->getSCEVType()) {
+  case scConstant:
+    OS << cast<SCEVConstant>(S)->getAPInt().getSExtValue();
+    return true;
+  case scUnknown: {
+    Value *V = cast<SCEVUnknown>(S)->getValue();
+    if (auto *C = dyn_cast<ConstantInt>(V)) {
+      OS << C->getSExtValue();
+      return true;
+    }
+    if (auto *CF = dyn_cast<ConstantFP>(V)) {
+      // FP induction starts and steps are wrapped as unknowns
+      SmallString<16> Text;
+      CF->getValueAPF().toString(Text);
+      OS << Text;
+      return true;
+    }
+    std::string Name = PatternDetection::getVariableName(V);
+    if (Name.empty())
+      return false;
+    if (V->getType()->isPointerTy())
+      OS << "(const char *)" << Name;
+    else
+      OS << Name;
+    return true;
+  }
+  case scPtrToInt:
+  case scTruncate:
+    // Neither the wide operand nor a (const char *) address is the value
+    // of a narrowed integer or of a pointer difference
+    return false;
+  case scZeroExtend:
+  case scSignExtend:
+    // Keep the widening so 4 * n cannot overflow a 32-bit n
+    OS << (S->getSCEVType() == scZeroExtend ? "(unsigned long)" : "(long)");
+    return printSCEV(cast<SCEVCastExpr>(S)->getOperand(), OS);
+  case scAddExpr:
+    return printOperands(cast<SCEVNAryExpr>(S), " + ", OS);
+  case scMulExpr:
+    return printOperands(cast<SCEVNAryExpr>(S), " * ", OS);
+  case scUDivExpr: {
+    auto *Div = cast<SCEVUDivExpr>(S);
+    OS << "(";
+    if (!printSCEV(Div->getLHS(), OS))
+      return false;
+    OS << ") / (";
+    if (!printSCEV(Div->getRHS(), OS))
+      return false;
+    OS << ")";
+    return true;
+  }
+  case scSMaxExpr:
+  case scUMaxExpr:
+  case scSMinExpr:
+  case scUMinExpr:
+  case scSequentialUMinExpr: {
+    auto *MinMax = cast<SCEVNAryExpr>(S);
+    bool IsMax = S->getSCEVType() == scSMaxExpr || S->getSCEVType() == scUMaxExpr;
+    bool Signed = S->getSCEVType() == scSMaxExpr || S->getSCEVType() == scSMinExpr;
+    std::string TypeName = getMinMaxTypeName(S->getType(), Signed);
+    if (TypeName.empty())
+      return false;
+    std::string Fn = (IsMax ? "std::max<" : "std::min<") + TypeName + ">(";
+    // Fold left: std::min(a, std::min(b, c))
+    unsigned NumOps = MinMax->getNumOperands();
+    for (unsigned I = 0; I + 1 < NumOps; ++I) {
+      OS << Fn;
+      if (!printSCEV(MinMax->getOperand(I), OS))
+        return false;
+      OS << ", ";
+    }
+    if (!printSCEV(MinMax->getOperand(NumOps - 1), OS))
+      return false;
+    for (unsigned I = 0; I + 1 < NumOps; ++I)
+      OS << ")";
+    return true;
+  }
+  default:
+    // Add recurrences and SCEVCouldNotCompute have no invariant spelling
+    return false;
+  }
+}
+
+std::string llvm::scevToSource(const SCEV *S) {
+  std::string Text;
+  raw_string_ostream OS(Text);
+  if (!printSCEV(S, OS))
+    return "";
+  return OS.str();
+}
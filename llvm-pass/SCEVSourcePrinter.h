@@ -0,0 +1,25 @@
+//===-- SCEVSourcePrinter.h - Render SCEVs as C expressions ----*- C++ -*-===//
+//
+// Turns loop-invariant SCEV expressions (bounds, pointer ranges, strides)
+// into C/C++ source text using the debug names of the values involved, so
+// generated patches can be compiled as-is.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SCEVSOURCEPRINTER_H
+#define LLVM_SCEVSOURCEPRINTER_H
+
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <string>
+
+namespace llvm {
+
+/// Render \p S as a C expression. Pointer-typed leaves are printed as
+/// "(const char *)name" so byte offsets from SCEV stay correct. Returns an
+/// empty string if some part (an add recurrence, an unnamed value) has no
+/// source-level spelling.
+std::string scevToSource(const SCEV *S);
+
+} // namespace llvm
+
+#endif // LLVM_SCEVSOURCEPRINTER_H
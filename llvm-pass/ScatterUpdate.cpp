@@ -0,0 +1,490 @@
+//===-- ScatterUpdate.cpp - Privatization of indirect updates ---*- C++ -*-===//
+//
+// Scatter-update recognition, target size estimation and strategy choice
+//
+//===----------------------------------------------------------------------===//
+
+#include "ScatterUpdate.h"
+#include "PatternDetect.h"
+#include "SCEVSourcePrinter.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "scatter-update"
+
+// Index ranges wider than this come from the index type (any 32-bit
+// value), not from a mask or a narrow type, and say nothing about the array
+static constexpr uint64_t MaxIndexRange = uint64_t(1) << 24;
+
+static std::string getCTypeName(Type *Ty) {
+  if (Ty->isFloatTy())
+    return "float";
+  if (Ty->isDoubleTy())
+    return "double";
+  if (Ty->isIntegerTy(8))
+    return "char";
+  if (Ty->isIntegerTy(16))
+    return "short";
+  if (Ty->isIntegerTy(32))
+    return "int";
+  if (Ty->isIntegerTy(64))
+    return "long";
+  return "";
+}
+
+/// OpenMP reduction operator of an update that combines the old element
+/// with one other operand.
+static std::string getUpdateOperator(Value *Update) {
+  if (auto *BO = dyn_cast<BinaryOperator>(Update)) {
+    switch (BO->getOpcode()) {
+    case Instruction::Add:
+    case Instruction::FAdd:
+      return "+";
+    case Instruction::Mul:
+    case Instruction::FMul:
+      return "*";
+    case Instruction::And:
+      return "&";
+    case Instruction::Or:
+      return "|";
+    case Instruction::Xor:
+      return "^";
+    default:
+      return "";
+    }
+  }
+  if (auto *II = dyn_cast<IntrinsicInst>(Update)) {
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::smin:
+    case Intrinsic::umin:
+    case Intrinsic::minnum:
+      return "min";
+    case Intrinsic::smax:
+    case Intrinsic::umax:
+    case Intrinsic::maxnum:
+      return "max";
+    default:
+      return "";
+    }
+  }
+  return "";
+}
+
+/// \p Text uses the identifier \p Name.
+static bool mentionsName(StringRef Text, StringRef Name) {
+  auto IsIdentifier = [](char C) { return isAlnum(C) || C == '_'; };
+  for (size_t Pos = Text.find(Name); Pos != StringRef::npos;
+       Pos = Text.find(Name, Pos + 1)) {
+    size_t End = Pos + Name.size();
+    if ((Pos == 0 || !IsIdentifier(Text[Pos - 1])) &&
+        (End == Text.size() || !IsIdentifier(Text[End])))
+      return true;
+  }
+  return false;
+}
+
+/// Loads in the computation of \p V in \p L; false if it also depends on
+/// something other than loads, casts, arithmetic and loop invariants.
+static bool collectIndexLoads(Value *V, Loop &L,
+                              SmallVectorImpl<LoadInst *> &Loads) {
+  if (L.isLoopInvariant(V))
+    return true;
+  if (auto *Load = dyn_cast<LoadInst>(V)) {
+    Loads.push_back(Load);
+    return true;
+  }
+  auto *I = dyn_cast<Instruction>(V);
+  if (!I || !(isa<CastInst>(I) || isa<BinaryOperator>(I)))
+    return false;
+  return all_of(I->operands(),
+                [&](Value *Op) { return collectIndexLoads(Op, L, Loads); });
+}
+
+ScatterUpdateInfo ScatterUpdateAnalyzer::analyze(Loop &L) {
+  ScatterUpdateInfo Info;
+  if (!L.isInnermost() || !L.getLoopLatch())
+    return Info;
+
+  SmallVector<LoadInst *, 8> Loads;
+  StoreInst *Store = nullptr;
+  for (BasicBlock *BB : L.blocks()) {
+    for (Instruction &I : *BB) {
+      if (isa<DbgInfoIntrinsic>(&I) || I.isLifetimeStartOrEnd())
+        continue;
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        if (!Load->isSimple())
+          return Info;
+        Loads.push_back(Load);
+      } else if (auto *S = dyn_cast<StoreInst>(&I)) {
+        if (Store || !S->isSimple())
+          return Info;
+        Store = S;
+      } else if (I.mayReadOrWriteMemory()) {
+        return Info;
+      }
+    }
+  }
+  if (!Store)
+    return Info;
+
+  // An update under one if (h[idx[i]] += w[i] when w[i] > 0) keeps its
+  // condition; the emitted bodies must not update unconditionally
+  BasicBlock *Latch = L.getLoopLatch();
+  std::string Guard;
+  if (!DT.dominates(Store->getParent(), Latch)) {
+    BasicBlock *If = Store->getParent()->getSinglePredecessor();
+    auto *Br = If ? dyn_cast<BranchInst>(If->getTerminator()) : nullptr;
+    if (!Br || !Br->isConditional() || !DT.dominates(If, Latch) ||
+        Br->getSuccessor(0) == Br->getSuccessor(1))
+      return Info;
+    Guard = PatternDetection::getSourceExpression(Br->getCondition(), &L);
+    if (Guard.empty())
+      return Info;
+    if (Br->getSuccessor(1) == Store->getParent())
+      Guard = "!(" + Guard + ")";
+  }
+
+  // The written element must move irregularly; affine addresses are
+  // covered by dependence analysis
+  Value *Ptr = Store->getPointerOperand();
+  auto *GEP = dyn_cast<GetElementPtrInst>(Ptr);
+  const SCEV *Address = SE.getSCEV(Ptr);
+  auto *AR = dyn_cast<SCEVAddRecExpr>(Address);
+  if (!GEP || SE.isLoopInvariant(Address, &L) || (AR && AR->getLoop() == &L))
+    return Info;
+  Value *Base = GEP->getPointerOperand();
+  if (!L.isLoopInvariant(Base))
+    return Info;
+  for (unsigned Op = 1; Op + 1 < GEP->getNumOperands(); ++Op) {
+    if (!isa<Constant>(GEP->getOperand(Op)))
+      return Info;
+  }
+  Value *Index = GEP->getOperand(GEP->getNumOperands() - 1);
+
+  // Stored value = old element op operand, used for nothing else
+  Value *Update = Store->getValueOperand();
+  std::string Operator = getUpdateOperator(Update);
+  if (Operator.empty() || !Update->hasOneUse())
+    return Info;
+  auto *UpdateInst = cast<Instruction>(Update);
+  LoadInst *Old = nullptr;
+  Value *Operand = nullptr;
+  for (unsigned Op = 0; Op < 2; ++Op) {
+    auto *Load = dyn_cast<LoadInst>(UpdateInst->getOperand(Op));
+    if (Load && L.contains(Load) && Load->hasOneUse() &&
+        SE.getSCEV(Load->getPointerOperand()) == Address) {
+      Old = Load;
+      Operand = UpdateInst->getOperand(1 - Op);
+      break;
+    }
+  }
+  if (!Old)
+    return Info;
+
+  // Other reads of the target would observe partial results
+  Value *Object = getUnderlyingObject(Base);
+  Info.Disjoint = true;
+  for (LoadInst *Load : Loads) {
+    if (Load == Old)
+      continue;
+    if (getUnderlyingObject(Load->getPointerOperand()) == Object)
+      return Info;
+    Info.Disjoint &= AA.isNoAlias(
+        MemoryLocation::getBeforeOrAfter(Load->getPointerOperand()),
+        MemoryLocation::getBeforeOrAfter(Base));
+  }
+
+  Type *ElemTy = Update->getType();
+  Info.ElemType = getCTypeName(ElemTy);
+  if (Info.ElemType.empty())
+    return Info;
+  Info.Found = true;
+  Info.Operator = Operator;
+  Info.Guard = Guard;
+  Info.FloatingPoint = ElemTy->isFloatingPointTy();
+  Info.ElemSize = SE.getDataLayout().getTypeAllocSize(ElemTy).getFixedSize();
+  Info.Target = PatternDetection::getVariableName(Base);
+  if (Info.Target.empty())
+    Info.Target = PatternDetection::getVariableName(Object);
+
+  Info.LoopVar = "i";
+  Info.LoopLo = "/* lower bound */";
+  Info.LoopHi = "/* upper bound */";
+  bool HasBounds = PatternDetection::getLoopBounds(&L, SE, Info.LoopVar,
+                                                   Info.LoopLo, Info.LoopHi);
+  Info.Index = PatternDetection::getSourceExpression(Index, &L);
+  Info.Value = PatternDetection::getSourceExpression(Operand, &L);
+
+  // h[bin(x[i])] += 1 counts the elements of x[lo:hi] per bin
+  auto *One = dyn_cast<ConstantInt>(Operand);
+  SmallVector<LoadInst *, 2> IndexLoads;
+  if (HasBounds && Operator == "+" && Guard.empty() && One && One->isOne() &&
+      !Info.Index.empty() && collectIndexLoads(Index, L, IndexLoads) &&
+      IndexLoads.size() == 1) {
+    LoadInst *Element = IndexLoads.front();
+    auto *ElementGEP = dyn_cast<GetElementPtrInst>(Element->getPointerOperand());
+    std::string Input =
+        ElementGEP ? PatternDetection::getVariableName(ElementGEP->getPointerOperand())
+                   : "";
+    // The load is input[i] itself, and the only array the index reads
+    const std::string Read = Input + "[" + Info.LoopVar + "]";
+    if (!Input.empty() &&
+        PatternDetection::getSourceExpression(Element, &L) == Read &&
+        !mentionsName(Info.Index, "x")) {
+      Info.Input = Input;
+      Info.BinOf = Info.Index;
+      for (size_t Pos = Info.BinOf.find(Read); Pos != std::string::npos;
+           Pos = Info.BinOf.find(Read, Pos + 1))
+        Info.BinOf.replace(Pos, Read.size(), "x");
+    }
+  }
+  if (unsigned TripCount = SE.getSmallConstantTripCount(&L))
+    Info.TripCount = TripCount;
+
+  estimateSize(Info, Base, Index);
+  chooseStrategy(Info);
+  return Info;
+}
+
+void ScatterUpdateAnalyzer::estimateSize(ScatterUpdateInfo &Info, Value *Base,
+                                         Value *Index) {
+  const DataLayout &DL = SE.getDataLayout();
+  Value *Object = getUnderlyingObject(Base);
+  Optional<uint64_t> Bytes;
+  const SCEV *ByteCount = nullptr;
+
+  // Only an array that starts at its allocation has the allocation's size
+  if (Base->stripPointerCasts() == Object) {
+    if (auto *GV = dyn_cast<GlobalVariable>(Object)) {
+      Bytes = DL.getTypeAllocSize(GV->getValueType()).getFixedSize();
+      Info.SizeSource = "global";
+    } else if (auto *Alloca = dyn_cast<AllocaInst>(Object)) {
+      if (Optional<TypeSize> Bits = Alloca->getAllocationSizeInBits(DL)) {
+        Bytes = Bits->getFixedSize() / 8;
+        Info.SizeSource = "alloca";
+      }
+    } else if (auto *Call = dyn_cast<CallBase>(Object)) {
+      Function *Callee = Call->getCalledFunction();
+      StringRef Name = Callee ? Callee->getName() : "";
+      if ((Name == "malloc" || Name == "_Znwm" || Name == "_Znam") &&
+          Call->arg_size() == 1) {
+        ByteCount = SE.getSCEV(Call->getArgOperand(0));
+      } else if (Name == "calloc" && Call->arg_size() == 2) {
+        ByteCount = SE.getMulExpr(SE.getSCEV(Call->getArgOperand(0)),
+                                  SE.getSCEV(Call->getArgOperand(1)));
+      }
+      if (ByteCount)
+        Info.SizeSource = "allocation";
+    }
+  }
+
+  if (ByteCount) {
+    if (auto *C = dyn_cast<SCEVConstant>(ByteCount)) {
+      Bytes = C->getAPInt().getZExtValue();
+    } else {
+      // n * sizeof(T) bytes are n elements
+      const SCEV *Elements = nullptr;
+      if (auto *Mul = dyn_cast<SCEVMulExpr>(ByteCount)) {
+        auto *Factor = dyn_cast<SCEVConstant>(Mul->getOperand(0));
+        if (Factor && Factor->getAPInt().getZExtValue() % Info.ElemSize == 0) {
+          SmallVector<const SCEV *, 4> Ops(Mul->operands());
+          Ops[0] = SE.getConstant(Factor->getType(),
+                                  Factor->getAPInt().getZExtValue() / Info.ElemSize);
+          Elements = SE.getMulExpr(Ops);
+        }
+      }
+      std::string Text = scevToSource(Elements ? Elements : ByteCount);
+      if (!Text.empty())
+        Info.SizeExpr = Elements ? Text
+                                 : "(" + Text + ") / sizeof(" + Info.ElemType + ")";
+    }
+  }
+  if (Bytes)
+    Info.Size = *Bytes / Info.ElemSize;
+
+  // A narrow or masked index reaches fewer elements: h[c] for an unsigned
+  // char c, h[k & 1023], h[k % 100]
+  ConstantRange Range = SE.getUnsignedRange(SE.getSCEV(Index));
+  if (!Range.isFullSet() && !Range.isWrappedSet() &&
+      Range.getUnsignedMax().ult(MaxIndexRange)) {
+    uint64_t Reach = Range.getUnsignedMax().getZExtValue() + 1;
+    if (Info.Size ? Reach < *Info.Size : Info.SizeExpr.empty()) {
+      Info.Size = Reach;
+      Info.SizeSource = "index_range";
+    }
+  }
+  if (Info.Size)
+    Info.SizeExpr = std::to_string(*Info.Size);
+  else if (Info.SizeExpr.empty())
+    Info.SizeSource.clear();
+}
+
+void ScatterUpdateAnalyzer::chooseStrategy(ScatterUpdateInfo &Info) const {
+  const uint64_t P = std::max(1u, Threads);
+  std::ostringstream Reason;
+  Reason << "Scatter update " << Info.Target << "[" << (Info.Index.empty() ? "..." : Info.Index)
+         << "] " << Info.Operator << "= ...";
+  if (!Info.Guard.empty())
+    Reason << " if " << Info.Guard;
+  Reason << ": ";
+
+  if (Info.SizeExpr.empty()) {
+    Info.Strategy = "atomic";
+    Reason << "the size of " << Info.Target
+           << " is unknown, so private copies cannot be sized - atomic updates";
+  } else if (!Info.Size) {
+    Info.Strategy = "privatized";
+    Reason << Info.Target << " holds " << Info.SizeExpr
+           << " elements, known at run time - per-thread copies merged in a "
+              "tree; prefer atomics when threads x elements exceeds the "
+              "number of updates";
+  } else {
+    const uint64_t N = *Info.Size;
+    const uint64_t Bytes = N * Info.ElemSize;
+    const uint64_t Copies = Bytes * P;
+    // Every copy is cleared and merged once, which must cost less than the
+    // contended updates it saves
+    const bool Amortized = !Info.TripCount || *Info.TripCount >= 2 * N * P;
+    Reason << N << " x " << Info.ElemType << " (" << formatBytes(Bytes) << "), "
+           << P << " threads";
+    if (Info.TripCount)
+      Reason << ", " << *Info.TripCount << " updates";
+    if (Amortized && Bytes <= Cache.L2Size / 2) {
+      Info.Strategy = "array_reduction";
+      Reason << " - a private copy per thread stays in L2; OpenMP "
+                "array-section reduction";
+    } else if (Amortized && (Info.TripCount || Copies <= Cache.L3Size)) {
+      Info.Strategy = "privatized";
+      Reason << " - " << formatBytes(Copies)
+             << " of per-thread copies merged in a tree, too large for the "
+                "runtime's stack copies";
+    } else {
+      Info.Strategy = "atomic";
+      Reason << " - "
+             << (Amortized ? formatBytes(Copies) + " of copies would not fit in L3"
+                           : std::string("fewer updates than copied elements"))
+             << "; with this many elements collisions are rare, atomic updates";
+    }
+  }
+  if (Info.Strategy == "privatized" && !Info.Input.empty())
+    Reason << " - per-block counts merged per bin by prt::parallel_histogram";
+  Info.Reason = Reason.str();
+}
+
+std::string ScatterUpdateAnalyzer::generatePatch(const ScatterUpdateInfo &Info) const {
+  if (!Info.Found)
+    return "";
+  const std::string Target = Info.Target.empty() ? "/* array */" : Info.Target;
+  const std::string Index = Info.Index.empty() ? "/* index */" : Info.Index;
+  const std::string Value = Info.Value.empty() ? "/* value */" : Info.Value;
+  const std::string &T = Info.ElemType;
+  const std::string &I = Info.LoopVar;
+  const std::string Header = "for (long " + I + " = " + Info.LoopLo + "; " + I +
+                             " < " + Info.LoopHi + "; ++" + I + ")";
+  const bool MinMax = Info.Operator == "min" || Info.Operator == "max";
+  auto combine = [&](const std::string &X, const std::string &Y) {
+    if (MinMax)
+      return X + " = std::" + Info.Operator + "(" + X + ", " + Y + ");";
+    return X + " " + Info.Operator + "= " + Y + ";";
+  };
+  auto Guarded = [&](const std::string &Statement) {
+    return Info.Guard.empty() ? Statement : "if (" + Info.Guard + ") " + Statement;
+  };
+
+  std::ostringstream Code;
+  if (Info.Strategy == "array_reduction") {
+    Code << "// ✅ Array-section reduction: every thread updates a private copy of "
+         << Target << ", merged when the loop ends\n"
+         << "#pragma omp parallel for reduction(" << Info.Operator << ":" << Target
+         << "[0:" << Info.SizeExpr << "])\n"
+         << "// Note: OpenMP 4.5 array sections; the copies live on the thread stacks";
+  } else if (Info.Strategy == "privatized" && !Info.Input.empty()) {
+    auto Offset = [](const std::string &Base, const std::string &By) {
+      return By == "0" ? Base : Base + " + " + By;
+    };
+    Code << "// ✅ Privatized histogram: per-block counts of " << Target
+         << " merged per bin - runtime/parallel_primitives.h\n"
+         << "#include \"parallel_primitives.h\"\n"
+         << "prt::parallel_histogram(" << Offset(Info.Input, Info.LoopLo) << ", "
+         << Info.Input << " + " << Info.LoopHi << ", " << Target << ", "
+         << Info.SizeExpr << ",\n"
+         << "                        [&](const auto &x) { return " << Info.BinOf
+         << "; });\n"
+         << "// Note: bins outside [0, " << Info.SizeExpr
+         << ") are skipped instead of written out of bounds";
+  } else if (Info.Strategy == "privatized") {
+    std::string Identity = "0";
+    if (Info.Operator == "*")
+      Identity = "1";
+    else if (Info.Operator == "&")
+      Identity = "~" + T + "(0)";
+    else if (Info.Operator == "min")
+      Identity = "std::numeric_limits<" + T + ">::max()";
+    else if (Info.Operator == "max")
+      Identity = "std::numeric_limits<" + T + ">::lowest()";
+    Code << "// ✅ Per-thread copies of " << Target
+         << " merged in a pairwise tree (log2(threads) rounds, each parallel "
+            "over the elements)\n"
+         << "#include <omp.h>\n#include <vector>\n";
+    if (MinMax)
+      Code << "#include <algorithm>\n#include <limits>\n";
+    Code << "const long NB = " << Info.SizeExpr << ";  // elements of " << Target << "\n"
+         << "std::vector<" << T << "> priv;\n"
+         << "#pragma omp parallel\n"
+         << "{\n"
+         << "    const int nt = omp_get_num_threads(), tid = omp_get_thread_num();\n"
+         << "    #pragma omp single\n"
+         << "    priv.assign((size_t)nt * NB, " << Identity << ");\n"
+         << "    " << T << " *mine = priv.data() + (size_t)tid * NB;\n"
+         << "    #pragma omp for schedule(static)\n"
+         << "    " << Header << "\n"
+         << "        " << Guarded(combine("mine[" + Index + "]", Value)) << "\n"
+         << "    for (int stride = 1; stride < nt; stride *= 2) {\n"
+         << "        #pragma omp for schedule(static)\n"
+         << "        for (long k = 0; k < NB; ++k)\n"
+         << "            for (int t = 0; t + stride < nt; t += 2 * stride)\n"
+         << "                "
+         << combine("priv[t * NB + k]", "priv[(t + stride) * NB + k]") << "\n"
+         << "    }\n"
+         << "    #pragma omp for schedule(static)\n"
+         << "    for (long k = 0; k < NB; ++k)\n"
+         << "        " << combine(Target + "[k]", "priv[k]") << "\n"
+         << "}";
+  } else {
+    const std::string Element = Target + "[" + Index + "]";
+    Code << "// ✅ Atomic read-modify-write of each element\n"
+         << "#pragma omp parallel for schedule(static)\n"
+         << Header << " {\n";
+    // The atomic construct must stay directly above its statement
+    std::string Indent = "    ";
+    if (!Info.Guard.empty()) {
+      Code << "    if (" << Info.Guard << ") {\n";
+      Indent += "    ";
+    }
+    if (MinMax) {
+      Code << Indent << "#pragma omp atomic compare  // OpenMP 5.1\n"
+           << Indent << "if (" << Value << (Info.Operator == "min" ? " < " : " > ") << Element
+           << ") { " << Element << " = " << Value << "; }\n";
+    } else {
+      Code << Indent << "#pragma omp atomic update\n"
+           << Indent << combine(Element, Value) << "\n";
+    }
+    if (!Info.Guard.empty())
+      Code << "    }\n";
+    Code << "}";
+  }
+  if (Info.FloatingPoint && Info.Strategy != "atomic")
+    Code << "\n// Note: floating-point updates are combined in a different order "
+            "than the serial loop";
+  if (!Info.Disjoint)
+    Code << "\n// Note: assumes " << Target << " does not overlap the arrays the loop reads";
+  return Code.str();
+}
@@ -0,0 +1,87 @@
+//===-- ScatterUpdate.h - Privatization of indirect updates -----*- C++ -*-===//
+//
+// Recognizes scatter updates such as h[idx[i]] += w[i], where two
+// iterations may update the same element, estimates the size of the
+// updated array from its allocation, its type or the range of the index,
+// and picks the cheapest race-free form for the thread count: an OpenMP
+// array-section reduction, per-thread copies merged in a tree, or atomics.
+// Privatized counts of one input element per iteration become a call to
+// prt::parallel_histogram (runtime/parallel_primitives.h).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SCATTERUPDATE_H
+#define LLVM_SCATTERUPDATE_H
+
+#include "TilingAdvisor.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+
+/// One read-modify-write of an indirectly indexed element per iteration.
+struct ScatterUpdateInfo {
+  bool Found = false;
+
+  std::string Target;      // Updated array
+  std::string Index;       // Source spelling of the index, "" if unknown
+  std::string Value;       // Operand combined into the element, "" if unknown
+  std::string Operator;    // +, *, &, |, ^, min, max
+  std::string Guard;       // Condition of an update under an if, "" if none
+  std::string ElemType;    // C type of the elements
+  uint64_t ElemSize = 0;
+  bool FloatingPoint = false;
+
+  /// Elements of the target that the index can reach: a constant, or the
+  /// source spelling of a run-time count.
+  Optional<uint64_t> Size;
+  std::string SizeExpr;
+  std::string SizeSource;  // "global", "alloca", "allocation", "index_range"
+
+  Optional<uint64_t> TripCount;
+  std::string LoopVar, LoopLo, LoopHi;
+
+  /// The target cannot overlap the arrays the loop reads.
+  bool Disjoint = false;
+
+  /// ++target[bin(input[i])] over the loop's range: the array whose
+  /// elements select the bin and the bin as a C expression of x.
+  std::string Input;
+  std::string BinOf;
+
+  std::string Strategy;    // "array_reduction", "privatized", "atomic"
+  std::string Reason;
+};
+
+class ScatterUpdateAnalyzer {
+public:
+  ScatterUpdateAnalyzer(ScalarEvolution &SE, AAResults &AA, DominatorTree &DT,
+                        const CacheModel &Cache, unsigned Threads)
+    : SE(SE), AA(AA), DT(DT), Cache(Cache), Threads(Threads) {}
+
+  /// Recognize a scatter update in the innermost loop \p L and choose a
+  /// strategy for it.
+  ScatterUpdateInfo analyze(Loop &L);
+
+  /// Code for the chosen strategy.
+  std::string generatePatch(const ScatterUpdateInfo &Info) const;
+
+private:
+  ScalarEvolution &SE;
+  AAResults &AA;
+  DominatorTree &DT;
+  CacheModel Cache;
+  unsigned Threads;
+
+  void estimateSize(ScatterUpdateInfo &Info, Value *Base, Value *Index);
+  void chooseStrategy(ScatterUpdateInfo &Info) const;
+};
+
+} // namespace llvm
+
+#endif // LLVM_SCATTERUPDATE_H
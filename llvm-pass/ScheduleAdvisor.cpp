@@ -0,0 +1,265 @@
+//===-- ScheduleAdvisor.cpp - Schedule from iteration cost ------*- C++ -*-===//
+//
+// The work of iteration i of the parallel loop P comes from its inner loops
+// Q and calls:
+//   trip(Q) invariant in P          uniform
+//   trip(Q) = {a,+,b}<P>            linear in i: a triangle
+//   trip(Q) other function of i     nonlinear
+//   Q or a call off some paths      conditional
+//   trip(Q) loaded or uncomputable  data dependent
+// The lowest row that applies picks the clause, with N iterations over T
+// threads:
+//   triangular      schedule(static, N / 8T): round robin, no runtime cost
+//   nonlinear       schedule(dynamic, N / 16T)
+//   conditional     schedule(dynamic, N / 16T)
+//   data dependent  schedule(guided)
+//
+//===----------------------------------------------------------------------===//
+
+#include "ScheduleAdvisor.h"
+#include "PatternDetect.h"
+#include "PerfectNestAnalysis.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace llvm;
+
+// Chunks per thread dealt round-robin, and handed out dynamically
+static constexpr uint64_t RoundsPerThread = 8;
+static constexpr uint64_t ChunksPerThread = 16;
+// Predicted slowest / average thread below which schedule(static) stays
+static constexpr double MinImbalance = 1.1;
+// Largest trip count whose iterations are costed one by one
+static constexpr uint64_t MaxPredictedTrips = 1 << 20;
+
+std::string ScheduleInfo::clause() const {
+  if (Kind.empty())
+    return "";
+  return "schedule(" + Kind + (Chunk ? ", " + std::to_string(Chunk) : "") +
+         ")";
+}
+
+static std::string describeAt(const std::string &What, unsigned Line) {
+  return Line ? What + " at line " + std::to_string(Line) : "an inner " + What;
+}
+
+/// True if \p S uses a value computed in \p L, such as a loaded bound.
+static bool usesValueOf(ScalarEvolution &SE, const SCEV *S, const Loop *L) {
+  return SCEVExprContains(S, [&](const SCEV *Op) {
+    return isa<SCEVUnknown>(Op) && !SE.isLoopInvariant(Op, L);
+  });
+}
+
+ScheduleInfo ScheduleAdvisor::analyze(Loop &L, ArrayRef<Loop *> Collapsed) {
+  ScheduleInfo Info;
+  Loop *Root = &L;
+  ArrayRef<Loop *> Parallel =
+      Collapsed.empty() ? ArrayRef<Loop *>(Root) : Collapsed;
+  Loop *Inner = Parallel.back();
+
+  uint64_t Trips = 1;
+  for (Loop *Level : Parallel) {
+    unsigned TC = SE.getSmallConstantTripCount(Level);
+    Trips = TC ? Trips * TC : 0;
+  }
+  if (Trips)
+    Info.TripCount = Trips;
+
+  // Worst variation found, in the order of the table above
+  static const char *const Kinds[] = {"none", "triangular", "nonlinear",
+                                      "conditional", "data_dependent"};
+  unsigned Rank = 0;
+  std::string Why;
+  auto Found = [&](unsigned R, unsigned Line, std::string Text) {
+    if (Line && !is_contained(Info.VaryingLines, Line))
+      Info.VaryingLines.push_back(Line);
+    if (R > Rank) {
+      Rank = R;
+      Why = std::move(Text);
+    }
+  };
+  BasicBlock *Latch = Inner->getLoopLatch();
+  auto OnSomePaths = [&](BasicBlock *BB) {
+    return Latch && !DT.dominates(BB, Latch);
+  };
+
+  for (Loop *Sub : Inner->getLoopsInPreorder()) {
+    if (Sub == Inner)
+      continue;
+    unsigned Line = PatternDetection::getLoopLocation(Sub).second;
+    std::string What = describeAt("loop", Line);
+    if (Sub->getParentLoop() == Inner && OnSomePaths(Sub->getHeader()))
+      Found(3, Line, What + " runs on some iterations only");
+
+    const SCEV *BTC = SE.getBackedgeTakenCount(Sub);
+    if (isa<SCEVCouldNotCompute>(BTC)) {
+      Found(4, Line, What + " exits on data-dependent conditions");
+      continue;
+    }
+    for (Loop *P : Parallel) {
+      if (SE.isLoopInvariant(BTC, P))
+        continue;
+      if (usesValueOf(SE, BTC, P))
+        Found(4, Line, "the trip count of " + What +
+                           " depends on data loaded in each iteration");
+      else if (hasAffineBounds(SE, *Sub, Parallel))
+        Found(1, Line, "the trip count of " + What +
+                           " is linear in the parallel index (a triangular "
+                           "nest)");
+      else
+        Found(2, Line, "the trip count of " + What +
+                           " varies non-linearly with the parallel index");
+    }
+  }
+
+  // Calls into code of this module (or through pointers) that some
+  // iterations skip: early exits and guarded bodies
+  for (BasicBlock *BB : Inner->blocks()) {
+    if (!OnSomePaths(BB) || any_of(Inner->getSubLoops(), [&](Loop *Sub) {
+          return Sub->contains(BB);
+        }))
+      continue;
+    for (Instruction &I : *BB) {
+      auto *Call = dyn_cast<CallBase>(&I);
+      if (!Call || isa<IntrinsicInst>(Call))
+        continue;
+      Function *Callee = Call->getCalledFunction();
+      if (Callee && Callee->isDeclaration())
+        continue;
+      unsigned Line = I.getDebugLoc() ? I.getDebugLoc().getLine() : 0;
+      std::string What = Callee ? "the call to " + Callee->getName().str()
+                                : std::string("an indirect call");
+      Found(3, Line,
+            What + (Line ? " at line " + std::to_string(Line) : "") +
+                " runs on some iterations only");
+    }
+  }
+  if (Rank == 0)
+    return Info;
+
+  const uint64_t T = std::max(1u, Threads);
+  std::ostringstream Reason;
+  Reason << Why;
+  if (Rank == 1) {
+    Info.Kind = "static";
+    Info.Chunk = Trips ? std::max<uint64_t>(1, Trips / (T * RoundsPerThread))
+                       : 1;
+    if (Parallel.size() == 1 && Trips && Trips <= MaxPredictedTrips) {
+      Info.StaticImbalance = predictImbalance(*Inner, Trips, 0);
+      Info.ChunkedImbalance = predictImbalance(*Inner, Trips, Info.Chunk);
+    }
+    // A large constant part of every iteration hides the triangle
+    if (Info.StaticImbalance && *Info.StaticImbalance < MinImbalance) {
+      Info.Kind.clear();
+      Info.Chunk = 0;
+      Info.VaryingLines.clear();
+      return Info;
+    }
+    Reason << "; " << Info.clause()
+           << " deals chunks round-robin so every thread gets cheap and "
+              "expensive iterations";
+    if (Info.StaticImbalance && Info.ChunkedImbalance)
+      Reason << std::fixed << std::setprecision(2)
+             << " (slowest thread " << *Info.StaticImbalance
+             << "x the average under schedule(static), "
+             << *Info.ChunkedImbalance << "x chunked)";
+  } else if (Rank == 4) {
+    Info.Kind = "guided";
+    Reason << "; schedule(guided) hands out shrinking chunks that absorb "
+              "the unpredictable tail";
+  } else {
+    Info.Kind = "dynamic";
+    Info.Chunk = Trips ? std::max<uint64_t>(1, Trips / (T * ChunksPerThread))
+                       : 1;
+    Reason << "; with " << Info.clause()
+           << " threads take the next chunk when they finish one";
+  }
+  Info.Imbalance = Kinds[Rank];
+  Info.Reason = Reason.str();
+  return Info;
+}
+
+Optional<double> ScheduleAdvisor::predictImbalance(Loop &L, uint64_t Trips,
+                                                   unsigned Chunk) const {
+  // Cost of an iteration: one, plus for every innermost loop the product
+  // of its trip count and those of the loops between it and L
+  std::vector<std::vector<const SCEV *>> Chains;
+  for (Loop *Sub : L.getLoopsInPreorder()) {
+    if (Sub == &L || !Sub->getSubLoops().empty())
+      continue;
+    std::vector<const SCEV *> Chain;
+    for (Loop *Level = Sub; Level != &L; Level = Level->getParentLoop())
+      Chain.push_back(SE.getBackedgeTakenCount(Level));
+    Chains.push_back(std::move(Chain));
+  }
+  // Trip count at iteration I: constants, or {a,+,b}<L> with constant a, b
+  auto TripsAt = [&](const SCEV *BTC, uint64_t I) -> Optional<int64_t> {
+    if (auto *C = dyn_cast<SCEVConstant>(BTC))
+      return C->getAPInt().getSExtValue() + 1;
+    auto *AR = dyn_cast<SCEVAddRecExpr>(BTC);
+    if (!AR || AR->getLoop() != &L || !AR->isAffine())
+      return None;
+    auto *Start = dyn_cast<SCEVConstant>(AR->getStart());
+    auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (!Start || !Step)
+      return None;
+    return Start->getAPInt().getSExtValue() +
+           Step->getAPInt().getSExtValue() * static_cast<int64_t>(I) + 1;
+  };
+
+  const uint64_t T = std::max(1u, Threads);
+  const uint64_t Block = (Trips + T - 1) / T;
+  std::vector<double> PerThread(T, 0.0);
+  double Total = 0;
+  for (uint64_t I = 0; I < Trips; ++I) {
+    double Cost = 1;
+    for (const auto &Chain : Chains) {
+      double Product = 1;
+      for (const SCEV *BTC : Chain) {
+        Optional<int64_t> N = TripsAt(BTC, I);
+        if (!N)
+          return None;
+        Product *= std::max<int64_t>(*N, 0);
+      }
+      Cost += Product;
+    }
+    PerThread[Chunk ? (I / Chunk) % T : I / Block] += Cost;
+    Total += Cost;
+  }
+  return *std::max_element(PerThread.begin(), PerThread.end()) /
+         (Total / T);
+}
+
+void ScheduleAdvisor::applyToPatch(const ScheduleInfo &Info,
+                                   std::string &Patch) {
+  std::string Clause = Info.clause();
+  if (Clause.empty())
+    return;
+
+  std::vector<std::string> Lines;
+  std::istringstream In(Patch);
+  for (std::string Text; std::getline(In, Text);)
+    Lines.push_back(Text);
+  auto Directive = find_if(Lines, [](const std::string &Text) {
+    StringRef T = StringRef(Text).trim();
+    return T.startswith("#pragma omp") && T.contains(" for");
+  });
+  // Generators that chose a schedule themselves keep it
+  if (Directive == Lines.end() ||
+      Directive->find("schedule(") != std::string::npos)
+    return;
+
+  *Directive += " " + Clause;
+  Lines.insert(std::next(Directive),
+               "// Note: load imbalance - " + Info.Reason);
+  std::string Out;
+  for (const std::string &Text : Lines)
+    Out += Text + "\n";
+  if (!Out.empty() && (Patch.empty() || Patch.back() != '\n'))
+    Out.pop_back();
+  Patch = std::move(Out);
+}
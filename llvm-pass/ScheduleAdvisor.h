@@ -0,0 +1,70 @@
+//===-- ScheduleAdvisor.h - Schedule from iteration cost --------*- C++ -*-===//
+//
+// schedule(static) hands every thread one contiguous block of iterations,
+// which only balances when iterations cost the same. The advisor looks at
+// the work inside one iteration of the parallel loop: inner loops whose trip
+// count is linear in the parallel index (triangles), varies otherwise with
+// it, depends on loaded data, or that only run on some iterations (early
+// exits and skipped bodies), and picks the schedule clause that evens out
+// the threads' shares.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SCHEDULEADVISOR_H
+#define LLVM_SCHEDULEADVISOR_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+struct ScheduleInfo {
+  std::string Imbalance = "none"; // none, triangular, nonlinear,
+                                  // conditional, data_dependent
+  std::string Kind;               // static, dynamic or guided; "" keeps
+                                  // the default schedule
+  unsigned Chunk = 0;             // 0 leaves the chunk to the runtime
+  std::vector<unsigned> VaryingLines; // Inner loops and calls whose work varies
+  Optional<uint64_t> TripCount;       // Iterations shared by the threads
+  Optional<double> StaticImbalance;   // Slowest / average thread, schedule(static)
+  Optional<double> ChunkedImbalance;  // Same with the recommended static chunk
+  std::string Reason;
+
+  /// "schedule(kind[, chunk])", or "" for the default schedule.
+  std::string clause() const;
+};
+
+class ScheduleAdvisor {
+public:
+  ScheduleAdvisor(ScalarEvolution &SE, DominatorTree &DT, unsigned Threads)
+    : SE(SE), DT(DT), Threads(Threads) {}
+
+  /// Iteration-cost variation of \p L as the parallel loop, or of the band
+  /// \p Collapsed (outermost first) collapsed into one iteration space.
+  ScheduleInfo analyze(Loop &L, ArrayRef<Loop *> Collapsed = {});
+
+  /// Add the schedule clause to the patch's parallel for directive, unless
+  /// it already has one, and note why under it.
+  static void applyToPatch(const ScheduleInfo &Info, std::string &Patch);
+
+private:
+  ScalarEvolution &SE;
+  DominatorTree &DT;
+  unsigned Threads;
+
+  /// Slowest over average thread cost for chunks of \p Chunk iterations
+  /// dealt round-robin (0: one block per thread), from the inner trip
+  /// counts evaluated at every iteration of \p L; None when they are not
+  /// all constant.
+  Optional<double> predictImbalance(Loop &L, uint64_t Trips,
+                                    unsigned Chunk) const;
+};
+
+} // namespace llvm
+
+#endif // LLVM_SCHEDULEADVISOR_H
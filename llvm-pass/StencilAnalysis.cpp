@@ -0,0 +1,420 @@
+//===-- StencilAnalysis.cpp - Stencil shape and temporal blocking -*- C++ -*-===//
+//
+// Radius/time-loop detection, trapezoid and wavefront planning
+//
+//===----------------------------------------------------------------------===//
+
+#include "StencilAnalysis.h"
+#include "PatternDetect.h"
+#include "SCEVSourcePrinter.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Debug.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "stencil-analysis"
+
+// Tiles of more time steps than this gain little: the block already
+// streams each grid once per TimeBlock steps
+static constexpr unsigned MaxTimeBlock = 16;
+
+static unsigned floorPowerOf2(unsigned X) {
+  unsigned P = 1;
+  while (P * 2 <= X)
+    P *= 2;
+  return P;
+}
+
+static std::string getBaseName(const SCEV *Base) {
+  if (auto *U = dyn_cast<SCEVUnknown>(Base))
+    return PatternDetection::getVariableName(U->getValue());
+  return "";
+}
+
+bool StencilAnalyzer::decompose(const SCEV *Address, ArrayRef<Loop *> Nest,
+                                SmallVectorImpl<const SCEV *> &Steps,
+                                const SCEV *&Start) {
+  Steps.assign(Nest.size(), nullptr);
+  while (auto *AR = dyn_cast<SCEVAddRecExpr>(Address)) {
+    auto Level = find(Nest, AR->getLoop());
+    if (!AR->isAffine() || Level == Nest.end())
+      return false;
+    const SCEV *Step = AR->getStepRecurrence(SE);
+    if (!SE.isLoopInvariant(Step, Nest.front()))
+      return false;
+    Steps[Level - Nest.begin()] = Step;
+    Address = AR->getStart();
+  }
+  Start = Address;
+  return SE.isLoopInvariant(Start, Nest.front());
+}
+
+// Delta = sum(Offsets[d] * Steps[d]) with |Offsets[d]| <= MaxRadius. Works
+// for symbolic row strides, where a division would not.
+bool StencilAnalyzer::solveOffsets(const SCEV *Delta,
+                                   ArrayRef<const SCEV *> Steps,
+                                   SmallVectorImpl<int> &Offsets) {
+  if (Steps.empty())
+    return Delta->isZero();
+  for (int K = -MaxRadius; K <= MaxRadius; ++K) {
+    const SCEV *Rest = SE.getMinusSCEV(
+        Delta, SE.getMulExpr(SE.getConstant(Delta->getType(), K, true),
+                             Steps.front()));
+    Offsets.push_back(K);
+    if (solveOffsets(Rest, Steps.drop_front(), Offsets))
+      return true;
+    Offsets.pop_back();
+  }
+  return false;
+}
+
+StencilInfo StencilAnalyzer::analyze(Loop &Inner) {
+  StencilInfo Info;
+  if (!Inner.isInnermost())
+    return Info;
+
+  SmallVector<LoadInst *, 16> Loads;
+  StoreInst *Store = nullptr;
+  for (BasicBlock *BB : Inner.blocks()) {
+    for (Instruction &I : *BB) {
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        Loads.push_back(Load);
+      } else if (auto *S = dyn_cast<StoreInst>(&I)) {
+        if (Store)
+          return Info;
+        Store = S;
+      } else if (I.mayReadOrWriteMemory()) {
+        return Info;
+      }
+    }
+  }
+  if (!Store || Loads.empty())
+    return Info;
+
+  // Spatial loops: the innermost loop and the parents the written element
+  // moves in; the first parent it does not move in may be a time loop
+  const SCEV *OutAddress = SE.getSCEV(Store->getPointerOperand());
+  SmallPtrSet<const Loop *, 4> Moving;
+  for (const SCEV *S = OutAddress; auto *AR = dyn_cast<SCEVAddRecExpr>(S);
+       S = AR->getStart())
+    Moving.insert(AR->getLoop());
+  std::vector<Loop *> Spatial{&Inner};
+  for (Loop *P = Inner.getParentLoop(); P && P->getSubLoops().size() == 1;
+       P = P->getParentLoop()) {
+    if (!Moving.count(P))
+      break;
+    Spatial.insert(Spatial.begin(), P);
+  }
+
+  SmallVector<const SCEV *, 3> OutSteps;
+  const SCEV *OutStart = nullptr;
+  if (!decompose(OutAddress, Spatial, OutSteps, OutStart) ||
+      is_contained(OutSteps, nullptr))
+    return Info;
+  const SCEV *OutBase = SE.getPointerBase(OutStart);
+  const SCEV *OutOffset = SE.getMinusSCEV(OutStart, OutBase);
+  Type *ElemTy = Store->getValueOperand()->getType();
+  const DataLayout &DL = SE.getDataLayout();
+  Info.ElemSize = DL.getTypeAllocSize(ElemTy).getFixedSize();
+
+  // Neighbours as (array, offset per spatial loop)
+  std::set<std::pair<const SCEV *, std::vector<int>>> Points;
+  SmallVector<const SCEV *, 4> InBases;
+  for (LoadInst *Load : Loads) {
+    const SCEV *Address = SE.getSCEV(Load->getPointerOperand());
+    if (SE.isLoopInvariant(Address, Spatial.front()))
+      continue; // Coefficients
+    SmallVector<const SCEV *, 3> Steps;
+    const SCEV *Start = nullptr;
+    if (!decompose(Address, Spatial, Steps, Start) || Steps != OutSteps ||
+        DL.getTypeAllocSize(Load->getType()).getFixedSize() != Info.ElemSize)
+      return Info;
+    const SCEV *Base = SE.getPointerBase(Start);
+    const SCEV *Delta = SE.getMinusSCEV(SE.getMinusSCEV(Start, Base), OutOffset);
+    SmallVector<int, 3> Offsets;
+    if (!solveOffsets(Delta, OutSteps, Offsets))
+      return Info;
+    Points.insert({Base, std::vector<int>(Offsets.begin(), Offsets.end())});
+    if (!is_contained(InBases, Base))
+      InBases.push_back(Base);
+  }
+
+  Info.Radius.assign(Spatial.size(), 0);
+  bool HasNeighbour = false;
+  for (const auto &Point : Points) {
+    unsigned NonZero = 0;
+    for (unsigned D = 0; D < Spatial.size(); ++D) {
+      unsigned Distance = std::abs(Point.second[D]);
+      Info.Radius[D] = std::max(Info.Radius[D], Distance);
+      NonZero += Distance != 0;
+    }
+    HasNeighbour |= NonZero != 0;
+    Info.Star &= NonZero <= 1;
+    Info.InPlace |= Point.first == OutBase && NonZero != 0;
+  }
+  // Without neighbour reads this is a map, not a stencil
+  if (!HasNeighbour)
+    return Info;
+
+  Info.Recognized = true;
+  Info.Spatial = Spatial;
+  Info.Points = Points.size();
+  Info.Output = getBaseName(OutBase);
+  for (const SCEV *Base : InBases)
+    Info.Inputs.push_back(getBaseName(Base));
+  for (Loop *L : Spatial) {
+    unsigned TripCount = SE.getSmallConstantTripCount(L);
+    Info.Extents.push_back(TripCount ? Optional<uint64_t>(TripCount) : None);
+  }
+  findTimeLoop(Info, OutBase, InBases);
+
+  std::ostringstream Reason;
+  Reason << Spatial.size() << "-D " << (Info.Star ? "star" : "box")
+         << " stencil, radius ";
+  for (unsigned D = 0; D < Spatial.size(); ++D)
+    Reason << (D ? "x" : "") << Info.Radius[D];
+  Reason << ", " << Info.Points << " points";
+  if (Info.InPlace)
+    Reason << ", updated in place";
+  if (Info.TimeLoop)
+    Reason << ", time loop (" << Info.TimeKind << ")";
+  Info.Reason = Reason.str();
+  return Info;
+}
+
+void StencilAnalyzer::findTimeLoop(StencilInfo &Info, const SCEV *OutBase,
+                                   ArrayRef<const SCEV *> InBases) {
+  Loop *Outer = Info.Spatial.front();
+  Loop *P = Outer->getParentLoop();
+  if (!P)
+    return;
+  // Every sweep must cover the same grid
+  for (Loop *L : Info.Spatial) {
+    const SCEV *BTC = SE.getBackedgeTakenCount(L);
+    if (isa<SCEVCouldNotCompute>(BTC) || !SE.isLoopInvariant(BTC, P))
+      return;
+  }
+
+  if (Info.InPlace) {
+    Info.TimeLoop = P;
+    Info.TimeKind = "in_place";
+    return;
+  }
+
+  // Pointers exchanged at the end of every step
+  auto getHeaderPhi = [&](const SCEV *Base) -> PHINode * {
+    auto *U = dyn_cast<SCEVUnknown>(Base);
+    auto *Phi = U ? dyn_cast<PHINode>(U->getValue()) : nullptr;
+    return Phi && Phi->getParent() == P->getHeader() ? Phi : nullptr;
+  };
+  BasicBlock *Latch = P->getLoopLatch();
+  PHINode *OutPhi = getHeaderPhi(OutBase);
+  for (const SCEV *InBase : InBases) {
+    PHINode *InPhi = getHeaderPhi(InBase);
+    if (Latch && OutPhi && InPhi &&
+        OutPhi->getIncomingValueForBlock(Latch) == InPhi &&
+        InPhi->getIncomingValueForBlock(Latch) == OutPhi) {
+      Info.TimeLoop = P;
+      Info.TimeKind = "swap";
+      return;
+    }
+  }
+
+  // A second sweep copying the result back into the input
+  for (BasicBlock *BB : P->blocks()) {
+    if (Outer->contains(BB))
+      continue;
+    for (Instruction &I : *BB) {
+      auto *Copy = dyn_cast<StoreInst>(&I);
+      auto *Value = Copy ? dyn_cast<LoadInst>(Copy->getValueOperand()) : nullptr;
+      if (!Value)
+        continue;
+      const SCEV *To = SE.getPointerBase(SE.getSCEV(Copy->getPointerOperand()));
+      const SCEV *From = SE.getPointerBase(SE.getSCEV(Value->getPointerOperand()));
+      if (From == OutBase && is_contained(InBases, To)) {
+        Info.TimeLoop = P;
+        Info.TimeKind = "copy_back";
+        return;
+      }
+    }
+  }
+}
+
+StencilTiling StencilAnalyzer::plan(const StencilInfo &Info) const {
+  StencilTiling Tiling;
+  if (!Info.Recognized)
+    return Tiling;
+
+  // Bytes of one iteration of the outermost (two outermost) spatial loops
+  auto planeBytes = [&](unsigned FromDim) -> uint64_t {
+    uint64_t Bytes = Info.ElemSize;
+    for (unsigned D = FromDim; D < Info.Extents.size(); ++D) {
+      if (!Info.Extents[D])
+        return 0;
+      Bytes *= *Info.Extents[D];
+    }
+    return Bytes;
+  };
+  const uint64_t Budget = Cache.L2Size / 2;
+  std::ostringstream Reason;
+
+  if (Info.TimeKind == "swap" || Info.TimeKind == "copy_back") {
+    const unsigned R = std::max(1u, Info.Radius.front());
+    const uint64_t Plane = planeBytes(1);
+    // Two buffers of TileWidth planes stay in half of L2
+    if (Plane && Plane * 2 * 8 * R > Budget) {
+      Reason << "one plane of the grid is " << formatBytes(Plane)
+             << " - too large for a tile of " << 8 * R << " planes in "
+             << formatBytes(Budget) << "; tile the inner loops as well";
+      Tiling.Reason = Reason.str();
+      return Tiling;
+    }
+    unsigned Rows = Plane ? std::min<uint64_t>(Budget / (2 * Plane), 1u << 16)
+                          : 64;
+    Tiling.Scheme = "trapezoid";
+    Tiling.TimeBlock = floorPowerOf2(
+        std::max(2u, std::min(Rows / (4 * R), MaxTimeBlock)));
+    Tiling.TileWidth = std::max(Rows, 4 * R * Tiling.TimeBlock);
+    Tiling.Footprint = Plane * 2 * Tiling.TileWidth;
+    Reason << Tiling.TimeBlock << " time steps per block over tiles of "
+           << Tiling.TileWidth << " iterations";
+    if (Tiling.Footprint)
+      Reason << " (" << formatBytes(Tiling.Footprint) << " for both buffers, "
+             << formatBytes(Cache.L2Size) << " L2)";
+    Reason << ": the grid streams from memory once per block instead of "
+              "once per step";
+  } else if (Info.InPlace && Info.Spatial.size() >= 2) {
+    const unsigned R = *std::max_element(Info.Radius.begin(), Info.Radius.end());
+    const uint64_t Plane = planeBytes(2);
+    unsigned Block = Plane ? static_cast<unsigned>(std::sqrt(
+                                 static_cast<double>(Budget / Plane)))
+                           : 64;
+    // Keep at least eight blocks along the outer loop so that the
+    // diagonals have parallelism to offer
+    if (Info.Extents[0])
+      Block = std::min<uint64_t>(Block, *Info.Extents[0] / 8);
+    Block = std::max(std::max(8u, R), std::min(Block, 256u) / 8 * 8);
+    Tiling.Scheme = "wavefront";
+    Tiling.BlockI = Tiling.BlockJ = Block;
+    Tiling.Skew = Info.Star ? 1 : 2;
+    Tiling.Footprint = Plane * Block * Block;
+    Reason << "in-place sweep as a wavefront of " << Block << "x" << Block
+           << " blocks; blocks on one diagonal are independent and every "
+              "point sees the same old and new neighbours as in the serial "
+              "sweep";
+  } else if (Info.InPlace) {
+    Reason << "an in-place 1-D sweep is one serial dependence chain";
+  } else {
+    Reason << "no time loop around the sweep - nothing to block in time, "
+              "the spatial loops are parallel as they are";
+  }
+  Tiling.Reason = Reason.str();
+  return Tiling;
+}
+
+void StencilAnalyzer::getBounds(Loop *L, std::string &Var, std::string &Lo,
+                                std::string &Hi) const {
+  Var = "i" + std::to_string(L->getLoopDepth());
+  Lo = "/* lower bound */";
+  Hi = "/* upper bound */";
+  PatternDetection::getLoopBounds(L, SE, Var, Lo, Hi);
+}
+
+std::string StencilAnalyzer::generatePatch(const StencilInfo &Info,
+                                           const StencilTiling &Tiling) const {
+  if (Tiling.Scheme.empty())
+    return "";
+  std::ostringstream Code;
+  std::vector<std::string> Vars(Info.Spatial.size()), Los(Vars.size()),
+      His(Vars.size());
+  for (unsigned D = 0; D < Vars.size(); ++D)
+    getBounds(Info.Spatial[D], Vars[D], Los[D], His[D]);
+  const std::string &I = Vars[0];
+  std::string Body = "/* stencil update of (" + join(Vars, ", ") + ") */";
+
+  if (Tiling.Scheme == "trapezoid") {
+    std::string T, TLo, THi;
+    getBounds(Info.TimeLoop, T, TLo, THi);
+    Code << "// ✅ Temporal blocking (trapezoid split tiling along " << I
+         << "): " << Info.Reason << "\n"
+         << "// " << Tiling.Reason << "\n"
+         << "// step(" << T << ", " << I
+         << ") runs one time step for one " << I << ": it must read buffer "
+         << T << " % 2 and write buffer (" << T << " + 1) % 2";
+    if (Info.TimeKind == "copy_back")
+      Code << " - replace the copy-back sweep by alternating the buffers";
+    Code << ".\n// Cells outside the " << I
+         << " range must hold the boundary values in both buffers.\n";
+    Code << "auto step = [&](long " << T << ", long " << I << ") {\n";
+    std::string Indent = "    ";
+    for (unsigned D = 1; D < Vars.size(); ++D) {
+      Code << Indent << "for (long " << Vars[D] << " = " << Los[D] << "; "
+           << Vars[D] << " < " << His[D] << "; ++" << Vars[D] << ")\n";
+      Indent += "    ";
+    }
+    Code << Indent << Body << ";\n};\n";
+    Code << "const long TLO = " << TLo << ", THI = " << THi << ";\n"
+         << "const long LO = " << Los[0] << ", HI = " << His[0] << ";\n"
+         << "const long R = " << std::max(1u, Info.Radius[0])
+         << ", BT = " << Tiling.TimeBlock << ", W = " << Tiling.TileWidth
+         << ";\n"
+         << "for (long t0 = TLO; t0 < THI; t0 += BT) {\n"
+         << "    const long nt = std::min(BT, THI - t0);\n"
+         << "    // Trapezoids shrink by R per step at inner tile edges\n"
+         << "    #pragma omp parallel for schedule(static)\n"
+         << "    for (long lo = LO; lo < HI; lo += W) {\n"
+         << "        const long hi = std::min(lo + W, HI);\n"
+         << "        for (long s = 0; s < nt; ++s)\n"
+         << "            for (long " << I << " = lo == LO ? lo : lo + R * s; "
+         << I << " < (hi == HI ? hi : hi - R * s); ++" << I << ")\n"
+         << "                step(t0 + s, " << I << ");\n"
+         << "    }\n"
+         << "    // Inverted triangles fill the gaps between trapezoids\n"
+         << "    #pragma omp parallel for schedule(static)\n"
+         << "    for (long b = LO + W; b < HI; b += W)\n"
+         << "        for (long s = 1; s < nt; ++s)\n"
+         << "            for (long " << I << " = b - R * s; " << I
+         << " < std::min(b + R * s, HI); ++" << I << ")\n"
+         << "                step(t0 + s, " << I << ");\n"
+         << "}";
+    return Code.str();
+  }
+
+  const std::string &J = Vars[1];
+  Code << "// ✅ Block wavefront: " << Info.Reason << "\n"
+       << "// " << Tiling.Reason << "\n";
+  if (Info.TimeLoop)
+    Code << "// Replaces one sweep inside the time loop.\n";
+  Code << "const long ILO = " << Los[0] << ", IHI = " << His[0] << ", JLO = "
+       << Los[1] << ", JHI = " << His[1] << ";\n"
+       << "const long BI = " << Tiling.BlockI << ", BJ = " << Tiling.BlockJ
+       << ", SKEW = " << Tiling.Skew << ";\n"
+       << "const long NI = (IHI - ILO + BI - 1) / BI, NJ = (JHI - JLO + BJ - 1) / BJ;\n"
+       << "for (long d = 0; d < SKEW * (NI - 1) + NJ; ++d) {\n"
+       << "    #pragma omp parallel for schedule(static)\n"
+       << "    for (long bi = 0; bi < NI; ++bi) {\n"
+       << "        const long bj = d - SKEW * bi;\n"
+       << "        if (bj < 0 || bj >= NJ) continue;\n"
+       << "        for (long " << I << " = ILO + bi * BI; " << I
+       << " < std::min(ILO + (bi + 1) * BI, IHI); ++" << I << ")\n"
+       << "            for (long " << J << " = JLO + bj * BJ; " << J
+       << " < std::min(JLO + (bj + 1) * BJ, JHI); ++" << J << ")\n";
+  std::string Indent = "                ";
+  for (unsigned D = 2; D < Vars.size(); ++D) {
+    Code << Indent << "for (long " << Vars[D] << " = " << Los[D] << "; "
+         << Vars[D] << " < " << His[D] << "; ++" << Vars[D] << ")\n";
+    Indent += "    ";
+  }
+  Code << Indent << Body << ";\n"
+       << "    }\n"
+       << "}\n"
+       << "// Note: reductions in the sweep (e.g. a convergence check) need "
+          "reduction clauses";
+  return Code.str();
+}
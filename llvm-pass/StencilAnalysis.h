@@ -0,0 +1,98 @@
+//===-- StencilAnalysis.h - Stencil shape and temporal blocking -*- C++ -*-===//
+//
+// Measures the shape of a stencil (dimensions, radius per dimension, number
+// of points) from the constant offsets between its address recurrences,
+// finds the time loop around the spatial nest and plans a temporally
+// blocked (trapezoid) or wavefront version sized from a cache model.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_STENCILANALYSIS_H
+#define LLVM_STENCILANALYSIS_H
+
+#include "TilingAdvisor.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// Shape of the stencil computed by a spatial loop nest.
+struct StencilInfo {
+  bool Recognized = false;
+
+  /// Spatial loops, outermost first; the innermost is the analyzed loop.
+  std::vector<Loop *> Spatial;
+  std::vector<unsigned> Radius;            // Per spatial loop
+  std::vector<Optional<uint64_t>> Extents; // Constant trip counts
+  unsigned Points = 0;    // Distinct neighbours read
+  bool Star = true;       // No point is offset in more than one dimension
+  bool InPlace = false;   // Reads neighbours of the array it writes
+  uint64_t ElemSize = 0;
+  std::string Output;     // Written array
+  std::vector<std::string> Inputs;
+
+  /// Loop around the spatial nest that repeats the sweep: "swap" when it
+  /// alternates two buffers, "copy_back" when it copies the result back,
+  /// "in_place" for repeated in-place sweeps.
+  Loop *TimeLoop = nullptr;
+  std::string TimeKind;
+
+  std::string Reason;
+};
+
+/// Temporally blocked or wavefront schedule for a stencil.
+struct StencilTiling {
+  std::string Scheme;      // "trapezoid", "wavefront" or "" (none)
+  unsigned TimeBlock = 0;  // Trapezoid: time steps per block
+  unsigned TileWidth = 0;  // Trapezoid: iterations of the outermost loop
+  unsigned BlockI = 0;     // Wavefront: block of the two outer loops
+  unsigned BlockJ = 0;
+  unsigned Skew = 1;       // Wavefront: diagonal d = Skew * bi + bj
+  uint64_t Footprint = 0;  // Bytes touched by one tile, 0 if unknown
+  std::string Reason;
+};
+
+class StencilAnalyzer {
+public:
+  StencilAnalyzer(ScalarEvolution &SE, const CacheModel &Cache)
+    : SE(SE), Cache(Cache) {}
+
+  /// Analyze the stencil whose innermost loop is \p Inner.
+  StencilInfo analyze(Loop &Inner);
+
+  /// Choose a schedule: trapezoids when a time loop alternates buffers,
+  /// a block wavefront for in-place sweeps of two or more dimensions.
+  StencilTiling plan(const StencilInfo &Info) const;
+
+  /// Render the blocked loops around a step()/update placeholder.
+  std::string generatePatch(const StencilInfo &Info,
+                            const StencilTiling &Tiling) const;
+
+private:
+  ScalarEvolution &SE;
+  CacheModel Cache;
+
+  // Neighbour offsets further than this are not treated as a stencil
+  static constexpr int MaxRadius = 4;
+
+  bool decompose(const SCEV *Address, ArrayRef<Loop *> Nest,
+                 SmallVectorImpl<const SCEV *> &Steps, const SCEV *&Start);
+  bool solveOffsets(const SCEV *Delta, ArrayRef<const SCEV *> Steps,
+                    SmallVectorImpl<int> &Offsets);
+  void findTimeLoop(StencilInfo &Info, const SCEV *OutBase,
+                    ArrayRef<const SCEV *> InBases);
+
+  /// Source spellings of a loop's index and bounds, or placeholders.
+  void getBounds(Loop *L, std::string &Var, std::string &Lo,
+                 std::string &Hi) const;
+};
+
+} // namespace llvm
+
+#endif // LLVM_STENCILANALYSIS_H
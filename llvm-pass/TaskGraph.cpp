@@ -0,0 +1,707 @@
+//===-- TaskGraph.cpp - Function-level task dependence graph ----*- C++ -*-===//
+//
+// Blocks that run on every call, task formation, mod/ref dependences and
+// the critical path
+//
+//===----------------------------------------------------------------------===//
+
+#include "TaskGraph.h"
+#include "PatternDetect.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "task-graph"
+
+// Calls into functions we cannot see, and calls nested deeper than this
+static constexpr uint64_t ExternalCallCost = 100;
+static constexpr unsigned MaxCallDepth = 3;
+// Cheaper calls stay with the task that follows them
+static constexpr uint64_t MinCallTaskCost = 20;
+
+// Instructions that neither take time nor order anything
+static bool isBookkeeping(const Instruction &I) {
+  if (isa<DbgInfoIntrinsic>(I) || I.isLifetimeStartOrEnd())
+    return true;
+  if (auto *II = dyn_cast<IntrinsicInst>(&I))
+    return II->getIntrinsicID() == Intrinsic::assume ||
+           II->getIntrinsicID() == Intrinsic::experimental_noalias_scope_decl;
+  return false;
+}
+
+static bool isAllocationCall(const Function &Callee) {
+  StringRef Name = Callee.getName();
+  return Name == "malloc" || Name == "calloc" || Name == "realloc" ||
+         Name == "free" || Name == "_Znwm" || Name == "_Znam" ||
+         Name == "_ZdlPv" || Name == "_ZdaPv" || Name == "_ZdlPvm";
+}
+
+// Callee without its parameter list
+static std::string getCalleeName(const CallBase &Call) {
+  const Function *Callee = Call.getCalledFunction();
+  if (!Callee)
+    return "indirect call";
+  std::string Name = demangle(Callee->getName().str());
+  size_t Paren = Name.find('(');
+  if (Paren != std::string::npos && Paren > 0)
+    Name.resize(Paren);
+  return Name;
+}
+
+// Blocks on the paths from S to T, without S and T, in function order
+static std::vector<BasicBlock *> getRegion(Function &F, BasicBlock *S,
+                                           BasicBlock *T) {
+  SmallPtrSet<BasicBlock *, 16> Forward, Backward;
+  SmallVector<BasicBlock *, 16> Work(succ_begin(S), succ_end(S));
+  while (!Work.empty()) {
+    BasicBlock *BB = Work.pop_back_val();
+    if (BB == S || BB == T || !Forward.insert(BB).second)
+      continue;
+    Work.append(succ_begin(BB), succ_end(BB));
+  }
+  Work.assign(pred_begin(T), pred_end(T));
+  while (!Work.empty()) {
+    BasicBlock *BB = Work.pop_back_val();
+    if (BB == S || BB == T || !Backward.insert(BB).second)
+      continue;
+    Work.append(pred_begin(BB), pred_end(BB));
+  }
+  std::vector<BasicBlock *> Region;
+  for (BasicBlock &BB : F) {
+    if (Forward.count(&BB) && Backward.count(&BB))
+      Region.push_back(&BB);
+  }
+  return Region;
+}
+
+// Control leaves the region other than to T or to exception handling:
+// an early return or a break out of the function's main path
+static bool leavesRegion(BasicBlock *S, ArrayRef<BasicBlock *> Region,
+                         BasicBlock *T) {
+  auto Leaves = [&](BasicBlock *BB) {
+    for (BasicBlock *Succ : successors(BB)) {
+      if (Succ == T || is_contained(Region, Succ) || Succ->isEHPad() ||
+          isa<UnreachableInst>(Succ->getTerminator()))
+        continue;
+      return true;
+    }
+    return false;
+  };
+  return Leaves(S) || any_of(Region, Leaves);
+}
+
+uint64_t TaskGraphBuilder::estimateCost(Instruction &I, unsigned Depth) {
+  auto *Call = dyn_cast<CallBase>(&I);
+  if (!Call || isa<IntrinsicInst>(Call))
+    return 1;
+  const Function *Callee = Call->getCalledFunction();
+  if (!Callee || Callee->isDeclaration())
+    return ExternalCallCost;
+  return 1 + estimateFunctionCost(*Callee, Depth + 1);
+}
+
+uint64_t TaskGraphBuilder::estimateLoopCost(Loop *L, LoopInfo &Loops,
+                                            ScalarEvolution *Trips,
+                                            unsigned Depth) {
+  uint64_t TripCount = DefaultTripCount;
+  if (Trips) {
+    if (unsigned TC = Trips->getSmallConstantTripCount(L))
+      TripCount = TC;
+  }
+  uint64_t Body = 0;
+  for (BasicBlock *BB : L->blocks()) {
+    if (Loops.getLoopFor(BB) != L)
+      continue;
+    for (Instruction &I : *BB)
+      Body = SaturatingAdd(Body, estimateCost(I, Depth));
+  }
+  for (Loop *Sub : L->getSubLoops())
+    Body = SaturatingAdd(Body, estimateLoopCost(Sub, Loops, Trips, Depth));
+  return SaturatingMultiply(Body, TripCount);
+}
+
+uint64_t TaskGraphBuilder::estimateFunctionCost(const Function &F,
+                                                unsigned Depth) {
+  if (Depth > MaxCallDepth)
+    return ExternalCallCost;
+  auto It = CalleeCosts.find(&F);
+  if (It != CalleeCosts.end())
+    return It->second;
+  // Recursive calls see the external cost
+  CalleeCosts[&F] = ExternalCallCost;
+
+  Function &G = const_cast<Function &>(F);
+  DominatorTree CalleeDT(G);
+  LoopInfo CalleeLI(CalleeDT);
+  uint64_t Cost = 0;
+  for (BasicBlock &BB : G) {
+    if (CalleeLI.getLoopFor(&BB))
+      continue;
+    for (Instruction &I : BB)
+      Cost = SaturatingAdd(Cost, estimateCost(I, Depth));
+  }
+  for (Loop *L : CalleeLI)
+    Cost = SaturatingAdd(Cost, estimateLoopCost(L, CalleeLI, nullptr, Depth));
+  CalleeCosts[&F] = Cost;
+  return Cost;
+}
+
+TaskGraph TaskGraphBuilder::build(Function &F) {
+  TaskGraph G;
+
+  // Blocks that dominate every return run on each call that returns; loops
+  // and branches between two of them form single-entry single-exit regions
+  BasicBlock *Exit = nullptr;
+  for (BasicBlock &BB : F) {
+    if (isa<ReturnInst>(BB.getTerminator()))
+      Exit = Exit ? DT.findNearestCommonDominator(Exit, &BB) : &BB;
+  }
+  if (!Exit) {
+    G.Reason = "function does not return";
+    return G;
+  }
+  std::vector<BasicBlock *> Spine;
+  for (DomTreeNode *N = DT.getNode(Exit); N; N = N->getIDom()) {
+    if (!LI.getLoopFor(N->getBlock()))
+      Spine.push_back(N->getBlock());
+  }
+  std::reverse(Spine.begin(), Spine.end());
+
+  // Loads and stores between tasks join the task that follows them
+  std::vector<Instruction *> Pending;
+  auto AddNode = [&](TaskNode Node) {
+    Node.Insts.insert(Node.Insts.begin(), Pending.begin(), Pending.end());
+    for (Instruction *I : Pending)
+      Node.Cost = SaturatingAdd(Node.Cost, estimateCost(*I, 0));
+    Pending.clear();
+    for (Instruction *I : Node.Insts) {
+      if (auto *Call = dyn_cast<CallBase>(I))
+        Node.MayThrow |= Call->mayThrow();
+      // Lines of F, not of the code inlined into it
+      DILocation *Loc = I->getDebugLoc();
+      while (Loc && Loc->getInlinedAt())
+        Loc = Loc->getInlinedAt();
+      if (!Loc || Loc->getLine() == 0)
+        continue;
+      if (Node.File.empty())
+        Node.File = Loc->getFilename().str();
+      Node.FirstLine = Node.FirstLine ? std::min(Node.FirstLine, Loc->getLine())
+                                      : Loc->getLine();
+      Node.LastLine = std::max(Node.LastLine, Loc->getLine());
+    }
+    G.Nodes.push_back(std::move(Node));
+  };
+
+  for (size_t K = 0; K < Spine.size() && G.Nodes.size() < MaxTasks; ++K) {
+    BasicBlock *S = Spine[K];
+    BasicBlock *T = K + 1 < Spine.size() ? Spine[K + 1] : nullptr;
+    std::vector<BasicBlock *> Region;
+    if (T) {
+      Region = getRegion(F, S, T);
+      // What follows depends on control flow the tasks cannot express
+      if (leavesRegion(S, Region, T))
+        break;
+    }
+
+    for (Instruction &I : *S) {
+      if (isBookkeeping(I) || I.isTerminator())
+        continue;
+      auto *Call = dyn_cast<CallBase>(&I);
+      const Function *Callee = Call ? Call->getCalledFunction() : nullptr;
+      if (Call && !isa<IntrinsicInst>(Call) &&
+          !(Callee && isAllocationCall(*Callee))) {
+        uint64_t Cost = estimateCost(I, 0);
+        if (Cost >= MinCallTaskCost) {
+          TaskNode Node;
+          Node.Kind = "call";
+          Node.Label = getCalleeName(*Call);
+          Node.Insts.push_back(&I);
+          Node.Cost = Cost;
+          AddNode(std::move(Node));
+          continue;
+        }
+      }
+      if (I.mayReadOrWriteMemory())
+        Pending.push_back(&I);
+    }
+
+    // Loops and branches with memory effects become one task each
+    TaskNode Node;
+    bool TouchesMemory = false;
+    for (BasicBlock *BB : Region) {
+      for (Instruction &I : *BB) {
+        if (isBookkeeping(I))
+          continue;
+        TouchesMemory |= I.mayReadOrWriteMemory();
+        Node.Insts.push_back(&I);
+        if (!LI.getLoopFor(BB))
+          Node.Cost = SaturatingAdd(Node.Cost, estimateCost(I, 0));
+      }
+    }
+    if (!TouchesMemory)
+      continue;
+    unsigned Loops = 0;
+    for (Loop *L : LI) {
+      if (is_contained(Region, L->getHeader())) {
+        ++Loops;
+        Node.Cost = SaturatingAdd(Node.Cost, estimateLoopCost(L, LI, SE, 0));
+      }
+    }
+    Node.Kind = Loops ? "loop" : "branch";
+    Node.Label = Loops > 1   ? std::to_string(Loops) + " loop nests"
+                 : Loops     ? "loop nest"
+                             : "conditional code";
+    AddNode(std::move(Node));
+  }
+  if (G.Nodes.empty()) {
+    G.Reason = "no call sites or loop nests on the path every call takes";
+    return G;
+  }
+  for (Instruction *I : Pending) {
+    G.Nodes.back().Insts.push_back(I);
+    G.Nodes.back().Cost = SaturatingAdd(G.Nodes.back().Cost, estimateCost(*I, 0));
+  }
+  Pending.clear();
+
+  computeDependences(G);
+  return G;
+}
+
+// Object whose data a pointer reaches, looking through pointers loaded
+// from memory: the argument, alloca, global or allocation that owns it.
+// Deep is set when a loaded pointer was followed.
+static const Value *getOwner(const Value *Ptr, bool &Deep) {
+  Deep = false;
+  for (unsigned Hops = 0; Hops < 4; ++Hops) {
+    const Value *Object = getUnderlyingObject(Ptr);
+    if (auto *Load = dyn_cast<LoadInst>(Object)) {
+      Ptr = Load->getPointerOperand();
+      Deep = true;
+      continue;
+    }
+    if (isa<Argument>(Object) || isa<AllocaInst>(Object) ||
+        isa<GlobalVariable>(Object) || isNoAliasCall(Object))
+      return Object;
+    return nullptr;
+  }
+  return nullptr;
+}
+
+// Exception plumbing and calls that end the program do not touch the
+// memory the tasks exchange
+static bool isUnwindingCall(const Function &Callee) {
+  StringRef Name = Callee.getName();
+  return Callee.doesNotReturn() || Name.startswith("__cxa_") ||
+         Name.startswith("_Unwind_") || Name == "__clang_call_terminate";
+}
+
+TaskGraphBuilder::ArgumentEffects
+TaskGraphBuilder::getArgumentEffects(const Function &F) {
+  auto It = Effects.find(&F);
+  if (It != Effects.end())
+    return It->second;
+  // Recursive calls may touch anything
+  Effects[&F] = ArgumentEffects();
+
+  ArgumentEffects E;
+  E.ArgumentsOnly = true;
+  E.Args.assign(F.arg_size(), ModRefInfo::NoModRef);
+  // Locals are private to the call; globals and unknown memory are not
+  auto Note = [&](const Value *Ptr, ModRefInfo MR) {
+    bool Deep;
+    const Value *Owner = getOwner(Ptr, Deep);
+    if (auto *Arg = dyn_cast_or_null<Argument>(Owner)) {
+      E.Args[Arg->getArgNo()] = unionModRef(E.Args[Arg->getArgNo()], MR);
+      return true;
+    }
+    return Owner && isa<AllocaInst>(Owner);
+  };
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      if (!I.mayReadOrWriteMemory() || isBookkeeping(I))
+        continue;
+      bool Known = false;
+      if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        Known = Note(Load->getPointerOperand(), ModRefInfo::Ref);
+      } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        Known = Note(Store->getPointerOperand(), ModRefInfo::Mod);
+      } else if (auto *Call = dyn_cast<CallBase>(&I)) {
+        std::vector<ModRefInfo> Args;
+        Known = getCallEffects(*Call, Args);
+        for (unsigned Arg = 0; Known && Arg < Args.size(); ++Arg) {
+          if (Args[Arg] != ModRefInfo::NoModRef)
+            Known = Note(Call->getArgOperand(Arg), Args[Arg]);
+        }
+      }
+      if (!Known) {
+        E.ArgumentsOnly = false;
+        Effects[&F] = E;
+        return E;
+      }
+    }
+  }
+  Effects[&F] = E;
+  return E;
+}
+
+bool TaskGraphBuilder::getCallEffects(const CallBase &Call,
+                                      std::vector<ModRefInfo> &Args) {
+  Args.assign(Call.arg_size(), ModRefInfo::NoModRef);
+  if (isa<MemTransferInst>(&Call)) {
+    Args[0] = ModRefInfo::Mod;
+    Args[1] = ModRefInfo::Ref;
+    return true;
+  }
+  if (isa<MemSetInst>(&Call)) {
+    Args[0] = ModRefInfo::Mod;
+    return true;
+  }
+  const Function *Callee = Call.getCalledFunction();
+  if (!Callee || Callee->isVarArg())
+    return false;
+  if (Call.doesNotAccessMemory() || isAllocationCall(*Callee) ||
+      isUnwindingCall(*Callee))
+    return true;
+  if (Callee->isIntrinsic())
+    return false;
+  if (Callee->isDeclaration()) {
+    if (!Call.onlyAccessesArgMemory())
+      return false;
+    for (unsigned Arg = 0; Arg < Call.arg_size(); ++Arg) {
+      if (Call.getArgOperand(Arg)->getType()->isPointerTy())
+        Args[Arg] = Call.onlyReadsMemory(Arg) ? ModRefInfo::Ref
+                                              : ModRefInfo::ModRef;
+    }
+    return true;
+  }
+  ArgumentEffects E = getArgumentEffects(*Callee);
+  if (!E.ArgumentsOnly)
+    return false;
+  std::copy(E.Args.begin(), E.Args.end(), Args.begin());
+  return true;
+}
+
+/// Memory touched by one instruction of a task.
+struct TaskGraphBuilder::Access {
+  const CallBase *Call = nullptr; // Calls with effects beyond their arguments
+  Optional<MemoryLocation> Loc;   // Loads, stores and call arguments
+  const Value *Owner = nullptr;   // See getOwner
+  bool Deep = false;
+  bool Write = false;
+  std::string Object;             // Name of the owner
+};
+
+static std::string getObjectName(const Value *Ptr) {
+  bool Deep;
+  const Value *Owner = getOwner(Ptr, Deep);
+  return PatternDetection::getVariableName(
+      const_cast<Value *>(Owner ? Owner : getUnderlyingObject(Ptr)));
+}
+
+std::vector<TaskGraphBuilder::Access>
+TaskGraphBuilder::collectAccesses(const TaskNode &Node) {
+  std::vector<Access> Accesses;
+  std::set<std::pair<const Value *, bool>> Whole;
+  // Whole objects for accesses in loops and through call arguments
+  auto AddWhole = [&](const Value *Ptr, bool Write) {
+    Access A;
+    A.Owner = getOwner(Ptr, A.Deep);
+    const Value *Object = getUnderlyingObject(Ptr);
+    if (!Whole.insert({A.Owner ? A.Owner : Object, Write}).second)
+      return;
+    A.Loc = MemoryLocation::getBeforeOrAfter(A.Deep ? Object : Ptr);
+    A.Write = Write;
+    A.Object = getObjectName(Ptr);
+    Accesses.push_back(std::move(A));
+  };
+  for (Instruction *I : Node.Insts) {
+    if (!I->mayReadOrWriteMemory())
+      continue;
+    const Value *Ptr = nullptr;
+    bool Write = false;
+    if (auto *Load = dyn_cast<LoadInst>(I)) {
+      Ptr = Load->getPointerOperand();
+    } else if (auto *Store = dyn_cast<StoreInst>(I)) {
+      Ptr = Store->getPointerOperand();
+      Write = true;
+    } else if (auto *Call = dyn_cast<CallBase>(I)) {
+      std::vector<ModRefInfo> Args;
+      if (!getCallEffects(*Call, Args)) {
+        Access A;
+        A.Call = Call;
+        Accesses.push_back(std::move(A));
+        continue;
+      }
+      for (unsigned Arg = 0; Arg < Args.size(); ++Arg) {
+        if (isRefSet(Args[Arg]))
+          AddWhole(Call->getArgOperand(Arg), false);
+        if (isModSet(Args[Arg]))
+          AddWhole(Call->getArgOperand(Arg), true);
+      }
+      continue;
+    } else {
+      // Atomics and fences order everything
+      Accesses.push_back(Access());
+      continue;
+    }
+    if (LI.getLoopFor(I->getParent())) {
+      AddWhole(Ptr, Write);
+      continue;
+    }
+    Access A;
+    A.Owner = getOwner(Ptr, A.Deep);
+    A.Loc = MemoryLocation::get(I);
+    A.Write = Write;
+    A.Object = getObjectName(Ptr);
+    Accesses.push_back(std::move(A));
+  }
+  return Accesses;
+}
+
+bool TaskGraphBuilder::mayConflict(const Access &X, const Access &Y) {
+  if ((!X.Call && !X.Loc) || (!Y.Call && !Y.Loc))
+    return true;
+  if (X.Loc && Y.Loc) {
+    if (!X.Write && !Y.Write)
+      return false;
+    // Through loaded pointers, compare the objects that own the data
+    if ((X.Deep || Y.Deep) && X.Owner && Y.Owner) {
+      if (X.Owner == Y.Owner)
+        return true;
+      if (isIdentifiedObject(X.Owner) && isIdentifiedObject(Y.Owner))
+        return false;
+      return !AA.isNoAlias(MemoryLocation::getBeforeOrAfter(X.Owner),
+                           MemoryLocation::getBeforeOrAfter(Y.Owner));
+    }
+    return !AA.isNoAlias(*X.Loc, *Y.Loc);
+  }
+  if (X.Call && Y.Call)
+    return isModSet(AA.getModRefInfo(X.Call, Y.Call)) ||
+           isModSet(AA.getModRefInfo(Y.Call, X.Call));
+  const Access &C = X.Call ? X : Y;
+  const Access &M = X.Call ? Y : X;
+  ModRefInfo MR = AA.getModRefInfo(C.Call, *M.Loc);
+  return M.Write ? isModOrRefSet(MR) : isModSet(MR);
+}
+
+void TaskGraphBuilder::computeDependences(TaskGraph &G) {
+  const unsigned N = G.Nodes.size();
+  DenseMap<const Instruction *, unsigned> Owner;
+  for (unsigned K = 0; K < N; ++K) {
+    for (Instruction *I : G.Nodes[K].Insts)
+      Owner[I] = K;
+  }
+
+  // Tasks whose results reach a value through instructions outside tasks
+  DenseMap<const Value *, BitVector> Carried;
+  std::function<BitVector(const Value *)> Sources =
+      [&](const Value *V) -> BitVector {
+    BitVector Result(N);
+    auto *I = dyn_cast<Instruction>(V);
+    if (!I)
+      return Result;
+    auto O = Owner.find(I);
+    if (O != Owner.end()) {
+      Result.set(O->second);
+      return Result;
+    }
+    auto C = Carried.find(I);
+    if (C != Carried.end())
+      return C->second;
+    Carried[I] = Result;
+    for (const Value *Op : I->operands())
+      Result |= Sources(Op);
+    Carried[I] = Result;
+    return Result;
+  };
+
+  std::vector<std::vector<Access>> Accesses;
+  for (TaskNode &Node : G.Nodes) {
+    Accesses.push_back(collectAccesses(Node));
+    std::set<std::string> Reads, Writes;
+    for (const Access &A : Accesses.back()) {
+      if (A.Loc && !A.Object.empty())
+        (A.Write ? Writes : Reads).insert(A.Object);
+    }
+    Node.Reads.assign(Reads.begin(), Reads.end());
+    Node.Writes.assign(Writes.begin(), Writes.end());
+  }
+
+  // Direct dependences with what causes them
+  std::vector<std::map<unsigned, std::string>> Direct(N);
+  for (unsigned B = 0; B < N; ++B) {
+    for (Instruction *I : G.Nodes[B].Insts) {
+      for (const Value *Op : I->operands()) {
+        BitVector From = Sources(Op);
+        for (unsigned A : From.set_bits()) {
+          if (A >= B || Direct[B].count(A))
+            continue;
+          std::string Name = PatternDetection::getVariableName(const_cast<Value *>(Op));
+          Direct[B][A] = Name.empty() ? "result of " + G.Nodes[A].Label : Name;
+        }
+      }
+    }
+    for (unsigned A = 0; A < B; ++A) {
+      if (Direct[B].count(A))
+        continue;
+      for (const Access &X : Accesses[A]) {
+        auto Y = find_if(Accesses[B],
+                         [&](const Access &Y) { return mayConflict(X, Y); });
+        if (Y == Accesses[B].end())
+          continue;
+        std::string Object = !X.Object.empty() ? X.Object : Y->Object;
+        Direct[B][A] = Object.empty() ? "memory" : Object;
+        break;
+      }
+    }
+  }
+
+  // Transitive reduction in program order: a later predecessor that
+  // already follows an earlier one makes the earlier edge redundant
+  G.Ancestors.assign(N, BitVector(N));
+  std::vector<uint64_t> Finish(N, 0);
+  std::vector<int> Via(N, -1);
+  std::vector<unsigned> Depth(N, 0);
+  for (unsigned B = 0; B < N; ++B) {
+    TaskNode &Node = G.Nodes[B];
+    for (auto It = Direct[B].rbegin(); It != Direct[B].rend(); ++It) {
+      unsigned A = It->first;
+      if (G.Ancestors[B].test(A))
+        continue;
+      Node.Preds.push_back(A);
+      Node.Causes.push_back(It->second);
+      G.Ancestors[B].set(A);
+      G.Ancestors[B] |= G.Ancestors[A];
+      if (Finish[A] > Finish[B] || Via[B] < 0) {
+        Finish[B] = Finish[A];
+        Via[B] = A;
+      }
+      Depth[B] = std::max(Depth[B], Depth[A] + 1);
+    }
+    std::reverse(Node.Preds.begin(), Node.Preds.end());
+    std::reverse(Node.Causes.begin(), Node.Causes.end());
+    Finish[B] = SaturatingAdd(Finish[B], std::max<uint64_t>(Node.Cost, 1));
+    G.Work = SaturatingAdd(G.Work, std::max<uint64_t>(Node.Cost, 1));
+  }
+
+  unsigned Last = std::max_element(Finish.begin(), Finish.end()) - Finish.begin();
+  G.Span = Finish[Last];
+  for (int K = Last; K >= 0; K = Via[K])
+    G.CriticalPath.insert(G.CriticalPath.begin(), K);
+  G.Parallelism = static_cast<double>(G.Work) / G.Span;
+  std::map<unsigned, unsigned> PerDepth;
+  for (unsigned D : Depth)
+    G.Width = std::max(G.Width, ++PerDepth[D]);
+
+  std::ostringstream Reason;
+  Reason << N << " tasks over call sites and loop nests, up to " << G.Width
+         << " at a time; estimated parallelism " << std::fixed
+         << std::setprecision(1) << G.Parallelism;
+  G.Reason = Reason.str();
+}
+
+bool TaskGraphBuilder::isProfitable(const TaskGraph &G) {
+  if (G.Nodes.size() < 2 || G.Parallelism < 1.2)
+    return false;
+  for (unsigned B = 1; B < G.Nodes.size(); ++B) {
+    if (G.Nodes[B].Cost < MinTaskCost)
+      continue;
+    for (unsigned A = 0; A < B; ++A) {
+      if (G.Nodes[A].Cost >= MinTaskCost && !G.Ancestors[B].test(A))
+        return true;
+    }
+  }
+  return false;
+}
+
+static std::string describeLines(const TaskNode &Node) {
+  if (!Node.FirstLine)
+    return "no source location";
+  if (Node.FirstLine == Node.LastLine)
+    return "line " + std::to_string(Node.FirstLine);
+  return "lines " + std::to_string(Node.FirstLine) + "-" +
+         std::to_string(Node.LastLine);
+}
+
+static std::string joinNames(const std::vector<std::string> &Names) {
+  std::string Text;
+  for (const std::string &Name : Names)
+    Text += (Text.empty() ? "" : ", ") + Name;
+  return Text;
+}
+
+std::string TaskGraphBuilder::generatePatch(const TaskGraph &G) {
+  const size_t N = G.Nodes.size();
+  std::ostringstream OS;
+  OS << "// ✅ Task graph: " << N << " tasks, up to " << G.Width
+     << " at a time, estimated parallelism " << std::fixed
+     << std::setprecision(1) << G.Parallelism << "\n";
+  OS << "// Critical path: task";
+  for (size_t K = 0; K < G.CriticalPath.size(); ++K)
+    OS << (K ? " -> " : " ") << G.CriticalPath[K];
+  OS << " (" << std::setprecision(0) << 100.0 * G.Span / G.Work
+     << "% of the estimated work)\n";
+  OS << "// A task follows the earlier tasks whose results it uses or whose "
+        "memory it may read or overwrite\n";
+  OS << "#pragma omp parallel\n"
+        "#pragma omp single\n"
+        "{\n"
+        "    char dep["
+     << N << "];  // dep[k]: out for task k, in for the tasks after it\n"
+     << "    #pragma omp taskgroup\n"
+        "    {\n";
+  bool MayThrow = false;
+  for (size_t K = 0; K < N; ++K) {
+    const TaskNode &Node = G.Nodes[K];
+    MayThrow |= Node.MayThrow;
+    OS << "        // Task " << K << ": " << Node.Label << ", "
+       << describeLines(Node);
+    if (!Node.Reads.empty())
+      OS << " - reads " << joinNames(Node.Reads);
+    if (!Node.Writes.empty())
+      OS << (Node.Reads.empty() ? " - writes " : "; writes ")
+         << joinNames(Node.Writes);
+    OS << "\n";
+    if (!Node.Preds.empty()) {
+      OS << "        // after";
+      for (size_t P = 0; P < Node.Preds.size(); ++P)
+        OS << (P ? ", " : " ") << "task " << Node.Preds[P] << " ("
+           << Node.Causes[P] << ")";
+      OS << "\n";
+    }
+    OS << "        #pragma omp task";
+    if (!Node.Preds.empty()) {
+      OS << " depend(in:";
+      for (size_t P = 0; P < Node.Preds.size(); ++P)
+        OS << (P ? ", " : " ") << "dep[" << Node.Preds[P] << "]";
+      OS << ")";
+    }
+    OS << " depend(out: dep[" << K << "])\n";
+    OS << "        { /* " << describeLines(Node) << " */ }\n";
+  }
+  OS << "    }\n"
+        "}\n";
+  OS << "// Note: declare the variables tasks assign before the parallel "
+        "region so they are shared,\n"
+        "// and move statements that read a task's results into the task "
+        "that follows it";
+  if (MayThrow)
+    OS << "\n// Note: an exception must not escape a task - catch it inside";
+  return OS.str();
+}
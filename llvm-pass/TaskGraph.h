@@ -0,0 +1,112 @@
+//===-- TaskGraph.h - Function-level task dependence graph ------*- C++ -*-===//
+//
+// Splits the part of a function that runs on every call into tasks - call
+// sites and top-level loop nests, with the loads and stores around them -
+// and orders two tasks when one may write memory the other reads or writes
+// (mod/ref through alias analysis) or uses a value the other computes.
+// Tasks without a path between them can run concurrently as OpenMP tasks
+// ordered by depend clauses.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TASKGRAPH_H
+#define LLVM_TASKGRAPH_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/Dominators.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// A call site, or the loops and branches between two blocks that run on
+/// every call, with the memory accesses that precede it.
+struct TaskNode {
+  std::string Kind;   // "call", "loop" or "branch"
+  std::string Label;  // Callee, or a summary of the region
+  std::string File;
+  unsigned FirstLine = 0, LastLine = 0;
+  std::vector<Instruction *> Insts;
+  std::vector<std::string> Reads, Writes; // Named objects touched
+  uint64_t Cost = 0;                      // Estimated dynamic instructions
+  bool MayThrow = false;
+  /// Earlier tasks this one must follow, transitively reduced.
+  std::vector<unsigned> Preds;
+  /// Objects or values behind each entry of Preds.
+  std::vector<std::string> Causes;
+};
+
+struct TaskGraph {
+  std::vector<TaskNode> Nodes; // In program order
+  uint64_t Work = 0;           // Sum of the task costs
+  uint64_t Span = 0;           // Costliest dependence chain
+  std::vector<unsigned> CriticalPath;
+  double Parallelism = 0;      // Work / Span
+  /// Most tasks at the same depth of the graph.
+  unsigned Width = 0;
+  /// Per task, the tasks that must finish before it starts.
+  std::vector<BitVector> Ancestors;
+  std::string Reason;
+};
+
+class TaskGraphBuilder {
+public:
+  /// \p SE may be null. Loops without a constant trip count from it are
+  /// assumed to run DefaultTripCount iterations.
+  TaskGraphBuilder(AAResults &AA, DominatorTree &DT, LoopInfo &LI,
+                   ScalarEvolution *SE)
+    : AA(AA), DT(DT), LI(LI), SE(SE) {}
+
+  /// Tasks and dependences of the blocks of \p F that run on every call.
+  TaskGraph build(Function &F);
+
+  /// Two tasks of at least MinTaskCost may overlap and the graph is wider
+  /// than a chain.
+  static bool isProfitable(const TaskGraph &G);
+
+  /// taskgroup of omp task depend(in/out) over per-task tokens.
+  static std::string generatePatch(const TaskGraph &G);
+
+  static constexpr uint64_t DefaultTripCount = 1000;
+  static constexpr uint64_t MinTaskCost = 5000;
+  static constexpr unsigned MaxTasks = 64;
+
+private:
+  AAResults &AA;
+  DominatorTree &DT;
+  LoopInfo &LI;
+  ScalarEvolution *SE;
+  DenseMap<const Function *, uint64_t> CalleeCosts;
+
+  /// Mod/ref of a function through each pointer argument, including the
+  /// data reached through pointers loaded from it. ArgumentsOnly is false
+  /// when it may touch globals or memory of unknown origin.
+  struct ArgumentEffects {
+    bool ArgumentsOnly = false;
+    std::vector<ModRefInfo> Args;
+  };
+  DenseMap<const Function *, ArgumentEffects> Effects;
+  ArgumentEffects getArgumentEffects(const Function &F);
+  /// Per-argument effects of \p Call; false when it is not limited to
+  /// memory reached from its arguments.
+  bool getCallEffects(const CallBase &Call, std::vector<ModRefInfo> &Args);
+
+  struct Access;
+  std::vector<Access> collectAccesses(const TaskNode &Node);
+  bool mayConflict(const Access &X, const Access &Y);
+
+  uint64_t estimateLoopCost(Loop *L, LoopInfo &Loops, ScalarEvolution *Trips,
+                            unsigned Depth);
+  uint64_t estimateCost(Instruction &I, unsigned Depth);
+  uint64_t estimateFunctionCost(const Function &F, unsigned Depth);
+  void computeDependences(TaskGraph &G);
+};
+
+} // namespace llvm
+
+#endif // LLVM_TASKGRAPH_H
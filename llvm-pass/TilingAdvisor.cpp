@@ -0,0 +1,325 @@
+//===-- TilingAdvisor.cpp - Cache-aware loop tiling advisor ----*- C++ -*-===//
+//
+// Reuse analysis, working-set model and tile size selection
+//
+//===----------------------------------------------------------------------===//
+
+#include "TilingAdvisor.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tiling-advisor"
+
+static std::string readSysfsValue(const std::string &Path) {
+  std::ifstream File(Path);
+  std::string Value;
+  if (File.good())
+    std::getline(File, Value);
+  return Value;
+}
+
+std::string llvm::formatBytes(uint64_t Bytes) {
+  std::ostringstream OS;
+  OS.setf(std::ios::fixed);
+  OS.precision(1);
+  if (Bytes >= 1024 * 1024)
+    OS << Bytes / (1024.0 * 1024.0) << " MiB";
+  else
+    OS << Bytes / 1024.0 << " KiB";
+  return OS.str();
+}
+
+uint64_t CacheModel::parseSize(StringRef Text) {
+  Text = Text.trim();
+  uint64_t Scale = 1;
+  // "KiB", "KB" and "K" are all accepted
+  if (!Text.consume_back_insensitive("ib"))
+    Text.consume_back_insensitive("b");
+  if (Text.consume_back_insensitive("k"))
+    Scale = 1024;
+  else if (Text.consume_back_insensitive("m"))
+    Scale = 1024 * 1024;
+  else if (Text.consume_back_insensitive("g"))
+    Scale = 1024 * 1024 * 1024;
+
+  uint64_t Value = 0;
+  if (Text.trim().getAsInteger(10, Value))
+    return 0;
+  return Value * Scale;
+}
+
+CacheModel CacheModel::detect() {
+  CacheModel Model;
+  for (unsigned Index = 0; Index < 8; ++Index) {
+    std::string Dir =
+        "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(Index);
+    std::string Type = readSysfsValue(Dir + "/type");
+    if (Type.empty())
+      break;
+    if (Type == "Instruction")
+      continue;
+
+    uint64_t Size = parseSize(readSysfsValue(Dir + "/size"));
+    uint64_t Line = parseSize(readSysfsValue(Dir + "/coherency_line_size"));
+    std::string Level = readSysfsValue(Dir + "/level");
+    if (Size == 0)
+      continue;
+
+    if (Level == "1") {
+      Model.L1Size = Size;
+      if (Line)
+        Model.LineSize = Line;
+    } else if (Level == "2") {
+      Model.L2Size = Size;
+    } else if (Level == "3") {
+      Model.L3Size = Size;
+    }
+  }
+  LLVM_DEBUG(dbgs() << "Cache model: L1=" << Model.L1Size << " L2="
+                    << Model.L2Size << " L3=" << Model.L3Size
+                    << " line=" << Model.LineSize << "\n");
+  return Model;
+}
+
+void TilingAdvisor::collectGroups(const PerfectNestInfo &Nest) {
+  Groups.clear();
+  const unsigned BandSize = Nest.Band.size();
+  const DataLayout &DL =
+      Nest.Band.front()->getHeader()->getModule()->getDataLayout();
+
+  for (BasicBlock *BB : Nest.Band.back()->blocks()) {
+    for (Instruction &I : *BB) {
+      Value *Ptr = getLoadStorePointerOperand(&I);
+      if (!Ptr)
+        continue;
+
+      const SCEV *S = SE.getSCEV(Ptr);
+      const SCEV *Base = SE.getPointerBase(S);
+      std::vector<Optional<int64_t>> Strides(BandSize);
+      for (unsigned K = 0; K < BandSize; ++K)
+        Strides[K] = getAccessStride(SE, Ptr, Nest.Band[K]);
+
+      // Join a group of the same array whose address differs by a constant
+      AccessGroup *Match = nullptr;
+      int64_t Diff = 0;
+      for (AccessGroup &G : Groups) {
+        if (G.Base != Base || G.Strides != Strides)
+          continue;
+        if (auto *C = dyn_cast<SCEVConstant>(SE.getMinusSCEV(S, G.First))) {
+          Match = &G;
+          Diff = C->getAPInt().getSExtValue();
+          break;
+        }
+      }
+
+      if (!Match) {
+        AccessGroup G;
+        G.Base = Base;
+        G.First = S;
+        G.ElemSize = DL.getTypeStoreSize(getLoadStoreType(&I)).getFixedSize();
+        G.Strides = std::move(Strides);
+        G.MinOffset.assign(BandSize, 0);
+        G.MaxOffset.assign(BandSize, 0);
+        Groups.push_back(std::move(G));
+        continue;
+      }
+
+      // Express the byte offset in iterations of each level, widest first
+      std::vector<unsigned> Order;
+      for (unsigned K = 0; K < BandSize; ++K)
+        if (Match->Strides[K] && *Match->Strides[K] != 0)
+          Order.push_back(K);
+      std::sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+        return std::abs(*Match->Strides[A]) > std::abs(*Match->Strides[B]);
+      });
+      for (unsigned K : Order) {
+        int64_t Offset = Diff / *Match->Strides[K];
+        Diff -= Offset * *Match->Strides[K];
+        Match->MinOffset[K] = std::min(Match->MinOffset[K], Offset);
+        Match->MaxOffset[K] = std::max(Match->MaxOffset[K], Offset);
+      }
+    }
+  }
+}
+
+bool TilingAdvisor::isFullyPermutable(const PerfectNestInfo &Nest) const {
+  for (const auto &Vec : Nest.Directions) {
+    unsigned NonEqual = 0;
+    bool HasBackward = false;
+    for (unsigned Dir : Vec) {
+      if (Dir != Dependence::DVEntry::EQ)
+        ++NonEqual;
+      HasBackward |= (Dir & Dependence::DVEntry::GT) != 0;
+    }
+    // A dependence between iterations that differ in a single level keeps
+    // its order under strip-mining, whatever its direction.
+    if (NonEqual > 1 && HasBackward)
+      return false;
+  }
+  return true;
+}
+
+uint64_t TilingAdvisor::footprint(const std::vector<unsigned> &Tiles) const {
+  uint64_t Total = 0;
+  for (const AccessGroup &G : Groups) {
+    // The level with the smallest sub-line stride is laid out contiguously
+    int Contiguous = -1;
+    for (unsigned K = 0; K < Tiles.size(); ++K) {
+      if (!G.Strides[K] || *G.Strides[K] == 0)
+        continue;
+      uint64_t Stride = std::abs(*G.Strides[K]);
+      if (Stride < Cache.LineSize &&
+          (Contiguous < 0 || Stride < (uint64_t)std::abs(*G.Strides[Contiguous])))
+        Contiguous = K;
+    }
+
+    uint64_t Lines = 1;
+    for (unsigned K = 0; K < Tiles.size(); ++K) {
+      if ((int)K == Contiguous || (G.Strides[K] && *G.Strides[K] == 0))
+        continue;
+      Lines *= Tiles[K] + (G.MaxOffset[K] - G.MinOffset[K]);
+    }
+
+    uint64_t RowBytes = Cache.LineSize;
+    if (Contiguous >= 0) {
+      uint64_t Extent = Tiles[Contiguous] + (G.MaxOffset[Contiguous] -
+                                             G.MinOffset[Contiguous]);
+      uint64_t Bytes = Extent * std::abs(*G.Strides[Contiguous]);
+      RowBytes = alignTo(std::max<uint64_t>(Bytes, G.ElemSize), Cache.LineSize);
+    }
+    Total += Lines * RowBytes;
+  }
+  return Total;
+}
+
+unsigned TilingAdvisor::pickTile(const std::vector<bool> &Tiled,
+                                 uint64_t Budget, unsigned Min,
+                                 uint64_t &Footprint) const {
+  unsigned Best = 0;
+  for (unsigned Tile = Min; Tile <= 1024; Tile *= 2) {
+    std::vector<unsigned> Tiles(Tiled.size(), 1);
+    for (unsigned K = 0; K < Tiled.size(); ++K)
+      if (Tiled[K])
+        Tiles[K] = Tile;
+    uint64_t Bytes = footprint(Tiles);
+    if (Bytes > Budget)
+      break;
+    Best = Tile;
+    Footprint = Bytes;
+  }
+  return Best;
+}
+
+TilingAdvice TilingAdvisor::advise(const PerfectNestInfo &Nest) {
+  TilingAdvice Advice;
+  const unsigned BandSize = Nest.Band.size();
+  if (BandSize < 2) {
+    Advice.Reason = "Tiling needs a perfect band of at least two loops";
+    return Advice;
+  }
+  if (Nest.NonRectangular) {
+    Advice.Reason = "Tiling needs a rectangular band";
+    return Advice;
+  }
+
+  collectGroups(Nest);
+  Advice.Legal = isFullyPermutable(Nest);
+
+  // A level carries reuse if some array is invariant in it while moving in
+  // another level (temporal), or is touched at several offsets along it
+  // (group reuse, e.g. stencil neighbours).
+  Advice.CarriesReuse.assign(BandSize, false);
+  uint64_t MinElem = Cache.LineSize;
+  for (const AccessGroup &G : Groups) {
+    MinElem = std::min(MinElem, G.ElemSize);
+    bool Varies = false;
+    for (unsigned K = 0; K < BandSize; ++K)
+      Varies |= !G.Strides[K] || *G.Strides[K] != 0;
+    for (unsigned K = 0; K < BandSize; ++K) {
+      bool Invariant = G.Strides[K] && *G.Strides[K] == 0;
+      if ((Invariant && Varies) || G.MaxOffset[K] > G.MinOffset[K])
+        Advice.CarriesReuse[K] = true;
+    }
+  }
+  Advice.Profitable = std::any_of(Advice.CarriesReuse.begin(),
+                                  Advice.CarriesReuse.end(),
+                                  [](bool Reuse) { return Reuse; });
+
+  // One cache line of the narrowest element is the smallest useful tile
+  unsigned MinTile = std::max<uint64_t>(4, Cache.LineSize / std::max<uint64_t>(MinElem, 1));
+  std::vector<bool> Tiled(BandSize, true);
+  unsigned L1Tile = pickTile(Tiled, Cache.L1Size / 2, MinTile, Advice.L1Footprint);
+  unsigned L2Tile = 0;
+  if (L1Tile)
+    L2Tile = pickTile(Tiled, Cache.L2Size / 2, L1Tile, Advice.L2Footprint);
+  if (!L1Tile) {
+    Advice.Profitable = false;
+    Advice.Reason = "Even the smallest tile exceeds half of L1";
+    return Advice;
+  }
+  Advice.L1Tiles.assign(BandSize, L1Tile);
+  Advice.L2Tiles.assign(BandSize, std::max(L2Tile, L1Tile));
+
+  std::ostringstream Reason;
+  Reason << "L1 tile " << L1Tile << " (" << formatBytes(Advice.L1Footprint)
+         << " of " << formatBytes(Cache.L1Size) << " L1), L2 tile "
+         << Advice.L2Tiles.front() << " (" << formatBytes(Advice.L2Footprint)
+         << " of " << formatBytes(Cache.L2Size) << " L2)";
+  if (!Advice.Legal)
+    Reason << "; band is not fully permutable";
+  else if (!Advice.Profitable)
+    Reason << "; no level carries reuse";
+  Advice.Reason = Reason.str();
+  return Advice;
+}
+
+std::string TilingAdvisor::generateTiledSkeleton(
+    const PerfectNestInfo &Nest, const TilingAdvice &Advice) const {
+  std::ostringstream Code;
+  const unsigned BandSize = Nest.Band.size();
+  if (!Advice.Legal || !Advice.Profitable || Advice.L1Tiles.empty())
+    return "";
+
+  Code << "// Cache-tiled version - " << Advice.Reason << "\n";
+  Code << "// Levels:";
+  for (unsigned K = 0; K < BandSize; ++K) {
+    Code << " i" << K << "=";
+    if (DebugLoc Loc = Nest.Band[K]->getStartLoc())
+      Code << "line " << Loc.getLine();
+    else
+      Code << "depth " << Nest.Band[K]->getLoopDepth();
+  }
+  Code << "\n";
+
+  unsigned Collapse = std::min<unsigned>(Nest.CollapseDepth, BandSize);
+  if (Collapse > 1)
+    Code << "#pragma omp parallel for collapse(" << Collapse << ")\n";
+  else if (Collapse == 1)
+    Code << "#pragma omp parallel for\n";
+
+  std::string Indent;
+  for (unsigned K = 0; K < BandSize; ++K) {
+    Code << Indent << "for (long i" << K << "t = lb" << K << "; i" << K
+         << "t < ub" << K << "; i" << K << "t += " << Advice.L1Tiles[K]
+         << ")\n";
+    Indent += "  ";
+  }
+  // Point loops follow the unit-stride order; tiling already requires the
+  // band to be fully permutable.
+  for (unsigned K : Nest.RecommendedOrder) {
+    Code << Indent << "for (long i" << K << " = i" << K << "t; i" << K
+         << " < std::min(i" << K << "t + " << Advice.L1Tiles[K] << "L, ub"
+         << K << "); ++i" << K << ")\n";
+    Indent += "  ";
+  }
+  Code << Indent << "/* original loop body */";
+  return Code.str();
+}
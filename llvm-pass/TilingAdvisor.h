@@ -0,0 +1,94 @@
+//===-- TilingAdvisor.h - Cache-aware loop tiling advisor ------*- C++ -*-===//
+//
+// Picks L1/L2 tile sizes for a perfect loop band from a simple cache model
+// and the SCEV access functions of the band, and renders a tiled skeleton.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TILINGADVISOR_H
+#define LLVM_TILINGADVISOR_H
+
+#include "PerfectNestAnalysis.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/// Data cache sizes in bytes used to size tiles.
+struct CacheModel {
+  uint64_t L1Size = 32 * 1024;
+  uint64_t L2Size = 1024 * 1024;
+  uint64_t L3Size = 8 * 1024 * 1024;
+  uint64_t LineSize = 64;
+
+  /// Read the data/unified caches of cpu0 from /sys/devices/system/cpu.
+  /// Levels that cannot be read keep their defaults.
+  static CacheModel detect();
+
+  /// Parse a size such as "32768", "32K" or "1M". Returns 0 on error.
+  static uint64_t parseSize(StringRef Text);
+};
+
+/// "48.0 KiB" / "1.5 MiB" for reasons and patch comments.
+std::string formatBytes(uint64_t Bytes);
+
+/// Tiling recommendation for one perfect band.
+struct TilingAdvice {
+  bool Profitable = false;     // Some band level carries reuse
+  bool Legal = false;          // Band is fully permutable
+  std::vector<bool> CarriesReuse;   // Per band level
+  std::vector<unsigned> L1Tiles;    // Per band level
+  std::vector<unsigned> L2Tiles;    // Per band level
+  uint64_t L1Footprint = 0;    // Working set of one L1 tile in bytes
+  uint64_t L2Footprint = 0;    // Working set of one L2 tile in bytes
+  std::string Reason;
+};
+
+/// Reuse and working-set based tiling advisor.
+class TilingAdvisor {
+public:
+  TilingAdvisor(ScalarEvolution &SE, const CacheModel &Cache)
+    : SE(SE), Cache(Cache) {}
+
+  /// Compute per-level reuse and tile sizes for the band of \p Nest.
+  TilingAdvice advise(const PerfectNestInfo &Nest);
+
+  /// Render the tiled loop skeleton, parallelizing the tile loops that the
+  /// nest analysis proved dependence free.
+  std::string generateTiledSkeleton(const PerfectNestInfo &Nest,
+                                    const TilingAdvice &Advice) const;
+
+private:
+  /// One group of references to the same array that differ only by
+  /// constant offsets, e.g. the neighbours of a stencil.
+  struct AccessGroup {
+    const SCEV *Base = nullptr;
+    const SCEV *First = nullptr;
+    uint64_t ElemSize = 0;
+    std::vector<Optional<int64_t>> Strides;  // Per band level, bytes
+    std::vector<int64_t> MinOffset;          // Per band level, iterations
+    std::vector<int64_t> MaxOffset;
+  };
+
+  ScalarEvolution &SE;
+  CacheModel Cache;
+  std::vector<AccessGroup> Groups;
+
+  void collectGroups(const PerfectNestInfo &Nest);
+  bool isFullyPermutable(const PerfectNestInfo &Nest) const;
+
+  /// Bytes touched by one tile of the given per-level sizes.
+  uint64_t footprint(const std::vector<unsigned> &Tiles) const;
+
+  /// Largest uniform tile (power of two, at least \p Min) whose footprint
+  /// fits in \p Budget bytes for the levels marked in \p Tiled.
+  unsigned pickTile(const std::vector<bool> &Tiled, uint64_t Budget,
+                    unsigned Min, uint64_t &Footprint) const;
+};
+
+} // namespace llvm
+
+#endif // LLVM_TILINGADVISOR_H
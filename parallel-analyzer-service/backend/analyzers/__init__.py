@@ -6,11 +6,15 @@ Enhanced components:
 - ConfidenceAnalyzer: Skip low-confidence candidates with OpenMP validation
 - PatternCache: Cache AI responses for similar patterns
 - OpenMPValidator: Validate pragmas against official OpenMP specification
+- LoopProfile: Rank candidates by measured loop time
+- DependenceProfile: Conflicts observed at run time by the shadow-memory profiler
 """
 
 from .hotspot_analyzer import HotspotAnalyzer, LoopHotspot
 from .confidence_analyzer import ConfidenceAnalyzer, ConfidenceLevel
 from .pattern_cache import PatternCache, CodePattern, CachedAnalysis
+from .loop_profile import LoopProfile, LoopProfileEntry
+from .dependence_profile import DependenceProfile
 
 # OpenMP validator may not be available if examples aren't downloaded
 try:
@@ -19,11 +23,13 @@ try:
         'HotspotAnalyzer', 'LoopHotspot',
         'ConfidenceAnalyzer', 'ConfidenceLevel', 
         'PatternCache', 'CodePattern', 'CachedAnalysis',
+        'LoopProfile', 'LoopProfileEntry', 'DependenceProfile',
         'OpenMPSpecValidator', 'ValidationStatus'
     ]
 except ImportError:
     __all__ = [
         'HotspotAnalyzer', 'LoopHotspot',
         'ConfidenceAnalyzer', 'ConfidenceLevel', 
-        'PatternCache', 'CodePattern', 'CachedAnalysis'
+        'PatternCache', 'CodePattern', 'CachedAnalysis',
+        'LoopProfile', 'LoopProfileEntry', 'DependenceProfile'
     ]
\ No newline at end of file
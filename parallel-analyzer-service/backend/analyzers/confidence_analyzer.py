@@ -254,6 +254,18 @@ class ConfidenceAnalyzer:
         elif any(hint in function_name for hint in ['compute', 'process', 'calculate', 'transform']):
             modifier += 0.05  # More confidence in computational functions
         
+        # Run-time evidence from the shadow-memory dependence profiler
+        observed = candidate.get('dynamic_dependences')
+        if observed:
+            verdict = observed.get('verdict')
+            if verdict == 'dependent':
+                modifier -= 0.3
+            elif verdict == 'privatizable':
+                modifier += 0.05
+            elif not observed.get('unobserved_calls'):
+                modifier += 0.15
+            logger.debug(f"Dependence profile: {observed.get('summary', verdict)}")
+        
         return modifier
     
     def _validate_openmp_compliance(self, candidate: Dict[str, Any]) -> Dict[str, Any]:
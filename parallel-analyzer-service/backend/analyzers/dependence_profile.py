@@ -0,0 +1,120 @@
+"""
+Dependence Profile - Run-time evidence for undecided loops
+
+Programs built with the parallel-deps instrumentation pass and linked with
+runtime/dependence_profile.cpp record, for each watched loop, the
+cross-iteration RAW/WAR/WAW conflicts observed in a shadow-memory table.
+This module loads those reports and attaches them to the candidates with
+the same "file:line:function" id, so a loop the static detector could only
+call risky carries "no conflicts observed across N executions" or the
+conflicting source lines.
+"""
+
+import json
+import logging
+import os
+from typing import List, Dict, Any, Optional
+
+logger = logging.getLogger(__name__)
+
+
+class DependenceProfile:
+    """Observed conflicts per loop, summed over one or more runs"""
+
+    def __init__(self):
+        self.loops: Dict[str, Dict[str, Any]] = {}
+
+    @classmethod
+    def load(cls, *paths: str) -> "DependenceProfile":
+        """Load and merge reports; unreadable files are skipped"""
+        profile = cls()
+        for path in paths:
+            try:
+                with open(path, "r") as f:
+                    profile.add(json.load(f))
+            except (OSError, ValueError) as e:
+                logger.error(f"Failed to load dependence profile {path}: {e}")
+        logger.info(f"Loaded dependence profile: {len(profile.loops)} loops")
+        return profile
+
+    @classmethod
+    def from_environment(cls) -> Optional["DependenceProfile"]:
+        """Reports named by PARALLEL_DEPS_PROFILE (os.pathsep separated), if set"""
+        paths = [p for p in os.environ.get("PARALLEL_DEPS_PROFILE", "").split(os.pathsep) if p]
+        return cls.load(*paths) if paths else None
+
+    def add(self, data: Dict[str, Any]):
+        for loop in data.get("loops", []):
+            known = self.loops.get(loop.get("id", ""))
+            if not known:
+                self.loops[loop.get("id", "")] = dict(loop, conflicts=list(loop.get("conflicts", [])))
+                continue
+            for key in ("executions", "iterations", "accesses", "raw", "war", "waw", "shared_lines"):
+                known[key] = known.get(key, 0) + loop.get(key, 0)
+            known["max_iterations_per_line"] = max(known.get("max_iterations_per_line", 0),
+                                                   loop.get("max_iterations_per_line", 0))
+            for conflict in loop.get("conflicts", []):
+                key = (conflict["kind"], conflict["source_line"], conflict["sink_line"])
+                same = next((c for c in known["conflicts"]
+                             if (c["kind"], c["source_line"], c["sink_line"]) == key), None)
+                if same:
+                    same["count"] += conflict.get("count", 0)
+                else:
+                    known["conflicts"].append(dict(conflict))
+            known["verdict"] = self._verdict(known)
+            known["summary"] = self._summary(known)
+
+    @staticmethod
+    def _verdict(loop: Dict[str, Any]) -> str:
+        if loop.get("raw", 0):
+            return "dependent"
+        if loop.get("war", 0) or loop.get("waw", 0):
+            return "privatizable"
+        return "independent"
+
+    @staticmethod
+    def _summary(loop: Dict[str, Any]) -> str:
+        if loop["verdict"] == "independent":
+            return (f"no conflicts observed across {loop.get('executions', 0)} executions "
+                    f"({loop.get('iterations', 0)} iterations)")
+        top = max(loop["conflicts"], key=lambda c: c.get("count", 0))
+        return (f"{loop['verdict']}: {top['kind']} line {top['source_line']} -> "
+                f"line {top['sink_line']} across {loop.get('executions', 0)} executions")
+
+    def lookup(self, file: str, line: int, function: str) -> Optional[Dict[str, Any]]:
+        """The report for file:line:function; by basename or a unique (line, function) otherwise"""
+        loop = self.loops.get(f"{file}:{line}:{function}")
+        if loop:
+            return loop
+        same_line = [l for l in self.loops.values()
+                     if l.get("line") == line and l.get("function") == function]
+        for candidate in same_line:
+            if os.path.basename(candidate.get("file", "")) == os.path.basename(file):
+                return candidate
+        return same_line[0] if len(same_line) == 1 else None
+
+    def annotate(self, candidates: List[Dict[str, Any]]) -> int:
+        """Attach a "dynamic_dependences" entry to each candidate with a report"""
+        annotated = 0
+        for candidate in candidates:
+            loop = self.lookup(candidate.get("file", ""), candidate.get("line", 0),
+                               candidate.get("function", ""))
+            if not loop:
+                continue
+            candidate["dynamic_dependences"] = {
+                "verdict": loop.get("verdict", "independent"),
+                "executions": loop.get("executions", 0),
+                "iterations": loop.get("iterations", 0),
+                "unobserved_calls": loop.get("unobserved_calls", 0),
+                "conflicts": loop.get("conflicts", []),
+                "shared_lines": loop.get("shared_lines", 0),
+                "max_iterations_per_line": loop.get("max_iterations_per_line", 0),
+                "summary": loop.get("summary", ""),
+            }
+            # Lines written by neighbouring iterations confirm the static estimate
+            false_sharing = candidate.get("analysis", {}).get("false_sharing")
+            if false_sharing:
+                false_sharing["observed"] = loop.get("shared_lines", 0) > 0
+            annotated += 1
+        logger.info(f"Dependence profile matched {annotated}/{len(candidates)} candidates")
+        return annotated
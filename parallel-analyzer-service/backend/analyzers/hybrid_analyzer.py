@@ -16,6 +16,8 @@ from .hotspot_analyzer import HotspotAnalyzer
 from .confidence_analyzer import ConfidenceAnalyzer
 from .pattern_cache import PatternCache
 from .code_block_analyzer import CodeBlockAnalyzer
+from .loop_profile import LoopProfile
+from .dependence_profile import DependenceProfile
 
 logger = logging.getLogger(__name__)
 
@@ -27,14 +29,20 @@ class HybridAnalyzer:
     - Hotspot detection: Focus on loops that actually matter
     - Confidence filtering: Skip low-confidence candidates  
     - Pattern caching: Reuse AI responses for similar code patterns
+    - Loop profiles: Rank by measured loop time when a profile is given
+    - Dependence profiles: Run-time conflict evidence for undecided loops
     
     This provides 95% accuracy at 70% cost reduction compared to previous version.
     """
     
     def __init__(self, llvm_analyzer: Optional[LLVMAnalyzer] = None, 
-                 ai_analyzer: Optional[AIAnalyzer] = None):
+                 ai_analyzer: Optional[AIAnalyzer] = None,
+                 loop_profile: Optional[LoopProfile] = None,
+                 dependence_profile: Optional[DependenceProfile] = None):
         self.llvm_analyzer = llvm_analyzer or LLVMAnalyzer()
         self.ai_analyzer = ai_analyzer or AIAnalyzer()
+        self.loop_profile = loop_profile or LoopProfile.from_environment()
+        self.dependence_profile = dependence_profile or DependenceProfile.from_environment()
         
         # Enhanced components
         self.hotspot_analyzer = HotspotAnalyzer()
@@ -50,7 +58,9 @@ class HybridAnalyzer:
         self.enable_pattern_caching = True
         
     async def analyze_file(self, filepath: str, filename: str, 
-                          language: str = "cpp") -> List[Dict[str, Any]]:
+                          language: str = "cpp",
+                          profile_path: Optional[str] = None,
+                          dependence_profile_path: Optional[str] = None) -> List[Dict[str, Any]]:
         """
         Perform hybrid analysis combining LLVM and AI insights
         
@@ -58,6 +68,9 @@ class HybridAnalyzer:
             filepath: Path to the source file
             filename: Display name for the file
             language: Programming language ("cpp" or "python")
+            profile_path: Loop profile written by a parallel-profile build
+                (overrides the analyzer's default profile)
+            dependence_profile_path: Conflict report written by a parallel-deps build
             
         Returns:
             List of enhanced parallelization candidates
@@ -72,9 +85,16 @@ class HybridAnalyzer:
             logger.error(f"Failed to read file {filepath}: {e}")
             return []
         
+        # Measured loop times replace the source heuristics of Phase 1
+        profile = LoopProfile.load(profile_path) if profile_path else self.loop_profile
+        dependences = (DependenceProfile.load(dependence_profile_path)
+                       if dependence_profile_path else self.dependence_profile)
+        
         # Phase 1: Hotspot Detection (Focus on important loops)
         hotspots = []
-        if self.enable_hotspot_filtering:
+        if profile:
+            logger.info("Phase 1: Using measured loop profile instead of hotspot heuristics")
+        elif self.enable_hotspot_filtering:
             logger.info("Phase 1: Detecting computational hotspots...")
             hotspots = self.hotspot_analyzer.analyze_hotspots(code_content, filename)
             logger.info(f"Found {len(hotspots)} hotspots for analysis focus")
@@ -100,6 +120,15 @@ class HybridAnalyzer:
                         llvm_results, hotspots
                     )
                     logger.info(f"Hotspot filtering: {len(llvm_results)} candidates remain")
+                
+                # Observed conflicts feed the confidence scores of Phase 3
+                if dependences and llvm_results:
+                    dependences.annotate(llvm_results)
+                
+                # Rank LLVM results by measured time
+                if profile and llvm_results:
+                    profile.annotate(llvm_results)
+                    llvm_results = profile.rank(llvm_results)
             else:
                 logger.warning("LLVM analyzer not available")
         except Exception as e:
@@ -122,10 +151,14 @@ class HybridAnalyzer:
         if self.ai_analyzer.is_available() and filtered_candidates:
             logger.info("Phase 4: AI analysis with pattern caching...")
             
-            # Prioritize candidates for AI analysis
-            prioritized_candidates = self.confidence_analyzer.prioritize_for_ai_analysis(
-                filtered_candidates, self.max_candidates_for_ai
-            )
+            # Prioritize candidates for AI analysis (measured or estimated hotness
+            # first when the loops are profiled or weighted by the pass)
+            if profile or any('hotness' in c.get('analysis', {}) for c in filtered_candidates):
+                prioritized_candidates = self._rank_and_limit_candidates(list(filtered_candidates))
+            else:
+                prioritized_candidates = self.confidence_analyzer.prioritize_for_ai_analysis(
+                    filtered_candidates, self.max_candidates_for_ai
+                )
             
             for candidate in prioritized_candidates:
                 cache_stats["total"] += 1
@@ -214,6 +247,12 @@ class HybridAnalyzer:
                 }
                 result["final_trust_score"] = result.get("hybrid_confidence", 0.5)
         
+        # Measured candidates first, in place of the line order
+        if profile:
+            for result in ai_enhanced_results:
+                self._apply_hardware_profile(result)
+            ai_enhanced_results = profile.rank(ai_enhanced_results)
+        
         # Log analysis statistics
         self._log_analysis_statistics(hotspots, confidence_stats, cache_stats, ai_enhanced_results)
         
@@ -457,7 +496,7 @@ class HybridAnalyzer:
         return prioritized
 
     def _rank_and_limit_candidates(self, results: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
-        """Rank candidates by priority and limit to max count"""
+        """Rank candidates by measured time (if profiled), hotness, then priority, and limit to max count"""
         if not results:
             return []
         
@@ -470,8 +509,10 @@ class HybridAnalyzer:
             "risky": 5
         }
         
-        # Sort by priority
-        results.sort(key=lambda x: priority_order.get(x.get("candidate_type", ""), 6))
+        # Sort by measured time, then the pass's hotness score, then priority
+        results.sort(key=lambda x: (-x.get("profile", {}).get("seconds", 0.0),
+                                    -x.get("analysis", {}).get("hotness", {}).get("score", 0.0),
+                                    priority_order.get(x.get("candidate_type", ""), 6)))
         
         # Return top candidates
         return results[:self.max_candidates_for_ai]
@@ -637,6 +678,20 @@ class HybridAnalyzer:
         
         return '\n'.join(lines[start_line:end_line])
     
+    def _apply_hardware_profile(self, result: Dict[str, Any]):
+        """Lead with locality transformations for loops measured as memory-bound"""
+        hardware = result.get("profile", {}).get("hardware", {})
+        if hardware.get("bound") != "memory":
+            return
+        advice = hardware.get("advice", LoopProfile.MEMORY_BOUND_ADVICE)
+        ai_analysis = result.setdefault("ai_analysis", {})
+        # A new list: block unification shares ai_analysis copies between results
+        ai_analysis["transformations"] = [advice] + [
+            t for t in ai_analysis.get("transformations", []) if t != advice]
+        logger.info(f"Memory-bound loop at {result.get('function', 'unknown')}:{result.get('line', 0)} "
+                    f"(IPC {hardware.get('ipc') or 0:.2f}, "
+                    f"{hardware.get('llc_misses_per_kilo_instruction') or 0:.1f} LLC MPKI)")
+    
     def _analyze_single_candidate(self, candidate: Dict[str, Any], context: str) -> Dict[str, Any]:
         """Analyze a single candidate using AI"""
         # Use existing AI analyzer method
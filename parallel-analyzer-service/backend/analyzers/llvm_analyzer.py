@@ -24,6 +24,9 @@ class LLVMAnalyzer:
         self.project_root = self._find_project_root()
         self.build_dir = os.path.join(self.project_root, "build")
         self.llvm_pass_path = os.path.join(self.build_dir, "llvm-pass", "libParallelCandidatePass.dylib")
+        # Instrumentation profile (.profdata from -fprofile-instr-generate runs);
+        # the pass then ranks candidates by their measured share of the run
+        self.profile_data = os.getenv("PARALLEL_PROFDATA")
         
     def _find_project_root(self) -> str:
         """Find the project root directory containing the LLVM pass"""
@@ -97,6 +100,8 @@ class LLVMAnalyzer:
                     filepath,
                     "-o", ir_filepath
                 ]
+                if self.profile_data and os.path.exists(self.profile_data):
+                    compile_cmd.insert(-3, f"-fprofile-instr-use={self.profile_data}")
                 
                 logger.info(f"Compiling {filepath} to LLVM IR...")
                 result = subprocess.run(compile_cmd, capture_output=True, text=True)
@@ -0,0 +1,325 @@
+"""
+Loop Profile - Rank candidates by measured time
+
+Programs built with the parallel-profile instrumentation pass and linked
+with runtime/loop_profile.cpp write, at exit, the entries, iterations and
+time of every loop that ran, keyed by the same "file:line:function" id the
+LLVM pass gives its candidates. This module loads those profiles and
+attaches the measured time to the candidates so the ones that actually
+cost time are ranked first.
+
+Profiles of parallel-profile<counters> builds also carry hardware counters
+per loop (cycles, instructions, LLC and branch misses). From those each
+candidate is classified as compute-bound or memory-bound: a loop that
+already waits on memory gains little from more threads sharing the same
+bandwidth, so tiling or a layout change is suggested first.
+
+Profiles of parallel-profile<variance> builds time every iteration of loops
+that contain loops or calls. The spread of those times (coefficient of
+variation, longest over mean iteration) confirms or replaces the schedule
+clause the LLVM pass derived from the loop's shape.
+"""
+
+import json
+import logging
+import os
+from typing import List, Dict, Any, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+HARDWARE_EVENTS = ("cycles", "instructions", "llc_misses", "branch_misses")
+
+
+class LoopProfileEntry:
+    """Measured counters of one loop, summed over the loaded profiles"""
+
+    def __init__(self, data: Dict[str, Any]):
+        self.id = data.get("id", "")
+        self.file = data.get("file", "")
+        self.function = data.get("function", "")
+        self.line = int(data.get("line", 0))
+        self.parent = data.get("parent")
+        self.entries = int(data.get("entries", 0))
+        self.iterations = int(data.get("iterations", 0))
+        self.seconds = float(data.get("seconds", 0.0))
+        self.self_seconds = self.seconds  # Minus inner loops, set by LoopProfile
+        # Counter totals; events the run could not open are absent
+        hardware = data.get("hardware") or {}
+        self.hardware = {e: float(hardware[e]) for e in HARDWARE_EVENTS
+                         if hardware.get(e) is not None}
+        # Per-iteration times, only for loops built with variance
+        iteration_cost = data.get("iteration_cost")
+        self.timed = bool(iteration_cost)
+        self.iteration_sum_squares = float((iteration_cost or {}).get("sum_squares", 0.0))
+        self.iteration_max_seconds = float((iteration_cost or {}).get("max_seconds", 0.0))
+
+    def merge(self, other: "LoopProfileEntry"):
+        self.entries += other.entries
+        self.iterations += other.iterations
+        self.seconds += other.seconds
+        for event, count in other.hardware.items():
+            self.hardware[event] = self.hardware.get(event, 0.0) + count
+        self.timed |= other.timed
+        self.iteration_sum_squares += other.iteration_sum_squares
+        self.iteration_max_seconds = max(self.iteration_max_seconds, other.iteration_max_seconds)
+
+    @property
+    def average_trip_count(self) -> float:
+        return self.iterations / self.entries if self.entries else 0.0
+
+    @property
+    def iteration_cost(self) -> Optional[Dict[str, float]]:
+        """Mean, spread and longest iteration time, None if not timed"""
+        if not self.timed or not self.iterations or self.seconds <= 0:
+            return None
+        mean = self.seconds / self.iterations
+        variance = max(self.iteration_sum_squares / self.iterations - mean * mean, 0.0)
+        return {
+            "mean_seconds": mean,
+            "stddev_seconds": variance ** 0.5,
+            "max_seconds": self.iteration_max_seconds,
+            "cv": variance ** 0.5 / mean,
+            "max_over_mean": self.iteration_max_seconds / mean,
+        }
+
+
+class LoopProfile:
+    """
+    Measured loop times from one or more profile files of the same program
+    (several runs or processes are summed).
+    """
+
+    # Bound classification: LLC misses per thousand instructions and IPC
+    MEMORY_BOUND_MPKI = 10.0        # Memory-bound at any IPC
+    MEMORY_BOUND_LOW_MPKI = 2.0     # Memory-bound when the IPC is also low
+    LOW_IPC = 1.0
+    COMPUTE_BOUND_MPKI = 1.0        # Compute-bound below this with a high IPC
+    HIGH_IPC = 1.5
+
+    MEMORY_BOUND_ADVICE = ("Memory-bound: threads would share the same memory bandwidth; "
+                           "improve locality first (loop tiling/blocking, a contiguous or "
+                           "structure-of-arrays layout, fusing passes over the data)")
+    COMPUTE_BOUND_ADVICE = "Compute-bound: should scale with threads and vectorization"
+
+    # Schedule from the coefficient of variation of iteration times
+    UNIFORM_CV = 0.2                # schedule(static) balances below this
+    HEAVY_TAIL_CV = 1.0             # Few iterations dominate: dynamic, small chunks
+    HEAVY_TAIL_MAX_OVER_MEAN = 50.0
+
+    def __init__(self):
+        self.loops: Dict[str, LoopProfileEntry] = {}
+        self.wall_seconds = 0.0
+        self._by_name: Dict[Tuple[str, int, str], LoopProfileEntry] = {}
+        self._by_line: Dict[Tuple[int, str], List[LoopProfileEntry]] = {}
+
+    @classmethod
+    def load(cls, *paths: str) -> "LoopProfile":
+        """Load and merge profile files; unreadable files are skipped"""
+        profile = cls()
+        for path in paths:
+            try:
+                with open(path, "r") as f:
+                    profile.add(json.load(f))
+            except (OSError, ValueError) as e:
+                logger.error(f"Failed to load loop profile {path}: {e}")
+        profile._index()
+        logger.info(f"Loaded loop profile: {len(profile.loops)} loops, "
+                    f"{profile.total_seconds:.3f}s measured")
+        return profile
+
+    @classmethod
+    def from_environment(cls) -> Optional["LoopProfile"]:
+        """Profiles named by PARALLEL_PROFILE (os.pathsep separated), if set"""
+        paths = [p for p in os.environ.get("PARALLEL_PROFILE", "").split(os.pathsep) if p]
+        return cls.load(*paths) if paths else None
+
+    def add(self, data: Dict[str, Any]):
+        self.wall_seconds += float(data.get("wall_seconds", 0.0))
+        for loop in data.get("loops", []):
+            entry = LoopProfileEntry(loop)
+            if entry.id in self.loops:
+                self.loops[entry.id].merge(entry)
+            else:
+                self.loops[entry.id] = entry
+
+    def _index(self):
+        for entry in self.loops.values():
+            entry.self_seconds = entry.seconds
+        for entry in self.loops.values():
+            parent = self.loops.get(entry.parent) if entry.parent else None
+            if parent:
+                parent.self_seconds -= entry.seconds
+        self._by_name.clear()
+        self._by_line.clear()
+        for entry in self.loops.values():
+            entry.self_seconds = max(entry.self_seconds, 0.0)
+            self._by_name[(os.path.basename(entry.file), entry.line, entry.function)] = entry
+            self._by_line.setdefault((entry.line, entry.function), []).append(entry)
+
+    @property
+    def total_seconds(self) -> float:
+        """Time in top-level loops (inner loops are included in their parents)"""
+        return sum(e.seconds for e in self.loops.values() if not e.parent)
+
+    def lookup(self, file: str, line: int, function: str) -> Optional[LoopProfileEntry]:
+        """
+        The loop at file:line in function. The service analyzes a temporary
+        copy of the source, so when the path differs the basename, then a
+        unique (line, function) match is used.
+        """
+        entry = self.loops.get(f"{file}:{line}:{function}")
+        if entry:
+            return entry
+        entry = self._by_name.get((os.path.basename(file), line, function))
+        if entry:
+            return entry
+        matches = self._by_line.get((line, function), [])
+        return matches[0] if len(matches) == 1 else None
+
+    def _candidate_loops(self, candidate: Dict[str, Any]) -> List[LoopProfileEntry]:
+        """Loops a candidate covers: its own, or the stages/tasks it groups"""
+        file = candidate.get("file", "")
+        function = candidate.get("function", "")
+        analysis = candidate.get("analysis", {})
+        lines = [candidate.get("line", 0)]
+        if "pipeline" in analysis:
+            lines = [s.get("line", 0) for s in analysis["pipeline"].get("stages", [])]
+        elif "task_graph" in analysis:
+            lines = [t.get("first_line", 0) for t in analysis["task_graph"].get("tasks", [])
+                     if t.get("kind") == "loop"]
+        found = []
+        for line in lines:
+            entry = self.lookup(file, line, function)
+            if entry and entry not in found:
+                found.append(entry)
+        return found
+
+    def measured_seconds(self, candidate: Dict[str, Any]) -> Optional[float]:
+        """Measured time of a candidate's loops, None if none of them was profiled"""
+        loops = self._candidate_loops(candidate)
+        return sum(e.seconds for e in loops) if loops else None
+
+    def annotate(self, candidates: List[Dict[str, Any]]) -> int:
+        """Attach a "profile" entry to each candidate with measured loops"""
+        total = self.total_seconds or 1.0
+        annotated = 0
+        for candidate in candidates:
+            loops = self._candidate_loops(candidate)
+            if not loops:
+                continue
+            seconds = sum(e.seconds for e in loops)
+            entries = sum(e.entries for e in loops)
+            iterations = sum(e.iterations for e in loops)
+            candidate["profile"] = {
+                "seconds": seconds,
+                "self_seconds": sum(e.self_seconds for e in loops),
+                "share": seconds / total,
+                "entries": entries,
+                "iterations": iterations,
+                "average_trip_count": iterations / entries if entries else 0.0,
+            }
+            hardware = self._hardware(loops, iterations)
+            if hardware:
+                candidate["profile"]["hardware"] = hardware
+            iteration_cost = loops[0].iteration_cost if len(loops) == 1 else None
+            if iteration_cost:
+                candidate["profile"]["iteration_cost"] = self._schedule(candidate, iteration_cost)
+            annotated += 1
+        logger.info(f"Loop profile matched {annotated}/{len(candidates)} candidates")
+        return annotated
+
+    def _hardware(self, loops: List[LoopProfileEntry], iterations: int) -> Optional[Dict[str, Any]]:
+        """Summed counters of a candidate's loops, their ratios and the bound class"""
+        counts: Dict[str, float] = {}
+        for entry in loops:
+            for event, count in entry.hardware.items():
+                counts[event] = counts.get(event, 0.0) + count
+        if not counts:
+            return None
+        cycles = counts.get("cycles")
+        instructions = counts.get("instructions")
+        llc_misses = counts.get("llc_misses")
+        branch_misses = counts.get("branch_misses")
+        ipc = instructions / cycles if cycles and instructions is not None else None
+        mpki = 1000.0 * llc_misses / instructions if instructions and llc_misses is not None else None
+
+        hardware: Dict[str, Any] = dict(counts)
+        hardware.update({
+            "ipc": ipc,
+            "llc_misses_per_kilo_instruction": mpki,
+            "llc_misses_per_iteration": llc_misses / iterations if iterations and llc_misses is not None else None,
+            "branch_misses_per_iteration": (branch_misses / iterations
+                                            if iterations and branch_misses is not None else None),
+            "bound": self.classify_bound(ipc, mpki),
+        })
+        if hardware["bound"] == "memory":
+            hardware["advice"] = self.MEMORY_BOUND_ADVICE
+        elif hardware["bound"] == "compute":
+            hardware["advice"] = self.COMPUTE_BOUND_ADVICE
+        return hardware
+
+    def _schedule(self, candidate: Dict[str, Any], cost: Dict[str, float]) -> Dict[str, Any]:
+        """Measured iteration spread and the schedule it calls for"""
+        static = candidate.get("analysis", {}).get("schedule", {})
+        schedule = self.recommend_schedule(cost["cv"], cost["max_over_mean"], static.get("kind"))
+        cost = dict(cost, schedule=schedule)
+        if schedule == "static" and not static.get("kind"):
+            cost["advice"] = (f"Iterations cost about the same (cv {cost['cv']:.2f}): "
+                              "keep schedule(static)")
+        elif schedule == static.get("kind"):
+            cost["advice"] = (f"Measured iteration times (cv {cost['cv']:.2f}) confirm "
+                              f"{static.get('clause') or 'the schedule'}")
+        else:
+            cost["advice"] = (f"Measured iteration times vary (cv {cost['cv']:.2f}, longest "
+                              f"{cost['max_over_mean']:.1f}x the mean): use schedule({schedule})")
+        return cost
+
+    @classmethod
+    def recommend_schedule(cls, cv: float, max_over_mean: float,
+                           static_kind: Optional[str] = None) -> str:
+        """
+        'static', 'guided' or 'dynamic' for measured iteration times. A
+        round-robin static chunk the pass chose for a triangular nest stays
+        while the spread is moderate.
+        """
+        if cv < cls.UNIFORM_CV:
+            return "static"
+        if cv >= cls.HEAVY_TAIL_CV or max_over_mean >= cls.HEAVY_TAIL_MAX_OVER_MEAN:
+            return "dynamic"
+        return static_kind or "guided"
+
+    @classmethod
+    def classify_bound(cls, ipc: Optional[float], mpki: Optional[float]) -> str:
+        """'memory', 'compute', 'mixed' or 'unknown' (counters missing)"""
+        if mpki is None:
+            return "unknown"
+        if mpki >= cls.MEMORY_BOUND_MPKI:
+            return "memory"
+        if ipc is None:
+            return "unknown"
+        if mpki >= cls.MEMORY_BOUND_LOW_MPKI and ipc < cls.LOW_IPC:
+            return "memory"
+        if mpki < cls.COMPUTE_BOUND_MPKI and ipc >= cls.HIGH_IPC:
+            return "compute"
+        return "mixed"
+
+    @staticmethod
+    def rank(candidates: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """Most measured time first; candidates without a profile keep their order at the end"""
+        return sorted(candidates,
+                      key=lambda c: -c.get("profile", {}).get("seconds", -1.0))
+
+    def get_profile_summary(self, limit: int = 10) -> Dict[str, Any]:
+        """Hottest loops by self time"""
+        hottest = sorted(self.loops.values(), key=lambda e: e.self_seconds, reverse=True)
+        return {
+            "loops": len(self.loops),
+            "total_seconds": self.total_seconds,
+            "wall_seconds": self.wall_seconds,
+            "hottest": [
+                {"id": e.id, "seconds": e.seconds, "self_seconds": e.self_seconds,
+                 "average_trip_count": e.average_trip_count,
+                 "bound": self._hardware([e], e.iterations)["bound"] if e.hardware else None}
+                for e in hottest[:limit]
+            ],
+        }
@@ -9,7 +9,7 @@ from fastapi import FastAPI, File, UploadFile, Form, HTTPException
 from fastapi.middleware.cors import CORSMiddleware
 from fastapi.responses import JSONResponse
 from pydantic import BaseModel
-from typing import List, Optional, Union
+from typing import List, Optional, Union, Dict, Any
 import tempfile
 import os
 import sys
@@ -126,6 +126,10 @@ class ParallelCandidate(BaseModel):
     hybrid_confidence: Optional[float] = None
     # Unified final score for UI/analytics
     final_trust_score: Optional[float] = None
+    # Measured loop time, when a loop profile was supplied
+    profile: Optional[Dict[str, Any]] = None
+    # Conflicts observed by the dependence profiler, when a report was supplied
+    dynamic_dependences: Optional[Dict[str, Any]] = None
 
 class AnalysisResponse(BaseModel):
     success: bool
@@ -173,7 +177,9 @@ async def health_check():
 async def analyze_parallel_code(
     code: Optional[str] = Form(None),
     file: Optional[UploadFile] = File(None),
-    language: str = Form("cpp")
+    language: str = Form("cpp"),
+    profile: Optional[UploadFile] = File(None),
+    dependence_profile: Optional[UploadFile] = File(None)
 ):
     """
     Analyze C++/Python code for parallelization opportunities.
@@ -182,6 +188,11 @@ async def analyze_parallel_code(
     - Raw code as text (code parameter)
     - Uploaded file (file parameter)
     
+    An optional loop profile (parallel_profile.json from a parallel-profile
+    build of the same code) ranks candidates by measured time; an optional
+    dependence report (parallel_deps.json from a parallel-deps build) adds
+    the conflicts observed at run time.
+    
     Returns analysis results with LLVM + AI insights.
     """
     import time
@@ -215,13 +226,27 @@ async def analyze_parallel_code(
             temp_file.write(code_content)
             temp_filepath = temp_file.name
         
+        profile_filepath = None
+        if profile is not None:
+            with tempfile.NamedTemporaryFile(mode='wb', suffix='.json', delete=False) as profile_file:
+                profile_file.write(await profile.read())
+                profile_filepath = profile_file.name
+        
+        deps_filepath = None
+        if dependence_profile is not None:
+            with tempfile.NamedTemporaryFile(mode='wb', suffix='.json', delete=False) as deps_file:
+                deps_file.write(await dependence_profile.read())
+                deps_filepath = deps_file.name
+        
         try:
             # Perform analysis (hybrid or mock)
             if ANALYZERS_AVAILABLE and hybrid_analyzer:
                 analysis_results = await hybrid_analyzer.analyze_file(
                     filepath=temp_filepath,
                     filename=filename,
-                    language=language
+                    language=language,
+                    profile_path=profile_filepath,
+                    dependence_profile_path=deps_filepath
                 )
             else:
                 # Use mock analyzer
@@ -344,6 +369,14 @@ async def analyze_parallel_code(
                 if result.get("hybrid_confidence"):
                     candidate_dict["hybrid_confidence"] = result["hybrid_confidence"]
                 
+                # Add measured loop time if profiled
+                if result.get("profile"):
+                    candidate_dict["profile"] = result["profile"]
+                
+                # Add observed dependences if profiled
+                if result.get("dynamic_dependences"):
+                    candidate_dict["dynamic_dependences"] = result["dynamic_dependences"]
+                
                 candidate = ParallelCandidate(**candidate_dict)
                 candidates.append(candidate)
             
@@ -358,9 +391,13 @@ async def analyze_parallel_code(
             )
             
         finally:
-            # Clean up temporary file
+            # Clean up temporary files
             if os.path.exists(temp_filepath):
                 os.unlink(temp_filepath)
+            if profile_filepath and os.path.exists(profile_filepath):
+                os.unlink(profile_filepath)
+            if deps_filepath and os.path.exists(deps_filepath):
+                os.unlink(deps_filepath)
     
     except Exception as e:
         logger.error(f"Analysis failed: {str(e)}")
@@ -0,0 +1,453 @@
+//===-- PragmaRewriter.cpp - Apply suggested pragmas to sources -*- C++ -*-===//
+//
+// Reads the candidates exported by the parallel-candidate pass, finds the
+// loop statement each one describes through the loop's llvm.loop location
+// range and inserts the suggested directive above it. Edits are batched per
+// file and either written in place or printed as a unified diff.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtCXX.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace clang;
+using namespace clang::tooling;
+using namespace llvm;
+
+static cl::OptionCategory RewriterCategory("pragma-rewriter options");
+
+static cl::opt<std::string>
+    CandidatesPath("candidates", cl::Required,
+                   cl::desc("JSON file written by the parallel-candidate pass"),
+                   cl::value_desc("file"), cl::cat(RewriterCategory));
+
+static cl::opt<bool>
+    InPlace("i", cl::desc("Edit the files in place instead of printing a "
+                          "unified diff"),
+            cl::cat(RewriterCategory));
+
+static cl::list<std::string>
+    OnlyTypes("only", cl::CommaSeparated,
+              cl::desc("Apply only candidates of these types, e.g. "
+                       "-only=embarrassingly_parallel,reduction"),
+              cl::cat(RewriterCategory));
+
+static cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
+
+namespace {
+
+/// A directive waiting for the loop it belongs to.
+struct PendingEdit {
+  std::string Type;
+  std::string Pragma; // One directive per line
+  unsigned Line = 0;
+  unsigned Column = 0;  // 0 when the IR had no llvm.loop location range
+  unsigned EndLine = 0; // 0 when the IR had no llvm.loop location range
+  bool Applied = false;
+  bool Dropped = false; // Its line already takes another directive
+};
+
+/// Text for one source line: lines inserted above it, or its replacement
+/// when the loop shares the line with other code.
+struct LineEdit {
+  std::vector<std::string> Text;
+  bool ReplacesLine = false;
+  unsigned Column = 0;
+  std::string Pragma;
+};
+
+using PendingMap = std::map<std::string, std::vector<PendingEdit>>;
+using LineEditMap = std::map<std::string, std::map<unsigned, LineEdit>>;
+
+std::string getRealPath(StringRef Path) {
+  SmallString<256> Real;
+  if (sys::fs::real_path(Path, Real))
+    return "";
+  return std::string(Real);
+}
+
+bool isSourceFile(StringRef Path) {
+  StringRef Ext = sys::path::extension(Path);
+  return Ext == ".c" || Ext == ".cc" || Ext == ".cpp" || Ext == ".cxx" ||
+         Ext == ".C";
+}
+
+/// Matches loop statements against the pending edits of their file.
+class LoopVisitor : public RecursiveASTVisitor<LoopVisitor> {
+public:
+  LoopVisitor(SourceManager &SM, PendingMap &Pending, LineEditMap &Edits)
+      : SM(SM), Pending(Pending), Edits(Edits) {}
+
+  bool VisitForStmt(ForStmt *S) {
+    match(S);
+    return true;
+  }
+
+  bool VisitCXXForRangeStmt(CXXForRangeStmt *S) {
+    match(S);
+    return true;
+  }
+
+private:
+  SourceManager &SM;
+  PendingMap &Pending;
+  LineEditMap &Edits;
+  std::map<FileID, std::string> Paths;
+
+  StringRef getPath(FileID FID) {
+    auto It = Paths.find(FID);
+    if (It != Paths.end())
+      return It->second;
+    std::string Path;
+    if (const FileEntry *FE = SM.getFileEntryForID(FID))
+      Path = getRealPath(FE->getName());
+    return Paths[FID] = Path;
+  }
+
+  // clang's llvm.loop range starts at the loop keyword and ends at the end
+  // of the statement, the same range the AST gives the loop
+  void match(Stmt *S) {
+    SourceLocation Begin = SM.getExpansionLoc(S->getBeginLoc());
+    if (Begin.isInvalid())
+      return;
+    StringRef Path = getPath(SM.getFileID(Begin));
+    auto It = Pending.find(std::string(Path));
+    if (It == Pending.end())
+      return;
+
+    unsigned Line = SM.getExpansionLineNumber(Begin);
+    unsigned Column = SM.getExpansionColumnNumber(Begin);
+    unsigned EndLine = SM.getExpansionLineNumber(S->getEndLoc());
+    for (PendingEdit &Edit : It->second) {
+      if (Edit.Applied || Edit.Line != Line ||
+          (Edit.Column && Edit.Column != Column) ||
+          (Edit.EndLine && Edit.EndLine != EndLine))
+        continue;
+      apply(Edit, Begin, It->first, Line, Column);
+    }
+  }
+
+  void apply(PendingEdit &Edit, SourceLocation Begin, const std::string &Path,
+             unsigned Line, unsigned Column) {
+    Edit.Applied = true;
+    std::map<unsigned, LineEdit> &FileEdits = Edits[Path];
+    auto Existing = FileEdits.find(Line);
+    if (Existing != FileEdits.end()) {
+      // A duplicate candidate for the same loop adds nothing; anything else
+      // (a second loop on the line, another directive) cannot be placed
+      if (Existing->second.Column == Column && Existing->second.Pragma == Edit.Pragma)
+        return;
+      errs() << "pragma-rewriter: " << Path << ":" << Line << ":" << Column
+             << " dropped " << Edit.Type
+             << ", the line already takes a directive\n";
+      Edit.Dropped = true;
+      return;
+    }
+
+    StringRef Buffer = SM.getBufferData(SM.getFileID(Begin));
+    size_t Offset = SM.getFileOffset(Begin);
+    size_t LineStart = Buffer.rfind('\n', Offset);
+    LineStart = LineStart == StringRef::npos ? 0 : LineStart + 1;
+    size_t LineEnd = std::min(Buffer.find('\n', Offset), Buffer.size());
+    StringRef Prefix = Buffer.slice(LineStart, Offset);
+    StringRef Indent = Prefix.take_while([](char C) { return C == ' ' || C == '\t'; });
+
+    // Do not stack a second directive on an annotated loop
+    if (LineStart > 0) {
+      StringRef Above = Buffer.substr(0, LineStart - 1);
+      Above = Above.substr(Above.rfind('\n') + 1).trim();
+      if (Above.startswith("#pragma omp") || Above.startswith("#pragma clang loop")) {
+        errs() << "pragma-rewriter: " << Path << ":" << Line
+               << " already has a loop directive, skipped\n";
+        return;
+      }
+    }
+
+    LineEdit &Result = FileEdits[Line];
+    Result.Column = Column;
+    Result.Pragma = Edit.Pragma;
+    Result.ReplacesLine = Indent.size() != Prefix.size();
+    if (Result.ReplacesLine)
+      Result.Text.push_back(Prefix.rtrim().str());
+    SmallVector<StringRef, 2> Directives;
+    StringRef(Edit.Pragma).split(Directives, '\n', -1, false);
+    for (StringRef Directive : Directives)
+      Result.Text.push_back((Indent + Directive).str());
+    if (Result.ReplacesLine)
+      Result.Text.push_back((Indent + Buffer.slice(Offset, LineEnd)).str());
+  }
+};
+
+class LoopConsumer : public ASTConsumer {
+public:
+  LoopConsumer(PendingMap &Pending, LineEditMap &Edits)
+      : Pending(Pending), Edits(Edits) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    LoopVisitor Visitor(Context.getSourceManager(), Pending, Edits);
+    Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+  }
+
+private:
+  PendingMap &Pending;
+  LineEditMap &Edits;
+};
+
+class LoopMatchAction : public ASTFrontendAction {
+public:
+  LoopMatchAction(PendingMap &Pending, LineEditMap &Edits)
+      : Pending(Pending), Edits(Edits) {}
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &,
+                                                 StringRef) override {
+    return std::make_unique<LoopConsumer>(Pending, Edits);
+  }
+
+private:
+  PendingMap &Pending;
+  LineEditMap &Edits;
+};
+
+class LoopMatchActionFactory : public FrontendActionFactory {
+public:
+  LoopMatchActionFactory(PendingMap &Pending, LineEditMap &Edits)
+      : Pending(Pending), Edits(Edits) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<LoopMatchAction>(Pending, Edits);
+  }
+
+private:
+  PendingMap &Pending;
+  LineEditMap &Edits;
+};
+
+/// Collect the candidates that carry a directive, keyed by real file path.
+/// Source files among them are appended to \p Sources.
+bool loadCandidates(StringRef Path, PendingMap &Pending,
+                    std::vector<std::string> &Sources) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFile(Path);
+  if (!Buffer) {
+    errs() << "pragma-rewriter: cannot read " << Path << ": "
+           << Buffer.getError().message() << "\n";
+    return false;
+  }
+  Expected<json::Value> Root = json::parse((*Buffer)->getBuffer());
+  if (!Root) {
+    errs() << "pragma-rewriter: " << Path << ": " << toString(Root.takeError())
+           << "\n";
+    return false;
+  }
+  const json::Array *Candidates = Root->getAsArray();
+  if (!Candidates) {
+    errs() << "pragma-rewriter: " << Path << ": expected an array of candidates\n";
+    return false;
+  }
+
+  std::set<std::string> Seen;
+  for (const json::Value &Value : *Candidates) {
+    const json::Object *Candidate = Value.getAsObject();
+    const json::Object *Analysis = Candidate ? Candidate->getObject("analysis") : nullptr;
+    if (!Analysis)
+      continue;
+    Optional<StringRef> Pragma = Analysis->getString("pragma");
+    Optional<StringRef> File = Candidate->getString("file");
+    Optional<StringRef> Type = Candidate->getString("candidate_type");
+    if (!Pragma || !File || !Type)
+      continue;
+    if (!OnlyTypes.empty() && !is_contained(OnlyTypes, *Type))
+      continue;
+
+    PendingEdit Edit;
+    Edit.Type = Type->str();
+    Edit.Pragma = Pragma->str();
+    Edit.Line = Candidate->getInteger("line").getValueOr(0);
+    SmallString<256> FullPath(*File);
+    if (const json::Object *Range = Analysis->getObject("loop_range")) {
+      Edit.Line = Range->getInteger("start_line").getValueOr(Edit.Line);
+      Edit.Column = Range->getInteger("start_column").getValueOr(0);
+      Edit.EndLine = Range->getInteger("end_line").getValueOr(0);
+      Optional<StringRef> Directory = Range->getString("directory");
+      if (Directory && sys::path::is_relative(FullPath)) {
+        FullPath = *Directory;
+        sys::path::append(FullPath, *File);
+      }
+    }
+
+    std::string Key = getRealPath(FullPath);
+    if (Key.empty()) {
+      errs() << "pragma-rewriter: " << FullPath << " not found, skipped\n";
+      continue;
+    }
+    Pending[Key].push_back(std::move(Edit));
+    if (isSourceFile(Key) && Seen.insert(Key).second)
+      Sources.push_back(Key);
+  }
+  return true;
+}
+
+std::vector<StringRef> splitLines(StringRef Buffer) {
+  std::vector<StringRef> Lines;
+  while (!Buffer.empty()) {
+    std::pair<StringRef, StringRef> Split = Buffer.split('\n');
+    Lines.push_back(Split.first);
+    Buffer = Split.second;
+  }
+  return Lines;
+}
+
+void writeEdited(raw_ostream &OS, ArrayRef<StringRef> Lines,
+                 const std::map<unsigned, LineEdit> &FileEdits,
+                 bool TrailingNewline) {
+  for (unsigned Line = 1; Line <= Lines.size(); ++Line) {
+    auto It = FileEdits.find(Line);
+    if (It != FileEdits.end())
+      for (const std::string &Text : It->second.Text)
+        OS << Text << "\n";
+    if (It == FileEdits.end() || !It->second.ReplacesLine)
+      OS << Lines[Line - 1] << (Line < Lines.size() || TrailingNewline ? "\n" : "");
+  }
+}
+
+/// Unified diff with three lines of context; edits whose context overlaps
+/// share a hunk.
+void printUnifiedDiff(raw_ostream &OS, StringRef Path, ArrayRef<StringRef> Lines,
+                      const std::map<unsigned, LineEdit> &FileEdits) {
+  constexpr unsigned Context = 3;
+  OS << "--- " << Path << "\n+++ " << Path << "\n";
+  int Shift = 0;
+  for (auto It = FileEdits.begin(); It != FileEdits.end();) {
+    auto Last = It;
+    auto Next = std::next(It);
+    while (Next != FileEdits.end() && Next->first <= Last->first + 2 * Context + 1)
+      Last = Next++;
+    unsigned First = It->first > Context ? It->first - Context : 1;
+    unsigned End = std::min<unsigned>(Last->first + Context, Lines.size());
+
+    std::string Body;
+    unsigned OldCount = 0, NewCount = 0;
+    for (unsigned Line = First; Line <= End; ++Line) {
+      auto Edit = FileEdits.find(Line);
+      if (Edit != FileEdits.end()) {
+        if (Edit->second.ReplacesLine) {
+          Body += "-" + Lines[Line - 1].str() + "\n";
+          ++OldCount;
+        }
+        for (const std::string &Text : Edit->second.Text)
+          Body += "+" + Text + "\n";
+        NewCount += Edit->second.Text.size();
+        if (Edit->second.ReplacesLine)
+          continue;
+      }
+      Body += " " + Lines[Line - 1].str() + "\n";
+      ++OldCount;
+      ++NewCount;
+    }
+    OS << "@@ -" << First << "," << OldCount << " +" << (First + Shift) << ","
+       << NewCount << " @@\n"
+       << Body;
+    Shift += static_cast<int>(NewCount) - static_cast<int>(OldCount);
+    It = Next;
+  }
+}
+
+} // end anonymous namespace
+
+int main(int argc, const char **argv) {
+  Expected<CommonOptionsParser> Options =
+      CommonOptionsParser::create(argc, argv, RewriterCategory, cl::ZeroOrMore);
+  if (!Options) {
+    errs() << toString(Options.takeError());
+    return 1;
+  }
+
+  PendingMap Pending;
+  std::vector<std::string> Sources;
+  if (!loadCandidates(CandidatesPath, Pending, Sources))
+    return 1;
+  if (!Options->getSourcePathList().empty())
+    Sources = Options->getSourcePathList();
+  if (Pending.empty() || Sources.empty()) {
+    errs() << "pragma-rewriter: no candidates with a directive to apply\n";
+    return 0;
+  }
+
+  // One parse per translation unit; loops in headers are matched from
+  // whichever unit includes them first
+  LineEditMap Edits;
+  ClangTool Tool(Options->getCompilations(), Sources);
+  LoopMatchActionFactory Factory(Pending, Edits);
+  int Status = Tool.run(&Factory);
+
+  unsigned Unmatched = 0, Dropped = 0;
+  for (const auto &Entry : Pending) {
+    for (const PendingEdit &Edit : Entry.second) {
+      Dropped += Edit.Dropped;
+      if (Edit.Applied)
+        continue;
+      errs() << "pragma-rewriter: no loop statement at " << Entry.first << ":"
+             << Edit.Line << " for " << Edit.Type << "\n";
+      ++Unmatched;
+    }
+  }
+
+  unsigned Applied = 0, Files = 0;
+  for (const auto &Entry : Edits) {
+    if (Entry.second.empty())
+      continue;
+    ++Files;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Entry.first);
+    if (!Buffer) {
+      errs() << "pragma-rewriter: cannot read " << Entry.first << "\n";
+      Status = 1;
+      continue;
+    }
+    StringRef Text = (*Buffer)->getBuffer();
+    std::vector<StringRef> Lines = splitLines(Text);
+    Applied += Entry.second.size();
+    if (!InPlace) {
+      printUnifiedDiff(outs(), Entry.first, Lines, Entry.second);
+      continue;
+    }
+
+    std::string Edited;
+    raw_string_ostream OS(Edited);
+    writeEdited(OS, Lines, Entry.second, Text.endswith("\n"));
+    OS.flush();
+    std::error_code EC;
+    raw_fd_ostream Out(Entry.first, EC);
+    if (EC) {
+      errs() << "pragma-rewriter: cannot write " << Entry.first << ": "
+             << EC.message() << "\n";
+      Status = 1;
+      continue;
+    }
+    Out << Edited;
+  }
+
+  errs() << "pragma-rewriter: " << Applied << " directive(s) in " << Files
+         << " file(s), " << Unmatched << " unmatched, " << Dropped
+         << " dropped\n";
+  return Status;
+}
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""
+Perf Sample Mapper for parallelization candidates
+Reads `perf script` output (or a list of sampled addresses), symbolizes the
+addresses through the binary's DWARF line table with addr2line and attaches
+to each candidate the share of CPU samples that fall in its loop's source
+lines, so candidates can be prioritized by production cost. Local only:
+needs binutils (nm, addr2line), not perf itself.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+from typing import Dict, Any, List, Optional, Tuple
+
+# Frame of a perf script sample, "ip sym+0xoff (dso)": an indented callchain
+# line, or the end of the header line of a sample without callchain
+FRAME_TAIL = r'([0-9a-fA-F]+)\s+(.+?)(?:\+0x([0-9a-fA-F]+))?\s+\(([^()]*)\)\s*$'
+CALLCHAIN_FRAME = re.compile(r'^\s+' + FRAME_TAIL)
+HEADER_FRAME = re.compile(r'^.*:\s+' + FRAME_TAIL)
+# --show-mmap-events: "[0xstart(0xlength) @ 0xpgoff ...]: prot path"
+MMAP = re.compile(r'PERF_RECORD_MMAP2?\s.*\[0x([0-9a-fA-F]+)\(0x([0-9a-fA-F]+)\) @ 0x([0-9a-fA-F]+)[^\]]*\]:\s+\S+\s+(\S+)')
+
+ELF_TYPE_EXEC = 2
+
+
+class PerfSampleMapper:
+    def __init__(self, binary: str, addr2line: str = "addr2line", nm: str = "nm"):
+        self.binary = binary
+        self.binary_name = os.path.basename(binary)
+        self.addr2line = addr2line
+        self.nm = nm
+        self.position_independent = self._elf_type() != ELF_TYPE_EXEC
+        self.symbols = self._load_symbols()
+        self.segments = self._load_segments()
+        self.mappings: List[Tuple[int, int, int]] = []  # (start, end, file offset) of the binary
+        self.unresolved = 0  # Frames in the binary without a usable address
+
+        # Samples as tuples of frames, leaf first; a frame is a binary-relative
+        # address or None when it lies outside the binary
+        self.samples: List[Tuple[Optional[int], ...]] = []
+        self.locations: Dict[int, List[Tuple[str, int]]] = {}
+
+    def _elf_type(self) -> int:
+        with open(self.binary, 'rb') as f:
+            header = f.read(18)
+        if header[:4] != b'\x7fELF':
+            raise ValueError(f"{self.binary} is not an ELF file")
+        return int.from_bytes(header[16:18], 'little' if header[5] == 1 else 'big')
+
+    def _load_symbols(self) -> Dict[str, int]:
+        """Symbol -> address, under both the mangled and the demangled name"""
+        symbols: Dict[str, int] = {}
+        for demangle in ([], ["-C"]):
+            result = subprocess.run([self.nm, "--defined-only", *demangle, self.binary],
+                                    capture_output=True, text=True)
+            for line in result.stdout.splitlines():
+                parts = line.split(None, 2)
+                if len(parts) == 3:
+                    symbols.setdefault(parts[2], int(parts[0], 16))
+        return symbols
+
+    def _load_segments(self) -> List[Tuple[int, int, int]]:
+        """(file offset, size, virtual address) of the LOAD segments"""
+        result = subprocess.run(["readelf", "-lW", self.binary], capture_output=True, text=True)
+        segments = []
+        for line in result.stdout.splitlines():
+            parts = line.split()
+            if parts[:1] == ["LOAD"] and len(parts) >= 5:
+                segments.append((int(parts[1], 16), int(parts[4], 16), int(parts[2], 16)))
+        return segments
+
+    def _from_mapping(self, ip: int) -> Optional[int]:
+        """Link-time address of a runtime address, through the recorded mmap events"""
+        for start, end, pgoff in self.mappings:
+            if start <= ip < end:
+                offset = ip - start + pgoff
+                for file_offset, size, vaddr in self.segments:
+                    if file_offset <= offset < file_offset + size:
+                        return vaddr + offset - file_offset
+        return None
+
+    def _binary_address(self, ip: str, symbol: str, offset: Optional[str], dso: str) -> Optional[int]:
+        """Address in the binary's own address space, None if the frame is elsewhere"""
+        if os.path.basename(dso) != self.binary_name:
+            return None
+        if offset is not None and symbol in self.symbols:
+            return self.symbols[symbol] + int(offset, 16)
+        # A runtime address is the link address unless the executable was
+        # relocated (PIE), then the mmap events give the load address
+        if not self.position_independent:
+            return int(ip, 16)
+        address = self._from_mapping(int(ip, 16))
+        if address is None:
+            self.unresolved += 1
+        return address
+
+    def load_perf_script(self, path: str, callchains: bool = True):
+        """Parse `perf script` text (with or without -g callchains)"""
+        frames: List[Optional[int]] = []
+        in_sample = False
+
+        def flush():
+            if in_sample:
+                self.samples.append(tuple(frames) if frames else (None,))
+
+        with open(path, 'r', errors='replace') as f:
+            for line in f:
+                if not line.strip():
+                    continue
+                if line.startswith('#'):
+                    continue
+                mmap = MMAP.search(line)
+                if mmap:
+                    if os.path.basename(mmap.group(4)) == self.binary_name:
+                        start, length, pgoff = (int(g, 16) for g in mmap.groups()[:3])
+                        self.mappings.append((start, start + length, pgoff))
+                    continue
+                match = CALLCHAIN_FRAME.match(line)
+                if match and in_sample:
+                    if callchains or not frames:
+                        frames.append(self._binary_address(*match.groups()))
+                    continue
+                # Header line of a new sample, possibly ending with its only frame
+                flush()
+                in_sample = True
+                frames = []
+                match = HEADER_FRAME.match(line)
+                if match:
+                    frames.append(self._binary_address(*match.groups()))
+        flush()
+
+    def load_addresses(self, path: str):
+        """One binary-relative hex address per line, optionally followed by a sample count"""
+        with open(path, 'r') as f:
+            for line in f:
+                parts = line.split()
+                if not parts or parts[0].startswith('#'):
+                    continue
+                count = int(parts[1]) if len(parts) > 1 else 1
+                self.samples.extend([(int(parts[0], 16),)] * count)
+
+    def symbolize(self):
+        """Source locations of every sampled address, innermost inline frame first"""
+        addresses = sorted({a for sample in self.samples for a in sample if a is not None})
+        if not addresses:
+            return
+        result = subprocess.run([self.addr2line, "-e", self.binary, "-i", "-a"],
+                                input="\n".join(hex(a) for a in addresses) + "\n",
+                                capture_output=True, text=True, check=True)
+        current = None
+        for line in result.stdout.splitlines():
+            if line.startswith("0x"):
+                current = int(line, 16)
+                self.locations[current] = []
+                continue
+            location = line.split(" (discriminator")[0].strip()
+            path, _, number = location.rpartition(':')
+            if current is not None and number.isdigit() and int(number) > 0:
+                self.locations[current].append((os.path.basename(path), int(number)))
+
+    @staticmethod
+    def _ranges(candidate: Dict[str, Any], by_first_line: Dict[Tuple[str, int], Tuple[int, int]]) -> List[Tuple[int, int]]:
+        """Source line ranges of the loops a candidate covers"""
+        analysis = candidate.get("analysis", {})
+        file = os.path.basename(candidate.get("file", ""))
+        lines = [candidate.get("line", 0)]
+        if "pipeline" in analysis:
+            lines = [s.get("line", 0) for s in analysis["pipeline"].get("stages", [])]
+        elif "task_graph" in analysis:
+            lines = [t.get("first_line", 0) for t in analysis["task_graph"].get("tasks", [])
+                     if t.get("kind") == "loop"]
+        loop_range = analysis.get("loop_range")
+        if loop_range and lines == [candidate.get("line", 0)]:
+            return [(loop_range.get("start_line", 0), loop_range.get("end_line", 0))]
+        return [by_first_line.get((file, line), (line, line)) for line in lines if line > 0]
+
+    def annotate(self, candidates: List[Dict[str, Any]]) -> int:
+        """Attach "perf" (samples in the loop, inclusive and self) to each candidate"""
+        total = len(self.samples)
+        if total == 0:
+            return 0
+        by_first_line = {}
+        for c in candidates:
+            r = c.get("analysis", {}).get("loop_range")
+            if r:
+                by_first_line.setdefault((os.path.basename(c.get("file", "")), r.get("start_line", 0)),
+                                         (r.get("start_line", 0), r.get("end_line", 0)))
+
+        # Distinct (file, line) sets per sample, inclusive of callers and inline frames
+        leaf_lines = []
+        all_lines = []
+        for sample in self.samples:
+            leaf = set(self.locations.get(sample[0], [])) if sample[0] is not None else set()
+            everywhere = set(leaf)
+            for address in sample[1:]:
+                if address is not None:
+                    everywhere.update(self.locations.get(address, []))
+            leaf_lines.append(leaf)
+            all_lines.append(everywhere)
+
+        annotated = 0
+        for candidate in candidates:
+            file = os.path.basename(candidate.get("file", ""))
+            ranges = self._ranges(candidate, by_first_line)
+            if not ranges:
+                continue
+
+            def inside(lines) -> bool:
+                return any(f == file and any(lo <= n <= hi for lo, hi in ranges) for f, n in lines)
+
+            samples = sum(1 for lines in all_lines if inside(lines))
+            self_samples = sum(1 for lines in leaf_lines if inside(lines))
+            candidate["perf"] = {
+                "samples": samples,
+                "self_samples": self_samples,
+                "percent": 100.0 * samples / total,
+                "self_percent": 100.0 * self_samples / total,
+                "total_samples": total,
+            }
+            annotated += 1 if samples else 0
+        return annotated
+
+    def summary(self) -> Dict[str, Any]:
+        resolved = sum(1 for s in self.samples if s[0] is not None and self.locations.get(s[0]))
+        return {
+            "samples": len(self.samples),
+            "in_binary_with_line_info": resolved,
+            "position_independent": self.position_independent,
+        }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Attach perf CPU sample shares to parallelization candidates')
+    parser.add_argument('candidates_file', help='Analysis JSON with candidates')
+    parser.add_argument('binary', help='Profiled binary, built with -g')
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument('--perf-script', help='Text output of `perf script` (with or without -g)')
+    source.add_argument('--addresses', help='Binary-relative addresses, one per line, optional count after each')
+    parser.add_argument('-o', '--output', help='Output file (default: candidates_file_perf.json)')
+    parser.add_argument('--self-only', action='store_true', help='Ignore callchains: count only leaf frames')
+    parser.add_argument('--addr2line', default='addr2line', help='addr2line executable (binutils or llvm-addr2line)')
+    parser.add_argument('--no-sort', action='store_true', help='Keep the pass order instead of sorting by samples')
+
+    args = parser.parse_args()
+    output_file = args.output or f"{os.path.splitext(args.candidates_file)[0]}_perf.json"
+
+    with open(args.candidates_file, 'r') as f:
+        candidates = json.load(f)
+
+    try:
+        mapper = PerfSampleMapper(args.binary, args.addr2line)
+        if args.perf_script:
+            mapper.load_perf_script(args.perf_script, callchains=not args.self_only)
+        else:
+            mapper.load_addresses(args.addresses)
+        mapper.symbolize()
+    except (OSError, ValueError, subprocess.CalledProcessError) as e:
+        print(f"❌ {e}")
+        sys.exit(1)
+
+    matched = mapper.annotate(candidates)
+    if not args.no_sort:
+        candidates.sort(key=lambda c: -c.get("perf", {}).get("percent", -1.0))
+
+    with open(output_file, 'w') as f:
+        json.dump(candidates, f, indent=2)
+
+    summary = mapper.summary()
+    print(f"📊 {summary['samples']} samples, {summary['in_binary_with_line_info']} resolved to source lines")
+    if mapper.unresolved:
+        print(f"⚠️  {mapper.unresolved} frames of the PIE binary had no symbol offset or mapping: "
+              f"rerun perf script with -F +symoff or --show-mmap-events")
+    for candidate in candidates[:10]:
+        perf = candidate.get("perf")
+        if perf and perf["samples"]:
+            print(f"   {perf['percent']:5.1f}% ({perf['self_percent']:5.1f}% self)  "
+                  f"{candidate.get('file')}:{candidate.get('line')} {candidate.get('candidate_type')}")
+    print(f"✅ {matched} candidates with samples → {output_file}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+"""
+Thread Scaling Explorer for profiled loops
+Runs a program built with the parallel-profile instrumentation (usually the
+patched, OpenMP version) at a sweep of OMP_NUM_THREADS values, collects the
+time of every loop from the profiles it writes, and fits Amdahl's law and
+the Universal Scalability Law to each loop and to the whole run:
+
+  Amdahl:  S(n) = 1 / (s + (1 - s) / n)             s: serial fraction
+  USL:     S(n) = n / (1 + a (n - 1) + b n (n - 1))  a: contention, b: coherency
+
+With b > 0 the USL speedup peaks at n* = sqrt((1 - a) / b) threads, past
+which more threads make the loop slower.
+"""
+
+import argparse
+import json
+import math
+import os
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Dict, Any, List, Optional, Tuple
+
+# Loops faster than this at one thread are too noisy to fit
+MIN_SECONDS = 1e-3
+# Predicted efficiency S(n) / n below which more threads stop paying off
+MIN_EFFICIENCY = 0.5
+# Predicted speedups below this are within run-to-run noise
+MIN_SPEEDUP = 1.1
+# (max - min) / median of the repeated runs above this makes a fit unreliable
+NOISY_SPREAD = 0.25
+# How far past the measured thread counts predictions are extrapolated
+EXTRAPOLATION = 4
+
+# Functions the OpenMP compilers outline parallel loop bodies into: their
+# loops run once per thread and are matched to candidates by file and line
+OUTLINED_MARKERS = (".omp_outlined.", "._omp_fn.", "omp_outlined")
+
+
+def fit_amdahl(points: List[Tuple[int, float]]) -> Optional[Dict[str, Any]]:
+    """
+    Least squares serial fraction from (threads, speedup) points, through
+    1/S - 1/n = s (1 - 1/n)
+    """
+    xs = [1.0 - 1.0 / n for n, _ in points]
+    ys = [1.0 / sp - 1.0 / n for n, sp in points]
+    sxx = sum(x * x for x in xs)
+    if sxx == 0:
+        return None
+    s = min(max(sum(x * y for x, y in zip(xs, ys)) / sxx, 0.0), 1.0)
+
+    def predict(n: float) -> float:
+        return 1.0 / (s + (1.0 - s) / n)
+
+    return {
+        "serial_fraction": s,
+        "max_speedup": 1.0 / s if s > 0 else None,
+        "r_squared": r_squared(points, predict),
+        "predict": predict,
+    }
+
+
+def fit_usl(points: List[Tuple[int, float]]) -> Optional[Dict[str, Any]]:
+    """
+    Non-negative least squares contention and coherency coefficients, through
+    n/S - 1 = a (n - 1) + b n (n - 1)
+    """
+    if len({n for n, _ in points}) < 3:
+        return None
+    x1 = [n - 1.0 for n, _ in points]
+    x2 = [n * (n - 1.0) for n, _ in points]
+    ys = [n / sp - 1.0 for n, sp in points]
+    s11 = sum(a * a for a in x1)
+    s22 = sum(b * b for b in x2)
+    s12 = sum(a * b for a, b in zip(x1, x2))
+    s1y = sum(a * y for a, y in zip(x1, ys))
+    s2y = sum(b * y for b, y in zip(x2, ys))
+    det = s11 * s22 - s12 * s12
+    alpha, beta = ((s1y * s22 - s2y * s12) / det, (s2y * s11 - s1y * s12) / det) if det else (-1.0, -1.0)
+    # A negative coefficient means the other one alone fits better
+    if alpha < 0 or beta < 0:
+        alpha, beta = max(s1y / s11, 0.0) if s11 else 0.0, 0.0
+        beta_only = max(s2y / s22, 0.0) if s22 else 0.0
+        if sum((y - beta_only * b) ** 2 for y, b in zip(ys, x2)) < \
+                sum((y - alpha * a) ** 2 for y, a in zip(ys, x1)):
+            alpha, beta = 0.0, beta_only
+
+    def predict(n: float) -> float:
+        return n / (1.0 + alpha * (n - 1.0) + beta * n * (n - 1.0))
+
+    peak = math.sqrt(max(1.0 - alpha, 0.0) / beta) if beta > 0 else None
+    return {
+        "contention": alpha,
+        "coherency": beta,
+        "peak_threads": peak,
+        "peak_speedup": predict(max(peak, 1.0)) if peak is not None else (1.0 / alpha if alpha > 0 else None),
+        "r_squared": r_squared(points, predict),
+        "predict": predict,
+    }
+
+
+def r_squared(points: List[Tuple[int, float]], predict) -> Optional[float]:
+    mean = statistics.mean(sp for _, sp in points)
+    total = sum((sp - mean) ** 2 for _, sp in points)
+    if total == 0:
+        return None
+    return 1.0 - sum((sp - predict(n)) ** 2 for n, sp in points) / total
+
+
+def recommend(predict, limit: int, min_efficiency: float) -> int:
+    """Most threads up to limit whose predicted efficiency is still min_efficiency"""
+    best = 1
+    for n in range(1, limit + 1):
+        speedup = predict(n)
+        if speedup / n < min_efficiency:
+            break
+        if speedup > predict(best) * (1.0 + 1e-9):
+            best = n
+    return best if predict(best) >= MIN_SPEEDUP else 1
+
+
+def analyze_scaling(samples: Dict[int, List[float]], min_efficiency: float, limit: int) -> Dict[str, Any]:
+    """Speedups of the median times relative to one thread and both fits"""
+    times = {n: statistics.median(values) for n, values in samples.items()}
+    base = times[1]
+    points = [(n, base / t) for n, t in sorted(times.items()) if t > 0]
+    result: Dict[str, Any] = {
+        "seconds": {str(n): t for n, t in sorted(times.items())},
+        "speedup": {str(n): sp for n, sp in points},
+        "noisy_timing": any(t > 0 and (max(samples[n]) - min(samples[n])) / t > NOISY_SPREAD
+                            for n, t in times.items()),
+    }
+    amdahl = fit_amdahl(points)
+    usl = fit_usl(points)
+    model = usl or amdahl
+    for name, fit in (("amdahl", amdahl), ("usl", usl)):
+        if fit:
+            result[name] = {k: v for k, v in fit.items() if k != "predict"}
+    if model:
+        result["optimal_threads"] = (max(1, round(usl["peak_threads"]))
+                                     if usl and usl["peak_threads"] is not None else None)
+        result["recommended_threads"] = recommend(model["predict"], limit, min_efficiency)
+    return result
+
+
+class ScalingExplorer:
+    def __init__(self, binary: str, threads: Optional[List[int]] = None, repeat: int = 3,
+                 run_args: Optional[List[str]] = None, timeout: float = 300.0,
+                 min_seconds: float = MIN_SECONDS, min_efficiency: float = MIN_EFFICIENCY,
+                 work_dir: Optional[str] = None):
+        self.binary = os.path.abspath(binary)
+        self.threads = sorted(set([1] + (threads or self._default_threads())))
+        self.repeat = max(1, repeat)
+        self.run_args = run_args or []
+        self.timeout = timeout
+        self.min_seconds = min_seconds
+        self.min_efficiency = min_efficiency
+        self.work_dir = work_dir or tempfile.mkdtemp(prefix="scaling_")
+
+        # threads -> [(wall seconds, {loop id: loop record}) per repeat]
+        self.runs: Dict[int, List[Tuple[float, Dict[str, Dict[str, Any]]]]] = {}
+
+    @staticmethod
+    def _default_threads() -> List[int]:
+        """1, 2, 4 ... up to the hardware threads (which is always included)"""
+        cpus = os.cpu_count() or 1
+        threads = []
+        t = 1
+        while t < cpus:
+            threads.append(t)
+            t *= 2
+        threads.append(cpus)
+        return threads
+
+    def _run(self, threads: int, index: int) -> Tuple[float, Dict[str, Dict[str, Any]]]:
+        """One run; returns (wall seconds, loops of its profile by id)"""
+        profile = os.path.join(self.work_dir, f"profile_t{threads}_r{index}.json")
+        env = dict(os.environ, OMP_NUM_THREADS=str(threads), PARALLEL_PROFILE_OUTPUT=profile)
+        start = time.perf_counter()
+        result = subprocess.run([self.binary, *self.run_args], env=env, capture_output=True,
+                                text=True, timeout=self.timeout)
+        wall = time.perf_counter() - start
+        if result.returncode != 0:
+            raise RuntimeError(f"exit code {result.returncode} at {threads} threads: "
+                               f"{result.stderr[-500:]}")
+        try:
+            with open(profile, 'r') as f:
+                loops = json.load(f).get("loops", [])
+        except (OSError, ValueError):
+            raise RuntimeError(f"no loop profile written at {threads} threads "
+                               f"(is the binary built with -passes=parallel-profile?)")
+        return wall, {loop["id"]: loop for loop in loops}
+
+    def sweep(self):
+        for threads in self.threads:
+            print(f"⏱️  OMP_NUM_THREADS={threads}: {self.repeat} runs")
+            self._run(threads, -1)  # Warm-up
+            self.runs[threads] = [self._run(threads, k) for k in range(self.repeat)]
+
+    def _loop_times(self) -> Dict[str, Dict[int, List[float]]]:
+        """
+        Seconds of each loop per thread count and run. A loop of an outlined
+        parallel region is entered once per thread, so its summed time is
+        divided by its entries relative to the one-thread run: the average
+        thread's time, which hides load imbalance.
+        """
+        times: Dict[str, Dict[int, List[float]]] = {}
+        single = {}
+        for _, loops in self.runs.get(1, []):
+            for loop_id, loop in loops.items():
+                single.setdefault(loop_id, loop.get("entries", 0))
+        for threads, runs in self.runs.items():
+            for _, loops in runs:
+                for loop_id, loop in loops.items():
+                    seconds = float(loop.get("seconds", 0.0))
+                    if single.get(loop_id):
+                        workers = loop.get("entries", 0) / single[loop_id]
+                        seconds /= max(1.0, min(workers, float(threads)))
+                    times.setdefault(loop_id, {}).setdefault(threads, []).append(seconds)
+        return times
+
+    def analyze(self) -> Dict[str, Any]:
+        limit = max(self.threads) * EXTRAPOLATION
+        walls = {n: [w for w, _ in runs] for n, runs in self.runs.items()}
+        loops = {}
+        for loop_id, times in self._loop_times().items():
+            if 1 not in times or statistics.median(times[1]) < self.min_seconds or len(times) < 2:
+                continue
+            loops[loop_id] = analyze_scaling(times, self.min_efficiency, limit)
+        return {
+            "binary": self.binary,
+            "threads": self.threads,
+            "repeat": self.repeat,
+            "program": analyze_scaling(walls, self.min_efficiency, limit),
+            "loops": loops,
+        }
+
+    @staticmethod
+    def _outlined(function: str) -> bool:
+        return any(marker in function for marker in OUTLINED_MARKERS)
+
+    def annotate(self, candidates: List[Dict[str, Any]], report: Dict[str, Any]) -> int:
+        """Attach "scaling" to each candidate whose loop was measured"""
+        by_location: Dict[Tuple[str, int], List[str]] = {}
+        for _, loops in self.runs.get(1, []):
+            for loop_id, loop in loops.items():
+                if loop_id in report["loops"] and self._outlined(loop.get("function", "")):
+                    key = (os.path.basename(loop.get("file", "")), int(loop.get("line", 0)))
+                    if loop_id not in by_location.setdefault(key, []):
+                        by_location[key].append(loop_id)
+        annotated = 0
+        for candidate in candidates:
+            loop_id = candidate.get("id") or \
+                f"{candidate.get('file', '')}:{candidate.get('line', 0)}:{candidate.get('function', '')}"
+            if loop_id not in report["loops"]:
+                matches = by_location.get((os.path.basename(candidate.get("file", "")),
+                                           candidate.get("line", 0)), [])
+                if len(matches) != 1:
+                    continue
+                loop_id = matches[0]
+            candidate["scaling"] = dict(report["loops"][loop_id], loop=loop_id)
+            annotated += 1
+        return annotated
+
+
+def describe(name: str, result: Dict[str, Any]) -> str:
+    amdahl = result.get("amdahl", {})
+    usl = result.get("usl", {})
+    parts = [f"{name}:"]
+    if amdahl:
+        parts.append(f"serial {100 * amdahl['serial_fraction']:.1f}%")
+    if usl:
+        parts.append(f"contention {usl['contention']:.3f} coherency {usl['coherency']:.4f}")
+    if result.get("optimal_threads"):
+        parts.append(f"peak at {result['optimal_threads']} threads")
+    if "recommended_threads" in result:
+        parts.append(f"→ {result['recommended_threads']} threads")
+    if result.get("noisy_timing"):
+        parts.append("(noisy)")
+    return " ".join(parts)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fit Amdahl and USL scaling models to profiled loops')
+    parser.add_argument('binary', help='Program built with -passes=parallel-profile (and OpenMP)')
+    parser.add_argument('--candidates', help='Analysis JSON whose candidates get a "scaling" entry')
+    parser.add_argument('-o', '--output', help='Output file (default: candidates_file_scaling.json, '
+                                               'or binary_scaling.json)')
+    parser.add_argument('--threads', help='Comma separated thread counts (default: 1,2,4...hardware threads)')
+    parser.add_argument('--repeat', type=int, default=3, help='Runs per thread count (default: 3)')
+    parser.add_argument('--timeout', type=float, default=300.0, help='Seconds per run before giving up')
+    parser.add_argument('--min-seconds', type=float, default=MIN_SECONDS,
+                        help=f'Ignore loops faster than this at one thread (default: {MIN_SECONDS})')
+    parser.add_argument('--min-efficiency', type=float, default=MIN_EFFICIENCY,
+                        help=f'Efficiency below which more threads stop paying off (default: {MIN_EFFICIENCY})')
+    parser.add_argument('--keep', action='store_true', help='Keep the profiles of every run')
+    parser.add_argument('--args', default='', help='Arguments for the program, as one string')
+
+    args = parser.parse_args()
+    base = args.candidates or args.binary
+    output_file = args.output or f"{os.path.splitext(base)[0]}_scaling.json"
+    threads = [int(t) for t in args.threads.split(',')] if args.threads else None
+
+    explorer = ScalingExplorer(args.binary, threads, args.repeat, shlex.split(args.args),
+                               args.timeout, args.min_seconds, args.min_efficiency)
+    try:
+        explorer.sweep()
+    except (OSError, RuntimeError, subprocess.TimeoutExpired) as e:
+        print(f"❌ {e}")
+        sys.exit(1)
+    finally:
+        if not args.keep:
+            subprocess.run(["rm", "-rf", explorer.work_dir])
+    report = explorer.analyze()
+
+    print(f"📈 {describe('program', report['program'])}")
+    ranked = sorted(report["loops"].items(), key=lambda item: -item[1]["seconds"]["1"])
+    for loop_id, result in ranked[:10]:
+        print(f"   {describe(loop_id, result)}")
+
+    if args.candidates:
+        with open(args.candidates, 'r') as f:
+            candidates = json.load(f)
+        matched = explorer.annotate(candidates, report)
+        with open(output_file, 'w') as f:
+            json.dump(candidates, f, indent=2)
+        print(f"✅ {matched} candidates with scaling fits → {output_file}")
+    else:
+        with open(output_file, 'w') as f:
+            json.dump(report, f, indent=2)
+        print(f"✅ {len(report['loops'])} loops fitted → {output_file}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+"""
+Speedup Validator for suggested parallelization patches
+Builds the source as is and with each candidate's pragma applied, times both
+at 1, 2, 4 ... N threads, checks that the outputs agree and records the
+measured speedup and parallel efficiency in the candidate record
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from typing import Dict, Any, List, Optional, Tuple
+
+# Best speedup below this is a slowdown; 1-thread time above baseline / this
+# is parallel overhead
+SLOWDOWN_THRESHOLD = 1.0
+OVERHEAD_THRESHOLD = 0.9
+# Efficiency at the largest thread count below this is poor scaling
+POOR_EFFICIENCY = 0.5
+# (max - min) / median of the repeated runs above this makes a result unreliable
+NOISY_SPREAD = 0.25
+
+NUMBER = re.compile(r'[-+]?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?|[-+]?(?:inf|nan)\b', re.IGNORECASE)
+
+
+class SpeedupValidator:
+    def __init__(self, source_file: str, compiler: str = "g++", flags: str = "-O2",
+                 threads: Optional[List[int]] = None, repeat: int = 5,
+                 run_args: Optional[List[str]] = None, timeout: float = 120.0,
+                 rtol: float = 1e-6, work_dir: Optional[str] = None):
+        self.source_file = source_file
+        self.compiler = compiler
+        self.flags = shlex.split(flags)
+        self.threads = threads or self._default_threads()
+        self.repeat = max(1, repeat)
+        self.run_args = run_args or []
+        self.timeout = timeout
+        self.rtol = rtol
+        self.work_dir = work_dir or tempfile.mkdtemp(prefix="speedup_")
+
+        with open(source_file, 'r') as f:
+            self.source_lines = f.readlines()
+
+        self.baseline: Optional[Dict[str, Any]] = None
+
+    @staticmethod
+    def _default_threads() -> List[int]:
+        """1, 2, 4 ... up to the hardware threads (which is always included)"""
+        cpus = os.cpu_count() or 1
+        threads = []
+        t = 1
+        while t < cpus:
+            threads.append(t)
+            t *= 2
+        threads.append(cpus)
+        return threads
+
+    def _build(self, source: str, name: str) -> Tuple[Optional[str], str]:
+        """Compile source into the work directory; returns (binary, diagnostics)"""
+        src = os.path.join(self.work_dir, name + os.path.splitext(self.source_file)[1])
+        binary = os.path.join(self.work_dir, name)
+        with open(src, 'w') as f:
+            f.write(source)
+        cmd = [self.compiler, *self.flags, "-fopenmp",
+               "-I", os.path.dirname(os.path.abspath(self.source_file)), src, "-o", binary]
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            return None, result.stderr[-2000:]
+        return binary, result.stderr
+
+    def _run(self, binary: str, threads: int) -> Tuple[float, str, int]:
+        """One timed run; returns (seconds, stdout, exit code)"""
+        env = dict(os.environ, OMP_NUM_THREADS=str(threads))
+        start = time.perf_counter()
+        result = subprocess.run([binary, *self.run_args], capture_output=True, text=True,
+                                env=env, timeout=self.timeout)
+        return time.perf_counter() - start, result.stdout, result.returncode
+
+    def _time(self, binary: str, threads: int) -> Dict[str, Any]:
+        """Median of repeated runs after one warm-up run"""
+        _, output, code = self._run(binary, threads)
+        times = []
+        for _ in range(self.repeat):
+            seconds, _, _ = self._run(binary, threads)
+            times.append(seconds)
+        return {
+            "seconds": statistics.median(times),
+            "spread": (max(times) - min(times)) / statistics.median(times) if len(times) > 1 else 0.0,
+            "output": output,
+            "exit_code": code,
+        }
+
+    def outputs_match(self, expected: str, actual: str) -> bool:
+        """Same text, with numbers compared to a relative tolerance (reductions reorder FP)"""
+        if expected == actual:
+            return True
+        expected_numbers = NUMBER.findall(expected)
+        actual_numbers = NUMBER.findall(actual)
+        if NUMBER.sub('#', expected) != NUMBER.sub('#', actual):
+            return False
+        if len(expected_numbers) != len(actual_numbers):
+            return False
+        for e, a in zip(expected_numbers, actual_numbers):
+            x, y = float(e), float(a)
+            if x != y and abs(x - y) > self.rtol * max(abs(x), abs(y), 1e-300):
+                return False
+        return True
+
+    def apply_pragma(self, line: int, pragma: str) -> Optional[str]:
+        """Source with the directive inserted above line (1-based), indented like it"""
+        if line <= 0 or line > len(self.source_lines):
+            return None
+        target = self.source_lines[line - 1]
+        indent = target[:len(target) - len(target.lstrip())]
+        lines = list(self.source_lines)
+        lines.insert(line - 1, indent + pragma.strip() + "\n")
+        return "".join(lines)
+
+    def run_baseline(self) -> Dict[str, Any]:
+        if self.baseline is None:
+            binary, diagnostics = self._build("".join(self.source_lines), "baseline")
+            if not binary:
+                raise RuntimeError(f"Baseline build failed:\n{diagnostics}")
+            print(f"⏱️  Timing baseline ({self.repeat} runs)...")
+            self.baseline = self._time(binary, 1)
+            if self.baseline["exit_code"] != 0:
+                raise RuntimeError(f"Baseline exited with {self.baseline['exit_code']}")
+            print(f"   baseline: {self.baseline['seconds']:.4f}s")
+        return self.baseline
+
+    def validate(self, line: int, pragma: str, name: str) -> Dict[str, Any]:
+        """Build the patched source and measure it at every thread count"""
+        baseline = self.run_baseline()
+        record: Dict[str, Any] = {
+            "pragma": pragma.strip(),
+            "line": line,
+            "baseline_seconds": baseline["seconds"],
+            "threads": self.threads,
+            "flags": [],
+        }
+        source = self.apply_pragma(line, pragma)
+        if source is None:
+            record["status"] = "skipped"
+            record["flags"].append("line_out_of_range")
+            return record
+        if not re.search(r'\b(for|while|do)\b', self.source_lines[line - 1]):
+            record["flags"].append("no_loop_on_line")
+
+        binary, diagnostics = self._build(source, name)
+        if not binary:
+            record["status"] = "build_failed"
+            record["diagnostics"] = diagnostics
+            return record
+
+        seconds, speedup, efficiency = {}, {}, {}
+        outputs_match = True
+        spread = baseline["spread"]
+        for t in self.threads:
+            try:
+                run = self._time(binary, t)
+            except subprocess.TimeoutExpired:
+                record["status"] = "run_failed"
+                record["flags"].append(f"timeout_at_{t}_threads")
+                return record
+            if run["exit_code"] != 0:
+                record["status"] = "run_failed"
+                record["flags"].append(f"exit_{run['exit_code']}_at_{t}_threads")
+                return record
+            if not self.outputs_match(baseline["output"], run["output"]):
+                outputs_match = False
+            seconds[t] = run["seconds"]
+            spread = max(spread, run["spread"])
+            speedup[t] = baseline["seconds"] / run["seconds"]
+            efficiency[t] = speedup[t] / t
+            print(f"   {t:3d} threads: {run['seconds']:.4f}s  speedup {speedup[t]:.2f}x  "
+                  f"efficiency {efficiency[t]:.0%}")
+
+        record.update({
+            "seconds": seconds,
+            "speedup": speedup,
+            "efficiency": efficiency,
+            "outputs_match": outputs_match,
+        })
+        best = max(self.threads, key=lambda t: speedup[t])
+        record["best_threads"] = best
+        record["best_speedup"] = speedup[best]
+        record["flags"].extend(self.diagnose(speedup))
+        if spread > NOISY_SPREAD:
+            record["flags"].append("noisy_timing")
+        if not outputs_match:
+            record["status"] = "incorrect"
+        elif speedup[best] < SLOWDOWN_THRESHOLD:
+            record["status"] = "slowdown"
+        else:
+            record["status"] = "speedup"
+        return record
+
+    def diagnose(self, speedup: Dict[int, float]) -> List[str]:
+        """
+        Name the likely cause of a bad result from the shape of the curve:
+        - overhead: already slower than the baseline on one thread (fork/join,
+          scheduling or lost vectorization dominate the loop's work)
+        - false_sharing_suspected: one thread is fine but more threads make it
+          slower, the signature of threads invalidating each other's lines
+        - poor_scaling: gains, but far from linear at the largest count
+        """
+        flags = []
+        ordered = sorted(speedup)
+        one = speedup.get(1)
+        if one is not None and one < OVERHEAD_THRESHOLD:
+            flags.append("overhead")
+        peak = max(ordered, key=lambda t: speedup[t])
+        last = ordered[-1]
+        if len(ordered) > 1 and peak < last and speedup[last] < speedup[peak] * 0.8 \
+                and (one is None or one >= OVERHEAD_THRESHOLD):
+            flags.append("false_sharing_suspected")
+        if last > 1 and speedup[last] / last < POOR_EFFICIENCY and speedup[last] >= SLOWDOWN_THRESHOLD:
+            flags.append("poor_scaling")
+        return flags
+
+    def validate_candidates(self, candidates: List[Dict[str, Any]],
+                            only: Optional[List[str]] = None) -> List[Dict[str, Any]]:
+        """Validate each distinct (line, pragma) once and record it on every candidate sharing it"""
+        base = os.path.basename(self.source_file)
+        measured: Dict[Tuple[int, str], Dict[str, Any]] = {}
+        for candidate in candidates:
+            analysis = candidate.get("analysis", {})
+            pragma = analysis.get("pragma")
+            if not pragma:
+                continue
+            if only and candidate.get("candidate_type") not in only:
+                continue
+            if os.path.basename(candidate.get("file", "")) != base:
+                continue
+            line = analysis.get("loop_range", {}).get("start_line", candidate.get("line", 0))
+            key = (line, pragma)
+            if key not in measured:
+                print(f"🔬 {base}:{line} {pragma.strip()}")
+                measured[key] = self.validate(line, pragma, f"patched_{len(measured)}")
+                print(f"   → {measured[key]['status']}"
+                      + (f" ({', '.join(measured[key]['flags'])})" if measured[key]['flags'] else ""))
+            candidate["validation"] = measured[key]
+        return candidates
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the speedup of suggested pragmas')
+    parser.add_argument('candidates_file', help='Analysis JSON with candidates')
+    parser.add_argument('source_file', help='Source file the candidates refer to (must build into a program)')
+    parser.add_argument('-o', '--output', help='Output file (default: candidates_file_validated.json)')
+    parser.add_argument('--compiler', default=os.getenv('CXX', 'g++'), help='Compiler (default: $CXX or g++)')
+    parser.add_argument('--flags', default='-O2', help='Compiler flags for both builds (default: -O2)')
+    parser.add_argument('--threads', help='Comma separated thread counts (default: 1,2,4...hardware threads)')
+    parser.add_argument('--repeat', type=int, default=5, help='Timed runs per configuration (default: 5)')
+    parser.add_argument('--rtol', type=float, default=1e-6, help='Relative tolerance for numbers in the output')
+    parser.add_argument('--timeout', type=float, default=120.0, help='Seconds per run before giving up')
+    parser.add_argument('--only', help='Comma separated candidate types to validate')
+    parser.add_argument('--keep', action='store_true', help='Keep the build directory')
+    parser.add_argument('--args', default='', help='Arguments for the program, as one string')
+
+    args = parser.parse_args()
+
+    output_file = args.output or f"{os.path.splitext(args.candidates_file)[0]}_validated.json"
+    threads = [int(t) for t in args.threads.split(',')] if args.threads else None
+    run_args = shlex.split(args.args)
+
+    with open(args.candidates_file, 'r') as f:
+        candidates = json.load(f)
+
+    validator = SpeedupValidator(args.source_file, args.compiler, args.flags, threads,
+                                 args.repeat, run_args, args.timeout, args.rtol)
+    try:
+        validator.validate_candidates(candidates, args.only.split(',') if args.only else None)
+    except RuntimeError as e:
+        print(f"❌ {e}")
+        sys.exit(1)
+    finally:
+        if args.keep:
+            print(f"📁 Builds kept in {validator.work_dir}")
+        else:
+            shutil.rmtree(validator.work_dir, ignore_errors=True)
+
+    with open(output_file, 'w') as f:
+        json.dump(candidates, f, indent=2)
+
+    statuses: Dict[str, int] = {}
+    for candidate in candidates:
+        if "validation" in candidate:
+            status = candidate["validation"]["status"]
+            statuses[status] = statuses.get(status, 0) + 1
+    print(f"✅ Validation results: {statuses or 'no candidate with a plain pragma'} → {output_file}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,303 @@
+//===-- dependence_profile.cpp - Runtime of the dependence profiler -*- C++ -*-===//
+//
+// Each thread keeps a stack of the watched loops it is running; every frame
+// owns a hash table from byte address to the iterations and source lines of
+// its last write and last reads in the current execution. Frames are reused
+// across executions so inner loops do not reallocate their tables. When an
+// execution ends its conflicts are merged into the loop's totals under a
+// lock; the totals are written at exit.
+//
+// Writes also record, per 64-byte line, the first and last iteration that
+// wrote it. A line written by several iterations without any byte being
+// written twice (a WAW) is shared between iterations only through distinct
+// bytes: false sharing once those iterations run on different threads.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dependence_profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum Kind { RAW, WAR, WAW, KindCount };
+const char *const KindNames[KindCount] = {"RAW", "WAR", "WAW"};
+
+constexpr unsigned kLineShift = 6; // 64-byte cache lines
+
+// One per byte, so neighbouring char/short elements do not conflict.
+// Iterations are numbered from 1; 0 means "never"
+struct Shadow {
+    uint64_t writeIter = 0, readIter = 0, earlierReadIter = 0;
+    uint32_t writeLine = 0, readLine = 0, earlierReadLine = 0;
+};
+
+// Iterations that wrote a cache line in the current execution
+struct LineSpan {
+    uint64_t firstIter = 0, lastIter = 0;
+    bool sameByte = false; // Some byte was written by two iterations
+};
+
+// (kind, source line, sink line) -> occurrences
+using Conflicts = std::map<std::tuple<int, uint32_t, uint32_t>, uint64_t>;
+
+struct Frame {
+    const ParallelDepsSite *site = nullptr;
+    uint64_t iteration = 0;
+    uint64_t accesses = 0;
+    std::unordered_map<uintptr_t, Shadow> shadow;
+    std::unordered_map<uintptr_t, LineSpan> lines;
+    Conflicts conflicts;
+};
+
+struct Stats {
+    uint64_t executions = 0, conflicted = 0, iterations = 0, accesses = 0;
+    uint64_t counts[KindCount] = {};
+    uint64_t sharedLines = 0, maxIterationsPerLine = 0;
+    Conflicts conflicts;
+};
+
+struct State {
+    std::mutex lock;
+    std::map<const ParallelDepsSite *, Stats> sites;
+    std::vector<const ParallelDepsSite *> order;
+};
+
+State &state() {
+    static State *s = new State; // Outlives other static destructors
+    return *s;
+}
+
+// Never freed, so accesses from static destructors still find it
+struct Stack {
+    std::vector<Frame> frames;
+    size_t depth = 0;
+};
+thread_local Stack *current = nullptr;
+
+std::string quote(const char *text) {
+    std::string out = "\"";
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        } else if ((unsigned char)*c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", *c);
+            out += buf;
+        } else {
+            out += *c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string outputPath() {
+    const char *env = std::getenv("PARALLEL_DEPS_OUTPUT");
+    std::string path = env && *env ? env : "parallel_deps.json";
+    size_t pos = path.find("%p");
+    if (pos != std::string::npos) path.replace(pos, 2, std::to_string(getpid()));
+    return path;
+}
+
+void merge(Frame &frame) {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto [it, inserted] = s.sites.try_emplace(frame.site);
+    if (inserted) s.order.push_back(frame.site);
+    Stats &stats = it->second;
+    stats.executions += 1;
+    stats.iterations += frame.iteration;
+    stats.accesses += frame.accesses;
+    if (!frame.conflicts.empty()) stats.conflicted += 1;
+    for (const auto &[line, span] : frame.lines) {
+        if (span.sameByte || span.lastIter == span.firstIter) continue;
+        stats.sharedLines += 1;
+        stats.maxIterationsPerLine =
+            std::max(stats.maxIterationsPerLine, span.lastIter - span.firstIter + 1);
+    }
+    for (const auto &[key, count] : frame.conflicts) {
+        stats.counts[std::get<0>(key)] += count;
+        stats.conflicts[key] += count;
+    }
+}
+
+// Ends the executions above and including the innermost frame of site
+void popTo(Stack &stack, const ParallelDepsSite *site) {
+    while (stack.depth > 0) {
+        Frame &top = stack.frames[stack.depth - 1];
+        --stack.depth;
+        merge(top);
+        if (top.site == site) return;
+    }
+}
+
+bool onStack(const Stack &stack, const ParallelDepsSite *site) {
+    for (size_t d = stack.depth; d > 0; --d) {
+        if (stack.frames[d - 1].site == site) return true;
+    }
+    return false;
+}
+
+void check(Frame &frame, uintptr_t first, uintptr_t last, uint32_t line, bool isWrite) {
+    const uint64_t i = frame.iteration;
+    bool found[KindCount] = {};
+    uint32_t source[KindCount] = {};
+    auto note = [&](Kind kind, uint32_t from) {
+        if (!found[kind]) {
+            found[kind] = true;
+            source[kind] = from;
+        }
+    };
+    for (uintptr_t byte = first; byte <= last; ++byte) {
+        Shadow &s = frame.shadow[byte];
+        if (isWrite) {
+            if (s.writeIter == i) continue; // Checked at this iteration's first write
+            LineSpan &span = frame.lines[byte >> kLineShift];
+            if (!span.firstIter) span.firstIter = i;
+            span.lastIter = i;
+            if (s.writeIter) {
+                note(WAW, s.writeLine);
+                span.sameByte = true;
+            }
+            if (s.readIter && s.readIter != i) note(WAR, s.readLine);
+            else if (s.earlierReadIter) note(WAR, s.earlierReadLine);
+            s.writeIter = i;
+            s.writeLine = line;
+        } else {
+            if (s.readIter == i) continue; // Checked at this iteration's first read
+            if (s.writeIter && s.writeIter != i) note(RAW, s.writeLine);
+            s.earlierReadIter = s.readIter;
+            s.earlierReadLine = s.readLine;
+            s.readIter = i;
+            s.readLine = line;
+        }
+    }
+    for (int kind = 0; kind < KindCount; ++kind) {
+        if (found[kind]) frame.conflicts[{kind, source[kind], line}] += 1;
+    }
+}
+
+void dump() {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    std::string path = outputPath();
+    FILE *out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "parallel-deps: cannot write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(out, "{\"version\": 1, \"loops\": [");
+    for (size_t k = 0; k < s.order.size(); ++k) {
+        const ParallelDepsSite *site = s.order[k];
+        const Stats &stats = s.sites[site];
+        const char *verdict = stats.counts[RAW] ? "dependent"
+                              : stats.counts[WAR] || stats.counts[WAW] ? "privatizable"
+                              : "independent";
+
+        std::vector<std::pair<std::tuple<int, uint32_t, uint32_t>, uint64_t>> conflicts(
+            stats.conflicts.begin(), stats.conflicts.end());
+        std::stable_sort(conflicts.begin(), conflicts.end(),
+                         [](const auto &a, const auto &b) { return a.second > b.second; });
+        if (conflicts.size() > 16) conflicts.resize(16);
+
+        char summary[256];
+        if (conflicts.empty()) {
+            std::snprintf(summary, sizeof summary,
+                          "no conflicts observed across %llu executions (%llu iterations)%s",
+                          (unsigned long long)stats.executions,
+                          (unsigned long long)stats.iterations,
+                          site->unobserved_calls ? "; external calls not observed" : "");
+        } else {
+            const auto &[key, count] = conflicts.front();
+            std::snprintf(summary, sizeof summary,
+                          "conflicts in %llu of %llu executions, most often %s line %u -> line %u",
+                          (unsigned long long)stats.conflicted,
+                          (unsigned long long)stats.executions, KindNames[std::get<0>(key)],
+                          std::get<1>(key), std::get<2>(key));
+        }
+
+        std::fprintf(out,
+                     "%s\n  {\"id\": %s, \"file\": %s, \"function\": %s, \"line\": %u, "
+                     "\"executions\": %llu, \"iterations\": %llu, \"accesses\": %llu, "
+                     "\"unobserved_calls\": %u, \"verdict\": \"%s\", "
+                     "\"raw\": %llu, \"war\": %llu, \"waw\": %llu, "
+                     "\"shared_lines\": %llu, \"max_iterations_per_line\": %llu,\n   \"conflicts\": [",
+                     k ? "," : "", quote(site->id).c_str(), quote(site->file).c_str(),
+                     quote(site->function).c_str(), site->line,
+                     (unsigned long long)stats.executions, (unsigned long long)stats.iterations,
+                     (unsigned long long)stats.accesses, site->unobserved_calls, verdict,
+                     (unsigned long long)stats.counts[RAW], (unsigned long long)stats.counts[WAR],
+                     (unsigned long long)stats.counts[WAW],
+                     (unsigned long long)stats.sharedLines,
+                     (unsigned long long)stats.maxIterationsPerLine);
+        for (size_t c = 0; c < conflicts.size(); ++c) {
+            const auto &[key, count] = conflicts[c];
+            std::fprintf(out, "%s{\"kind\": \"%s\", \"source_line\": %u, \"sink_line\": %u, "
+                         "\"count\": %llu}",
+                         c ? ", " : "", KindNames[std::get<0>(key)], std::get<1>(key),
+                         std::get<2>(key), (unsigned long long)count);
+        }
+        std::fprintf(out, "],\n   \"summary\": %s}", quote(summary).c_str());
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+}
+
+} // namespace
+
+extern "C" {
+
+void __parallel_deps_loop_begin(const ParallelDepsSite *site) {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        state();
+        std::atexit(dump);
+    });
+    if (!current) current = new Stack;
+    Stack &stack = *current;
+    if (stack.depth == stack.frames.size()) stack.frames.emplace_back();
+    Frame &frame = stack.frames[stack.depth++];
+    frame.site = site;
+    frame.iteration = 0;
+    frame.accesses = 0;
+    frame.shadow.clear();
+    frame.lines.clear();
+    frame.conflicts.clear();
+}
+
+void __parallel_deps_iteration(const ParallelDepsSite *site) {
+    if (!current || !onStack(*current, site)) return;
+    Stack &stack = *current;
+    // Frames above it were left without passing an exit (unwinding)
+    while (stack.frames[stack.depth - 1].site != site) popTo(stack, stack.frames[stack.depth - 1].site);
+    stack.frames[stack.depth - 1].iteration += 1;
+}
+
+void __parallel_deps_loop_end(const ParallelDepsSite *site) {
+    if (current && onStack(*current, site)) popTo(*current, site);
+}
+
+void __parallel_deps_access(const void *addr, uint64_t size, uint32_t line, uint32_t is_write) {
+    if (!current || current->depth == 0 || size == 0) return;
+    const uintptr_t first = reinterpret_cast<uintptr_t>(addr);
+    const uintptr_t last = first + size - 1;
+    Stack &stack = *current;
+    for (size_t d = 0; d < stack.depth; ++d) {
+        Frame &frame = stack.frames[d];
+        if (frame.iteration == 0) continue;
+        frame.accesses += 1;
+        check(frame, first, last, line, is_write != 0);
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,55 @@
+//===-- dependence_profile.h - Runtime of the dependence profiler -*- C++ -*-===//
+//
+// ABI between code instrumented by -passes=parallel-deps and
+// dependence_profile.cpp. While a watched loop runs, every reported access
+// is checked against a shadow hash table of the addresses touched in the
+// current execution of that loop, byte by byte:
+//   RAW  read of a value written in an earlier iteration
+//   WAR  write of a value read in an earlier iteration
+//   WAW  write of a value written in an earlier iteration
+// A read that follows a write in the same iteration is not a conflict, so
+// per-iteration temporaries show up as WAR/WAW only ("privatizable").
+// Shadow tables are per thread: only conflicts within one thread's
+// execution of the loop are observed.
+//
+// At exit the runtime writes $PARALLEL_DEPS_OUTPUT (default
+// parallel_deps.json, "%p" is replaced by the process id):
+//
+//   {"version": 1, "loops": [{"id": "f.cpp:12:main", "file": "f.cpp",
+//     "function": "main", "line": 12, "executions": 3, "iterations": 3000,
+//     "accesses": 9000, "unobserved_calls": 0, "verdict": "independent",
+//     "raw": 0, "war": 0, "waw": 0, "shared_lines": 0,
+//     "max_iterations_per_line": 0, "conflicts": [],
+//     "summary": "no conflicts observed across 3 executions"}]}
+//
+// "verdict" is independent, privatizable (WAR/WAW only) or dependent;
+// each conflict lists its kind, the source line of the earlier access
+// ("source_line"), of the later one ("sink_line") and how often it occurred.
+//
+// "shared_lines" counts the 64-byte lines that several iterations wrote
+// through distinct bytes, which false-share once those iterations run on
+// different threads; "max_iterations_per_line" is the widest such span.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+
+struct ParallelDepsSite {
+    const char *id;            // "file:line:function", as in the analysis output
+    const char *file;
+    const char *function;
+    uint32_t line;
+    uint32_t unobserved_calls; // External calls in the loop that may write memory
+};
+
+void __parallel_deps_loop_begin(const ParallelDepsSite *site);
+void __parallel_deps_iteration(const ParallelDepsSite *site);
+void __parallel_deps_loop_end(const ParallelDepsSite *site);
+void __parallel_deps_access(const void *addr, uint64_t size, uint32_t line,
+                            uint32_t is_write);
+
+} // extern "C"
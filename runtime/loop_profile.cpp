@@ -0,0 +1,402 @@
+//===-- loop_profile.cpp - Runtime of the loop profiling mode ---*- C++ -*-===//
+//
+// Collects the tables registered by instrumented modules and writes them as
+// JSON at exit. TSC ticks are converted to seconds with a rate measured
+// between the first registration and exit against CLOCK_MONOTONIC. Loops
+// with the same id (inline functions instrumented in several modules) are
+// summed.
+//
+// Hardware counters are a perf_event_open group per thread (user space
+// only, so the default perf_event_paranoid=2 suffices), opened on the
+// thread's first loop entry and read with one read() per snapshot. When
+// the PMU multiplexes the group, deltas are scaled by enabled/running time.
+//
+// Iteration times are summed on the instrumented function's stack and merged
+// into the loop's row under a lock when the loop exits.
+//
+//===----------------------------------------------------------------------===//
+
+#include "loop_profile.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+struct Module {
+    ParallelProfileCounters *counters;
+    const ParallelProfileSite *sites;
+    uint32_t count;
+    uint32_t clock;
+    ParallelProfileHardware *hardware = nullptr;
+    ParallelProfileIterationCost *iterations = nullptr;
+};
+
+constexpr int kHardwareEvents = 4;
+const char *const kHardwareNames[kHardwareEvents] = {"cycles", "instructions", "llc_misses",
+                                                     "branch_misses"};
+
+// Events any thread managed to open (bit per event) and the first failure
+std::atomic<unsigned> hardwareOpened{0};
+std::atomic<int> hardwareErrno{0};
+
+// The perf_event_open group of one thread
+struct ThreadCounters {
+    bool opened = false;
+    int leader = -1;
+    int fds[kHardwareEvents] = {-1, -1, -1, -1};
+    int slot[kHardwareEvents] = {-1, -1, -1, -1}; // Position in the group read
+
+    ~ThreadCounters() {
+        for (int fd : fds)
+            if (fd >= 0) close(fd);
+    }
+
+    void open() {
+        opened = true;
+#ifdef __linux__
+        const uint64_t configs[kHardwareEvents] = {PERF_COUNT_HW_CPU_CYCLES,
+                                                   PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES,
+                                                   PERF_COUNT_HW_BRANCH_MISSES};
+        int members = 0;
+        for (int e = 0; e < kHardwareEvents; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof attr);
+            attr.size = sizeof attr;
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[e];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                int expected = 0;
+                hardwareErrno.compare_exchange_strong(expected, errno);
+                continue;
+            }
+            if (leader < 0) leader = fd;
+            fds[e] = fd;
+            slot[e] = members++;
+            hardwareOpened.fetch_or(1u << e);
+        }
+#endif
+    }
+
+    void read(ParallelProfileHardware &out) {
+        out = {};
+        if (!opened) open();
+        if (leader < 0) return;
+        uint64_t buf[3 + kHardwareEvents]; // nr, time_enabled, time_running, values
+        if (::read(leader, buf, sizeof buf) < ssize_t(3 * sizeof(uint64_t))) return;
+        uint64_t *values[kHardwareEvents] = {&out.cycles, &out.instructions, &out.llc_misses,
+                                             &out.branch_misses};
+        for (int e = 0; e < kHardwareEvents; ++e)
+            if (slot[e] >= 0 && uint64_t(slot[e]) < buf[0]) *values[e] = buf[3 + slot[e]];
+        out.time_enabled = buf[1];
+        out.time_running = buf[2];
+    }
+};
+
+thread_local ThreadCounters threadCounters;
+
+std::mutex iterationLock; // Guards the iteration cost rows
+
+struct State {
+    std::mutex lock;
+    std::vector<Module> modules;
+    uint64_t startNs = 0;
+    uint64_t startTsc = 0;
+};
+
+State &state() {
+    static State *s = new State; // Outlives other static destructors
+    return *s;
+}
+
+uint64_t monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+}
+
+uint64_t readTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+std::string quote(const char *text) {
+    std::string out = "\"";
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+            out += *c;
+        } else if ((unsigned char)*c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", *c);
+            out += buf;
+        } else {
+            out += *c;
+        }
+    }
+    return out + "\"";
+}
+
+std::string outputPath() {
+    const char *env = std::getenv("PARALLEL_PROFILE_OUTPUT");
+    std::string path = env && *env ? env : "parallel_profile.json";
+    size_t pos = path.find("%p");
+    if (pos != std::string::npos) path.replace(pos, 2, std::to_string(getpid()));
+    return path;
+}
+
+struct Row {
+    const ParallelProfileSite *site;
+    const char *parent;
+    uint32_t clock;
+    uint64_t entries = 0, iterations = 0, ticks = 0;
+    ParallelProfileHardware hardware = {};
+    bool timed = false; // Iterations were timed one by one
+    double sumSquares = 0;
+    uint64_t maxTicks = 0;
+};
+
+std::string hardwareSummary() {
+    unsigned opened = hardwareOpened.load();
+    if (!opened) {
+        int error = hardwareErrno.load();
+        return std::string("{\"available\": false, \"error\": ") +
+               quote(error ? (std::string("perf_event_open: ") + std::strerror(error)).c_str()
+                           : "no counters were read") +
+               "}";
+    }
+    std::string events;
+    for (int e = 0; e < kHardwareEvents; ++e)
+        if (opened & (1u << e)) events += std::string(events.empty() ? "" : ", ") + "\"" +
+                                          kHardwareNames[e] + "\"";
+    return "{\"available\": true, \"events\": [" + events + "]}";
+}
+
+std::string hardwareRow(const Row &row) {
+    const ParallelProfileHardware &h = row.hardware;
+    if (h.time_running == 0) return "null";
+    unsigned opened = hardwareOpened.load();
+    auto count = [&](int e, uint64_t value) {
+        return opened & (1u << e) ? std::to_string(value) : std::string("null");
+    };
+    auto ratio = [&](int e, uint64_t value, double over) {
+        if (!(opened & (1u << e)) || over <= 0) return std::string("null");
+        char buf[32];
+        std::snprintf(buf, sizeof buf, "%.6g", value / over);
+        return std::string(buf);
+    };
+    return "{\"cycles\": " + count(0, h.cycles) +
+           ", \"instructions\": " + count(1, h.instructions) +
+           ", \"llc_misses\": " + count(2, h.llc_misses) +
+           ", \"branch_misses\": " + count(3, h.branch_misses) +
+           ", \"ipc\": " + (opened & 1u ? ratio(1, h.instructions, double(h.cycles))
+                                          : std::string("null")) +
+           ", \"llc_misses_per_iteration\": " + ratio(2, h.llc_misses, double(row.iterations)) +
+           ", \"branch_misses_per_iteration\": " +
+           ratio(3, h.branch_misses, double(row.iterations)) +
+           ", \"multiplexed\": " + (h.time_running < h.time_enabled ? "true" : "false") + "}";
+}
+
+std::string iterationRow(const Row &row, double rate) {
+    if (!row.timed || row.iterations == 0 || rate <= 0) return "null";
+    const double n = double(row.iterations);
+    const double mean = row.ticks / n;
+    const double variance = row.sumSquares / n - mean * mean;
+    const double stddev = variance > 0 ? std::sqrt(variance) : 0.0;
+    char buf[256];
+    std::snprintf(buf, sizeof buf,
+                  "{\"mean_seconds\": %.6g, \"stddev_seconds\": %.6g, \"max_seconds\": %.6g, "
+                  "\"sum_squares\": %.6g, \"cv\": %.4g, \"max_over_mean\": %.4g}",
+                  mean / rate, stddev / rate, row.maxTicks / rate,
+                  row.sumSquares / (rate * rate), mean > 0 ? stddev / mean : 0.0,
+                  mean > 0 ? row.maxTicks / mean : 0.0);
+    return buf;
+}
+
+void dump() {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    const uint64_t endNs = monotonicNs();
+    const double wall = (endNs - s.startNs) * 1e-9;
+    const double tscRate = wall > 0 ? (readTsc() - s.startTsc) / wall : 0;
+
+    std::map<std::string, Row> rows;
+    std::vector<std::string> order;
+    bool anyTsc = false;
+    bool anyHardware = false;
+    bool anyIterations = false;
+    for (const Module &m : s.modules) {
+        anyTsc |= m.clock == PARALLEL_PROFILE_CLOCK_TSC;
+        anyHardware |= m.hardware != nullptr;
+        anyIterations |= m.iterations != nullptr;
+        for (uint32_t k = 0; k < m.count; ++k) {
+            const ParallelProfileCounters &c = m.counters[k];
+            if (c.entries == 0) continue;
+            auto [it, inserted] = rows.try_emplace(m.sites[k].id);
+            Row &row = it->second;
+            if (inserted) {
+                order.push_back(m.sites[k].id);
+                row.site = &m.sites[k];
+                row.parent = m.sites[k].parent >= 0 ? m.sites[m.sites[k].parent].id : nullptr;
+                row.clock = m.clock;
+            }
+            row.entries += c.entries;
+            row.iterations += c.iterations;
+            row.ticks += c.ticks;
+            if (m.hardware) {
+                const ParallelProfileHardware &h = m.hardware[k];
+                row.hardware.cycles += h.cycles;
+                row.hardware.instructions += h.instructions;
+                row.hardware.llc_misses += h.llc_misses;
+                row.hardware.branch_misses += h.branch_misses;
+                row.hardware.time_enabled += h.time_enabled;
+                row.hardware.time_running += h.time_running;
+            }
+            if (m.iterations && m.iterations[k].max_ticks) {
+                row.timed = true;
+                row.sumSquares += m.iterations[k].sum_squares;
+                if (m.iterations[k].max_ticks > row.maxTicks) row.maxTicks = m.iterations[k].max_ticks;
+            }
+        }
+    }
+
+    std::string path = outputPath();
+    FILE *out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "parallel-profile: cannot write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(out, "{\"version\": 1, \"clock\": \"%s\", \"ticks_per_second\": %.6g, "
+                 "\"wall_seconds\": %.6f,",
+                 anyTsc ? "tsc" : "clock_gettime", anyTsc ? tscRate : 1e9, wall);
+    if (anyHardware) std::fprintf(out, "\n \"hardware_counters\": %s,", hardwareSummary().c_str());
+    std::fprintf(out, "\n \"loops\": [");
+    for (size_t k = 0; k < order.size(); ++k) {
+        const Row &row = rows[order[k]];
+        const double rate = row.clock == PARALLEL_PROFILE_CLOCK_TSC ? tscRate : 1e9;
+        std::fprintf(out,
+                     "%s\n  {\"id\": %s, \"file\": %s, \"function\": %s, \"line\": %u, "
+                     "\"parent\": %s, \"entries\": %llu, \"iterations\": %llu, "
+                     "\"ticks\": %llu, \"seconds\": %.9g%s%s%s%s}",
+                     k ? "," : "", quote(row.site->id).c_str(), quote(row.site->file).c_str(),
+                     quote(row.site->function).c_str(), row.site->line,
+                     row.parent ? quote(row.parent).c_str() : "null",
+                     (unsigned long long)row.entries, (unsigned long long)row.iterations,
+                     (unsigned long long)row.ticks, rate > 0 ? row.ticks / rate : 0.0,
+                     anyHardware ? ", \"hardware\": " : "",
+                     anyHardware ? hardwareRow(row).c_str() : "",
+                     anyIterations ? ", \"iteration_cost\": " : "",
+                     anyIterations ? iterationRow(row, rate).c_str() : "");
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+}
+
+} // namespace
+
+extern "C" {
+
+void __parallel_profile_register(ParallelProfileCounters *counters,
+                                 const ParallelProfileSite *sites, uint32_t count,
+                                 uint32_t clock) {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (s.modules.empty()) {
+        s.startNs = monotonicNs();
+        s.startTsc = readTsc();
+        std::atexit(dump);
+    }
+    s.modules.push_back({counters, sites, count, clock});
+}
+
+uint64_t __parallel_profile_clock(void) {
+    return monotonicNs();
+}
+
+void __parallel_profile_register_hw(ParallelProfileCounters *counters,
+                                    ParallelProfileHardware *hardware) {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    for (Module &m : s.modules)
+        if (m.counters == counters) m.hardware = hardware;
+}
+
+void __parallel_profile_hw_read(ParallelProfileHardware *snapshot) {
+    threadCounters.read(*snapshot);
+}
+
+void __parallel_profile_hw_add(ParallelProfileHardware *row,
+                               const ParallelProfileHardware *snapshot) {
+    ParallelProfileHardware now;
+    threadCounters.read(now);
+    const uint64_t enabled = now.time_enabled - snapshot->time_enabled;
+    const uint64_t running = now.time_running - snapshot->time_running;
+    if (running == 0) return; // The group was not on the PMU during the loop
+    const double scale = double(enabled) / double(running);
+    auto add = [](uint64_t &total, uint64_t delta) {
+        __atomic_fetch_add(&total, delta, __ATOMIC_RELAXED);
+    };
+    add(row->cycles, uint64_t((now.cycles - snapshot->cycles) * scale));
+    add(row->instructions, uint64_t((now.instructions - snapshot->instructions) * scale));
+    add(row->llc_misses, uint64_t((now.llc_misses - snapshot->llc_misses) * scale));
+    add(row->branch_misses, uint64_t((now.branch_misses - snapshot->branch_misses) * scale));
+    add(row->time_enabled, enabled);
+    add(row->time_running, running);
+}
+
+void __parallel_profile_register_iter(ParallelProfileCounters *counters,
+                                      ParallelProfileIterationCost *costs) {
+    State &s = state();
+    std::lock_guard<std::mutex> guard(s.lock);
+    for (Module &m : s.modules)
+        if (m.counters == counters) m.iterations = costs;
+}
+
+void __parallel_profile_iter_begin(ParallelProfileIterationTimer *timer, uint64_t now) {
+    timer->last = now;
+    timer->sum_squares = 0;
+    timer->max_ticks = 0;
+}
+
+void __parallel_profile_iter_next(ParallelProfileIterationTimer *timer, uint64_t now) {
+    const uint64_t ticks = now - timer->last;
+    timer->last = now;
+    timer->sum_squares += double(ticks) * double(ticks);
+    if (ticks > timer->max_ticks) timer->max_ticks = ticks;
+}
+
+void __parallel_profile_iter_end(ParallelProfileIterationCost *row,
+                                 ParallelProfileIterationTimer *timer, uint64_t now) {
+    __parallel_profile_iter_next(timer, now); // The exiting iteration
+    std::lock_guard<std::mutex> guard(iterationLock);
+    row->sum_squares += timer->sum_squares;
+    if (timer->max_ticks > row->max_ticks) row->max_ticks = timer->max_ticks;
+}
+
+} // extern "C"
@@ -0,0 +1,116 @@
+//===-- loop_profile.h - Runtime of the loop profiling mode -----*- C++ -*-===//
+//
+// ABI between code instrumented by -passes=parallel-profile and
+// loop_profile.cpp. Each instrumented module registers its counter and site
+// tables from a static constructor; at exit the runtime writes every loop
+// that ran to $PARALLEL_PROFILE_OUTPUT (default parallel_profile.json, "%p"
+// is replaced by the process id):
+//
+//   {"version": 1, "clock": "tsc", "ticks_per_second": 2.9e9,
+//    "wall_seconds": 1.25,
+//    "loops": [{"id": "f.cpp:12:main", "file": "f.cpp", "function": "main",
+//               "line": 12, "parent": null, "entries": 1,
+//               "iterations": 1000, "ticks": 123456, "seconds": 4.2e-5}]}
+//
+// "parent" is the id of the enclosing loop; times include inner loops.
+//
+// Modules built with parallel-profile<counters> also register a table of
+// hardware counters, read with perf_event_open on the current thread around
+// each loop. The output then has a "hardware_counters" entry (the events
+// that could be opened, or the error) and each loop that ran a "hardware"
+// entry:
+//
+//   "hardware_counters": {"available": true, "events": ["cycles", ...]},
+//   ... "hardware": {"cycles": 9.1e6, "instructions": 2.3e7,
+//                    "llc_misses": 1.2e4, "branch_misses": 1003,
+//                    "ipc": 2.53, "llc_misses_per_iteration": 12.1,
+//                    "branch_misses_per_iteration": 1.0, "multiplexed": false}
+//
+// Counts include inner loops and callees, and each instrumented loop
+// nested in the measured one adds two reads (system calls) per entry.
+//
+// Modules built with parallel-profile<variance> time every iteration of
+// loops that contain loops or calls, and those loops get an
+// "iteration_cost" entry (null for the others):
+//
+//   ... "iteration_cost": {"mean_seconds": 2.1e-6, "stddev_seconds": 1.2e-6,
+//                          "max_seconds": 4.2e-6, "sum_squares": 5.9e-9,
+//                          "cv": 0.57, "max_over_mean": 2.0}
+//
+// "cv" is the standard deviation over the mean iteration time; the
+// schedule a parallel version needs follows from it.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+
+extern "C" {
+
+struct ParallelProfileCounters {
+    uint64_t entries;
+    uint64_t iterations;
+    uint64_t ticks;
+};
+
+struct ParallelProfileSite {
+    const char *id;       // "file:line:function", as in the analysis output
+    const char *file;
+    const char *function;
+    uint32_t line;
+    int32_t parent;       // Index of the enclosing loop's site, -1 if none
+};
+
+// Counter deltas of one loop, and the snapshot layout of a loop entry
+struct ParallelProfileHardware {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t llc_misses;
+    uint64_t branch_misses;
+    uint64_t time_enabled; // ns the events were enabled / on the PMU
+    uint64_t time_running;
+};
+
+enum ParallelProfileClock : uint32_t {
+    PARALLEL_PROFILE_CLOCK_GETTIME = 0, // Ticks are CLOCK_MONOTONIC ns
+    PARALLEL_PROFILE_CLOCK_TSC = 1,     // Ticks are rdtsc cycles
+};
+
+void __parallel_profile_register(ParallelProfileCounters *counters,
+                                 const ParallelProfileSite *sites,
+                                 uint32_t count, uint32_t clock);
+
+uint64_t __parallel_profile_clock(void);
+
+void __parallel_profile_register_hw(ParallelProfileCounters *counters,
+                                    ParallelProfileHardware *hardware);
+
+void __parallel_profile_hw_read(ParallelProfileHardware *snapshot);
+
+void __parallel_profile_hw_add(ParallelProfileHardware *row,
+                               const ParallelProfileHardware *snapshot);
+
+// Running sums of one loop entry, and the per-loop totals
+struct ParallelProfileIterationTimer {
+    uint64_t last;        // Clock at the start of the current iteration
+    double sum_squares;   // Of iteration ticks
+    uint64_t max_ticks;
+};
+
+struct ParallelProfileIterationCost {
+    double sum_squares;
+    uint64_t max_ticks;
+};
+
+void __parallel_profile_register_iter(ParallelProfileCounters *counters,
+                                      ParallelProfileIterationCost *costs);
+
+void __parallel_profile_iter_begin(ParallelProfileIterationTimer *timer, uint64_t now);
+
+void __parallel_profile_iter_next(ParallelProfileIterationTimer *timer, uint64_t now);
+
+void __parallel_profile_iter_end(ParallelProfileIterationCost *row,
+                                 ParallelProfileIterationTimer *timer, uint64_t now);
+
+} // extern "C"
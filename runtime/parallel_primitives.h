@@ -0,0 +1,283 @@
+//===-- parallel_primitives.h - Scan, compaction, histogram, ... -*- C++ -*-===//
+//
+// Header-only C++17 parallel primitives for the loop shapes a plain OpenMP
+// pragma cannot parallelize, or only slowly: prefix scans, stream
+// compaction (filters), histograms, reductions by key and argmin/argmax.
+// The analyzer's patches call these for prefix_sum and filter candidates,
+// and for histogram candidates that count one input element per iteration
+// into per-thread copies.
+//
+// Every primitive takes an optional WorkStealingPool as its first argument
+// and otherwise uses WorkStealingPool::global(). Ranges are random access.
+// The work is cut into a few contiguous blocks per thread; the per-block
+// loops are plain counted loops over contiguous elements that the compiler
+// can vectorize. Inputs below SerialCutoff elements run serially.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace prt {
+
+enum class ScanKind { Inclusive, Exclusive };
+
+// Positions of the first smallest and first largest element
+struct MinMaxIndex {
+    std::size_t min = 0;
+    std::size_t max = 0;
+};
+
+namespace detail {
+
+// Forking costs more than running this many elements serially
+inline constexpr std::size_t SerialCutoff = std::size_t(1) << 14;
+
+// Four blocks per thread leave room for stealing to balance uneven blocks
+inline std::size_t blockCount(const WorkStealingPool &pool, std::size_t n) {
+    std::size_t blocks = std::min<std::size_t>(std::size_t(pool.size()) * 4,
+                                               n / (SerialCutoff / 4));
+    return n < SerialCutoff || pool.size() == 1 ? 1 : std::max<std::size_t>(1, blocks);
+}
+
+inline std::size_t blockBegin(std::size_t n, std::size_t blocks, std::size_t b) {
+    return n / blocks * b + std::min(b, n % blocks);
+}
+
+// Calls fn(b, lo, hi) for each block of [0, n)
+template <class Fn>
+void forEachBlock(WorkStealingPool &pool, std::size_t n, std::size_t blocks, Fn &&fn) {
+    pool.parallel_for(0, blocks, 1, [&](std::size_t b0, std::size_t b1) {
+        for (std::size_t b = b0; b < b1; ++b) {
+            fn(b, blockBegin(n, blocks, b), blockBegin(n, blocks, b + 1));
+        }
+    });
+}
+
+// Replaces counts by their exclusive prefix sums and returns the total
+inline std::size_t exclusiveOffsets(std::vector<std::size_t> &counts) {
+    std::size_t total = 0;
+    for (std::size_t &count : counts) {
+        std::size_t c = count;
+        count = total;
+        total += c;
+    }
+    return total;
+}
+
+} // namespace detail
+
+// out[i] = init op in[0] op ... op in[i] (inclusive), or the same without
+// in[i] (exclusive); returns init combined with every element. op must be
+// associative; floating-point sums are rounded in a different order than
+// the serial loop. out may equal first.
+template <class InIt, class OutIt, class T, class Op>
+T parallel_scan(WorkStealingPool &pool, InIt first, InIt last, OutIt out, T init, Op op,
+                ScanKind kind = ScanKind::Inclusive) {
+    const std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+    auto scanBlock = [&](std::size_t lo, std::size_t hi, T running) {
+        if (kind == ScanKind::Inclusive) {
+            for (std::size_t i = lo; i < hi; ++i) {
+                running = op(running, first[i]);
+                out[i] = running;
+            }
+        } else {
+            for (std::size_t i = lo; i < hi; ++i) {
+                T value = first[i];
+                out[i] = running;
+                running = op(running, value);
+            }
+        }
+        return running;
+    };
+
+    const std::size_t blocks = detail::blockCount(pool, n);
+    if (blocks == 1) return scanBlock(0, n, init);
+
+    // Block totals, their exclusive scan, then each block from its offset
+    std::vector<T> offsets(blocks, init);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        T total = first[lo];
+        for (std::size_t i = lo + 1; i < hi; ++i) total = op(total, first[i]);
+        offsets[b] = total;
+    });
+    T running = init;
+    for (T &offset : offsets) {
+        T next = op(running, offset);
+        offset = running;
+        running = next;
+    }
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        scanBlock(lo, hi, offsets[b]);
+    });
+    return running;
+}
+
+template <class InIt, class OutIt, class T, class Op>
+T parallel_scan(InIt first, InIt last, OutIt out, T init, Op op,
+                ScanKind kind = ScanKind::Inclusive) {
+    return parallel_scan(WorkStealingPool::global(), first, last, out, init, op, kind);
+}
+
+// Stable copy_if: count, scan the counts, scatter. pred runs once per
+// element. Returns the end of the output.
+template <class InIt, class OutIt, class Pred>
+OutIt parallel_compact(WorkStealingPool &pool, InIt first, InIt last, OutIt out, Pred pred) {
+    const std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+    const std::size_t blocks = detail::blockCount(pool, n);
+    if (blocks == 1) return std::copy_if(first, last, out, pred);
+
+    std::vector<unsigned char> keep(n);
+    std::vector<std::size_t> offsets(blocks);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        std::size_t count = 0;
+        for (std::size_t i = lo; i < hi; ++i) {
+            unsigned char k = pred(first[i]) ? 1 : 0;
+            keep[i] = k;
+            count += k;
+        }
+        offsets[b] = count;
+    });
+    std::size_t total = detail::exclusiveOffsets(offsets);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        OutIt dst = out + offsets[b];
+        for (std::size_t i = lo; i < hi; ++i) {
+            if (keep[i]) *dst++ = first[i];
+        }
+    });
+    return out + total;
+}
+
+template <class InIt, class OutIt, class Pred>
+OutIt parallel_compact(InIt first, InIt last, OutIt out, Pred pred) {
+    return parallel_compact(WorkStealingPool::global(), first, last, out, pred);
+}
+
+// ++bins[binOf(x)] for every element, skipping bins >= numBins. Each block
+// counts into a private copy of the bins, merged bin-parallel at the end;
+// fewer blocks are used when the copies would outweigh the input.
+template <class InIt, class Count, class BinOf>
+void parallel_histogram(WorkStealingPool &pool, InIt first, InIt last, Count *bins,
+                        std::size_t numBins, BinOf binOf) {
+    const std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+    auto countBlock = [&](Count *hist, std::size_t lo, std::size_t hi) {
+        for (std::size_t i = lo; i < hi; ++i) {
+            std::size_t bin = static_cast<std::size_t>(binOf(first[i]));
+            if (bin < numBins) ++hist[bin];
+        }
+    };
+
+    std::size_t blocks = std::min<std::size_t>(detail::blockCount(pool, n), pool.size());
+    blocks = std::min(blocks, std::max<std::size_t>(1, n / std::max<std::size_t>(1, numBins)));
+    if (blocks == 1) {
+        countBlock(bins, 0, n);
+        return;
+    }
+
+    std::vector<Count> priv(blocks * numBins, Count{});
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        countBlock(priv.data() + b * numBins, lo, hi);
+    });
+    pool.parallel_for(0, numBins, 1024, [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t b = 0; b < blocks; ++b) {
+            const Count *hist = priv.data() + b * numBins;
+            for (std::size_t k = lo; k < hi; ++k) bins[k] += hist[k];
+        }
+    });
+}
+
+template <class InIt, class Count, class BinOf>
+void parallel_histogram(InIt first, InIt last, Count *bins, std::size_t numBins, BinOf binOf) {
+    parallel_histogram(WorkStealingPool::global(), first, last, bins, numBins, binOf);
+}
+
+// Combines the values of each run of equal consecutive keys with op, like
+// thrust::reduce_by_key; writes one key and value per run and returns the
+// number of runs. Runs are reduced in parallel, each one serially.
+template <class KeyIt, class ValueIt, class KeyOut, class ValueOut, class Op>
+std::size_t parallel_reduce_by_key(WorkStealingPool &pool, KeyIt keysFirst, KeyIt keysLast,
+                                   ValueIt values, KeyOut keysOut, ValueOut valuesOut, Op op) {
+    const std::size_t n = static_cast<std::size_t>(std::distance(keysFirst, keysLast));
+    if (n == 0) return 0;
+    auto isHead = [&](std::size_t i) { return i == 0 || !(keysFirst[i] == keysFirst[i - 1]); };
+
+    // Start of every run, found with the count-scan-scatter of compaction
+    const std::size_t blocks = detail::blockCount(pool, n);
+    std::vector<std::size_t> offsets(blocks);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        std::size_t count = 0;
+        for (std::size_t i = lo; i < hi; ++i) count += isHead(i);
+        offsets[b] = count;
+    });
+    const std::size_t runs = detail::exclusiveOffsets(offsets);
+    std::vector<std::size_t> heads(runs + 1);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        std::size_t *dst = heads.data() + offsets[b];
+        for (std::size_t i = lo; i < hi; ++i) {
+            if (isHead(i)) *dst++ = i;
+        }
+    });
+    heads[runs] = n;
+
+    const std::size_t grain = std::max<std::size_t>(1, runs / (std::size_t(pool.size()) * 8));
+    pool.parallel_for(0, runs, n < detail::SerialCutoff ? runs : grain,
+                      [&](std::size_t lo, std::size_t hi) {
+        for (std::size_t r = lo; r < hi; ++r) {
+            auto value = values[heads[r]];
+            for (std::size_t i = heads[r] + 1; i < heads[r + 1]; ++i) value = op(value, values[i]);
+            keysOut[r] = keysFirst[heads[r]];
+            valuesOut[r] = value;
+        }
+    });
+    return runs;
+}
+
+template <class KeyIt, class ValueIt, class KeyOut, class ValueOut, class Op>
+std::size_t parallel_reduce_by_key(KeyIt keysFirst, KeyIt keysLast, ValueIt values,
+                                   KeyOut keysOut, ValueOut valuesOut, Op op) {
+    return parallel_reduce_by_key(WorkStealingPool::global(), keysFirst, keysLast, values,
+                                  keysOut, valuesOut, op);
+}
+
+// First positions of the smallest and largest element under comp, as
+// std::min_element and std::max_element find them; {0, 0} when empty
+template <class It, class Compare = std::less<>>
+MinMaxIndex parallel_argminmax(WorkStealingPool &pool, It first, It last, Compare comp = {}) {
+    const std::size_t n = static_cast<std::size_t>(std::distance(first, last));
+    if (n == 0) return {};
+    auto scanBlock = [&](std::size_t lo, std::size_t hi) {
+        MinMaxIndex result{lo, lo};
+        for (std::size_t i = lo + 1; i < hi; ++i) {
+            if (comp(first[i], first[result.min])) result.min = i;
+            if (comp(first[result.max], first[i])) result.max = i;
+        }
+        return result;
+    };
+
+    const std::size_t blocks = detail::blockCount(pool, n);
+    if (blocks == 1) return scanBlock(0, n);
+    std::vector<MinMaxIndex> partial(blocks);
+    detail::forEachBlock(pool, n, blocks, [&](std::size_t b, std::size_t lo, std::size_t hi) {
+        partial[b] = scanBlock(lo, hi);
+    });
+    // Blocks in order with strict comparisons keep the first occurrence
+    MinMaxIndex result = partial.front();
+    for (const MinMaxIndex &p : partial) {
+        if (comp(first[p.min], first[result.min])) result.min = p.min;
+        if (comp(first[result.max], first[p.max])) result.max = p.max;
+    }
+    return result;
+}
+
+template <class It, class Compare = std::less<>>
+MinMaxIndex parallel_argminmax(It first, It last, Compare comp = {}) {
+    return parallel_argminmax(WorkStealingPool::global(), first, last, comp);
+}
+
+} // namespace prt
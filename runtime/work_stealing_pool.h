@@ -0,0 +1,236 @@
+//===-- work_stealing_pool.h - Fork-join pool with work stealing -*- C++ -*-===//
+//
+// Header-only thread pool behind the parallel primitives. Every thread owns
+// a deque of index ranges: it splits the range it runs, keeps the lower half
+// and pushes the upper half at the back of its deque. Idle threads steal
+// from the front of other deques, which hands them the largest pieces left.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace prt {
+
+class WorkStealingPool {
+public:
+    // threads counts the calling thread, which runs work while it waits
+    explicit WorkStealingPool(unsigned threads = defaultThreads())
+        : size_(std::max(1u, threads)), queues_(new Queue[size_]) {
+        workers_.reserve(size_ - 1);
+        for (unsigned slot = 1; slot < size_; ++slot) {
+            workers_.emplace_back([this, slot] { workerLoop(slot); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &worker : workers_) worker.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    unsigned size() const { return size_; }
+
+    // Calls fn(lo, hi) on disjoint subranges covering [begin, end), none
+    // longer than grain, and returns when all have finished. The first
+    // exception thrown by fn is rethrown here. May be nested.
+    template <class Fn>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, Fn &&fn) {
+        if (begin >= end) return;
+        grain = std::max<std::size_t>(1, grain);
+        if (size_ == 1 || end - begin <= grain) {
+            fn(begin, end);
+            return;
+        }
+
+        using F = std::remove_reference_t<Fn>;
+        Job job;
+        job.invoke = [](const void *ctx, std::size_t lo, std::size_t hi) {
+            (*static_cast<F *>(const_cast<void *>(ctx)))(lo, hi);
+        };
+        job.ctx = std::addressof(fn);
+        job.grain = grain;
+        job.remaining.store(end - begin, std::memory_order_relaxed);
+
+        // External callers share slot 0, one at a time; a thread already
+        // inside this pool keeps its own slot
+        CurrentSlot &current = currentSlot();
+        std::unique_lock<std::mutex> external;
+        bool entered = current.pool != this;
+        if (entered) {
+            external = std::unique_lock<std::mutex>(externalMutex_);
+            current = {this, 0};
+        }
+        unsigned self = current.slot;
+
+        run(self, Task{&job, begin, end});
+        while (job.remaining.load(std::memory_order_acquire) != 0) {
+            Task task;
+            if (pop(self, task) || steal(self, task)) {
+                run(self, task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (entered) current = {};
+        if (job.error) std::rethrow_exception(job.error);
+    }
+
+    // Pool shared by the primitives when none is passed: PRT_NUM_THREADS
+    // threads, else one per hardware thread
+    static WorkStealingPool &global() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    static unsigned defaultThreads() {
+        if (const char *env = std::getenv("PRT_NUM_THREADS")) {
+            int threads = std::atoi(env);
+            if (threads > 0) return static_cast<unsigned>(threads);
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+private:
+    struct Job {
+        void (*invoke)(const void *, std::size_t, std::size_t) = nullptr;
+        const void *ctx = nullptr;
+        std::size_t grain = 1;
+        std::atomic<std::size_t> remaining{0};  // Indices not yet run
+        std::atomic<bool> failed{false};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        Job *job = nullptr;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct CurrentSlot {
+        WorkStealingPool *pool = nullptr;
+        unsigned slot = 0;
+    };
+
+    static CurrentSlot &currentSlot() {
+        static thread_local CurrentSlot current;
+        return current;
+    }
+
+    void run(unsigned self, Task task) {
+        Job &job = *task.job;
+        while (task.end - task.begin > job.grain) {
+            std::size_t mid = task.begin + (task.end - task.begin) / 2;
+            push(self, Task{&job, mid, task.end});
+            task.end = mid;
+        }
+        if (!job.failed.load(std::memory_order_relaxed)) {
+            try {
+                job.invoke(job.ctx, task.begin, task.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job.errorMutex);
+                if (!job.error) job.error = std::current_exception();
+                job.failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        // The owner may return and destroy job once this reaches zero
+        job.remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+    }
+
+    void push(unsigned self, const Task &task) {
+        {
+            std::lock_guard<std::mutex> lock(queues_[self].mutex);
+            queues_[self].tasks.push_back(task);
+        }
+        queued_.fetch_add(1);
+        // Pairs with the sleeper count taken before re-checking queued_
+        if (sleepers_.load() > 0) {
+            { std::lock_guard<std::mutex> lock(sleepMutex_); }
+            wake_.notify_one();
+        }
+    }
+
+    bool pop(unsigned self, Task &task) {
+        std::lock_guard<std::mutex> lock(queues_[self].mutex);
+        if (queues_[self].tasks.empty()) return false;
+        task = queues_[self].tasks.back();
+        queues_[self].tasks.pop_back();
+        queued_.fetch_sub(1);
+        return true;
+    }
+
+    bool steal(unsigned self, Task &task) {
+        for (unsigned i = 1; i < size_; ++i) {
+            Queue &victim = queues_[(self + i) % size_];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned slot) {
+        currentSlot() = {this, slot};
+        // Spin briefly before sleeping: the next fork usually follows soon
+        constexpr int SpinRounds = 64;
+        int idle = 0;
+        for (;;) {
+            Task task;
+            if (pop(slot, task) || steal(slot, task)) {
+                run(slot, task);
+                idle = 0;
+                continue;
+            }
+            if (++idle < SpinRounds) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepers_.fetch_add(1);
+            wake_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+            sleepers_.fetch_sub(1);
+            if (stop_) return;
+            idle = 0;
+        }
+    }
+
+    const unsigned size_;
+    std::unique_ptr<Queue[]> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex externalMutex_;
+
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<unsigned> sleepers_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+
+} // namespace prt
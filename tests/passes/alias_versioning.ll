@@ -0,0 +1,61 @@
+; Loops over may-alias pointers are parallel behind a range check, with the
+; loop header printed in both versions. When a range or loop bound has no
+; source spelling the check is described, not emitted.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK-NOT: if (false
+; CHECK-DAG: "suggested_patch": "// ✅ Runtime alias check from LoopAccessInfo (1 range test(s))\nif (((4 * (unsigned long)n) + (const char *)a <= (const char *)b || (4 * (unsigned long)n) + (const char *)b <= (const char *)a)) {\n    #pragma omp parallel for simd\n    for (long i = 0; i < (unsigned long)n; ++i)\n        /* original loop body */\n} else {\n    // Ranges may overlap - keep the original serial loop\n    for (long i = 0; i < (unsigned long)n; ++i)\n        /* original loop body */\n}"
+; CHECK-DAG: "suggested_patch": "// ⚠️ Parallel only if these ranges do not overlap; the bounds are not expressible in source, so no versioned loop is given\n// requires: ranges of {<pointer>} and {<pointer>} do not overlap"
+; CHECK-DAG: "versioning": "Not emitted - the range or loop bounds are not expressible in source"
+; CHECK-NOT: if (false
+
+; for (i < n) a[i] = 2 * b[i]
+define void @scale(float* %a, float* %b, i32 %n) {
+entry:
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %ph, label %exit
+ph:
+  %wide = zext i32 %n to i64
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %ph ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds float, float* %b, i64 %i
+  %vb = load float, float* %pb
+  %m = fmul float %vb, 2.0
+  %pa = getelementptr inbounds float, float* %a, i64 %i
+  store float %m, float* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %wide
+  br i1 %done, label %exit, label %loop
+exit:
+  ret void
+}
+
+declare float* @get_buffer(i32)
+
+; The same loop over pointers that have no name in the source
+define void @scale_unnamed(i32 %n) {
+entry:
+  %0 = call float* @get_buffer(i32 0)
+  %1 = call float* @get_buffer(i32 1)
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %ph, label %exit
+ph:
+  %wide = zext i32 %n to i64
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %ph ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds float, float* %1, i64 %i
+  %vb = load float, float* %pb
+  %m = fmul float %vb, 2.0
+  %pa = getelementptr inbounds float, float* %0, i64 %i
+  store float %m, float* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, %wide
+  br i1 %done, label %exit, label %loop
+exit:
+  ret void
+}
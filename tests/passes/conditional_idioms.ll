@@ -0,0 +1,129 @@
+; memset, memcpy and axpy replace the whole loop, so the store has to run
+; on every iteration. Stores under an if must not become library calls.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: grep -E '"(candidate_type|function)"' %t.json | paste - - | sort \
+; RUN:   | %FileCheck %s
+; RUN: %FileCheck --check-prefix=CALL --input-file=%t.json %s
+
+; CHECK:      "candidate_type": "embarrassingly_parallel", "function": "copy_positive",
+; CHECK-NEXT: "candidate_type": "embarrassingly_parallel", "function": "fill_odd",
+; CHECK-NEXT: "candidate_type": "embarrassingly_parallel", "function": "masked_axpy",
+; CHECK-NEXT: "candidate_type": "library_call", "function": "axpy",
+; CHECK-NEXT: "candidate_type": "library_call", "function": "fill",
+; CHECK-NOT: "candidate_type"
+
+; CALL-DAG: "call": "cblas_daxpy(n, al, x, 1, y, 1);"
+; CALL-DAG: "call": "memset(a, 0, n * sizeof(int));"
+
+; for (i < n) y[i] += al * x[i]
+define void @axpy(double* noalias %y, double* noalias %x, double %al, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %vx = load double, double* %px
+  %m = fmul double %vx, %al
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %vy = load double, double* %py
+  %s = fadd double %vy, %m
+  store double %s, double* %py
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) if (m[i]) y[i] += al * x[i]
+define void @masked_axpy(double* noalias %y, double* noalias %x, i8* noalias %mask,
+                         double %al, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pm = getelementptr inbounds i8, i8* %mask, i64 %i
+  %vm = load i8, i8* %pm
+  %on = icmp ne i8 %vm, 0
+  br i1 %on, label %update, label %latch
+update:
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %vx = load double, double* %px
+  %m = fmul double %vx, %al
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %vy = load double, double* %py
+  %s = fadd double %vy, %m
+  store double %s, double* %py
+  br label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) a[i] = 0
+define void @fill(i32* noalias %a, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 0, i32* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) if (i & 1) a[i] = 0
+define void @fill_odd(i32* noalias %a, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %bit = and i64 %i, 1
+  %odd = icmp ne i64 %bit, 0
+  br i1 %odd, label %set, label %latch
+set:
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 0, i32* %p
+  br label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) if (s[i] > 0) d[i] = s[i]
+define void @copy_positive(i32* noalias %d, i32* noalias %s, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %ps = getelementptr inbounds i32, i32* %s, i64 %i
+  %v = load i32, i32* %ps
+  %pos = icmp sgt i32 %v, 0
+  br i1 %pos, label %copy, label %latch
+copy:
+  %pd = getelementptr inbounds i32, i32* %d, i64 %i
+  store i32 %v, i32* %pd
+  br label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,75 @@
+; A histogram update under an if keeps its condition in every strategy's
+; loop body; an unconditional rewrite would change the result.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK: "condition": "w[i] > 0.0"
+; CHECK: "strategy": "atomic"
+; CHECK: "candidate_type": "histogram"
+; CHECK: "function": "weighted_histogram"
+; CHECK: "suggested_patch": "{{.*}}    if (w[i] > 0.0) {\n        #pragma omp atomic update\n        h[idx[i]] += w[i];\n    }\n}
+; CHECK: "condition": "!(c[i] == 0)"
+; CHECK: "strategy": "privatized"
+; CHECK: "function": "sized_histogram"
+; CHECK: "suggested_patch": "{{.*}}for (long i = 0; i < n; ++i)\n        if (!(c[i] == 0)) mine[c[i]] += 1;\n
+
+; for (i < n) if (w[i] > 0) h[idx[i]] += w[i]   (h of unknown size)
+define void @weighted_histogram(double* noalias %h, i32* noalias %idx,
+                                double* noalias %w, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pw = getelementptr inbounds double, double* %w, i64 %i
+  %vw = load double, double* %pw
+  %pos = fcmp ogt double %vw, 0.0
+  br i1 %pos, label %update, label %latch
+update:
+  %pi = getelementptr inbounds i32, i32* %idx, i64 %i
+  %k = load i32, i32* %pi
+  %k64 = sext i32 %k to i64
+  %ph = getelementptr inbounds double, double* %h, i64 %k64
+  %old = load double, double* %ph
+  %new = fadd double %old, %vw
+  store double %new, double* %ph
+  br label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; h = malloc(m * sizeof(long)); for (i < n) if (c[i] != 0) h[c[i]] += 1
+define i64* @sized_histogram(i32* noalias %c, i64 %m, i64 %n) {
+entry:
+  %raw = call noalias i8* @calloc(i64 %m, i64 8)
+  %h = bitcast i8* %raw to i64*
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %pc = getelementptr inbounds i32, i32* %c, i64 %i
+  %k = load i32, i32* %pc
+  %nz = icmp eq i32 %k, 0
+  br i1 %nz, label %latch, label %update
+update:
+  %k64 = sext i32 %k to i64
+  %ph = getelementptr inbounds i64, i64* %h, i64 %k64
+  %old = load i64, i64* %ph
+  %new = add i64 %old, 1
+  store i64 %new, i64* %ph
+  br label %latch
+latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret i64* %h
+}
+
+declare noalias i8* @calloc(i64, i64)
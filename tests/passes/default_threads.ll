@@ -0,0 +1,38 @@
+; Schedules are predicted for a reference thread count, not for the cores
+; of the machine running opt: on a one-CPU host a triangle still gets its
+; balancing schedule.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK: "imbalance": "triangular",
+
+; for i<1000: for j<=i: B[i] += A[i*1000+j]
+define void @tri_rowsum(double* noalias %A, double* noalias %B) {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %row = mul nsw i64 %i, 1000
+  %pb = getelementptr inbounds double, double* %B, i64 %i
+  br label %inner
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %idx = add nsw i64 %row, %j
+  %pa = getelementptr inbounds double, double* %A, i64 %idx
+  %va = load double, double* %pa
+  %vb = load double, double* %pb
+  %s = fadd double %va, %vb
+  store double %s, double* %pb
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp sle i64 %j.next, %i
+  br i1 %jc, label %inner, label %outer.latch
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, 1000
+  br i1 %ic, label %outer, label %exit
+exit:
+  ret void
+}
+
@@ -0,0 +1,94 @@
+; parallel-deps records the addresses the watched loop touches; the
+; dependence_profile runtime reports the conflicts it saw as JSON at exit.
+; The first call shifts the array by one element (a carried RAW dependence),
+; the second updates it in place. bump_char and bump_short update char and
+; short arrays in place: neighbouring elements share a 4-byte word but no
+; byte, so they are independent.
+;
+; RUN: %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='function(loop-simplify),parallel-deps<loop=unknown:0:shift;loop=unknown:0:bump_char;loop=unknown:0:bump_short>' %s -o %t.bc
+; RUN: %llc -relocation-model=pic -filetype=obj %t.bc -o %t.o
+; RUN: %cxx %t.o %dependence_profile -pthread -o %t.exe
+; RUN: rm -f %t.json
+; RUN: PARALLEL_DEPS_OUTPUT=%t.json %t.exe
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK:      {"version": 1, "loops": [
+; CHECK-NEXT: {"id": "unknown:0:shift", "file": "unknown", "function": "shift", "line": 0, "executions": 2, "iterations": 2000, "accesses": 4000, "unobserved_calls": 0, "verdict": "dependent", "raw": 999, "war": 0, "waw": 0,
+; CHECK-NEXT: "conflicts": [{"kind": "RAW", "source_line": 0, "sink_line": 0, "count": 999}],
+; CHECK-NEXT: "summary": "conflicts in 1 of 2 executions, most often RAW line 0 -> line 0"},
+; CHECK-NEXT: {"id": "unknown:0:bump_char", "file": "unknown", "function": "bump_char", "line": 0, "executions": 1, "iterations": 64, "accesses": 128, "unobserved_calls": 0, "verdict": "independent", "raw": 0, "war": 0, "waw": 0, "shared_lines": 1, "max_iterations_per_line": 64,
+; CHECK-NEXT: "conflicts": [],
+; CHECK-NEXT: "summary": "no conflicts observed across 1 executions (64 iterations)"},
+; CHECK-NEXT: {"id": "unknown:0:bump_short", "file": "unknown", "function": "bump_short", "line": 0, "executions": 1, "iterations": 64, "accesses": 128, "unobserved_calls": 0, "verdict": "independent", "raw": 0, "war": 0, "waw": 0, "shared_lines": 2, "max_iterations_per_line": 32,
+; CHECK-NEXT: "conflicts": [],
+; CHECK-NEXT: "summary": "no conflicts observed across 1 executions (64 iterations)"}
+; CHECK-NEXT: ]}
+
+; a[i + 1] = a[i] + 1 when b aliases a + 1
+define void @shift(double* %a, double* %b, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %v = load double, double* %pa
+  %s = fadd double %v, 1.0
+  %pb = getelementptr inbounds double, double* %b, i64 %i
+  store double %s, double* %pb
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) c[i] += 1
+define void @bump_char(i8* %c, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i8, i8* %c, i64 %i
+  %v = load i8, i8* %p
+  %s = add i8 %v, 1
+  store i8 %s, i8* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i < n) h[i] += 1
+define void @bump_short(i16* %h, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i16, i16* %h, i64 %i
+  %v = load i16, i16* %p
+  %s = add i16 %v, 1
+  store i16 %s, i16* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %buf = alloca [1001 x double]
+  %p = getelementptr inbounds [1001 x double], [1001 x double]* %buf, i64 0, i64 0
+  %q = getelementptr inbounds [1001 x double], [1001 x double]* %buf, i64 0, i64 1
+  call void @shift(double* %p, double* %q, i64 1000)
+  call void @shift(double* %p, double* %p, i64 1000)
+  %chars = alloca [64 x i8], align 64
+  %c = getelementptr inbounds [64 x i8], [64 x i8]* %chars, i64 0, i64 0
+  call void @bump_char(i8* %c, i64 64)
+  %shorts = alloca [64 x i16], align 64
+  %h = getelementptr inbounds [64 x i16], [64 x i16]* %shorts, i64 0, i64 0
+  call void @bump_short(i16* %h, i64 64)
+  ret i32 0
+}
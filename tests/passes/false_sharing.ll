@@ -0,0 +1,111 @@
+; False sharing between the threads of a parallel for, with 8 threads and
+; 64-byte lines:
+;   sixtyfour     64 floats, 8 per thread: schedule(static, 16) is added;
+;   tiny          16 floats, fewer than two lines: pad instead of chunking;
+;   rowsum        sum[i] stored in the inner loop: accumulate in a local;
+;   prefix_means  a triangle whose schedule(static, 1) is rounded up to 16.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<threads=8>' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK-DAG: "suggested_patch": "// ✅ OpenMP 5.2 specification compliant\n#pragma omp parallel for schedule(static, 16)\n// Note: false sharing - each thread's block is under a 64-byte line of out; chunks of 16 iterations keep threads on separate lines\n
+; CHECK-DAG: "suggested_patch": "// ✅ OpenMP 5.2 specification compliant\n#pragma omp parallel for\n// Note: false sharing - pad each element of small to 64 bytes (struct alignas(64) { value; }) so threads never write the same line\n
+; CHECK-DAG: "suggested_patch": "// ✅ OpenMP 5.2 parallel for on the outermost loop (inner levels carry dependences)\n#pragma omp parallel for\n// Note: false sharing - sum is stored inside an inner loop at every chunk edge; accumulate in a local and store once, or use chunks that are multiples of 8 iterations\n
+; CHECK-DAG: "suggested_patch": "#pragma omp parallel for schedule(static, 16)\n// Note: chunk rounded up to 16 iterations so chunks of out do not share 64-byte lines\n
+; CHECK-DAG: "clause": "schedule(static, 16)",
+; CHECK-DAG: "risk": "moderate",
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; for (i < 64) out[i] = i
+define void @sixtyfour(float* noalias %out) {
+entry:
+  br label %l
+l:
+  %i = phi i64 [ 0, %entry ], [ %i1, %l ]
+  %f = sitofp i64 %i to float
+  %p = getelementptr inbounds float, float* %out, i64 %i
+  store float %f, float* %p
+  %i1 = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i1, 64
+  br i1 %c, label %l, label %x
+x:
+  ret void
+}
+
+; for (i < 16) small[i] = i
+@small = global [16 x float] zeroinitializer, align 64
+define void @tiny() {
+entry:
+  br label %l
+l:
+  %i = phi i64 [ 0, %entry ], [ %i1, %l ]
+  %f = sitofp i64 %i to float
+  %p = getelementptr inbounds [16 x float], [16 x float]* @small, i64 0, i64 %i
+  store float %f, float* %p
+  %i1 = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i1, 16
+  br i1 %c, label %l, label %x
+x:
+  ret void
+}
+
+; for (i < n) for (j < m) sum[i] += a[i * m + j]
+define void @rowsum(double* noalias %sum, double* noalias %a, i64 %n, i64 %m) {
+entry:
+  %c0 = icmp sgt i64 %n, 0
+  %cm = icmp sgt i64 %m, 0
+  %cc = and i1 %c0, %cm
+  br i1 %cc, label %outer, label %x
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i1, %latch ]
+  %ps = getelementptr inbounds double, double* %sum, i64 %i
+  %row = mul nsw i64 %i, %m
+  br label %inner
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j1, %inner ]
+  %k = add nsw i64 %row, %j
+  %pa = getelementptr inbounds double, double* %a, i64 %k
+  %v = load double, double* %pa
+  %s = load double, double* %ps
+  %s1 = fadd double %s, %v
+  store double %s1, double* %ps
+  %j1 = add nuw nsw i64 %j, 1
+  %cj = icmp slt i64 %j1, %m
+  br i1 %cj, label %inner, label %latch
+latch:
+  %i1 = add nuw nsw i64 %i, 1
+  %ci = icmp slt i64 %i1, %n
+  br i1 %ci, label %outer, label %x
+x:
+  ret void
+}
+
+; for (i < 64) { float s = 0; for (j <= i) s += a[j]; out[i] = s; }
+define void @prefix_means(float* noalias %out, float* noalias %a) {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i1, %latch ]
+  br label %inner
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j1, %inner ]
+  %s = phi float [ 0.0, %outer ], [ %s1, %inner ]
+  %pa = getelementptr inbounds float, float* %a, i64 %j
+  %v = load float, float* %pa
+  %s1 = fadd float %s, %v
+  %j1 = add nuw nsw i64 %j, 1
+  %cj = icmp ule i64 %j1, %i
+  br i1 %cj, label %inner, label %latch
+latch:
+  %sum = phi float [ %s1, %inner ]
+  %po = getelementptr inbounds float, float* %out, i64 %i
+  store float %sum, float* %po
+  %i1 = add nuw nsw i64 %i, 1
+  %ci = icmp slt i64 %i1, 64
+  br i1 %ci, label %outer, label %x
+x:
+  ret void
+}
@@ -0,0 +1,44 @@
+; A conditional append at a cursor is a filter candidate: the patch counts
+; the kept elements per thread, scans the counts and scatters each thread's
+; elements at its offset. It rewrites the loop, so it carries no pragma.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+; RUN: ! grep '"pragma"' %t.json
+
+; CHECK:      "filter": {
+; CHECK-NEXT:   "condition": "x[i] > 0",
+; CHECK-NEXT:   "cursor": "k",
+; CHECK-NEXT:   "outputs": [
+; CHECK-NEXT:     "out"
+; CHECK-NEXT:   ],
+; CHECK-NEXT:   "push_back": false
+; CHECK:      "candidate_type": "filter",
+; CHECK:      "reason": "Conditional append at cursor k - order-preserving parallel stream compaction",
+; CHECK-NEXT: "suggested_patch": "// ✅ Order-preserving stream compaction: count, exclusive scan, scatter\n// Note: the condition is evaluated twice per element and must not write shared state\n// Both loops are schedule(static) over the same range, so each thread\n// scatters exactly the elements it counted, in order\n#include <omp.h>\n#include <vector>\nauto keep = [&](long i) -> bool { return x[i] > 0; };\nconst long first = 0;\nstd::vector<long> offset;\n#pragma omp parallel\n{\n    const int nt = omp_get_num_threads(), tid = omp_get_thread_num();\n    #pragma omp single\n    offset.assign(nt + 1, 0);\n    long count = 0;\n    #pragma omp for schedule(static) nowait\n    for (long i = 0; i < std::max<long>(1, n); ++i)\n        count += keep(i);\n    offset[tid + 1] = count;\n    #pragma omp barrier\n    #pragma omp single\n    for (int t = 0; t < nt; ++t) offset[t + 1] += offset[t];\n    long pos = first + offset[tid];\n    #pragma omp for schedule(static)\n    for (long i = 0; i < std::max<long>(1, n); ++i)\n        if (keep(i)) {\n            out[pos] = x[i];\n            ++pos;\n        }\n}\nk = first + offset.back();\n// Or, with C++17 parallel algorithms (<algorithm>, <execution>):\n// auto pred = [&](const auto &v) { return v > 0; };\n// k = std::copy_if(std::execution::par_unseq, x, x + std::max<long>(1, n), out + first, pred) - out;\n// Or runtime/parallel_primitives.h: k = prt::parallel_compact(x, x + std::max<long>(1, n), out + first, pred) - out;"
+
+; long k = 0; for (long i = 0; i < n; ++i) if (x[i] > 0) out[k++] = x[i]; return k;
+define i64 @positives(i32* noalias %out, i32* noalias %x, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %latch ]
+  %k = phi i64 [ 0, %entry ], [ %k.next, %latch ]
+  %px = getelementptr inbounds i32, i32* %x, i64 %i
+  %v = load i32, i32* %px
+  %keep = icmp sgt i32 %v, 0
+  br i1 %keep, label %store, label %latch
+store:
+  %po = getelementptr inbounds i32, i32* %out, i64 %k
+  store i32 %v, i32* %po
+  %k.inc = add nsw i64 %k, 1
+  br label %latch
+latch:
+  %k.next = phi i64 [ %k.inc, %store ], [ %k, %loop ]
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i64 %k.next
+}
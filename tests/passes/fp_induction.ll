@@ -0,0 +1,50 @@
+; A floating-point induction is carried from one iteration to the next:
+; a bare "#pragma omp parallel for" would race on x. The loop is only
+; reported with the note to recompute x from the iteration number; the
+; integer-only twin is still a plain parallel for.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK: "candidate_type": "risky"
+; CHECK: "function": "fp_induction"
+; CHECK-NOT: #pragma omp
+; CHECK: "suggested_patch": "{{.*}}compute x = x0 + iteration * 0.25
+; CHECK: "candidate_type": "embarrassingly_parallel"
+; CHECK: "function": "int_only"
+
+; x = x0; for (i = 0; i < 1024; ++i) { x += 0.25; y[i] = x * x; }
+define void @fp_induction(double* noalias %y, double %x0) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %x = phi double [ %x0, %entry ], [ %x.next, %loop ]
+  %x.next = fadd fast double %x, 2.500000e-01
+  %sq = fmul double %x.next, %x.next
+  %p = getelementptr inbounds double, double* %y, i64 %i
+  store double %sq, double* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp ult i64 %i.next, 1024
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (i = 0; i < 1024; ++i) y[i] = y[i] * y[i]
+define void @int_only(double* noalias %y) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %y, i64 %i
+  %v = load double, double* %p
+  %sq = fmul double %v, %v
+  store double %sq, double* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp ult i64 %i.next, 1024
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,117 @@
+; Loops entered straight from an "n > 0" guard have no preheader until
+; loop-simplify runs. The pass must skip them instead of crashing in the
+; induction and reduction descriptors, and analyze them once simplified
+; (results are sorted by function).
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.raw.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes=parallel-candidate -disable-output %s
+; RUN: %FileCheck --check-prefix=RAW --input-file=%t.raw.json %s
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; RAW: []
+
+; CHECK: "call": "s += cblas_ddot(n, x, 1, y, 1);"
+; CHECK: "function": "guarded_dot"
+; CHECK: "candidate_type": "embarrassingly_parallel"
+; CHECK: "function": "guarded_scale"
+; CHECK: "candidate_type": "reduction"
+; CHECK: "function": "guarded_sum"
+
+; if (n > 0) for (i = 0; i < n; ++i) a[i] *= 2
+define void @guarded_scale(double* noalias %a, i64 %n) {
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %a, i64 %i
+  %v = load double, double* %p
+  %m = fmul double %v, 2.0
+  store double %m, double* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  ret void
+}
+
+; s = 0; if (n > 0) for (i = 0; i < n; ++i) s += a[i]
+define double @guarded_sum(double* noalias %a, i64 %n) {
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi double [ 0.0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds double, double* %a, i64 %i
+  %v = load double, double* %p
+  %s.next = fadd fast double %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  %r = phi double [ 0.0, %entry ], [ %s.next, %loop ]
+  ret double %r
+}
+
+; if (n > 0) for (i < n) for (k = rp[i]; k < rp[i+1]; ++k) y[i] += v[k] * x[c[k]]
+define void @guarded_csr(i64* noalias %rp, i64* noalias %c, double* noalias %v,
+                         double* noalias %x, double* noalias %y, i64 %n) {
+entry:
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %row, label %exit
+row:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %row.end ]
+  %prp = getelementptr inbounds i64, i64* %rp, i64 %i
+  %lo = load i64, i64* %prp
+  %i.next = add nuw nsw i64 %i, 1
+  %prp1 = getelementptr inbounds i64, i64* %rp, i64 %i.next
+  %hi = load i64, i64* %prp1
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %ne = icmp slt i64 %lo, %hi
+  br i1 %ne, label %elem, label %row.end
+elem:
+  %k = phi i64 [ %lo, %row ], [ %k.next, %elem ]
+  %pc = getelementptr inbounds i64, i64* %c, i64 %k
+  %col = load i64, i64* %pc
+  %px = getelementptr inbounds double, double* %x, i64 %col
+  %vx = load double, double* %px
+  %pv = getelementptr inbounds double, double* %v, i64 %k
+  %vv = load double, double* %pv
+  %prod = fmul double %vv, %vx
+  %vy = load double, double* %py
+  %sum = fadd double %vy, %prod
+  store double %sum, double* %py
+  %k.next = add nsw i64 %k, 1
+  %more = icmp slt i64 %k.next, %hi
+  br i1 %more, label %elem, label %row.end
+row.end:
+  %rows = icmp slt i64 %i.next, %n
+  br i1 %rows, label %row, label %exit
+exit:
+  ret void
+}
+
+; s = 0; if (n > 0) for (i = 0; i < n; ++i) s += x[i] * y[i]
+define double @guarded_dot(double* noalias %x, double* noalias %y, i64 %n) {
+entry:
+  %c = icmp sgt i64 %n, 0
+  br i1 %c, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi double [ 0.0, %entry ], [ %s.next, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %vx = load double, double* %px
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %vy = load double, double* %py
+  %p = fmul double %vx, %vy
+  %s.next = fadd double %s, %p
+  %i.next = add nuw nsw i64 %i, 1
+  %e = icmp slt i64 %i.next, %n
+  br i1 %e, label %loop, label %exit
+exit:
+  %r = phi double [ 0.0, %entry ], [ %s.next, %loop ]
+  ret double %r
+}
@@ -0,0 +1,76 @@
+; A privatized histogram that adds one per iteration to the bin of one
+; input element is a prt::parallel_histogram call over the loop's range.
+; Weighted updates keep the per-thread copies merged in a tree.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK:     "scatter_update": {
+; CHECK-NOT:   "input"
+; CHECK:       "strategy": "privatized",
+; CHECK:     "function": "weighted",
+; CHECK:     "suggested_patch": "// ✅ Per-thread copies of h merged in a pairwise tree
+; CHECK-NOT: parallel_histogram
+; CHECK:     "scatter_update": {
+; CHECK-DAG:   "bin": "x >> s",
+; CHECK-DAG:   "input": "key",
+; CHECK-DAG:   "strategy": "privatized",
+; CHECK:     "function": "count_keys",
+; CHECK:     "reason": "{{.*}} - per-block counts merged per bin by prt::parallel_histogram",
+; CHECK:     "suggested_patch": "// ✅ Privatized histogram: per-block counts of h merged per bin - runtime/parallel_primitives.h\n#include \"parallel_primitives.h\"\nprt::parallel_histogram(key + 1, key + n, h, m,\n                        [&](const auto &x) { return x >> s; });\n// Note: bins outside [0, m) are skipped instead of written out of bounds"
+
+declare noalias i8* @malloc(i64)
+
+; long *h = malloc(m * sizeof(long));
+; for (long i = 1; i < n; ++i) ++h[key[i] >> s];
+define i64* @count_keys(i32* noalias %key, i64 %n, i64 %m, i32 %s) {
+entry:
+  %bytes = shl i64 %m, 3
+  %raw = call noalias i8* @malloc(i64 %bytes)
+  %h = bitcast i8* %raw to i64*
+  %g = icmp sgt i64 %n, 1
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %loop ]
+  %pk = getelementptr inbounds i32, i32* %key, i64 %i
+  %k = load i32, i32* %pk
+  %b = lshr i32 %k, %s
+  %b64 = zext i32 %b to i64
+  %ph = getelementptr inbounds i64, i64* %h, i64 %b64
+  %old = load i64, i64* %ph
+  %new = add i64 %old, 1
+  store i64 %new, i64* %ph
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i64* %h
+}
+
+; long *h = malloc(m * sizeof(long));
+; for (long i = 0; i < n; ++i) h[idx[i]] += w[i];
+define i64* @weighted(i32* noalias %idx, i64* noalias %w, i64 %n, i64 %m) {
+entry:
+  %bytes = shl i64 %m, 3
+  %raw = call noalias i8* @malloc(i64 %bytes)
+  %h = bitcast i8* %raw to i64*
+  %g = icmp sgt i64 %n, 0
+  br i1 %g, label %loop, label %exit
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pi = getelementptr inbounds i32, i32* %idx, i64 %i
+  %k = load i32, i32* %pi
+  %k64 = zext i32 %k to i64
+  %pw = getelementptr inbounds i64, i64* %w, i64 %i
+  %vw = load i64, i64* %pw
+  %ph = getelementptr inbounds i64, i64* %h, i64 %k64
+  %old = load i64, i64* %ph
+  %new = add i64 %old, %vw
+  store i64 %new, i64* %ph
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i64* %h
+}
@@ -0,0 +1,115 @@
+; parallel-annotate records the dependence proof of a loop in its metadata:
+; an access group on every access, llvm.loop.parallel_accesses and the
+; vectorizer hints. A loop with a carried dependence keeps no metadata.
+; The remark names only the hints attached: none when the trip count is
+; below one vector, and not those the loop already carries.
+;
+; RUN: %opt -load-pass-plugin=%plugin -passes='parallel-annotate,verify' \
+; RUN:   -pass-remarks=parallel-annotate -S %s -o %t.ll 2> %t.err
+; RUN: %FileCheck --input-file=%t.ll %s
+; RUN: %FileCheck --check-prefix=REMARK --input-file=%t.err %s
+
+; REMARK:     remark: {{.*}}loop proven free of carried dependences (vectorize.width=2, interleave.count=2)
+; REMARK:     remark: {{.*}}loop proven free of carried dependences{{$}}
+; REMARK:     remark: {{.*}}loop proven free of carried dependences (interleave.count=2){{$}}
+; REMARK-NOT: remark
+
+; CHECK-LABEL: define void @scale(
+; CHECK:       load double, double* %pb, align 8, !llvm.access.group ![[GROUP:[0-9]+]]
+; CHECK:       store double %m, double* %pa, align 8, !llvm.access.group ![[GROUP]]
+; CHECK:       br i1 %c, label %loop, label %exit, !llvm.loop ![[LOOP:[0-9]+]]
+; CHECK-LABEL: define void @single(
+; CHECK:       br i1 %c, label %loop, label %exit, !llvm.loop ![[SLOOP:[0-9]+]]
+; CHECK-LABEL: define void @hinted(
+; CHECK:       br i1 %c, label %loop, label %exit, !llvm.loop ![[HLOOP:[0-9]+]]
+; CHECK-LABEL: define void @carried(
+; CHECK-NOT:   !llvm.access.group
+; CHECK-NOT:   !llvm.loop
+; CHECK:       ![[GROUP]] = distinct !{}
+; CHECK:       ![[LOOP]] = distinct !{![[LOOP]], ![[PAR:[0-9]+]], ![[ENABLE:[0-9]+]], ![[WIDTH:[0-9]+]], ![[IC:[0-9]+]]}
+; CHECK:       ![[PAR]] = !{!"llvm.loop.parallel_accesses", ![[GROUP]]}
+; CHECK:       ![[ENABLE]] = !{!"llvm.loop.vectorize.enable", i1 true}
+; CHECK:       ![[WIDTH]] = !{!"llvm.loop.vectorize.width", i32 2}
+; CHECK:       ![[IC]] = !{!"llvm.loop.interleave.count", i32 2}
+; CHECK:       ![[SLOOP]] = distinct !{![[SLOOP]], ![[SPAR:[0-9]+]], ![[ENABLE]]}
+; CHECK:       ![[HLOOP]] = distinct !{![[HLOOP]], ![[USERW:[0-9]+]], ![[HPAR:[0-9]+]], ![[ENABLE]], ![[IC]]}
+; CHECK:       ![[USERW]] = !{!"llvm.loop.vectorize.width", i32 4}
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; for (long i = 0; i < n; ++i) a[i] = 2 * b[i]
+define void @scale(double* noalias %a, double* noalias %b, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds double, double* %b, i64 %i
+  %vb = load double, double* %pb
+  %m = fmul double %vb, 2.0
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double %m, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (long i = 0; i < 1; ++i) a[i] = 2 * b[i]   (trip count below one vector)
+define void @single(double* noalias %a, double* noalias %b) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds double, double* %b, i64 %i
+  %vb = load double, double* %pb
+  %m = fmul double %vb, 2.0
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double %m, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, 1
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; #pragma clang loop vectorize_width(4)
+; for (long i = 0; i < n; ++i) a[i] = 2 * b[i]
+define void @hinted(double* noalias %a, double* noalias %b, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds double, double* %b, i64 %i
+  %vb = load double, double* %pb
+  %m = fmul double %vb, 2.0
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double %m, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit, !llvm.loop !0
+exit:
+  ret void
+}
+
+; for (long i = 0; i < n; ++i) a[i + 1] = a[i] + 1   (carried)
+define void @carried(double* noalias %a, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %va = load double, double* %pa
+  %s = fadd double %va, 1.0
+  %i.next = add nuw nsw i64 %i, 1
+  %pn = getelementptr inbounds double, double* %a, i64 %i.next
+  store double %s, double* %pn
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+!0 = distinct !{!0, !1}
+!1 = !{!"llvm.loop.vectorize.width", i32 4}
@@ -0,0 +1,55 @@
+; parallel-profile instruments each loop; the loop_profile runtime writes
+; the entries, iterations and time of every loop as JSON at exit. With
+; counters, each loop also reports its hardware counts, or null when
+; perf_event_open is unavailable, with the reason in "hardware_counters".
+;
+; RUN: %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='function(loop-simplify),parallel-profile' %s -o %t.bc
+; RUN: %llc -relocation-model=pic -filetype=obj %t.bc -o %t.o
+; RUN: %cxx %t.o %loop_profile -o %t.exe
+; RUN: rm -f %t.json
+; RUN: PARALLEL_PROFILE_OUTPUT=%t.json %t.exe
+; RUN: %FileCheck --input-file=%t.json %s
+; RUN: %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='function(loop-simplify),parallel-profile<counters>' %s -o %t.hw.bc
+; RUN: %llc -relocation-model=pic -filetype=obj %t.hw.bc -o %t.hw.o
+; RUN: %cxx %t.hw.o %loop_profile -o %t.hw.exe
+; RUN: rm -f %t.hw.json
+; RUN: PARALLEL_PROFILE_OUTPUT=%t.hw.json %t.hw.exe
+; RUN: %FileCheck --check-prefix=HW --input-file=%t.hw.json %s
+
+; CHECK:      {"version": 1, "clock": "{{[a-z_]+}}", "ticks_per_second": {{.*}}, "wall_seconds": {{.*}},
+; CHECK-NEXT: "loops": [
+; CHECK-NEXT: {"id": "unknown:0:scale", "file": "unknown", "function": "scale", "line": 0, "parent": null, "entries": 2, "iterations": 2000, "ticks": {{[0-9]+}}, "seconds": {{.*}}}
+; CHECK-NEXT: ]}
+
+; HW:      {"version": 1,
+; HW-NEXT: "hardware_counters": {"available": {{(true, "events": \[.+\]|false, "error": ".+")}}},
+; HW-NEXT: "loops": [
+; HW-NEXT: {"id": "unknown:0:scale", {{.*}} "entries": 2, "iterations": 2000, {{.*}}, "hardware": {{(null|\{"cycles": .+, "multiplexed": (true|false)\})}}}
+; HW-NEXT: ]}
+
+define void @scale(double* noalias %a, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %v = load double, double* %pa
+  %m = fmul double %v, 2.0
+  store double %m, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %buf = alloca [1000 x double]
+  %p = getelementptr inbounds [1000 x double], [1000 x double]* %buf, i64 0, i64 0
+  call void @scale(double* %p, i64 1000)
+  call void @scale(double* %p, i64 1000)
+  ret i32 0
+}
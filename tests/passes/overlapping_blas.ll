@@ -0,0 +1,158 @@
+; gemm and gemv write C and y while reading A, B and x. BLAS forbids
+; overlapping arguments, so operands that may alias the output are not
+; library calls: y = A * y in place would read elements already written.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: grep -E '"(candidate_type|function)"' %t.json | paste - - | sort \
+; RUN:   | %FileCheck %s
+; RUN: %FileCheck --check-prefix=CALL --input-file=%t.json %s
+
+; CHECK:      "candidate_type": "library_call", "function": "gemv",
+; CHECK-NEXT: "candidate_type": "matrix_multiply", "function": "gemm_may_alias",
+; CHECK-NEXT: "candidate_type": "reduction", "function": "gemm_may_alias",
+; CHECK-NEXT: "candidate_type": "reduction", "function": "gemv_in_place",
+; CHECK-NEXT: "candidate_type": "reduction", "function": "gemv_may_alias",
+; CHECK-NOT:  "candidate_type"
+
+; CALL:     "call": "cblas_sgemv(CblasRowMajor, CblasNoTrans, std::max<long>(1, M), std::max<long>(1, N), 1.0f, A, N, x, 1, 0.0f, y, 1);"
+; CALL-NOT: "call"
+
+; y[i] = sum_j A[i][j] * x[j], operands declared disjoint
+define void @gemv(float* noalias %A, float* noalias %x, float* noalias %y, i64 %M, i64 %N) {
+entry:
+  br label %li
+li:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %li.latch ]
+  %iN = mul nsw i64 %i, %N
+  br label %lj
+lj:
+  %j = phi i64 [ 0, %li ], [ %j.next, %lj ]
+  %sum = phi float [ 0.0, %li ], [ %s, %lj ]
+  %aij = add nsw i64 %iN, %j
+  %pa = getelementptr inbounds float, float* %A, i64 %aij
+  %va = load float, float* %pa
+  %px = getelementptr inbounds float, float* %x, i64 %j
+  %vx = load float, float* %px
+  %m = fmul float %va, %vx
+  %s = fadd float %sum, %m
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %N
+  br i1 %jc, label %lj, label %li.latch
+li.latch:
+  %s.lcssa = phi float [ %s, %lj ]
+  %py = getelementptr inbounds float, float* %y, i64 %i
+  store float %s.lcssa, float* %py
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %M
+  br i1 %ic, label %li, label %exit
+exit:
+  ret void
+}
+
+; the same loop over pointers that may alias
+define void @gemv_may_alias(float* %A, float* %x, float* %y, i64 %M, i64 %N) {
+entry:
+  br label %li
+li:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %li.latch ]
+  %iN = mul nsw i64 %i, %N
+  br label %lj
+lj:
+  %j = phi i64 [ 0, %li ], [ %j.next, %lj ]
+  %sum = phi float [ 0.0, %li ], [ %s, %lj ]
+  %aij = add nsw i64 %iN, %j
+  %pa = getelementptr inbounds float, float* %A, i64 %aij
+  %va = load float, float* %pa
+  %px = getelementptr inbounds float, float* %x, i64 %j
+  %vx = load float, float* %px
+  %m = fmul float %va, %vx
+  %s = fadd float %sum, %m
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %N
+  br i1 %jc, label %lj, label %li.latch
+li.latch:
+  %s.lcssa = phi float [ %s, %lj ]
+  %py = getelementptr inbounds float, float* %y, i64 %i
+  store float %s.lcssa, float* %py
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %M
+  br i1 %ic, label %li, label %exit
+exit:
+  ret void
+}
+
+; y[i] = sum_j A[i][j] * y[j]
+define void @gemv_in_place(float* noalias %A, float* noalias %y, i64 %M, i64 %N) {
+entry:
+  br label %li
+li:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %li.latch ]
+  %iN = mul nsw i64 %i, %N
+  br label %lj
+lj:
+  %j = phi i64 [ 0, %li ], [ %j.next, %lj ]
+  %sum = phi float [ 0.0, %li ], [ %s, %lj ]
+  %aij = add nsw i64 %iN, %j
+  %pa = getelementptr inbounds float, float* %A, i64 %aij
+  %va = load float, float* %pa
+  %px = getelementptr inbounds float, float* %y, i64 %j
+  %vx = load float, float* %px
+  %m = fmul float %va, %vx
+  %s = fadd float %sum, %m
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %N
+  br i1 %jc, label %lj, label %li.latch
+li.latch:
+  %s.lcssa = phi float [ %s, %lj ]
+  %py = getelementptr inbounds float, float* %y, i64 %i
+  store float %s.lcssa, float* %py
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %M
+  br i1 %ic, label %li, label %exit
+exit:
+  ret void
+}
+
+; C[i][j] = sum_k A[i][k] * B[j][k] over pointers that may alias
+define void @gemm_may_alias(double* %A, double* %B, double* %C, i64 %M, i64 %N, i64 %K) {
+entry:
+  br label %li
+li:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %li.latch ]
+  %iK = mul nsw i64 %i, %K
+  %iN = mul nsw i64 %i, %N
+  br label %lj
+lj:
+  %j = phi i64 [ 0, %li ], [ %j.next, %lj.latch ]
+  %jK = mul nsw i64 %j, %K
+  br label %lk
+lk:
+  %k = phi i64 [ 0, %lj ], [ %k.next, %lk ]
+  %sum = phi double [ 0.0, %lj ], [ %s, %lk ]
+  %aik = add nsw i64 %iK, %k
+  %pa = getelementptr inbounds double, double* %A, i64 %aik
+  %va = load double, double* %pa
+  %bjk = add nsw i64 %jK, %k
+  %pb = getelementptr inbounds double, double* %B, i64 %bjk
+  %vb = load double, double* %pb
+  %m = fmul double %va, %vb
+  %s = fadd double %sum, %m
+  %k.next = add nuw nsw i64 %k, 1
+  %kc = icmp slt i64 %k.next, %K
+  br i1 %kc, label %lk, label %lj.latch
+lj.latch:
+  %s.lcssa = phi double [ %s, %lk ]
+  %cij = add nsw i64 %iN, %j
+  %pc = getelementptr inbounds double, double* %C, i64 %cij
+  store double %s.lcssa, double* %pc
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %N
+  br i1 %jc, label %lj, label %li.latch
+li.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %M
+  br i1 %ic, label %li, label %exit
+exit:
+  ret void
+}
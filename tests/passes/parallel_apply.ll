@@ -0,0 +1,94 @@
+; parallel-apply outlines loops it proves independent into OpenMP runtime
+; calls and leaves every other loop untouched. The rewritten module must
+; pass the verifier.
+;
+; RUN: %opt -load-pass-plugin=%plugin -passes='parallel-apply,verify' \
+; RUN:   -S %s -o %t.ll 2> %t.err
+; RUN: %FileCheck --input-file=%t.ll %s
+; RUN: %FileCheck --check-prefix=LOG --input-file=%t.err %s
+
+; LOG:     parallel-apply: parallelized loop in scale
+; LOG-NOT: parallelized
+
+; CHECK-LABEL: define void @scale(
+; CHECK:       call void {{.*}} @__kmpc_fork_call({{.*}} @scale.omp_outlined
+; CHECK-LABEL: define void @carried(
+; CHECK-NOT:   __kmpc_fork_call
+; CHECK-LABEL: define void @fp_induction(
+; CHECK-NOT:   __kmpc_fork_call
+; CHECK-LABEL: define void @no_preheader(
+; CHECK-NOT:   __kmpc_fork_call
+; CHECK:       define internal void @scale.omp_par(
+; CHECK:       call void @__kmpc_for_static_init_8u(
+; CHECK:       call void @__kmpc_for_static_fini(
+
+; for (long i = 0; i < n; ++i) a[i] = 2 * b[i]
+define void @scale(double* noalias %a, double* noalias %b, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pb = getelementptr inbounds double, double* %b, i64 %i
+  %vb = load double, double* %pb
+  %m = fmul double %vb, 2.0
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double %m, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (long i = 0; i < n; ++i) a[i + 1] = a[i] + 1   (carried)
+define void @carried(double* noalias %a, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %va = load double, double* %pa
+  %s = fadd double %va, 1.0
+  %i.next = add nuw nsw i64 %i, 1
+  %pn = getelementptr inbounds double, double* %a, i64 %i.next
+  store double %s, double* %pn
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; double x = 0; for (long i = 0; i < n; ++i, x += 0.5) a[i] = x
+define void @fp_induction(double* noalias %a, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %x = phi double [ 0.0, %entry ], [ %x.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double %x, double* %pa
+  %x.next = fadd double %x, 5.000000e-01
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; The loop is entered from two blocks, so it has no preheader
+define void @no_preheader(double* noalias %a, i64 %n, i1 %f) {
+entry:
+  br i1 %f, label %loop, label %other
+other:
+  store double 1.0, double* %a
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ 1, %other ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  store double 0.0, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,125 @@
+; Three consecutive loops, each consuming the array the previous one wrote,
+; form a pipeline. The last carries a running sum, so the chain runs as
+; blocked tasks: every stage waits for the blocks it reads and the
+; sequential stage also for its own previous block.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<threads=8>' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK:      "pipeline": {
+; CHECK-NEXT:   "block": 16384,
+; CHECK-NEXT:   "bottleneck": 2,
+; CHECK-NEXT:   "speedup_bound": 3.25,
+; CHECK-NEXT:   "stages": [
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "cost": 10,
+; CHECK-NEXT:       "index": "i",
+; CHECK-NEXT:       "line": 3,
+; CHECK-NEXT:       "reads": [],
+; CHECK-NEXT:       "sequential": false,
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "d"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     },
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "cost": 8,
+; CHECK-NEXT:       "index": "j",
+; CHECK-NEXT:       "line": 4,
+; CHECK-NEXT:       "reads": [
+; CHECK-NEXT:         {
+; CHECK-NEXT:           "array": "d",
+; CHECK-NEXT:           "max_offset": 0,
+; CHECK-NEXT:           "min_offset": 0,
+; CHECK-NEXT:           "stage": 0
+; CHECK-NEXT:         }
+; CHECK-NEXT:       ],
+; CHECK-NEXT:       "sequential": false,
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "s"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     },
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "carries": "acc",
+; CHECK-NEXT:       "cost": 8,
+; CHECK-NEXT:       "index": "k",
+; CHECK-NEXT:       "line": 5,
+; CHECK-NEXT:       "reads": [
+; CHECK-NEXT:         {
+; CHECK-NEXT:           "array": "s",
+; CHECK-NEXT:           "max_offset": 0,
+; CHECK-NEXT:           "min_offset": 0,
+; CHECK-NEXT:           "stage": 1
+; CHECK-NEXT:         }
+; CHECK-NEXT:       ],
+; CHECK-NEXT:       "sequential": true,
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "y"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     }
+; CHECK-NEXT:   ],
+; CHECK-NEXT:   "strategy": "pipeline",
+; CHECK-NEXT:   "window": 8
+; CHECK:      "candidate_type": "pipeline",
+; CHECK:      "line": 3,
+; CHECK-NEXT: "reason": "3 consecutive loops form a producer/consumer chain; the loop at line 5 carries acc: {{.*}}",
+; CHECK-NEXT: "suggested_patch": "{{.*}}depend(out: d0[b]) depend(in: d1[b - W])\n{{.*}}depend(out: d1[b]) depend(in: d0[b], d2[b - W])\n{{.*}}depend(out: d2[b]) depend(in: d1[b], d2[b - 1])\n
+
+; 3: for (i < n) d[i] = x[i + 1] - x[i];
+; 4: for (i < n) s[i] = d[i] * d[i];
+; 5: for (i < n) { acc += s[i]; y[i] = acc; }
+define void @energy(double* noalias %x, double* noalias %d, double* noalias %s, double* noalias %y, i64 %n) !dbg !4 {
+entry:
+  br label %diff
+diff:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %diff ]
+  %i.next = add nuw nsw i64 %i, 1, !dbg !6
+  %px1 = getelementptr inbounds double, double* %x, i64 %i.next
+  %px0 = getelementptr inbounds double, double* %x, i64 %i
+  %x1 = load double, double* %px1
+  %x0 = load double, double* %px0
+  %dv = fsub double %x1, %x0
+  %pd = getelementptr inbounds double, double* %d, i64 %i
+  store double %dv, double* %pd
+  %ic = icmp slt i64 %i.next, %n
+  br i1 %ic, label %diff, label %square.ph
+square.ph:
+  br label %square
+square:
+  %j = phi i64 [ 0, %square.ph ], [ %j.next, %square ]
+  %qd = getelementptr inbounds double, double* %d, i64 %j, !dbg !7
+  %dj = load double, double* %qd
+  %sq = fmul double %dj, %dj
+  %ps = getelementptr inbounds double, double* %s, i64 %j
+  store double %sq, double* %ps
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %n
+  br i1 %jc, label %square, label %sum.ph
+sum.ph:
+  br label %sum
+sum:
+  %k = phi i64 [ 0, %sum.ph ], [ %k.next, %sum ]
+  %acc = phi double [ 0.0, %sum.ph ], [ %acc.next, %sum ]
+  %qs = getelementptr inbounds double, double* %s, i64 %k, !dbg !8
+  %sk = load double, double* %qs
+  %acc.next = fadd double %acc, %sk
+  %py = getelementptr inbounds double, double* %y, i64 %k
+  store double %acc.next, double* %py
+  %k.next = add nuw nsw i64 %k, 1
+  %kc = icmp slt i64 %k.next, %n
+  br i1 %kc, label %sum, label %exit
+exit:
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C_plus_plus_14, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "energy.cpp", directory: "/src")
+!2 = !{i32 2, !"Debug Info Version", i32 3}
+!3 = !DISubroutineType(types: !{})
+!4 = distinct !DISubprogram(name: "energy", scope: !1, file: !1, line: 1, type: !3, unit: !0, spFlags: DISPFlagDefinition)
+!6 = !DILocation(line: 3, column: 5, scope: !4)
+!7 = !DILocation(line: 4, column: 5, scope: !4)
+!8 = !DILocation(line: 5, column: 5, scope: !4)
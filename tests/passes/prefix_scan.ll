@@ -0,0 +1,73 @@
+; Scan patches spell out the loop: bounds, input and the runtime call come
+; from the IR. A scan whose input has no source name is advisory only.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+; RUN: ! grep -e '/\* input' -e '/\* first' -e 'existing loop header' %t.json
+
+; CHECK-DAG: "suggested_patch": "// ✅ OpenMP 5.0 inclusive scan (+) - array[i] = array[i - 1] + array[i], carried in a scalar\nint array_scan = array[0];\n#pragma omp parallel for reduction(inscan, +:array_scan)\nfor (long i = 1; i < std::max<long>(2, n); ++i) {\n    array_scan += array[i];\n    #pragma omp scan inclusive(array_scan)\n    array[i] = array_scan;\n}\n// Without OpenMP 5.0 scan support: #include \"parallel_primitives.h\" (runtime/)\n// array_scan = prt::parallel_scan(array + 1, array + std::max<long>(2, n), array + 1, array_scan, std::plus<>{}, prt::ScanKind::Inclusive);"
+; CHECK-DAG: "suggested_patch": "// ✅ OpenMP 5.0 exclusive scan (max) - running value m stored every iteration\n#pragma omp parallel for reduction(inscan, max:m)\nfor (long i = 0; i < std::max<long>(1, n); ++i) {\n    out[i] = m;\n    #pragma omp scan exclusive(m)\n    m = std::max(m, x[i]);\n}\n// Without OpenMP 5.0 scan support: #include \"parallel_primitives.h\" (runtime/)\n// m = prt::parallel_scan(x, x + std::max<long>(1, n), out, m, [](int a, int b) { return std::max(a, b); }, prt::ScanKind::Exclusive);"
+; CHECK-DAG: "scan_patch": "Advisory only - the scan input or loop bounds are not expressible in source"
+; CHECK-DAG: "suggested_patch": "// ⚠️ inclusive scan (+) of s into out - its input or loop bounds are not expressible in source\n// Rewrite the loop by hand as an OpenMP 5.0 scan with reduction(inscan, +:s) or with\n// prt::parallel_scan(first, last, out, s, std::plus<>{}, prt::ScanKind::Inclusive) (runtime/parallel_primitives.h)"
+
+; for (i=1;i<n;i++) array[i] += array[i-1];   after GVN load-PRE
+define void @psum(i32* noalias %array, i64 %n) {
+entry:
+  %a0 = load i32, i32* %array
+  br label %loop
+loop:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %loop ]
+  %prev = phi i32 [ %a0, %entry ], [ %s, %loop ]
+  %p = getelementptr inbounds i32, i32* %array, i64 %i
+  %v = load i32, i32* %p
+  %s = add nsw i32 %v, %prev
+  store i32 %s, i32* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; exclusive running max: out[i] = m; m = max(m, x[i])
+define void @exmax(i32* noalias %out, i32* noalias %x, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %m = phi i32 [ -2147483648, %entry ], [ %m.next, %loop ]
+  %po = getelementptr inbounds i32, i32* %out, i64 %i
+  store i32 %m, i32* %po
+  %px = getelementptr inbounds i32, i32* %x, i64 %i
+  %xv = load i32, i32* %px
+  %m.next = call i32 @llvm.smax.i32(i32 %m, i32 %xv)
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; running sum over a buffer that has no name in the source
+define void @unnamed_input(i32* noalias %out, i64 %n) {
+entry:
+  %0 = call i32* @get_input()
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %px = getelementptr inbounds i32, i32* %0, i64 %i
+  %xv = load i32, i32* %px
+  %s.next = add nsw i32 %s, %xv
+  %po = getelementptr inbounds i32, i32* %out, i64 %i
+  store i32 %s.next, i32* %po
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+declare i32* @get_input()
+declare i32 @llvm.smax.i32(i32, i32)
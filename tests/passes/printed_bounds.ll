@@ -0,0 +1,85 @@
+; Trip counts of loops without a guard print as std::max. The literal and
+; the bound must not deduce different types, so the call names the type.
+; Truncations and pointer differences have no spelling: fill_trunc and
+; fill_range stay parallel loops instead of memset calls of a wrong size.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+; RUN: grep -E '"(candidate_type|function)"' %t.json | paste - - | sort \
+; RUN:   | %FileCheck --check-prefix=TYPES %s
+
+; CHECK-DAG: "call": "cblas_daxpy(std::max<long>(1, n), al, x, 1, y, 1);"
+; CHECK-DAG: "call": "memset(a, 0, std::max<int>(1, n) * sizeof(int));"
+
+; TYPES:      "candidate_type": "embarrassingly_parallel", "function": "fill_range",
+; TYPES-NEXT: "candidate_type": "embarrassingly_parallel", "function": "fill_trunc",
+; TYPES-NEXT: "candidate_type": "library_call", "function": "axpy",
+; TYPES-NEXT: "candidate_type": "library_call", "function": "fill",
+; TYPES-NOT:  "candidate_type"
+
+; for (long i = 0; i < n; ++i) y[i] += al * x[i]   (do-while shape)
+define void @axpy(double* noalias %y, double* noalias %x, double %al, i64 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %vx = load double, double* %px
+  %m = fmul double %vx, %al
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %vy = load double, double* %py
+  %s = fadd double %vy, %m
+  store double %s, double* %py
+  %i.next = add nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (int i = 0; i < n; ++i) a[i] = 0   (do-while shape)
+define void @fill(i32* noalias %a, i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds i32, i32* %a, i32 %i
+  store i32 0, i32* %pa
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (int i = 0; i < (int)n; ++i) a[i] = 0   (do-while shape, long n)
+define void @fill_trunc(i32* noalias %a, i64 %n) {
+entry:
+  %m = trunc i64 %n to i32
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr inbounds i32, i32* %a, i32 %i
+  store i32 0, i32* %pa
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %m
+  br i1 %c, label %loop, label %exit
+exit:
+  ret void
+}
+
+; for (int *p = a; p != e; ++p) *p = 0
+define void @fill_range(i32* %a, i32* %e) {
+entry:
+  %g = icmp eq i32* %a, %e
+  br i1 %g, label %exit, label %loop
+loop:
+  %p = phi i32* [ %a, %entry ], [ %p.next, %loop ]
+  store i32 0, i32* %p
+  %p.next = getelementptr inbounds i32, i32* %p, i64 1
+  %c = icmp eq i32* %p.next, %e
+  br i1 %c, label %exit, label %loop
+exit:
+  ret void
+}
@@ -0,0 +1,67 @@
+; With !prof data, hotness counts the profiled run. Per call, @hot runs its
+; 8-instruction loop 100 times (800 of 802 instructions) and @cold 9.875
+; times (79 of 81). Entry counts of 10 and 1 make the run 8020 + 81
+; instructions, of which the loops are 8000 and 79: program_share is each
+; loop's weight over that total, and the hotter loop comes first.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK:      "hotness": {
+; CHECK-NEXT:   "function_share": 0.9975{{[0-9]*}},
+; CHECK-NEXT:   "header_count": 1000,
+; CHECK-NEXT:   "iterations_per_call": 100,
+; CHECK-NEXT:   "program_share": 0.9875{{[0-9]*}},
+; CHECK-NEXT:   "score": 0.9875{{[0-9]*}},
+; CHECK-NEXT:   "source": "profile"
+; CHECK:      "function": "hot",
+; CHECK:      "hotness": {
+; CHECK-NEXT:   "function_share": 0.9753{{[0-9]*}},
+; CHECK-NEXT:   "header_count": 10,
+; CHECK-NEXT:   "iterations_per_call": 9.875,
+; CHECK-NEXT:   "program_share": 0.00975{{[0-9]*}},
+; CHECK-NEXT:   "score": 0.00975{{[0-9]*}},
+; CHECK-NEXT:   "source": "profile"
+; CHECK:      "function": "cold",
+
+; Called 10 times, about 100 iterations per call
+; for (long i = 0; i < n; ++i) a[i] = 2 * a[i]
+define void @hot(double* noalias %a, i64 %n) !prof !0 {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %a, i64 %i
+  %v = load double, double* %p
+  %m = fmul double %v, 2.0
+  store double %m, double* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit, !prof !1
+exit:
+  ret void
+}
+
+; Called once, about 10 iterations per call
+; for (long i = 0; i < n; ++i) b[i] = b[i] + 1
+define void @cold(double* noalias %b, i64 %n) !prof !2 {
+entry:
+  br label %loop
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %b, i64 %i
+  %v = load double, double* %p
+  %s = fadd double %v, 1.0
+  store double %s, double* %p
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp slt i64 %i.next, %n
+  br i1 %c, label %loop, label %exit, !prof !3
+exit:
+  ret void
+}
+
+!0 = !{!"function_entry_count", i64 10}
+!1 = !{!"branch_weights", i32 99, i32 1}
+!2 = !{!"function_entry_count", i64 1}
+!3 = !{!"branch_weights", i32 9, i32 1}
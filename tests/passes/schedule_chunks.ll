@@ -0,0 +1,82 @@
+; The false-sharing advice rounds the schedule chunk up to whole cache
+; lines. The schedule details must quote the clause the pragma ends up with.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<threads=8>' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK-NOT: "clause": "schedule(dynamic)"
+; CHECK-NOT: "clause": "schedule(guided)"
+; CHECK-DAG: "suggested_patch": "#pragma omp parallel for schedule(dynamic, 8)\n// Note: chunk rounded up to 8 iterations
+; CHECK-DAG: "clause": "schedule(dynamic, 8)",
+; CHECK-DAG: "reason": "the trip count of an inner loop varies non-linearly with the parallel index; with schedule(dynamic, 8) threads take the next chunk when they finish one; chunk rounded up to 8 iterations so chunks do not share cache lines",
+; CHECK-DAG: "suggested_patch": "#pragma omp parallel for schedule(guided, 8)\n// Note: chunk rounded up to 8 iterations
+; CHECK-DAG: "clause": "schedule(guided, 8)",
+; CHECK-NOT: "clause": "schedule(dynamic)"
+; CHECK-NOT: "clause": "schedule(guided)"
+
+; for i<n: for k=rp[i]..rp[i+1]-1: y[i] += v[k] * x[c[k]]
+define void @csr(i64* noalias %rp, i64* noalias %c, double* noalias %v, double* noalias %x, double* noalias %y, i64 %n) {
+entry:
+  %c0 = icmp sgt i64 %n, 0
+  br i1 %c0, label %outer, label %exit
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %prs = getelementptr inbounds i64, i64* %rp, i64 %i
+  %start = load i64, i64* %prs
+  %i1 = add nuw nsw i64 %i, 1
+  %pre = getelementptr inbounds i64, i64* %rp, i64 %i1
+  %end = load i64, i64* %pre
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %g = icmp slt i64 %start, %end
+  br i1 %g, label %inner, label %outer.latch
+inner:
+  %k = phi i64 [ %start, %outer ], [ %k.next, %inner ]
+  %pv = getelementptr inbounds double, double* %v, i64 %k
+  %vv = load double, double* %pv
+  %pc = getelementptr inbounds i64, i64* %c, i64 %k
+  %col = load i64, i64* %pc
+  %px = getelementptr inbounds double, double* %x, i64 %col
+  %vx = load double, double* %px
+  %m = fmul double %vv, %vx
+  %vy = load double, double* %py
+  %s = fadd double %vy, %m
+  store double %s, double* %py
+  %k.next = add nsw i64 %k, 1
+  %kc = icmp slt i64 %k.next, %end
+  br i1 %kc, label %inner, label %outer.latch
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %n
+  br i1 %ic, label %outer, label %exit
+exit:
+  ret void
+}
+
+
+; for i=1..255: for j<i*i: o[i] = o[i] + a[j]  (j-loop carries o[i])
+define void @quad(double* noalias %a, double* noalias %o) {
+entry:
+  br label %outer
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %sq = mul nuw nsw i64 %i, %i
+  %po = getelementptr inbounds double, double* %o, i64 %i
+  br label %inner
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %pa = getelementptr inbounds double, double* %a, i64 %j
+  %va = load double, double* %pa
+  %vo = load double, double* %po
+  %s = fadd double %va, %vo
+  store double %s, double* %po
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp ult i64 %j.next, %sq
+  br i1 %jc, label %inner, label %outer.latch
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp ult i64 %i.next, 256
+  br i1 %ic, label %outer, label %exit
+exit:
+  ret void
+}
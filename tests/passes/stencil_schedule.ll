@@ -0,0 +1,103 @@
+; Time-stepped stencils get a stencil candidate with a temporally blocked
+; schedule: trapezoids when the time loop swaps two buffers, a block
+; wavefront when the sweep updates a 2-D grid in place. Tile sizes come
+; from half of the L2 given here.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<l2-cache=1M;threads=8>' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK-DAG: "reason": "1-D star stencil, radius 1, 3 points, time loop (swap) - trapezoid schedule",
+; CHECK-DAG: "blocking": "trapezoid",
+; CHECK-DAG: "time_block": 16,
+; CHECK-DAG: "tile_width": 32768,
+; CHECK-DAG: "tile_bytes": 524288,
+; CHECK-DAG: "time_loop": "swap",
+; CHECK-DAG: "suggested_patch": "// ✅ Temporal blocking (trapezoid split tiling along i): {{.*}}\nconst long TLO = 0, THI = std::max<long>(1, steps);\nconst long LO = 1, HI = std::max<long>(2, -1 + n);\nconst long R = 1, BT = 16, W = 32768;\n
+
+; CHECK-DAG: "reason": "2-D star stencil, radius 1x1, 4 points, updated in place, time loop (in_place) - wavefront schedule",
+; CHECK-DAG: "blocking": "wavefront",
+; CHECK-DAG: "skew": 1,
+; CHECK-DAG: "tile_bytes": 4608,
+; CHECK-DAG: "time_loop": "in_place",
+; CHECK-DAG: "suggested_patch": "// ✅ Block wavefront: {{.*}}\nconst long ILO = 1, IHI = 255, JLO = 1, JHI = 255;\nconst long BI = 24, BJ = 24, SKEW = 1;\n
+
+; for (t < steps) { for (i = 1; i < n - 1; ++i) out[i] = in[i-1] + in[i] + in[i+1]; swap(in, out); }
+define void @jacobi1d(double* noalias %a, double* noalias %b, i64 %n, i64 %steps) {
+entry:
+  %hi = add nsw i64 %n, -1
+  br label %t.loop
+t.loop:
+  %t = phi i64 [ 0, %entry ], [ %t.next, %t.latch ]
+  %in = phi double* [ %a, %entry ], [ %out, %t.latch ]
+  %out = phi double* [ %b, %entry ], [ %in, %t.latch ]
+  br label %i.loop
+i.loop:
+  %i = phi i64 [ 1, %t.loop ], [ %i.next, %i.loop ]
+  %im = add nsw i64 %i, -1
+  %ip = add nsw i64 %i, 1
+  %pl = getelementptr inbounds double, double* %in, i64 %im
+  %pc = getelementptr inbounds double, double* %in, i64 %i
+  %pr = getelementptr inbounds double, double* %in, i64 %ip
+  %vl = load double, double* %pl
+  %vc = load double, double* %pc
+  %vr = load double, double* %pr
+  %s1 = fadd double %vl, %vc
+  %s2 = fadd double %s1, %vr
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  store double %s2, double* %po
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %hi
+  br i1 %ic, label %i.loop, label %t.latch
+t.latch:
+  %t.next = add nuw nsw i64 %t, 1
+  %tc = icmp slt i64 %t.next, %steps
+  br i1 %tc, label %t.loop, label %exit
+exit:
+  ret void
+}
+
+; for (t < steps) for (i = 1; i < 255; ++i) for (j = 1; j < 255; ++j)
+;   a[i][j] = a[i-1][j] + a[i+1][j] + a[i][j-1] + a[i][j+1]
+define void @seidel2d([256 x double]* %a, i64 %steps) {
+entry:
+  br label %t.loop
+t.loop:
+  %t = phi i64 [ 0, %entry ], [ %t.next, %t.latch ]
+  br label %i.loop
+i.loop:
+  %i = phi i64 [ 1, %t.loop ], [ %i.next, %i.latch ]
+  %im = add nsw i64 %i, -1
+  %ip = add nsw i64 %i, 1
+  br label %j.loop
+j.loop:
+  %j = phi i64 [ 1, %i.loop ], [ %j.next, %j.loop ]
+  %jm = add nsw i64 %j, -1
+  %jp = add nsw i64 %j, 1
+  %pn = getelementptr inbounds [256 x double], [256 x double]* %a, i64 %im, i64 %j
+  %ps = getelementptr inbounds [256 x double], [256 x double]* %a, i64 %ip, i64 %j
+  %pw = getelementptr inbounds [256 x double], [256 x double]* %a, i64 %i, i64 %jm
+  %pe = getelementptr inbounds [256 x double], [256 x double]* %a, i64 %i, i64 %jp
+  %vn = load double, double* %pn
+  %vs = load double, double* %ps
+  %vw = load double, double* %pw
+  %ve = load double, double* %pe
+  %s1 = fadd double %vn, %vs
+  %s2 = fadd double %s1, %vw
+  %s3 = fadd double %s2, %ve
+  %pc = getelementptr inbounds [256 x double], [256 x double]* %a, i64 %i, i64 %j
+  store double %s3, double* %pc
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, 255
+  br i1 %jc, label %j.loop, label %i.latch
+i.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, 255
+  br i1 %ic, label %i.loop, label %t.latch
+t.latch:
+  %t.next = add nuw nsw i64 %t, 1
+  %tc = icmp slt i64 %t.next, %steps
+  br i1 %tc, label %t.loop, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,97 @@
+; Loops that touch disjoint arrays become independent tasks; a later loop
+; reading both follows them through depend(in:) on their tokens.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: %FileCheck --input-file=%t.json %s
+
+; CHECK:      "task_graph": {
+; CHECK-NEXT:   "critical_path": [
+; CHECK-NEXT:     1,
+; CHECK-NEXT:     2
+; CHECK-NEXT:   ],
+; CHECK-NEXT:   "critical_path_cost": 19000,
+; CHECK-NEXT:   "parallelism": 1.42{{[0-9]*}},
+; CHECK-NEXT:   "tasks": [
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "cost": 8000,
+; CHECK-NEXT:       "depends_on": [],
+; CHECK:            "reads": [
+; CHECK-NEXT:         "a"
+; CHECK-NEXT:       ],
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "a"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     },
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "cost": 8000,
+; CHECK-NEXT:       "depends_on": [],
+; CHECK:            "reads": [
+; CHECK-NEXT:         "b"
+; CHECK-NEXT:       ],
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "b"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     },
+; CHECK-NEXT:     {
+; CHECK-NEXT:       "cost": 11000,
+; CHECK-NEXT:       "depends_on": [
+; CHECK-NEXT:         0,
+; CHECK-NEXT:         1
+; CHECK-NEXT:       ],
+; CHECK:            "reads": [
+; CHECK-NEXT:         "a",
+; CHECK-NEXT:         "b"
+; CHECK-NEXT:       ],
+; CHECK-NEXT:       "writes": [
+; CHECK-NEXT:         "c"
+; CHECK-NEXT:       ]
+; CHECK-NEXT:     }
+; CHECK-NEXT:   ],
+; CHECK-NEXT:   "width": 2,
+; CHECK-NEXT:   "work": 27000
+; CHECK:      "candidate_type": "task_graph",
+; CHECK:      "reason": "3 tasks over call sites and loop nests, up to 2 at a time; estimated parallelism 1.4",
+; CHECK-NEXT: "suggested_patch": "{{.*}}\n        #pragma omp task depend(out: dep[0])\n{{.*}}\n        #pragma omp task depend(out: dep[1])\n{{.*}}\n        // after task 0 (a), task 1 (b)\n        #pragma omp task depend(in: dep[0], dep[1]) depend(out: dep[2])\n
+
+; for (i < n) a[i] = 2 * a[i];  for (i < n) b[i] = b[i] + 1;  for (i < n) c[i] = a[i] + b[i];
+define void @three_sweeps(double* noalias %a, double* noalias %b, double* noalias %c, i64 %n) {
+entry:
+  br label %first
+first:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %first ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %va = load double, double* %pa
+  %ma = fmul double %va, 2.0
+  store double %ma, double* %pa
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %n
+  br i1 %ic, label %first, label %second.ph
+second.ph:
+  br label %second
+second:
+  %j = phi i64 [ 0, %second.ph ], [ %j.next, %second ]
+  %pb = getelementptr inbounds double, double* %b, i64 %j
+  %vb = load double, double* %pb
+  %sb = fadd double %vb, 1.0
+  store double %sb, double* %pb
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %n
+  br i1 %jc, label %second, label %third.ph
+third.ph:
+  br label %third
+third:
+  %k = phi i64 [ 0, %third.ph ], [ %k.next, %third ]
+  %qa = getelementptr inbounds double, double* %a, i64 %k
+  %qb = getelementptr inbounds double, double* %b, i64 %k
+  %xa = load double, double* %qa
+  %xb = load double, double* %qb
+  %s = fadd double %xa, %xb
+  %pc = getelementptr inbounds double, double* %c, i64 %k
+  store double %s, double* %pc
+  %k.next = add nuw nsw i64 %k, 1
+  %kc = icmp slt i64 %k.next, %n
+  br i1 %kc, label %third, label %exit
+exit:
+  ret void
+}
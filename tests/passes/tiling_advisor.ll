@@ -0,0 +1,80 @@
+; The tiling advisor sizes L1 tiles so the three 8-byte arrays of a matrix
+; multiply fill at most half of L1: 16x16 tiles (6 KiB) for a 32 KiB L1,
+; 32x32 tiles (24 KiB) for a 48 KiB L1. Integer elements keep the nest from
+; being replaced by cblas_dgemm.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.32k.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<l1-cache=32K;l2-cache=1M;cache-line=64;threads=8>' \
+; RUN:   -disable-output %s
+; RUN: %FileCheck --check-prefix=L1-32K --input-file=%t.32k.json %s
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.48k.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<l1-cache=48K;l2-cache=1M;cache-line=64;threads=8>' \
+; RUN:   -disable-output %s
+; RUN: %FileCheck --check-prefix=L1-48K --input-file=%t.48k.json %s
+
+; L1-32K:      "l1_tile_sizes": [
+; L1-32K-NEXT:   16,
+; L1-32K-NEXT:   16,
+; L1-32K-NEXT:   16
+; L1-32K-NEXT: ],
+; L1-32K-NEXT: "l1_working_set_bytes": 6144,
+; L1-32K-NEXT: "l2_tile_sizes": [
+; L1-32K-NEXT:   128,
+; L1-32K-NEXT:   128,
+; L1-32K-NEXT:   128
+; L1-32K-NEXT: ],
+; L1-32K-NEXT: "l2_working_set_bytes": 393216,
+; L1-32K:      "candidate_type": "matrix_multiply",
+; L1-32K:      "suggested_patch": "{{.*}}// Cache-tiled version - L1 tile 16 (6.0 KiB of 32.0 KiB L1), L2 tile 128 (384.0 KiB of 1.0 MiB L2)\n
+
+; L1-48K:      "l1_tile_sizes": [
+; L1-48K-NEXT:   32,
+; L1-48K-NEXT:   32,
+; L1-48K-NEXT:   32
+; L1-48K-NEXT: ],
+; L1-48K-NEXT: "l1_working_set_bytes": 24576,
+; L1-48K:      "suggested_patch": "{{.*}}// Cache-tiled version - L1 tile 32 (24.0 KiB of 48.0 KiB L1), L2 tile 128
+
+; for (i < n) for (j < n) for (k < n) C[i * n + j] += A[i * n + k] * B[k * n + j]
+define void @mm(i64* noalias %A, i64* noalias %B, i64* noalias %C, i64 %n) {
+entry:
+  %c0 = icmp sgt i64 %n, 0
+  br i1 %c0, label %ph, label %exit
+ph:
+  br label %li
+li:
+  %i = phi i64 [ 0, %ph ], [ %i.next, %li.latch ]
+  %in = mul nsw i64 %i, %n
+  br label %lj
+lj:
+  %j = phi i64 [ 0, %li ], [ %j.next, %lj.latch ]
+  %cij = add nsw i64 %in, %j
+  %pc = getelementptr inbounds i64, i64* %C, i64 %cij
+  br label %lk
+lk:
+  %k = phi i64 [ 0, %lj ], [ %k.next, %lk ]
+  %aik = add nsw i64 %in, %k
+  %pa = getelementptr inbounds i64, i64* %A, i64 %aik
+  %va = load i64, i64* %pa
+  %kn = mul nsw i64 %k, %n
+  %bkj = add nsw i64 %kn, %j
+  %pb = getelementptr inbounds i64, i64* %B, i64 %bkj
+  %vb = load i64, i64* %pb
+  %m = mul i64 %va, %vb
+  %vc = load i64, i64* %pc
+  %s = add i64 %vc, %m
+  store i64 %s, i64* %pc
+  %k.next = add nuw nsw i64 %k, 1
+  %kc = icmp slt i64 %k.next, %n
+  br i1 %kc, label %lk, label %lj.latch
+lj.latch:
+  %j.next = add nuw nsw i64 %j, 1
+  %jc = icmp slt i64 %j.next, %n
+  br i1 %jc, label %lj, label %li.latch
+li.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ic = icmp slt i64 %i.next, %n
+  br i1 %ic, label %li, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,66 @@
+; A time-step loop carries a dependence and holds two nests, so it has no
+; band of its own. The space nests inside it are analyzed as nests.
+;
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate' -disable-output %s
+; RUN: grep -E '"candidate_type"' %t.json | sort | %FileCheck %s
+; RUN: %FileCheck --check-prefix=NEST --input-file=%t.json %s
+
+; CHECK:      "candidate_type": "embarrassingly_parallel",
+; CHECK-NEXT: "candidate_type": "embarrassingly_parallel",
+; CHECK-NEXT: "candidate_type": "perfect_nest",
+; CHECK-NEXT: "candidate_type": "perfect_nest",
+; CHECK-NOT:  "candidate_type"
+
+; NEST-COUNT-2: "reason": "Perfect nest depth 2 of 2, rectangular band 2, 2 dependence-free outer level(s)"
+
+; for (t < steps) {
+;   for (i < 64) for (j < 64) a[i][j] = 2 * b[i][j];
+;   for (i < 64) for (j < 64) b[i][j] = a[i][j];
+; }
+define void @time_steps([64 x double]* noalias %a, [64 x double]* noalias %b, i64 %steps) {
+entry:
+  br label %t.loop
+t.loop:
+  %t = phi i64 [ 0, %entry ], [ %t.next, %t.latch ]
+  br label %i1.loop
+i1.loop:
+  %i1 = phi i64 [ 0, %t.loop ], [ %i1.next, %i1.latch ]
+  br label %j1.loop
+j1.loop:
+  %j1 = phi i64 [ 0, %i1.loop ], [ %j1.next, %j1.loop ]
+  %pb1 = getelementptr inbounds [64 x double], [64 x double]* %b, i64 %i1, i64 %j1
+  %vb1 = load double, double* %pb1
+  %m = fmul double %vb1, 2.0
+  %pa1 = getelementptr inbounds [64 x double], [64 x double]* %a, i64 %i1, i64 %j1
+  store double %m, double* %pa1
+  %j1.next = add nuw nsw i64 %j1, 1
+  %j1.c = icmp ult i64 %j1.next, 64
+  br i1 %j1.c, label %j1.loop, label %i1.latch
+i1.latch:
+  %i1.next = add nuw nsw i64 %i1, 1
+  %i1.c = icmp ult i64 %i1.next, 64
+  br i1 %i1.c, label %i1.loop, label %i2.loop
+i2.loop:
+  %i2 = phi i64 [ 0, %i1.latch ], [ %i2.next, %i2.latch ]
+  br label %j2.loop
+j2.loop:
+  %j2 = phi i64 [ 0, %i2.loop ], [ %j2.next, %j2.loop ]
+  %pa2 = getelementptr inbounds [64 x double], [64 x double]* %a, i64 %i2, i64 %j2
+  %va2 = load double, double* %pa2
+  %pb2 = getelementptr inbounds [64 x double], [64 x double]* %b, i64 %i2, i64 %j2
+  store double %va2, double* %pb2
+  %j2.next = add nuw nsw i64 %j2, 1
+  %j2.c = icmp ult i64 %j2.next, 64
+  br i1 %j2.c, label %j2.loop, label %i2.latch
+i2.latch:
+  %i2.next = add nuw nsw i64 %i2, 1
+  %i2.c = icmp ult i64 %i2.next, 64
+  br i1 %i2.c, label %i2.loop, label %t.latch
+t.latch:
+  %t.next = add nuw nsw i64 %t, 1
+  %t.c = icmp slt i64 %t.next, %steps
+  br i1 %t.c, label %t.loop, label %exit
+exit:
+  ret void
+}
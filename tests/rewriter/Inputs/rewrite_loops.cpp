@@ -0,0 +1,15 @@
+// Loops for pragma_rewriter.ll, whose debug locations point at these lines
+void scale(double *a, long n) {
+  a[0] = 1.0; for (long i = 1; i < n; ++i)
+    a[i] *= 2.0;
+}
+
+void shift(double *a, long n) {
+#pragma omp parallel for
+  for (long i = 0; i < n; ++i)
+    a[i] += 1.0;
+}
+
+void bump(double *a, double *b, long n) {
+  for (long i = 0; i < n; ++i) a[i] += 1.0; for (long i = 0; i < n; ++i) b[i] += 2.0;
+}
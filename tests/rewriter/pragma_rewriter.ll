@@ -0,0 +1,130 @@
+; pragma-rewriter inserts each directive above the loop statement that the
+; candidate's loop_range names, in Inputs/rewrite_loops.cpp:
+;   scale  a loop after other code on its line: the line is split
+;   shift  a loop that already has a pragma: skipped
+;   bump   two loops on one line: the first gets the directive, the second
+;          is dropped and reported
+;
+; RUN: rm -rf %t.d && mkdir -p %t.d && cp %S/Inputs/rewrite_loops.cpp %t.d/
+; RUN: PARALLEL_ANALYSIS_OUTPUT=%t.d/candidates.json %opt -load-pass-plugin=%plugin \
+; RUN:   -passes='loop-simplify,parallel-candidate<threads=8>' -disable-output %s
+; RUN: cd %t.d && %pragma_rewriter -candidates=candidates.json rewrite_loops.cpp -- \
+; RUN:   > %t.diff 2> %t.err
+; RUN: %FileCheck --input-file=%t.diff %s
+; RUN: %FileCheck --check-prefix=ERR --input-file=%t.err %s
+
+; CHECK:      --- {{.*}}rewrite_loops.cpp
+; CHECK-NEXT: +++ {{.*}}rewrite_loops.cpp
+; CHECK-NEXT: @@ -1,6 +1,8 @@
+; CHECK:      -  a[0] = 1.0; for (long i = 1; i < n; ++i)
+; CHECK-NEXT: +  a[0] = 1.0;
+; CHECK-NEXT: +  #pragma omp parallel for
+; CHECK-NEXT: +  for (long i = 1; i < n; ++i)
+; CHECK-NEXT:        a[i] *= 2.0;
+; CHECK-NEXT:  }
+; CHECK-NEXT: {{^ $}}
+; CHECK-NEXT: @@ -11,5 +13,6 @@
+; CHECK-NEXT:  }
+; CHECK-NEXT: {{^ $}}
+; CHECK-NEXT:  void bump(double *a, double *b, long n) {
+; CHECK-NEXT: +  #pragma omp parallel for
+; CHECK-NEXT:    for (long i = 0; i < n; ++i) a[i] += 1.0; for (long i = 0; i < n; ++i) b[i] += 2.0;
+; CHECK-NEXT:  }
+; CHECK-NOT:  {{.}}
+
+; ERR:     rewrite_loops.cpp:9 already has a loop directive, skipped
+; ERR:     rewrite_loops.cpp:14:45 dropped embarrassingly_parallel, the line already takes a directive
+; ERR:     pragma-rewriter: 2 directive(s) in 1 file(s), 0 unmatched, 1 dropped
+
+define void @scale(double* noalias %a, i64 %n) !dbg !10 {
+entry:
+  store double 1.0, double* %a, !dbg !11
+  br label %loop, !dbg !12
+loop:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %a, i64 %i, !dbg !13
+  %v = load double, double* %p, !dbg !13
+  %m = fmul double %v, 2.0, !dbg !13
+  store double %m, double* %p, !dbg !13
+  %i.next = add nuw nsw i64 %i, 1, !dbg !12
+  %c = icmp slt i64 %i.next, %n, !dbg !12
+  br i1 %c, label %loop, label %exit, !dbg !12, !llvm.loop !14
+exit:
+  ret void, !dbg !16
+}
+
+define void @shift(double* noalias %a, i64 %n) !dbg !20 {
+entry:
+  br label %loop, !dbg !21
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds double, double* %a, i64 %i, !dbg !22
+  %v = load double, double* %p, !dbg !22
+  %s = fadd double %v, 1.0, !dbg !22
+  store double %s, double* %p, !dbg !22
+  %i.next = add nuw nsw i64 %i, 1, !dbg !21
+  %c = icmp slt i64 %i.next, %n, !dbg !21
+  br i1 %c, label %loop, label %exit, !dbg !21, !llvm.loop !23
+exit:
+  ret void, !dbg !25
+}
+
+define void @bump(double* noalias %a, double* noalias %b, i64 %n) !dbg !30 {
+entry:
+  br label %first, !dbg !31
+first:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %first ]
+  %pa = getelementptr inbounds double, double* %a, i64 %i, !dbg !31
+  %va = load double, double* %pa, !dbg !31
+  %sa = fadd double %va, 1.0, !dbg !31
+  store double %sa, double* %pa, !dbg !31
+  %i.next = add nuw nsw i64 %i, 1, !dbg !31
+  %c = icmp slt i64 %i.next, %n, !dbg !31
+  br i1 %c, label %first, label %mid, !dbg !31, !llvm.loop !32
+mid:
+  br label %second, !dbg !34
+second:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %second ]
+  %pb = getelementptr inbounds double, double* %b, i64 %j, !dbg !34
+  %vb = load double, double* %pb, !dbg !34
+  %sb = fadd double %vb, 2.0, !dbg !34
+  store double %sb, double* %pb, !dbg !34
+  %j.next = add nuw nsw i64 %j, 1, !dbg !34
+  %d = icmp slt i64 %j.next, %n, !dbg !34
+  br i1 %d, label %second, label %exit, !dbg !34, !llvm.loop !35
+exit:
+  ret void, !dbg !37
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!2, !3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C_plus_plus_14, file: !1, emissionKind: FullDebug)
+!1 = !DIFile(filename: "rewrite_loops.cpp", directory: ".")
+!2 = !{i32 2, !"Debug Info Version", i32 3}
+!3 = !{i32 7, !"Dwarf Version", i32 5}
+!4 = !DISubroutineType(types: !{})
+
+!10 = distinct !DISubprogram(name: "scale", scope: !1, file: !1, line: 2, type: !4, unit: !0, spFlags: DISPFlagDefinition)
+!11 = !DILocation(line: 3, column: 8, scope: !10)
+!12 = !DILocation(line: 3, column: 15, scope: !10)
+!13 = !DILocation(line: 4, column: 10, scope: !10)
+!14 = distinct !{!14, !12, !15}
+!15 = !DILocation(line: 4, column: 16, scope: !10)
+!16 = !DILocation(line: 5, column: 1, scope: !10)
+
+!20 = distinct !DISubprogram(name: "shift", scope: !1, file: !1, line: 7, type: !4, unit: !0, spFlags: DISPFlagDefinition)
+!21 = !DILocation(line: 9, column: 3, scope: !20)
+!22 = !DILocation(line: 10, column: 10, scope: !20)
+!23 = distinct !{!23, !21, !24}
+!24 = !DILocation(line: 10, column: 16, scope: !20)
+!25 = !DILocation(line: 11, column: 1, scope: !20)
+
+!30 = distinct !DISubprogram(name: "bump", scope: !1, file: !1, line: 13, type: !4, unit: !0, spFlags: DISPFlagDefinition)
+!31 = !DILocation(line: 14, column: 3, scope: !30)
+!32 = distinct !{!32, !31, !33}
+!33 = !DILocation(line: 14, column: 43, scope: !30)
+!34 = !DILocation(line: 14, column: 45, scope: !30)
+!35 = distinct !{!35, !34, !36}
+!36 = !DILocation(line: 14, column: 85, scope: !30)
+!37 = !DILocation(line: 15, column: 1, scope: !30)
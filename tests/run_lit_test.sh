@@ -0,0 +1,55 @@
+#!/bin/bash
+# Runs the "; RUN:" lines of one pass test, lit style, with substitutions:
+#   %s        the test file          %t  a scratch path for this test
+#   %S        the test's directory
+#   %opt      opt                    %FileCheck  FileCheck
+#   %plugin   the ParallelCandidatePass plugin
+#   %llc      llc                    %cxx  the C++ compiler
+#   %loop_profile, %dependence_profile  the runtime libraries
+#   %pragma_rewriter  the pragma-rewriter tool
+# Substitutions come from CTest as name=value arguments before the test.
+#
+# Usage: run_lit_test.sh [name=value...] test.ll
+
+set -e
+
+declare -A subst
+while [[ $# -gt 1 ]]; do
+    subst["%${1%%=*}"]="${1#*=}"
+    shift
+done
+test_file="$1"
+name=$(basename "$test_file" .ll)
+mkdir -p Output
+subst["%s"]="$test_file"
+subst["%S"]=$(dirname "$test_file")
+subst["%t"]="$PWD/Output/$name.tmp"
+
+# Joined RUN lines; a trailing '\' continues on the next RUN line
+commands=()
+current=""
+while IFS= read -r line; do
+    [[ "$line" =~ ^\;\ RUN:\ ?(.*)$ ]] || continue
+    text="${BASH_REMATCH[1]}"
+    if [[ "$text" == *\\ ]]; then
+        current+="${text%\\} "
+        continue
+    fi
+    commands+=("$current$text")
+    current=""
+done < "$test_file"
+
+if [[ ${#commands[@]} -eq 0 ]]; then
+    echo "$test_file: no RUN lines" >&2
+    exit 1
+fi
+
+# Longest names first so %t does not eat the start of %tsc-like names
+keys=$(printf '%s\n' "${!subst[@]}" | awk '{ print length, $0 }' | sort -rn | cut -d' ' -f2-)
+for command in "${commands[@]}"; do
+    while IFS= read -r key; do
+        command="${command//$key/${subst[$key]}}"
+    done <<< "$keys"
+    echo "RUN: $command"
+    bash -o pipefail -c "$command"
+done